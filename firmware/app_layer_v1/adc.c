@@ -32,6 +32,7 @@
 #include <assert.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 #include <libpic30.h>
 
 
@@ -39,6 +40,10 @@
 #include "logging.h"
 #include "protocol.h"
 #include "pins.h"
+#include "control.h"
+#include "reflex.h"
+#include "sync.h"
+#include "timebase.h"
 
 static unsigned int analog_scan_bitmask;
 static int analog_scan_num_channels;
@@ -53,10 +58,128 @@ static uint16_t capsense_current = 15;
 // Set to true before triggering a sample to designate this is a cap-sense
 // sample.
 static bool capsense_sample = false;
+// Per-channel reporting setup, as requested by the client: channel k is
+// reported every (channel_decimation[k] + 1) scans, averaged over these scans
+// iff bit k of oversample_bitmask is set.
+static BYTE channel_decimation[16];
+static uint16_t oversample_bitmask;
+// A due channel is only reported when its value moved by more than
+// channel_deadband[k] (in 10-bit units) since it was last reported.
+static WORD channel_deadband[16];
+// Set once the client has configured decimation. From then on frames carry a
+// bitmap of the channels they contain.
+static bool extended_frames;
+// Whether frames are delta encoded, and how many frames apart the keyframes
+// are (0 for none).
+static bool delta_frames;
+static BYTE delta_keyframe_interval;
+// Set when the above changed and the new format has not been reported yet.
+static bool format_dirty;
+// The setup in effect, latched when the format is reported. Only touched from
+// the T3 and scan-done interrupts (or when these can't fire).
+static BYTE active_decimation[16];
+static uint16_t active_oversample_bitmask;
+static WORD active_deadband[16];
+static bool active_extended_frames;
+static bool active_delta_frames;
+static BYTE active_keyframe_interval;
+// Frames sent since the last keyframe.
+static BYTE frames_since_keyframe;
+// Scans left until channel k is due, and the sum of its samples so far.
+static BYTE channel_countdown[16];
+static WORD channel_sum[16];
+// The value last reported for channel k, valid iff bit k of
+// reported_bitmask is set.
+static WORD channel_reported[16];
+static uint16_t reported_bitmask;
+// Channel k goes through channel_filter[k] iff bit k of filter_bitmask is set,
+// before anything else sees its samples. Owned by the scan done interrupt,
+// which keeps the filtered scan in filtered_scan.
+static ADC_FILTER channel_filter[16];
+static uint16_t filter_bitmask;
+static unsigned int filtered_scan[16];
+// Burst capture into RAM. From arming until the capture is done, it owns the
+// ADC and the periodic scan is paused.
+typedef enum {
+  CAPTURE_IDLE,
+  CAPTURE_ARMED,
+  CAPTURE_RUNNING,
+  CAPTURE_DONE,
+  CAPTURE_READING
+} CAPTURE_STATE;
+
+#if ADC_CAPTURE_BUF_SIZE
+static __eds__ WORD capture_buf[ADC_CAPTURE_BUF_SIZE] __attribute__((eds));
+#endif
+static volatile CAPTURE_STATE capture_state;
+static bool capture_owns_adc;
+static bool capture_overflow;
+static int capture_num_pins;
+// capture_order[j] is the position in the client's pin list of the j'th
+// channel in scan order, that is, by ascending channel number.
+static BYTE capture_order[ADC_CAPTURE_MAX_PINS];
+static int capture_scans_per_int;
+// The buffer half holding the next samples to read.
+static int capture_half;
+// All counts are in samples.
+static unsigned int capture_total;
+static volatile unsigned int capture_count;
+static unsigned int capture_reported;
+static unsigned int capture_read_pos;
+// AD1CSSL of the periodic scan, while a capture is using the register.
+static unsigned int capture_saved_cssl;
+// Analog trigger. While engaged, every scan goes into a circular history
+// instead of being reported, and only the window of scans around the point
+// where the condition fired is sent.
+typedef enum {
+  TRIGGER_OFF,
+  TRIGGER_ARMED,
+  TRIGGER_TRIGGERED,
+  TRIGGER_STOPPED
+} TRIGGER_STATE;
+
+static __eds__ WORD trigger_buf[ADC_TRIGGER_BUF_SIZE] __attribute__((eds));
+static volatile TRIGGER_STATE trigger_state;
+// The condition, as requested by the client.
+static int trigger_mode;
+static int trigger_pin;
+static bool trigger_invert;
+static bool trigger_repeat;
+static WORD trigger_low;
+static WORD trigger_high;
+static unsigned int trigger_pre;
+static unsigned int trigger_post;
+// Derived from the scan format when arming: its channel mask, samples per
+// scan, the position of the trigger pin in a scan, and how many scans the
+// history holds.
+static unsigned int trigger_mask;
+static int trigger_num_channels;
+static int trigger_index;
+static unsigned int trigger_capacity;
+// Recording, in scans: the next slot to write, how many scans we have before
+// the current one (up to trigger_pre), and whether an edge condition has seen
+// the level on its starting side.
+static unsigned int trigger_write;
+static unsigned int trigger_filled;
+static bool trigger_ready;
+// The window: its first slot, how many of its scans are recorded, and how many
+// of its samples have been sent.
+static unsigned int trigger_start;
+static volatile unsigned int trigger_recorded;
+static unsigned int trigger_read_pos;
+// When the current analog scan was triggered.
+static DWORD scan_time;
 // Used to decide whether or not to enable T3 interrupt. When 0, interrupt
 // should be enabled, otherwise, disabled.
 static int t3_int_counter;
 
+// system clock, 31 Tad acquisition time, ADC clock @8MHz
+#define SCAN_AD1CON3 0x1F01
+
+// Captured and trigger window data are only streamed while the outgoing queue
+// holds less than this, leaving room for other messages.
+#define CAPTURE_TX_QUEUE_LIMIT 4096
+
 // we need to generate a priority 1 interrupt in order to send a message
 // containing ADC-captured data.
 // this is the reasononing:
@@ -80,7 +203,7 @@ static inline void ScanDoneInterruptTrigger() {
 }
 
 // timer 3 is clocked @2MHz
-// we set its period to 2000 so that a match occurs @1KHz
+// we set its period to 2000 so that a match occurs @1KHz by default
 // used for ADC
 static inline void Timer3Init() {
   PR3   = 1999;  // period is 2000 clocks = 1KHz
@@ -135,7 +258,7 @@ void ADCInit() {
   // Now nothing will interrupt us
   AD1CON1 = 0x0000;  // ADC off.
   AD1CON2 = 0x0000;  // Avdd Avss ref, single buffer, interrupt on every sample
-  AD1CON3 = 0x1F01;  // system clock, 31 Tad acquisition time, ADC clock @8MHz
+  AD1CON3 = SCAN_AD1CON3;
   AD1CHS  = 0x0000;  // Sample AN0 against negative reference.
   AD1CSSL = 0x0000;  // reset scan mask.
 
@@ -154,67 +277,367 @@ void ADCInit() {
   analog_scan_num_channels = 0;
   capsense_bitmask = 0x0000;
   capsense_dirty_bitmask = 0x0000;
+
+  memset(channel_decimation, 0, sizeof channel_decimation);
+  oversample_bitmask = 0x0000;
+  memset(channel_deadband, 0, sizeof channel_deadband);
+  extended_frames = false;
+  delta_frames = false;
+  delta_keyframe_interval = 0;
+  format_dirty = false;
+  filter_bitmask = 0x0000;
+
+  capture_state = CAPTURE_IDLE;
+  capture_owns_adc = false;
+
+  trigger_state = TRIGGER_OFF;
+  trigger_mode = ADC_TRIGGER_OFF;
 }
 
-static inline int CountOnes(unsigned int val) {
-  int res = 0;
-  while (val) {
-    if (val & 1) ++res;
-    val >>= 1;
+static inline void ChannelReported(int channel, WORD value) {
+  channel_reported[channel] = value;
+  reported_bitmask |= 1 << channel;
+}
+
+// Delta encoding of 10-bit values, as a stream of bits, LSb first, padded to a
+// whole byte. Each value is one of:
+// 0 + 4 bits: difference from the previous value of the channel, in [-8, 7].
+// 1 + 0 + 7 bits: difference in [-64, 63].
+// 1 + 1 + 10 bits: the value itself.
+typedef struct {
+  BYTE* out;
+  int size;
+  DWORD bits;
+  int num_bits;
+} DELTA_ENCODER;
+
+static inline void DeltaPut(DELTA_ENCODER* enc, WORD code, int num_bits) {
+  enc->bits |= (DWORD) code << enc->num_bits;
+  enc->num_bits += num_bits;
+  while (enc->num_bits >= 8) {
+    enc->out[enc->size++] = enc->bits;
+    enc->bits >>= 8;
+    enc->num_bits -= 8;
   }
-  return res;
 }
 
-static inline void ReportAnalogInStatus() {
-  volatile unsigned int* buf = &ADC1BUF0;
-  int num_channels = CountOnes(AD1CSSL);
+// Encodes a value of a channel against the value last reported. keyframe
+// forces the whole value. The caller records the value as reported once the
+// frame is actually queued, so that a dropped frame leaves the predictor
+// where the client's decoder is.
+static inline void DeltaEncode(DELTA_ENCODER* enc, int channel, WORD value,
+                               bool keyframe) {
+  int diff = value - channel_reported[channel];
+  if (keyframe || !(reported_bitmask & (1 << channel))) {
+    DeltaPut(enc, 3 | (value << 2), 12);
+  } else if (diff >= -8 && diff < 8) {
+    DeltaPut(enc, (diff & 0xF) << 1, 5);
+  } else if (diff >= -64 && diff < 64) {
+    DeltaPut(enc, 1 | ((diff & 0x7F) << 2), 9);
+  } else {
+    DeltaPut(enc, 3 | (value << 2), 12);
+  }
+}
+
+static inline void DeltaFlush(DELTA_ENCODER* enc) {
+  if (enc->num_bits) {
+    enc->out[enc->size++] = enc->bits;
+  }
+}
+
+// Whether the frame about to be sent is to be a keyframe.
+static inline bool KeyframeDue() {
+  return active_keyframe_interval
+      && frames_since_keyframe + 1 == active_keyframe_interval;
+}
+
+// Advances the keyframe counter, once a delta frame has been queued.
+static inline void DeltaFrameSent(bool keyframe) {
+  if (active_keyframe_interval) {
+    frames_since_keyframe = keyframe ? 0 : frames_since_keyframe + 1;
+  }
+}
+
+// Delta encoded frame of all scanned channels.
+static inline void ReportAnalogInStatusAllDelta(
+    const volatile unsigned int* buf) {
+  WORD values[16];
+  BYTE channels[16];
+  BYTE out[24];
+  DELTA_ENCODER enc = { out, 0, 0, 0 };
+  unsigned int mask = AD1CSSL;
+  bool keyframe = KeyframeDue();
+  int channel = 0;
+  int num_channels = 0;
+  int i;
+  OUTGOING_MESSAGE_BUFFER var_arg;
+  OUTGOING_MESSAGE msg;
+
+  for (; mask; mask >>= 1, ++channel) {
+    if (!(mask & 1)) continue;
+    channels[num_channels] = channel;
+    values[num_channels] = buf[num_channels];
+    DeltaEncode(&enc, channel, values[num_channels], keyframe);
+    ++num_channels;
+  }
+  DeltaFlush(&enc);
+  msg.type = REPORT_ANALOG_IN_STATUS;
+  TimebaseStamp(TIMESTAMP_ANALOG, scan_time);
+  if (!AppProtocolBeginMessage(&msg, enc.size, &var_arg)) return;
+  AppProtocolMessageWrite(&var_arg, 0, out, enc.size);
+  AppProtocolEndMessage(enc.size);
+
+  for (i = 0; i < num_channels; ++i) {
+    ChannelReported(channels[i], values[i]);
+  }
+  DeltaFrameSent(keyframe);
+}
+
+static inline void ReportAnalogInStatusAll(const volatile unsigned int* buf) {
+  int num_channels = ADCCountOnes(AD1CSSL);
   int i;
-  BYTE var_arg[16 / 4 * 5];
+  OUTGOING_MESSAGE_BUFFER var_arg;
   int var_arg_pos = 0;
-  int group_header_pos;
+  BYTE* group_header;
   int pos_in_group;
   int value;
   OUTGOING_MESSAGE msg;
   msg.type = REPORT_ANALOG_IN_STATUS;
+  TimebaseStamp(TIMESTAMP_ANALOG, scan_time);
+  // Serialize straight into the outgoing buffer: a group header for every 4
+  // channels plus a byte per channel.
+  if (!AppProtocolBeginMessage(&msg, num_channels + (num_channels + 3) / 4,
+                               &var_arg)) {
+    return;
+  }
   for (i = 0; i < num_channels; i++) {
     pos_in_group = i & 3;
     if (pos_in_group == 0) {
-      group_header_pos = var_arg_pos;
-      var_arg[var_arg_pos++] = 0;  // reset header
+      group_header = AppProtocolMessageByte(&var_arg, var_arg_pos++);
+      *group_header = 0;  // reset header
     }
     value = buf[i];
     //log_printf("%d", value);
-    var_arg[group_header_pos] |= (value & 3) << (pos_in_group * 2);  // two LSb to group header
-    var_arg[var_arg_pos++] = value >> 2;  // eight MSb to channel byte
+    *group_header |= (value & 3) << (pos_in_group * 2);  // two LSb to group header
+    *AppProtocolMessageByte(&var_arg, var_arg_pos++) = value >> 2;  // eight MSb to channel byte
+  }
+  AppProtocolEndMessage(var_arg_pos);
+}
+
+// Whether a due value of a channel is worth reporting, given its deadband.
+static inline bool ChannelChanged(int channel, WORD value, bool wide) {
+  WORD band = active_deadband[channel];
+  WORD last = channel_reported[channel];
+  if (band && (reported_bitmask & (1 << channel))) {
+    if (wide) band <<= 6;
+    if ((value > last ? value - last : last - value) <= band) return false;
+  }
+  return true;
+}
+
+// Extended frame: a 16-bit bitmap of the scanned channels present in this
+// frame (bit i stands for the i'th pin in the format), then the plain channels
+// packed as above, then the oversampled ones as 16-bit values. Channels are
+// present when due, and changed beyond their deadband.
+static inline void ReportAnalogInStatusDue(const volatile unsigned int* buf) {
+  WORD values[16];
+  BYTE channels[16];
+  BYTE delta[24];
+  DELTA_ENCODER enc = { delta, 0, 0, 0 };
+  bool keyframe = false;
+  uint16_t due = 0;
+  uint16_t wide = 0;
+  int num_narrow = 0;
+  int num_wide = 0;
+  unsigned int mask = AD1CSSL;
+  uint16_t channel_mask = 1;
+  int channel = 0;
+  int num_channels = 0;
+  int i;
+  OUTGOING_MESSAGE_BUFFER var_arg;
+  int var_arg_pos = 0;
+  BYTE* group_header;
+  int pos_in_group = 0;
+  OUTGOING_MESSAGE msg;
+
+  // Accumulate and find out who's due.
+  for (; mask; mask >>= 1, channel_mask <<= 1, ++channel) {
+    if (!(mask & 1)) continue;
+    int value = buf[num_channels];
+    channels[num_channels] = channel;
+    if (active_oversample_bitmask & channel_mask) {
+      channel_sum[channel] += value;
+    }
+    if (channel_countdown[channel]-- == 0) {
+      channel_countdown[channel] = active_decimation[channel];
+      if (active_oversample_bitmask & channel_mask) {
+        values[num_channels] =
+            ((DWORD) channel_sum[channel] << 6) / (active_decimation[channel] + 1);
+        channel_sum[channel] = 0;
+        if (ChannelChanged(channel, values[num_channels], true)) {
+          due |= 1 << num_channels;
+          wide |= 1 << num_channels;
+          ++num_wide;
+        }
+      } else {
+        values[num_channels] = value;
+        if (ChannelChanged(channel, value, false)) {
+          due |= 1 << num_channels;
+          ++num_narrow;
+        }
+      }
+    }
+    ++num_channels;
+  }
+  if (!due) return;
+
+  if (active_delta_frames) {
+    keyframe = KeyframeDue();
+    for (i = 0; i < num_channels; ++i) {
+      if (!(due & ~wide & (1 << i))) continue;
+      DeltaEncode(&enc, channels[i], values[i], keyframe);
+    }
+    DeltaFlush(&enc);
+  }
+
+  msg.type = REPORT_ANALOG_IN_STATUS;
+  TimebaseStamp(TIMESTAMP_ANALOG, scan_time);
+  if (!AppProtocolBeginMessage(&msg,
+                               2 + (active_delta_frames
+                                    ? enc.size
+                                    : num_narrow + (num_narrow + 3) / 4)
+                               + 2 * num_wide,
+                               &var_arg)) {
+    return;
+  }
+  *AppProtocolMessageByte(&var_arg, var_arg_pos++) = due & 0xFF;
+  *AppProtocolMessageByte(&var_arg, var_arg_pos++) = due >> 8;
+  if (active_delta_frames) {
+    AppProtocolMessageWrite(&var_arg, var_arg_pos, delta, enc.size);
+    var_arg_pos += enc.size;
+  } else {
+    for (i = 0; i < num_channels; ++i) {
+      if (!(due & ~wide & (1 << i))) continue;
+      if (pos_in_group == 0) {
+        group_header = AppProtocolMessageByte(&var_arg, var_arg_pos++);
+        *group_header = 0;
+      }
+      *group_header |= (values[i] & 3) << (pos_in_group * 2);
+      *AppProtocolMessageByte(&var_arg, var_arg_pos++) = values[i] >> 2;
+      pos_in_group = (pos_in_group + 1) & 3;
+      ChannelReported(channels[i], values[i]);
+    }
+  }
+  for (i = 0; i < num_channels; ++i) {
+    if (!(wide & (1 << i))) continue;
+    ChannelReported(channels[i], values[i]);
+    *AppProtocolMessageByte(&var_arg, var_arg_pos++) = values[i] & 0xFF;
+    *AppProtocolMessageByte(&var_arg, var_arg_pos++) = values[i] >> 8;
+  }
+  AppProtocolEndMessage(var_arg_pos);
+
+  if (active_delta_frames) {
+    for (i = 0; i < num_channels; ++i) {
+      if (due & ~wide & (1 << i)) ChannelReported(channels[i], values[i]);
+    }
+    DeltaFrameSent(keyframe);
+  }
+}
+
+static inline void ReportAnalogInStatus(const volatile unsigned int* buf) {
+  if (active_extended_frames) {
+    ReportAnalogInStatusDue(buf);
+  } else if (active_delta_frames) {
+    ReportAnalogInStatusAllDelta(buf);
+  } else {
+    ReportAnalogInStatusAll(buf);
   }
-  AppProtocolSendMessageWithVarArg(&msg, var_arg, var_arg_pos);
 }
 
 static inline void ReportCapSense() {
   OUTGOING_MESSAGE msg;
   msg.type = CAPSENSE_REPORT;
   msg.args.capsense_report.pin = PinFromAnalogChannel(capsense_current);
-  msg.args.capsense_report.value = ADC1BUF0;
+  msg.args.capsense_report.value =
+      filter_bitmask & (1 << capsense_current)
+      ? ADCFilterApply(&channel_filter[capsense_current], ADC1BUF0)
+      : ADC1BUF0;
   AppProtocolSendMessage(&msg);
 }
 
+static void ReportTriggerStatus() {
+  OUTGOING_MESSAGE msg;
+  msg.type = ANALOG_TRIGGER_STATUS;
+  msg.args.analog_trigger_status.state = trigger_state;
+  AppProtocolSendMessage(&msg);
+}
+
+// Arms the trigger for the scan format given by mask, with an empty history.
+// Stops it instead if the trigger pin is not in the format, or the window does
+// not fit in the history. Call with the scan interrupts held off.
+static void TriggerRestart(unsigned int mask) {
+  int channel = PinToAnalogChannel(trigger_pin);
+  trigger_mask = mask;
+  trigger_num_channels = ADCCountOnes(mask);
+  trigger_capacity = trigger_num_channels
+                     ? ADC_TRIGGER_BUF_SIZE / trigger_num_channels : 0;
+  if (channel != -1 && (mask & (1 << channel))
+      && trigger_pre + trigger_post <= trigger_capacity) {
+    trigger_index = ADCCountOnes(mask & ((1 << channel) - 1));
+    trigger_write = 0;
+    trigger_filled = 0;
+    trigger_ready = false;
+    trigger_state = TRIGGER_ARMED;
+  } else {
+    trigger_state = TRIGGER_STOPPED;
+  }
+  ReportTriggerStatus();
+}
+
+// Reports the format and puts it into effect: the channel list, and in
+// extended mode, whether each channel is oversampled (bit 7 of its pin byte).
+// Restarts decimation for all channels, and has each reported on its next due
+// scan regardless of its deadband.
 static inline void ReportAnalogInFormat() {
   unsigned int mask = analog_scan_bitmask;
   int channel = 0;
   BYTE var_arg[16];
   int var_arg_pos = 0;
   OUTGOING_MESSAGE msg;
+
+  active_extended_frames = extended_frames;
+  active_oversample_bitmask = oversample_bitmask;
+  memcpy(active_decimation, channel_decimation, sizeof active_decimation);
+  memcpy(channel_countdown, channel_decimation, sizeof channel_countdown);
+  memset(channel_sum, 0, sizeof channel_sum);
+  memcpy(active_deadband, channel_deadband, sizeof active_deadband);
+  reported_bitmask = 0x0000;
+  active_delta_frames = delta_frames;
+  active_keyframe_interval = delta_keyframe_interval;
+  frames_since_keyframe = 0;
+  format_dirty = false;
+
   msg.type = REPORT_ANALOG_IN_FORMAT;
   msg.args.report_analog_in_format.num_pins = analog_scan_num_channels;
+  msg.args.report_analog_in_format.delta = active_delta_frames;
+  msg.args.report_analog_in_format.extended = active_extended_frames;
   while (mask) {
     if (mask & 1) {
-      var_arg[var_arg_pos++] = PinFromAnalogChannel(channel);
+      var_arg[var_arg_pos] = PinFromAnalogChannel(channel);
+      if (active_extended_frames && (active_oversample_bitmask & (1 << channel))) {
+        var_arg[var_arg_pos] |= 0x80;
+      }
+      ++var_arg_pos;
     }
     mask >>= 1;
     ++channel;
   }
   AppProtocolSendMessageWithVarArg(&msg, var_arg, var_arg_pos);
   AD1CSSL = analog_scan_bitmask;
+  // A window recorded in the old format can't be sent after the new one.
+  if (trigger_mode != ADC_TRIGGER_OFF && trigger_mask != analog_scan_bitmask) {
+    TriggerRestart(analog_scan_bitmask);
+  }
 }
 
 
@@ -280,87 +703,513 @@ static inline void ADCCapSenseTrigger() {
   }
 }
 
+// Whether the periodic scan should be running: there is something to sample
+// and no capture has taken over the ADC.
+static inline int ScanRunning() {
+  return (analog_scan_bitmask | capsense_bitmask) && !capture_owns_adc;
+}
+
+// Reports what changed while the scan wasn't running to report it itself.
+static void ReportPendingChanges() {
+  if (AD1CSSL != analog_scan_bitmask) {
+    ReportAnalogInFormat();
+  }
+  if (capsense_dirty_bitmask) {
+    ReportModifiedCapSenseStatus();
+  }
+}
+
+// Starts or stops the scan after the main loop changed the channel masks, with
+// the T3 interrupt blocked iff was_running.
+static void ScanUpdate(int was_running) {
+  if (ScanRunning()) {
+    if (was_running) {
+      T3IntUnblock();
+    } else {
+      // first channel, start running
+      ADCStart();
+    }
+  } else if (was_running) {
+    // This was the last channel. At this point no new samples will be
+    // triggered, but we may be in the middle of a sample.
+    ADCStop();
+    // Now we're safe. Report the change in format.
+    ReportPendingChanges();
+  }
+}
+
 void ADCSetScan(int pin, int enable) {
   log_printf("ADCSetScan(%d, %d)", pin, enable);
   int channel = PinToAnalogChannel(pin);
   int mask;
+  int was_running = ScanRunning();
   if (channel == -1) return;
   mask = 1 << channel;
   if (!!(mask & analog_scan_bitmask) == enable) return;
 
+  // These two variables are shared with the triggering code, ran from timer 3
+  // interrupt context.
+  if (was_running) T3IntBlock();
   if (enable) {
-    if (analog_scan_bitmask | capsense_bitmask) {
-      // already running, just add the new channel
-      T3IntBlock();
-      // These two variables are shared with the triggering code, ran from
-      // timer 3 interrupt context.
-      ++analog_scan_num_channels;
-      analog_scan_bitmask |= mask;
-      T3IntUnblock();
-    } else {
-      // first channel, start running
-      analog_scan_num_channels = 1;
-      analog_scan_bitmask = mask;
-      ADCStart();
-    }
+    // Not scanned until the next format report, so the filter is ours.
+    ADCFilterRestart(&channel_filter[channel]);
+    ++analog_scan_num_channels;
+    analog_scan_bitmask |= mask;
   } else {
-    T3IntBlock();
     --analog_scan_num_channels;
     analog_scan_bitmask &= ~mask;
-    if (analog_scan_bitmask | capsense_bitmask) {
-      T3IntUnblock();
-    } else {
-      // This was the last channel. At this point no new samples will be
-      // triggered, but we may be in the middle of a sample.
-      ADCStop();
-      // Now we're safe. Report the change in format.
-      ReportAnalogInFormat();
-    }
   }
+  ScanUpdate(was_running);
 }
 
 void ADCSetCapSense(int pin, int enable) {
   log_printf("ADCSetCapSense(%d, %d)", pin, enable);
   int channel = PinToAnalogChannel(pin);
   int mask;
+  int was_running = ScanRunning();
   if (channel == -1) return;
   mask = 1 << channel;
   if (!!(mask & capsense_bitmask) == enable) return;
 
+  if (was_running) T3IntBlock();
   if (enable) {
-    if (analog_scan_bitmask | capsense_bitmask) {
-      // already running, just add the new channel
-      T3IntBlock();
-      // These two variables are shared with the triggering code, ran from
-      // timer 3 interrupt context.
-      capsense_bitmask |= mask;
-      capsense_dirty_bitmask |= mask;
-      T3IntUnblock();
-    } else {
-      // first channel, start running
-      capsense_bitmask = mask;
-      capsense_dirty_bitmask = mask;
-      ADCStart();
-    }
+    ADCFilterRestart(&channel_filter[channel]);
+    capsense_bitmask |= mask;
   } else {
-    T3IntBlock();
     capsense_bitmask &= ~mask;
-    capsense_dirty_bitmask |= mask;
-    if (analog_scan_bitmask | capsense_bitmask) {
-      T3IntUnblock();
+  }
+  capsense_dirty_bitmask |= mask;
+  ScanUpdate(was_running);
+}
+
+void ADCSetScanPeriod(unsigned int period) {
+  log_printf("ADCSetScanPeriod(%u)", period);
+  PR3 = period;
+  // Don't let the counter run all the way around if we've shortened the
+  // period past it.
+  if (TMR3 > period) {
+    TMR3 = 0;
+  }
+}
+
+void ADCSetDecimation(int pin, int decimation, int oversample) {
+  log_printf("ADCSetDecimation(%d, %d, %d)", pin, decimation, oversample);
+  int channel = PinToAnalogChannel(pin);
+  int running = ScanRunning();
+  if (channel == -1) return;
+
+  // These variables are read by the T3 interrupt, when reporting the format.
+  if (running) T3IntBlock();
+  channel_decimation[channel] = decimation;
+  if (oversample) {
+    oversample_bitmask |= 1 << channel;
+  } else {
+    oversample_bitmask &= ~(1 << channel);
+  }
+  extended_frames = true;
+  format_dirty = true;
+  if (running) T3IntUnblock();
+}
+
+void ADCSetDeadband(int pin, int deadband) {
+  log_printf("ADCSetDeadband(%d, %d)", pin, deadband);
+  int channel = PinToAnalogChannel(pin);
+  int running = ScanRunning();
+  if (channel == -1) return;
+
+  // Read by the T3 interrupt, when reporting the format.
+  if (running) T3IntBlock();
+  channel_deadband[channel] = deadband;
+  extended_frames = true;
+  format_dirty = true;
+  if (running) T3IntUnblock();
+}
+
+void ADCSetEncoding(int delta, int keyframe_interval) {
+  log_printf("ADCSetEncoding(%d, %d)", delta, keyframe_interval);
+  int running = ScanRunning();
+
+  // Read by the T3 interrupt, when reporting the format.
+  if (running) T3IntBlock();
+  delta_frames = delta;
+  delta_keyframe_interval = keyframe_interval;
+  format_dirty = true;
+  if (running) T3IntUnblock();
+}
+
+void ADCSetFilter(int pin, int type, int param, const void* taps) {
+  log_printf("ADCSetFilter(%d, %d, %d)", pin, type, param);
+  int channel = PinToAnalogChannel(pin);
+  BYTE prev;
+  if (channel == -1) return;
+
+  // Owned by the scan done interrupt.
+  prev = SyncInterruptLevel(1);
+  ADCFilterSet(&channel_filter[channel], type, param, taps);
+  if (type == ADC_FILTER_NONE) {
+    filter_bitmask &= ~(1 << channel);
+  } else {
+    filter_bitmask |= 1 << channel;
+  }
+  SyncInterruptLevel(prev);
+}
+
+static void ReportCaptureStatus() {
+  OUTGOING_MESSAGE msg;
+  capture_reported = capture_count;
+  msg.type = ADC_CAPTURE_STATUS;
+  msg.args.adc_capture_status.state = capture_state;
+  msg.args.adc_capture_status.overflow = capture_overflow;
+  msg.args.adc_capture_status.count =
+      capture_state == CAPTURE_READING ? capture_read_pos : capture_reported;
+  AppProtocolSendMessage(&msg);
+}
+
+// Gives the ADC back to the periodic scan.
+static void CaptureRelease() {
+  _AD1IE = 0;
+  _ADON = 0;
+  _ASAM = 0;
+  _BUFM = 0;
+  AD1CON3 = SCAN_AD1CON3;
+  AD1CSSL = capture_saved_cssl;
+  capture_owns_adc = false;
+  if (ScanRunning()) {
+    ADCStart();
+  } else {
+    ReportPendingChanges();
+  }
+}
+
+void ADCCaptureArm(const BYTE* pins, int num_pins, unsigned int num_scans,
+                   int clock_div, int sample_time) {
+  log_printf("ADCCaptureArm(%d, %u, %d, %d)", num_pins, num_scans, clock_div,
+             sample_time);
+  unsigned int mask = 0;
+  int i, j, channel;
+
+  if (capture_owns_adc) CaptureRelease();
+  capture_state = CAPTURE_IDLE;
+  capture_overflow = false;
+  capture_count = 0;
+#if !ADC_CAPTURE_BUF_SIZE
+  num_pins = 0;  // Nowhere to capture to.
+#endif
+  for (i = 0; i < num_pins; ++i) {
+    channel = PinToAnalogChannel(pins[i]);
+    if (channel == -1 || (mask & (1 << channel))) break;
+    mask |= 1 << channel;
+  }
+  if (num_pins == 0 || i < num_pins) {
+    // Disarm, or bad pin list, which leaves us disarmed too.
+    ReportCaptureStatus();
+    return;
+  }
+  for (channel = 0, j = 0; channel < 16; ++channel) {
+    if (!(mask & (1 << channel))) continue;
+    i = 0;
+    while (PinToAnalogChannel(pins[i]) != channel) ++i;
+    capture_order[j++] = i;
+  }
+  capture_num_pins = num_pins;
+  // Whole scans per interrupt, so that every half-buffer starts a scan.
+  capture_scans_per_int = 8 / num_pins;
+  capture_total = num_scans * num_pins;
+  capture_half = 0;
+
+  // Take over the ADC. Any scan in progress is dropped.
+  if (ScanRunning()) ADCStop();
+  capture_owns_adc = true;
+  capture_saved_cssl = AD1CSSL;
+  _ASAM = 0;
+  _SAMP = 0;
+  AD1CON3 = (sample_time << 8) | clock_div;
+  AD1CSSL = mask;
+  _SSRC = 7;   // auto-convert.
+  _CSCNA = 1;  // scan channels set in AD1CSSL
+  _SMPI = capture_scans_per_int * num_pins - 1;
+  _BUFM = 1;   // fill one half of the buffer while we read the other.
+  _AD1IF = 0;
+  _AD1IE = 1;
+  _ADON = 1;
+  capture_state = CAPTURE_ARMED;
+  ReportCaptureStatus();
+}
+
+void ADCCaptureTrigger() {
+  log_printf("ADCCaptureTrigger()");
+  if (capture_state != CAPTURE_ARMED) return;
+  capture_state = CAPTURE_RUNNING;
+  ReportCaptureStatus();
+  _ASAM = 1;  // go!
+}
+
+void ADCCaptureRead() {
+  log_printf("ADCCaptureRead()");
+  // Wait for the capture to be reported done before reading.
+  if ((capture_state == CAPTURE_DONE || capture_state == CAPTURE_READING)
+      && !capture_owns_adc) {
+    capture_read_pos = 0;
+    capture_state = CAPTURE_READING;
+  }
+  ReportCaptureStatus();
+}
+
+// Appends the i'th of a run of samples to a message, packed like analog
+// frames: a header byte with the 2 LSb of every 4 samples, followed by a byte
+// of 8 MSb per sample.
+static inline void PackSample(OUTGOING_MESSAGE_BUFFER* var_arg,
+                              int* var_arg_pos, BYTE** group_header, int i,
+                              WORD value) {
+  if ((i & 3) == 0) {
+    *group_header = AppProtocolMessageByte(var_arg, (*var_arg_pos)++);
+    **group_header = 0;
+  }
+  **group_header |= (value & 3) << ((i & 3) * 2);
+  *AppProtocolMessageByte(var_arg, (*var_arg_pos)++) = value >> 2;
+}
+
+#if ADC_CAPTURE_BUF_SIZE
+// Streams captured samples as long as the outgoing queue has room to spare.
+static void CaptureStream() {
+  OUTGOING_MESSAGE msg;
+  OUTGOING_MESSAGE_BUFFER var_arg;
+  int var_arg_pos;
+  BYTE* group_header;
+  int n, i;
+
+  msg.type = ADC_CAPTURE_DATA;
+  while (capture_read_pos < capture_total
+         && AppProtocolTxQueueSize() < CAPTURE_TX_QUEUE_LIMIT) {
+    n = capture_total - capture_read_pos;
+    if (n > 64) n = 64;
+    msg.args.adc_capture_data.size = n - 1;
+    msg.args.adc_capture_data.offset = capture_read_pos;
+    if (!AppProtocolBeginMessage(&msg, n + (n + 3) / 4, &var_arg)) break;
+    var_arg_pos = 0;
+    for (i = 0; i < n; ++i) {
+      PackSample(&var_arg, &var_arg_pos, &group_header, i,
+                 capture_buf[capture_read_pos + i]);
+    }
+    AppProtocolEndMessage(var_arg_pos);
+    capture_read_pos += n;
+  }
+  if (capture_read_pos == capture_total) {
+    capture_state = CAPTURE_DONE;
+    ReportCaptureStatus();
+  }
+}
+#else
+static void CaptureStream() {}
+#endif
+
+void ADCSetTrigger(int pin, int mode, int invert, int repeat, int low,
+                   int high, unsigned int pre, unsigned int post) {
+  log_printf("ADCSetTrigger(%d, %d, %d, %d, %d, %d, %u, %u)", pin, mode,
+             invert, repeat, low, high, pre, post);
+  // Shared with the scan interrupts.
+  BYTE prev = SyncInterruptLevel(1);
+  trigger_mode = mode;
+  trigger_pin = pin;
+  trigger_invert = invert;
+  trigger_repeat = repeat;
+  trigger_low = low;
+  trigger_high = high;
+  trigger_pre = pre;
+  trigger_post = post;
+  if (mode == ADC_TRIGGER_OFF) {
+    trigger_state = TRIGGER_OFF;
+    ReportTriggerStatus();
+  } else {
+    TriggerRestart(capture_owns_adc ? capture_saved_cssl : AD1CSSL);
+  }
+  SyncInterruptLevel(prev);
+}
+
+// Sends the next chunk of the trigger window, as far as it is recorded. Once
+// all of it is sent, re-arms or stops. Returns whether there is more to do
+// right away. Call with the scan interrupts held off.
+static bool TriggerStreamChunk() {
+  OUTGOING_MESSAGE msg;
+  OUTGOING_MESSAGE_BUFFER var_arg;
+  int var_arg_pos = 0;
+  BYTE* group_header;
+  unsigned int total = (trigger_pre + trigger_post) * trigger_num_channels;
+  unsigned int n = trigger_recorded * trigger_num_channels - trigger_read_pos;
+  unsigned int scan, channel, i;
+
+  if (trigger_state != TRIGGER_TRIGGERED) return false;  // aborted
+  if (trigger_read_pos == total) {
+    if (trigger_repeat) {
+      TriggerRestart(trigger_mask);
     } else {
-      // This was the last channel. At this point no new samples will be
-      // triggered, but we may be in the middle of a sample.
-      ADCStop();
-      // Now we're safe. Report the change in format.
-      ReportModifiedCapSenseStatus();
+      trigger_state = TRIGGER_STOPPED;
+      ReportTriggerStatus();
+    }
+    return false;
+  }
+  if (n == 0) return false;
+  if (n > 64) n = 64;
+
+  msg.type = ANALOG_TRIGGER_DATA;
+  msg.args.analog_trigger_data.size = n - 1;
+  msg.args.analog_trigger_data.offset = trigger_read_pos;
+  if (!AppProtocolBeginMessage(&msg, n + (n + 3) / 4, &var_arg)) return false;
+  scan = trigger_start + trigger_read_pos / trigger_num_channels;
+  if (scan >= trigger_capacity) scan -= trigger_capacity;
+  channel = trigger_read_pos % trigger_num_channels;
+  for (i = 0; i < n; ++i) {
+    PackSample(&var_arg, &var_arg_pos, &group_header, i,
+               trigger_buf[scan * trigger_num_channels + channel]);
+    if (++channel == trigger_num_channels) {
+      channel = 0;
+      if (++scan == trigger_capacity) scan = 0;
+    }
+  }
+  AppProtocolEndMessage(var_arg_pos);
+  trigger_read_pos += n;
+  return true;
+}
+
+static void TriggerStream() {
+  BYTE prev;
+  bool more = true;
+  while (more && AppProtocolTxQueueSize() < CAPTURE_TX_QUEUE_LIMIT) {
+    // Hold off the scan interrupts chunk by chunk rather than for the whole
+    // window, so that the scan keeps its pace.
+    prev = SyncInterruptLevel(1);
+    more = TriggerStreamChunk();
+    SyncInterruptLevel(prev);
+  }
+}
+
+void ADCTasks() {
+  if (trigger_state == TRIGGER_TRIGGERED) {
+    TriggerStream();
+  }
+
+  switch (capture_state) {
+    case CAPTURE_RUNNING:
+      // Progress report every 1/8 of the capture.
+      if (capture_count - capture_reported > capture_total / 8) {
+        ReportCaptureStatus();
+      }
+      break;
+
+    case CAPTURE_DONE:
+      if (capture_owns_adc) {
+        CaptureRelease();
+        ReportCaptureStatus();
+      }
+      break;
+
+    case CAPTURE_READING:
+      CaptureStream();
+      break;
+
+    default:
+      break;
+  }
+}
+
+#if ADC_CAPTURE_BUF_SIZE
+// Moves the half-buffer the ADC just filled to the capture buffer.
+static inline void CaptureInterrupt() {
+  volatile unsigned int* buf = &ADC1BUF0 + (capture_half ? 8 : 0);
+  __eds__ WORD* dst = capture_buf + capture_count;
+  int i, j;
+
+  // The ADC has moved on to the other half, unless we're late and it already
+  // came back to this one.
+  if (_BUFS == capture_half) {
+    capture_overflow = true;
+  }
+  for (i = 0; i < capture_scans_per_int && capture_count < capture_total; ++i) {
+    for (j = 0; j < capture_num_pins; ++j) {
+      dst[capture_order[j]] = *buf++;
     }
+    dst += capture_num_pins;
+    capture_count += capture_num_pins;
+  }
+  capture_half ^= 1;
+  if (capture_count == capture_total) {
+    _ASAM = 0;
+    _ADON = 0;
+    capture_state = CAPTURE_DONE;
+  }
+}
+#else
+static inline void CaptureInterrupt() {}
+#endif
+
+static inline bool TriggerCondition(WORD value) {
+  switch (trigger_mode) {
+    case ADC_TRIGGER_LEVEL:
+      return trigger_invert ? value < trigger_low : value > trigger_high;
+
+    case ADC_TRIGGER_EDGE:
+      // With hysteresis: the value must first be seen on the starting side of
+      // one threshold, then reach the other.
+      if (trigger_invert ? value > trigger_high : value < trigger_low) {
+        trigger_ready = true;
+      } else if (trigger_ready
+                 && (trigger_invert ? value <= trigger_low
+                                    : value >= trigger_high)) {
+        trigger_ready = false;
+        return true;
+      }
+      return false;
+
+    case ADC_TRIGGER_WINDOW:
+      return (value < trigger_low || value > trigger_high) != trigger_invert;
+
+    default:
+      return false;
+  }
+}
+
+// Records a scan into the trigger history, and evaluates the condition on it
+// once there is enough history before it.
+static inline void TriggerFeed(const volatile unsigned int* buf) {
+  __eds__ WORD* dst;
+  unsigned int slot = trigger_write;
+  int i;
+  bool fire;
+
+  if (trigger_state == TRIGGER_TRIGGERED
+      && trigger_recorded == trigger_pre + trigger_post) {
+    return;  // Complete, waiting to be sent.
+  } else if (trigger_state == TRIGGER_STOPPED) {
+    return;
+  }
+  dst = trigger_buf + slot * trigger_num_channels;
+  for (i = 0; i < trigger_num_channels; ++i) {
+    dst[i] = buf[i];
+  }
+  if (++trigger_write == trigger_capacity) trigger_write = 0;
+
+  if (trigger_state == TRIGGER_TRIGGERED) {
+    ++trigger_recorded;
+    return;
+  }
+  fire = TriggerCondition(buf[trigger_index]);
+  if (trigger_filled < trigger_pre) {
+    ++trigger_filled;
+  } else if (fire) {
+    // The window is trigger_pre scans before this one, then trigger_post
+    // starting with this one.
+    trigger_start = slot >= trigger_pre ? slot - trigger_pre
+                                        : slot + trigger_capacity - trigger_pre;
+    trigger_recorded = trigger_pre + 1;
+    trigger_read_pos = 0;
+    trigger_state = TRIGGER_TRIGGERED;
+    ReportTriggerStatus();
   }
 }
 
 void __attribute__((__interrupt__, auto_psv)) _T3Interrupt() {
   // Report frame format of analog channels if changed.
-  if (AD1CSSL != analog_scan_bitmask) {
+  if (AD1CSSL != analog_scan_bitmask || format_dirty) {
     ReportAnalogInFormat();
   }
   assert(AD1CSSL == analog_scan_bitmask);
@@ -375,6 +1224,7 @@ void __attribute__((__interrupt__, auto_psv)) _T3Interrupt() {
   // Sample!
   if (analog_scan_num_channels) {
     // Trigger ADC sequence, which will eventually trigger capsense.
+    scan_time = TimebaseNow();
     ADCTrigger();
   } else if (capsense_bitmask) {
     // Jump directly to capsense.
@@ -385,6 +1235,24 @@ void __attribute__((__interrupt__, auto_psv)) _T3Interrupt() {
   _T3IF = 0;  // clear
 }
 
+// Runs the results of a scan through the filters of their channels, if any
+// has one, and returns the results to use from there on.
+static inline const volatile unsigned int* FilterScan() {
+  volatile unsigned int* buf = &ADC1BUF0;
+  unsigned int mask = AD1CSSL;
+  int channel = 0;
+  int i = 0;
+  if (!(mask & filter_bitmask)) return buf;
+  for (; mask; mask >>= 1, ++channel) {
+    if (!(mask & 1)) continue;
+    filtered_scan[i] = filter_bitmask & (1 << channel)
+                       ? ADCFilterApply(&channel_filter[channel], buf[i])
+                       : buf[i];
+    ++i;
+  }
+  return filtered_scan;
+}
+
 void __attribute__((__interrupt__, auto_psv)) _CRCInterrupt() {
   if (capsense_sample) {
     _CTMUEN = 0; // CTMU off.
@@ -393,7 +1261,14 @@ void __attribute__((__interrupt__, auto_psv)) _CRCInterrupt() {
     ReportCapSense();
     T3IntUnblock();  // ready for next trigger.
   } else {
-    ReportAnalogInStatus();
+    const volatile unsigned int* buf = FilterScan();
+    ReflexAnalogUpdate(buf, AD1CSSL);
+    ControlUpdate(buf, AD1CSSL);
+    if (trigger_state == TRIGGER_OFF) {
+      ReportAnalogInStatus(buf);
+    } else {
+      TriggerFeed(buf);
+    }
     if (capsense_bitmask) {
       ADCCapSenseTrigger();
     } else {
@@ -404,6 +1279,11 @@ void __attribute__((__interrupt__, auto_psv)) _CRCInterrupt() {
 }
 
 void __attribute__((__interrupt__, auto_psv)) _ADC1Interrupt() {
+  if (capture_state == CAPTURE_RUNNING) {
+    _AD1IF = 0;  // clear first, so that we can tell if we're late.
+    CaptureInterrupt();
+    return;
+  }
   _ADON = 0;  // Turn the module off.
   ScanDoneInterruptTrigger();
   _AD1IF = 0;  // clear
@@ -39,6 +39,43 @@
 #ifndef __ADC_H__
 #define __ADC_H__
 
+#include "GenericTypeDefs.h"
+#include "adc_filter.h"
+
+// Shortest allowed scan period, in timer 3 ticks (0.5us) minus one: 100us.
+// Shorter periods would leave no time for the main loop.
+#define ADC_MIN_SCAN_PERIOD 199
+
+// Oversampled channels accumulate into 16 bits, so they may average up to 64
+// samples of 10 bits.
+#define ADC_MAX_OVERSAMPLE 64
+
+// Size of the burst capture buffer, in samples, and the maximum number of pins
+// captured together. The buffer takes the spare extended data space of the
+// 96KB parts. The PIC24FJ128DA106 has 24KB of RAM and does without burst
+// capture, which a size of 0 compiles out.
+#ifdef __PIC24FJ128DA106__
+#define ADC_CAPTURE_BUF_SIZE 0
+#else
+#define ADC_CAPTURE_BUF_SIZE 16384
+#endif
+#define ADC_CAPTURE_MAX_PINS 8
+
+// Size of the analog trigger history, in samples. It is shared by all scanned
+// channels, so a window may span up to ADC_TRIGGER_BUF_SIZE / (number of
+// scanned pins) scans. The PIC24FJ128DA106 has 24KB of RAM, so it only gets a
+// short history.
+#ifdef __PIC24FJ128DA106__
+#define ADC_TRIGGER_BUF_SIZE 512
+#else
+#define ADC_TRIGGER_BUF_SIZE 4096
+#endif
+
+// Analog trigger conditions.
+#define ADC_TRIGGER_OFF    0
+#define ADC_TRIGGER_LEVEL  1
+#define ADC_TRIGGER_EDGE   2
+#define ADC_TRIGGER_WINDOW 3
 
 // Initialize this module.
 // Can be used any time to reset the module's state.
@@ -55,4 +92,99 @@ void ADCSetScan(int pin, int enable);
 // for sampling.
 void ADCSetCapSense(int pin, int enable);
 
+// Set the period at which the analog channels are scanned, in units of 0.5us,
+// minus one. Defaults to 1999 (1KHz) after ADCInit().
+void ADCSetScanPeriod(unsigned int period);
+
+// Have a pin reported once every (decimation + 1) scans instead of on every
+// scan. When oversample is set, the skipped samples are averaged into the
+// reported one, which then carries 6 extra bits of resolution. decimation must
+// be smaller than ADC_MAX_OVERSAMPLE in this case.
+// Once called, analog frames only carry the channels that are due, preceded by
+// a bitmap of which ones these are. The setting applies from the next scan on,
+// and persists across ADCSetScan() calls until ADCInit().
+void ADCSetDecimation(int pin, int decimation, int oversample);
+
+// Have a pin reported only when it has moved by more than deadband (in 10-bit
+// units) since it was last reported, and only on scans it is due on. 0 reports
+// it on every due scan. Like ADCSetDecimation(), switches to extended frames,
+// and every pin is reported on its first due scan after a format report.
+void ADCSetDeadband(int pin, int deadband);
+
+// Have analog frames carry each 10-bit value as a variable-length code for its
+// difference from the previous value reported for the same pin. Every
+// keyframe_interval frames (never if 0), and on a pin's first report after a
+// format report, values are sent whole instead. Oversampled values are not
+// affected. Applies from the next scan on, until ADCInit().
+void ADCSetEncoding(int delta, int keyframe_interval);
+
+// Have the samples of a pin go through a filter (see adc_filter.h), or through
+// none with ADC_FILTER_NONE, before they are reported, whether as an analog
+// input or as capacitance, and before reflexes, control loops and the analog
+// trigger see them. Decimated pins are filtered at the full scan rate, ahead
+// of the decimation. The filter starts over from its next sample, and also
+// whenever sampling of the pin starts. The setting persists across
+// ADCSetScan() and ADCSetCapSense() calls until ADCInit().
+void ADCSetFilter(int pin, int type, int param, const void* taps);
+
+// Burst capture: sample up to ADC_CAPTURE_MAX_PINS pins back-to-back into RAM,
+// num_scans times, then stream the samples to the client on request.
+// Arming sets the ADC up and pauses the periodic scan until the capture is
+// done. Each conversion takes (sample_time + 12) * (clock_div + 1) instruction
+// cycles, and clock_div, sample_time must be at least 1. num_scans * num_pins
+// must not exceed ADC_CAPTURE_BUF_SIZE. num_pins of 0 disarms, as does a pin
+// that is not analog or appears twice, and any call where capture is compiled
+// out.
+// Every step is reported with an ADC_CAPTURE_STATUS message.
+void ADCCaptureArm(const BYTE* pins, int num_pins, unsigned int num_scans,
+                   int clock_div, int sample_time);
+
+// Start an armed capture.
+void ADCCaptureTrigger();
+
+// Stream a complete capture, scan by scan, with pins in the order they were
+// given to ADCCaptureArm(). Ignored unless the capture has been reported done.
+void ADCCaptureRead();
+
+// Analog trigger: instead of reporting every scan, keep the latest ones in a
+// circular history, and only send a window of pre scans before the one where
+// the condition on pin fires, and post scans starting with it, like an
+// oscilloscope. The condition is one of:
+// - ADC_TRIGGER_LEVEL: the value is above high (below low if invert).
+// - ADC_TRIGGER_EDGE: the value rises from below low to high or above (falls
+//   from above high to low or below if invert).
+// - ADC_TRIGGER_WINDOW: the value is outside [low, high] (inside if invert).
+// With repeat, the trigger re-arms once a window has been sent, otherwise it
+// stops until set again. It also re-arms whenever the set of scanned pins
+// changes, and stays stopped while pin is not scanned or the window doesn't
+// fit in the history. Windows are sent scan by scan, with pins in the order
+// of the last format report, and every state change is reported with an
+// ANALOG_TRIGGER_STATUS message. ADC_TRIGGER_OFF goes back to reporting
+// every scan.
+void ADCSetTrigger(int pin, int mode, int invert, int repeat, int low,
+                   int high, unsigned int pre, unsigned int post);
+
+// Call this function periodically to stream captured data and report capture
+// progress.
+void ADCTasks();
+
+// The number of set bits in val.
+static inline int ADCCountOnes(unsigned int val) {
+  int res = 0;
+  while (val) {
+    if (val & 1) ++res;
+    val >>= 1;
+  }
+  return res;
+}
+
+// The sample of channel in buf, a scan of the channels in mask, which holds
+// one sample per set bit in ascending channel order. -1 if channel is not in
+// mask.
+static inline int ADCScanSample(const volatile unsigned int* buf,
+                                unsigned int mask, int channel) {
+  if (!(mask & (1 << channel))) return -1;
+  return buf[ADCCountOnes(mask & ((1 << channel) - 1))];
+}
+
 #endif  // __ADC_H__
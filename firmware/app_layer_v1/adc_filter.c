@@ -0,0 +1,98 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+#include "adc_filter.h"
+
+#include <string.h>
+
+void ADCFilterSet(ADC_FILTER* f, int type, int param, const void* taps) {
+  f->type = type;
+  f->length = 1;
+  f->shift = 0;
+  switch (type) {
+    case ADC_FILTER_BOXCAR:
+      f->length = param;
+      break;
+
+    case ADC_FILTER_IIR:
+      f->shift = param;
+      break;
+
+    case ADC_FILTER_FIR:
+      f->length = param;
+      memcpy(f->taps, taps, param * sizeof(SHORT));
+      break;
+  }
+  ADCFilterRestart(f);
+}
+
+static void Prime(ADC_FILTER* f, WORD sample) {
+  int i;
+  for (i = 0; i < f->length; ++i) {
+    f->history[i] = sample;
+  }
+  f->pos = 0;
+  f->sum = sample * f->length;
+  f->state = (LONG) sample << 16;
+  f->primed = TRUE;
+}
+
+WORD ADCFilterApply(ADC_FILTER* f, WORD sample) {
+  if (!f->primed) Prime(f, sample);
+  switch (f->type) {
+    case ADC_FILTER_BOXCAR:
+      f->sum += sample - f->history[f->pos];
+      f->history[f->pos] = sample;
+      if (++f->pos == f->length) f->pos = 0;
+      return (f->sum + f->length / 2) / f->length;
+
+    case ADC_FILTER_IIR:
+      f->state += (((LONG) sample << 16) - f->state) >> f->shift;
+      return (f->state + 0x8000) >> 16;
+
+    case ADC_FILTER_FIR: {
+      LONG acc = 1 << 13;  // rounding
+      int i;
+      int j = f->pos;
+      f->history[j] = sample;
+      // taps[0] goes with the newest sample, taps[1] with the one before...
+      for (i = 0; i < f->length; ++i) {
+        acc += (LONG) f->taps[i] * f->history[j];
+        if (j-- == 0) j = f->length - 1;
+      }
+      if (++f->pos == f->length) f->pos = 0;
+      if (acc < 0) return 0;
+      acc >>= 14;
+      return acc > 1023 ? 1023 : acc;
+    }
+
+    default:
+      return sample;
+  }
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+// Fixed-point filters for 10-bit ADC samples, one instance per channel. Every
+// filter takes a sample and returns the filtered value, also in 10 bits, in
+// a bounded number of cycles, so that it can run from the scan done interrupt:
+// - ADC_FILTER_BOXCAR: the average of the last length samples. A division and
+//   a couple of additions per sample, whatever the length.
+// - ADC_FILTER_IIR: a single-pole low-pass, which moves the output by
+//   1 / 2^shift of its distance to each new sample. The state keeps 16 bits
+//   of fraction, so that even long time constants settle on a steady input
+//   rather than stopping short of it. A shift and an addition per sample.
+// - ADC_FILTER_FIR: sum(taps[i] * sample[n - i]), with signed taps with 14
+//   bits of fraction, i.e. in [-2, 2), and the result clamped to 10 bits. A
+//   multiply-accumulate per tap.
+// A filter starts out as if it had only ever seen its first sample, so that
+// there is no settling from 0.
+
+#ifndef __ADC_FILTER_H__
+#define __ADC_FILTER_H__
+
+#include "GenericTypeDefs.h"
+
+#define ADC_FILTER_NONE   0
+#define ADC_FILTER_BOXCAR 1
+#define ADC_FILTER_IIR    2
+#define ADC_FILTER_FIR    3
+
+// Longest boxcar, in samples, and most FIR taps.
+#define ADC_FILTER_MAX_LENGTH 16
+#define ADC_FILTER_MAX_SHIFT  15
+
+typedef struct {
+  BYTE type;
+  BYTE length;  // boxcar and FIR
+  BYTE shift;   // IIR
+  BYTE pos;     // where the next sample goes in history
+  BOOL primed;
+  WORD sum;     // boxcar: of history
+  LONG state;   // IIR: the output, with 16 bits of fraction
+  WORD history[ADC_FILTER_MAX_LENGTH];
+  SHORT taps[ADC_FILTER_MAX_LENGTH];
+} ADC_FILTER;
+
+// Sets a filter up and restarts it. param is the length of a boxcar, 1 to
+// ADC_FILTER_MAX_LENGTH, the shift of an IIR, 0 to ADC_FILTER_MAX_SHIFT, or
+// the number of taps of an FIR, 1 to ADC_FILTER_MAX_LENGTH. taps is only used
+// for an FIR, and holds 2 bytes per tap, LSB first.
+void ADCFilterSet(ADC_FILTER* f, int type, int param, const void* taps);
+
+// Has the filter start over from its next sample.
+static inline void ADCFilterRestart(ADC_FILTER* f) {
+  f->primed = FALSE;
+}
+
+// Filters a sample.
+WORD ADCFilterApply(ADC_FILTER* f, WORD sample);
+
+#endif  // __ADC_FILTER_H__
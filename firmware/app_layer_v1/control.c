@@ -0,0 +1,205 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+#include "control.h"
+
+#include <string.h>
+
+#include "Compiler.h"
+#include "adc.h"
+#include "logging.h"
+#include "pins.h"
+#include "protocol.h"
+#include "pwm.h"
+#include "sync.h"
+
+typedef struct {
+  BYTE source;
+  BYTE input;  // analog channel or input capture module
+  BYTE pwm_num;
+  WORD out_min;
+  WORD out_max;
+  WORD report_interval;
+  WORD report_countdown;
+  LONG setpoint;
+  SHORT kp;
+  SHORT ki;
+  SHORT kd;
+  BYTE shift;
+  LONG acc;  // integral term, times 2^shift
+  LONG last_input;
+  BOOL primed;  // whether last_input is valid
+} CONTROL_LOOP;
+
+static CONTROL_LOOP loops[NUM_CONTROL_LOOPS];
+// The running loops, as a bitmask. Owned by the interrupt, along with the
+// loops in it.
+static BYTE active_mask;
+
+void ControlInit() {
+  BYTE prev = SyncInterruptLevel(1);
+  active_mask = 0;
+  memset(loops, 0, sizeof loops);
+  SyncInterruptLevel(prev);
+}
+
+static void ControlSendStatus(int loop_num, int enabled) {
+  OUTGOING_MESSAGE msg;
+  msg.type = CONTROL_STATUS;
+  msg.args.control_status.loop_num = loop_num;
+  msg.args.control_status.enabled = enabled;
+  AppProtocolSendMessage(&msg);
+}
+
+void ControlConfig(int loop_num, int source, int input, int pwm_num,
+                   WORD out_min, WORD out_max, WORD report_interval) {
+  CONTROL_LOOP* l = &loops[loop_num];
+  const BYTE bit = 1 << loop_num;
+  BOOL was_active;
+  BYTE prev;
+  log_printf("ControlConfig(%d, %d, %d, %d, %u, %u, %u)", loop_num, source,
+             input, pwm_num, out_min, out_max, report_interval);
+  prev = SyncInterruptLevel(1);
+  was_active = (active_mask & bit) != 0;
+  active_mask &= ~bit;
+  SyncInterruptLevel(prev);
+  if (was_active) ControlSendStatus(loop_num, 0);
+  if (source == CONTROL_OFF) return;
+
+  l->source = source;
+  l->input = source == CONTROL_ANALOG ? PinToAnalogChannel(input) : input;
+  l->pwm_num = pwm_num;
+  l->out_min = out_min;
+  l->out_max = out_max;
+  l->report_interval = report_interval;
+  l->report_countdown = report_interval;
+  l->acc = (LONG) out_min << l->shift;
+  l->primed = FALSE;
+  // Takes the module over from its sequencer and group update, if any.
+  PWMForceDutyCycle(pwm_num, out_min, 0);
+  ControlSendStatus(loop_num, 1);
+
+  prev = SyncInterruptLevel(1);
+  active_mask |= bit;
+  SyncInterruptLevel(prev);
+}
+
+void ControlSetParams(int loop_num, LONG setpoint, SHORT kp, SHORT ki,
+                      SHORT kd, int shift) {
+  CONTROL_LOOP* l = &loops[loop_num];
+  BYTE prev;
+  log_printf("ControlSetParams(%d, %ld, %d, %d, %d, %d)", loop_num, setpoint,
+             kp, ki, kd, shift);
+  prev = SyncInterruptLevel(1);
+  // Keep the integral term's value in output units.
+  if (shift > l->shift) {
+    l->acc <<= shift - l->shift;
+  } else {
+    l->acc >>= l->shift - shift;
+  }
+  l->setpoint = setpoint;
+  l->kp = kp;
+  l->ki = ki;
+  l->kd = kd;
+  l->shift = shift;
+  SyncInterruptLevel(prev);
+}
+
+static inline LONG Saturate16(LONG val) {
+  if (val > 32767) return 32767;
+  if (val < -32768) return -32768;
+  return val;
+}
+
+static void Run(int loop_num, LONG input) {
+  CONTROL_LOOP* l = &loops[loop_num];
+  const LONG lo = (LONG) l->out_min << l->shift;
+  const LONG hi = (LONG) l->out_max << l->shift;
+  const LONG e = Saturate16(l->setpoint - input);
+  const LONG dy = l->primed ? Saturate16(input - l->last_input) : 0;
+  LONGLONG u;
+  WORD out;
+  BOOL saturated = TRUE;
+
+  l->last_input = input;
+  l->primed = TRUE;
+  // Both terms are within 2^30 in magnitude, so this can't overflow.
+  l->acc += (LONG) l->ki * e;
+  if (l->acc > hi) {
+    l->acc = hi;
+  } else if (l->acc < lo) {
+    l->acc = lo;
+  }
+  u = ((LONGLONG) l->kp * e + l->acc - (LONGLONG) l->kd * dy) >> l->shift;
+  if (u >= l->out_max) {
+    out = l->out_max;
+  } else if (u <= l->out_min) {
+    out = l->out_min;
+  } else {
+    out = u;
+    saturated = FALSE;
+  }
+  SetPwmDutyCycle(l->pwm_num, out, 0);
+
+  if (l->report_interval && !--l->report_countdown) {
+    OUTGOING_MESSAGE msg;
+    l->report_countdown = l->report_interval;
+    msg.type = CONTROL_REPORT;
+    msg.args.control_report.loop_num = loop_num;
+    msg.args.control_report.saturated = saturated;
+    msg.args.control_report.input = input;
+    msg.args.control_report.output = out;
+    AppProtocolSendMessage(&msg);
+  }
+}
+
+void ControlUpdate(const volatile unsigned int* buf, unsigned int mask) {
+  int i;
+  for (i = 0; i < NUM_CONTROL_LOOPS; ++i) {
+    const CONTROL_LOOP* l = &loops[i];
+    int input;
+    if (!(active_mask & (1 << i)) || l->source != CONTROL_ANALOG) continue;
+    input = ADCScanSample(buf, mask, l->input);
+    if (input == -1) continue;  // not scanned
+    Run(i, input);
+  }
+}
+
+void ControlCapture(int incap_num, DWORD capture) {
+  int i;
+  if (capture > 0x7FFFFFFF) capture = 0x7FFFFFFF;
+  for (i = 0; i < NUM_CONTROL_LOOPS; ++i) {
+    const CONTROL_LOOP* l = &loops[i];
+    if (!(active_mask & (1 << i)) || l->source != CONTROL_INCAP
+        || l->input != incap_num) {
+      continue;
+    }
+    Run(i, capture);
+  }
+}
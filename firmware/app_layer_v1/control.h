@@ -0,0 +1,87 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+// Control loops: PID controllers that drive the duty cycle of a PWM module
+// from a measured input, with no round trip to the client. A loop runs once
+// per new value of its input, which is either:
+// - CONTROL_ANALOG: the value of a scanned analog pin, 0 to 1023. The loop
+//   runs from the ADC scan done interrupt, on every scan its pin is part of,
+//   so at the analog sampling rate.
+// - CONTROL_INCAP: a width or period measured by an input capture module, in
+//   its clock ticks. The loop runs from the input capture interrupt, on every
+//   capture the module reports, and needs no analog pin to be sampled.
+//
+// On every run, with e = setpoint - input and dy the change in the input
+// since the last run, both saturated to 16 bits:
+//   acc = clamp(acc + ki * e, out_min << shift, out_max << shift)
+//   out = clamp((kp * e + acc - kd * dy) >> shift, out_min, out_max)
+// and out is set as the duty cycle of the module, in clocks. The integral
+// term is kept already multiplied by ki, so that new gains take effect
+// without a bump in the output. Keeping it within the output range is what
+// prevents windup. The derivative is taken on the input rather than on the
+// error, so that a setpoint step doesn't kick the output either.
+//
+// Every report_interval runs (never if 0), a CONTROL_REPORT message is sent
+// with the input and output of the run.
+
+#ifndef __CONTROL_H__
+#define __CONTROL_H__
+
+#include "GenericTypeDefs.h"
+
+#define NUM_CONTROL_LOOPS 4
+#define CONTROL_MAX_SHIFT 14
+
+// Sources.
+#define CONTROL_OFF    0
+#define CONTROL_ANALOG 1
+#define CONTROL_INCAP  2
+
+void ControlInit();
+
+// Starts a loop, restarting it from out_min if it was running, or stops it if
+// source is CONTROL_OFF. Either way, a CONTROL_STATUS message is sent. input
+// is a pin for CONTROL_ANALOG and an input capture module for CONTROL_INCAP.
+// Does not change the setpoint and gains, which are all 0 after a reset.
+void ControlConfig(int loop_num, int source, int input, int pwm_num,
+                   WORD out_min, WORD out_max, WORD report_interval);
+
+// Sets the setpoint and gains of a loop, taking effect on its next run.
+void ControlSetParams(int loop_num, LONG setpoint, SHORT kp, SHORT ki,
+                      SHORT kd, int shift);
+
+// Called from the ADC scan done interrupt, with the results of a scan of the
+// analog channels in mask, in ascending channel order.
+void ControlUpdate(const volatile unsigned int* buf, unsigned int mask);
+
+// Called from the input capture interrupt, at priority 1 like the above, with
+// a width or period just reported by a module.
+void ControlCapture(int incap_num, DWORD capture);
+
+#endif  // __CONTROL_H__
@@ -28,11 +28,68 @@
  */
 #include "digital.h"
 
+#include <string.h>
+
 #include "Compiler.h"
+#include "byte_ring.h"
+#include "encoder.h"
 #include "logging.h"
 #include "pins.h"
 #include "protocol.h"
+#include "reflex.h"
 #include "sync.h"
+#include "timebase.h"
+
+// When the change notification being handled came in.
+static DWORD cn_time;
+// With batching, the changes found by the change notification being handled,
+// as bitmaps over the pins.
+static BOOL batch_changes;
+static BYTE change_mask[(NUM_PINS + 7) / 8];
+static BYTE change_levels[(NUM_PINS + 7) / 8];
+
+// Periodic sampling. Every Timer 1 period, the level of each sampled pin, in
+// ascending pin order, is shifted into a bitstream, LSB first. Ticks are not
+// byte-aligned. Complete bytes go through sample_ring and out from
+// DigitalTasks() in REPORT_PERIODIC_DIGITAL_IN_STATUS messages.
+typedef struct {
+  volatile unsigned int* port;
+  unsigned int mask;
+} SAMPLED_PIN;
+
+static SAMPLED_PIN sampled_pins[NUM_PINS];
+static int num_sampled_pins;
+static BOOL pin_sampled[NUM_PINS];
+// The byte being filled, and the bit the next sample goes to.
+static BYTE sample_byte;
+static BYTE sample_bit;
+// Set by the interrupt when sample_ring has overflowed. Sampling pauses until
+// DigitalTasks() has sent out what came before and reported the gap.
+static volatile BOOL sample_gap;
+DEFINE_STATIC_BYTE_RING(sample_ring, 512);
+
+static void StopSampling() {
+  _T1IE = 0;
+  T1CON = 0x0000;
+  _T1IF = 0;
+}
+
+void DigitalInit() {
+  batch_changes = FALSE;
+  memset(change_mask, 0, sizeof change_mask);
+  StopSampling();
+  _T1IP = 5;
+  num_sampled_pins = 0;
+  memset(pin_sampled, 0, sizeof pin_sampled);
+  ByteRingClear(&sample_ring);
+}
+
+void SetDigitalInBatching(int enable) {
+  log_printf("SetDigitalInBatching(%d)", enable);
+  BYTE prev = SyncInterruptLevel(1);
+  batch_changes = enable;
+  SyncInterruptLevel(prev);
+}
 
 void SetDigitalOutLevel(int pin, int value) {
   log_printf("SetDigitalOutLevel(%d, %d)", pin, value);
@@ -42,6 +99,75 @@ void SetDigitalOutLevel(int pin, int value) {
   SyncInterruptLevel(prev);
 }
 
+void SetDigitalOutLevels(int first_pin, int num_bytes,
+                         const BYTE* mask_and_value) {
+  log_printf("SetDigitalOutLevels(%d, %d)", first_pin, num_bytes);
+  BYTE prev = SyncInterruptLevel(4);
+  PinSetLatMasked(first_pin, num_bytes, mask_and_value,
+                  mask_and_value + num_bytes);
+  SyncInterruptLevel(prev);
+}
+
+static void SendSamples(BOOL all) {
+  int size1, size2;
+  const BYTE *data1, *data2;
+  OUTGOING_MESSAGE msg;
+  msg.type = REPORT_PERIODIC_DIGITAL_IN_STATUS;
+  do {
+    ByteRingPeekMax(&sample_ring, 64, &data1, &size1, &data2, &size2);
+    if (!size1) break;
+    msg.args.report_periodic_digital_in_status.size = size1 + size2;
+    BYTE prev = SyncInterruptLevel(1);
+    AppProtocolSendMessageWithVarArgSplit(&msg, data1, size1, data2, size2);
+    SyncInterruptLevel(prev);
+    ByteRingPull(&sample_ring, size1 + size2);
+  } while (all);
+}
+
+void RegisterPeriodicDigitalSampling(int pin, int freq_scale) {
+  int i;
+  log_printf("RegisterPeriodicDigitalSampling(%d, %d)", pin, freq_scale);
+  SAVE_PIN_FOR_LOG(pin);
+  // The stream restarts with the new set of pins. Whatever is left of the old
+  // one goes out first, short of the incomplete byte.
+  StopSampling();
+  SendSamples(TRUE);
+  sample_gap = FALSE;
+  pin_sampled[pin] = freq_scale != 0;
+  num_sampled_pins = 0;
+  for (i = 0; i < NUM_PINS; ++i) {
+    if (pin_sampled[i]) {
+      SAMPLED_PIN* p = &sampled_pins[num_sampled_pins++];
+      PinGetPortReg(i, &p->port, &p->mask);
+    }
+  }
+  if (freq_scale) {
+    // 2MHz, (freq_scale + 1) * 10us.
+    PR1 = (freq_scale + 1) * 20 - 1;
+  }
+  if (num_sampled_pins) {
+    sample_byte = 0;
+    sample_bit = 1;
+    TMR1 = 0;
+    T1CON = 0x8010;
+    _T1IE = 1;
+  }
+}
+
+void DigitalTasks() {
+  SendSamples(FALSE);
+  if (sample_gap && !ByteRingSize(&sample_ring)) {
+    OUTGOING_MESSAGE msg;
+    log_printf("Periodic digital samples lost");
+    msg.type = REPORT_PERIODIC_DIGITAL_IN_STATUS;
+    msg.args.report_periodic_digital_in_status.size = 0;
+    BYTE prev = SyncInterruptLevel(1);
+    AppProtocolSendMessage(&msg);
+    SyncInterruptLevel(prev);
+    sample_gap = FALSE;
+  }
+}
+
 void SetChangeNotify(int pin, int changeNotify) {
   int cnie_backup = _CNIE;
   log_printf("SetChangeNotify(%d, %d)", pin, changeNotify);
@@ -62,9 +188,41 @@ static void SendDigitalInStatusMessage(int pin, int value) {
   msg.type = REPORT_DIGITAL_IN_STATUS;
   msg.args.report_digital_in_status.pin = pin;
   msg.args.report_digital_in_status.level = value;
+  TimebaseStamp(TIMESTAMP_DIGITAL, cn_time);
   AppProtocolSendMessage(&msg);
 }
 
+static void SendDigitalInChanges() {
+  int first, last, size;
+  OUTGOING_MESSAGE msg;
+  for (first = 0; first < sizeof change_mask && !change_mask[first]; ++first);
+  if (first == sizeof change_mask) return;
+  for (last = sizeof change_mask - 1; !change_mask[last]; --last);
+  size = last - first + 1;
+  log_printf("SendDigitalInChanges(%d, %d)", first * 8, size);
+  msg.type = REPORT_DIGITAL_IN_CHANGES;
+  msg.args.report_digital_in_changes.first_pin = first * 8;
+  msg.args.report_digital_in_changes.num_bytes = size;
+  TimebaseStamp(TIMESTAMP_DIGITAL, cn_time);
+  AppProtocolSendMessageWithVarArgSplit(&msg, change_mask + first, size,
+                                        change_levels + first, size);
+  memset(change_mask + first, 0, size);
+}
+
+static void ReportChange(int pin, int value) {
+  if (batch_changes) {
+    const BYTE bit = 1 << (pin & 7);
+    change_mask[pin >> 3] |= bit;
+    if (value) {
+      change_levels[pin >> 3] |= bit;
+    } else {
+      change_levels[pin >> 3] &= ~bit;
+    }
+  } else {
+    SendDigitalInStatusMessage(pin, value);
+  }
+}
+
 #define CHECK_PORT_CHANGE(name)                                        \
   do {                                                                 \
     unsigned int i = 0;                                                \
@@ -75,7 +233,7 @@ static void SendDigitalInStatusMessage(int pin, int value) {
     CNFORCE##name = 0x0000;                                            \
     while (changed) {                                                  \
       if (changed & 1) {                                               \
-        SendDigitalInStatusMessage(PinFromPort##name(i), (port & 1));  \
+        ReportChange(PinFromPort##name(i), (port & 1));                \
       }                                                                \
       ++i;                                                             \
       port >>= 1;                                                      \
@@ -86,12 +244,39 @@ static void SendDigitalInStatusMessage(int pin, int value) {
 
 void __attribute__((__interrupt__, auto_psv)) _CNInterrupt() {
   _CNIF = 0;
+  cn_time = TimebaseNow();
   log_printf("_CNInterrupt()");
 
+  ReflexDigitalUpdate();  // first, as it may act on outputs
+  EncoderUpdate();
   CHECK_PORT_CHANGE(B);
   CHECK_PORT_CHANGE(C);
   CHECK_PORT_CHANGE(D);
   CHECK_PORT_CHANGE(E);
   CHECK_PORT_CHANGE(F);
   CHECK_PORT_CHANGE(G);
+  if (batch_changes) SendDigitalInChanges();
+}
+
+void __attribute__((__interrupt__, auto_psv)) _T1Interrupt() {
+  const SAMPLED_PIN* p = sampled_pins;
+  const SAMPLED_PIN* const end = sampled_pins + num_sampled_pins;
+  _T1IF = 0;
+  if (sample_gap) return;
+  for (; p != end; ++p) {
+    if (*p->port & p->mask) sample_byte |= sample_bit;
+    sample_bit <<= 1;
+    if (!sample_bit) {
+      if (!ByteRingRemaining(&sample_ring)) {
+        // Restart on a tick boundary once the gap has been reported.
+        sample_gap = TRUE;
+        sample_byte = 0;
+        sample_bit = 1;
+        return;
+      }
+      ByteRingPushByte(&sample_ring, sample_byte);
+      sample_byte = 0;
+      sample_bit = 1;
+    }
+  }
 }
@@ -30,9 +30,23 @@
 #ifndef __DIGITAL_H__
 #define __DIGITAL_H__
 
+#include "GenericTypeDefs.h"
 
 void SetDigitalOutLevel(int pin, int value);
+// Sets pins first_pin onwards at once. mask_and_value is a bitmap of the pins
+// to set, num_bytes long, followed by a bitmap of their levels.
+void SetDigitalOutLevels(int first_pin, int num_bytes,
+                         const BYTE* mask_and_value);
 void SetChangeNotify(int pin, int changeNotify);
+// When enabled, all the changes found by one change notification interrupt go
+// in a single REPORT_DIGITAL_IN_CHANGES rather than a REPORT_DIGITAL_IN_STATUS
+// each.
+void SetDigitalInBatching(int enable);
+// Adds pin to the pins sampled every (freq_scale + 1) * 10us, or removes it if
+// freq_scale is 0. A non-zero freq_scale sets the rate for all the pins.
+void RegisterPeriodicDigitalSampling(int pin, int freq_scale);
+void DigitalInit();
+void DigitalTasks();
 
 
 #endif  // __DIGITAL_H__
@@ -0,0 +1,179 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+#include "encoder.h"
+
+#include <string.h>
+
+#include "Compiler.h"
+#include "logging.h"
+#include "pins.h"
+#include "protocol.h"
+#include "sync.h"
+#include "timebase.h"
+
+typedef struct {
+  volatile unsigned int* port_a;
+  volatile unsigned int* port_b;
+  unsigned int mask_a;
+  unsigned int mask_b;
+  int pin_a;
+  int pin_b;
+  // Owned by the change notification interrupt while enabled.
+  BOOL enabled;
+  BYTE state;  // B:A as of the last edge
+  LONG position;
+  // Reporting.
+  WORD period;  // ms, 0 for only on request
+  BOOL report_requested;
+  DWORD last_report_time;
+  LONG last_report_position;
+} ENCODER;
+
+static ENCODER encoders[NUM_ENCODERS];
+
+// Position change, indexed by the previous state << 2 | the new state. When
+// both lines change at once an edge has been missed, and we cannot tell which
+// way.
+static const signed char quad_delta[16] = {
+   0,  1, -1,  0,
+  -1,  0,  0,  1,
+   1,  0,  0, -1,
+   0, -1,  1,  0
+};
+
+static BYTE ReadState(const ENCODER* enc) {
+  return ((*enc->port_b & enc->mask_b) ? 2 : 0)
+         | ((*enc->port_a & enc->mask_a) ? 1 : 0);
+}
+
+void EncoderInit() {
+  int i;
+  BYTE prev = SyncInterruptLevel(1);
+  for (i = 0; i < NUM_ENCODERS; ++i) {
+    if (encoders[i].enabled) {
+      PinSetCnenQuiet(encoders[i].pin_a, 0);
+      PinSetCnenQuiet(encoders[i].pin_b, 0);
+    }
+  }
+  memset(encoders, 0, sizeof encoders);
+  SyncInterruptLevel(prev);
+}
+
+static void EncoderSendStatus(int encoder_num, int enabled) {
+  OUTGOING_MESSAGE msg;
+  msg.type = ENCODER_STATUS;
+  msg.args.encoder_status.encoder_num = encoder_num;
+  msg.args.encoder_status.enabled = enabled;
+  AppProtocolSendMessage(&msg);
+}
+
+void EncoderConfig(int encoder_num, int enable, int pin_a, int pin_b,
+                   int period) {
+  ENCODER* enc = &encoders[encoder_num];
+  BYTE prev;
+  log_printf("EncoderConfig(%d, %d, %d, %d, %d)", encoder_num, enable, pin_a,
+             pin_b, period);
+  if (enc->enabled) {
+    prev = SyncInterruptLevel(1);
+    enc->enabled = FALSE;
+    SyncInterruptLevel(prev);
+    PinSetCnenQuiet(enc->pin_a, 0);
+    PinSetCnenQuiet(enc->pin_b, 0);
+    EncoderSendStatus(encoder_num, 0);
+  }
+  if (!enable) return;
+  enc->pin_a = pin_a;
+  enc->pin_b = pin_b;
+  PinGetPortReg(pin_a, &enc->port_a, &enc->mask_a);
+  PinGetPortReg(pin_b, &enc->port_b, &enc->mask_b);
+  enc->period = period;
+  enc->report_requested = FALSE;
+  enc->last_report_time = TimebaseNow();
+  enc->last_report_position = 0;
+  prev = SyncInterruptLevel(1);
+  enc->state = ReadState(enc);
+  enc->position = 0;
+  enc->enabled = TRUE;
+  SyncInterruptLevel(prev);
+  PinSetCnenQuiet(pin_a, 1);
+  PinSetCnenQuiet(pin_b, 1);
+  EncoderSendStatus(encoder_num, 1);
+}
+
+void EncoderRead(int encoder_num) {
+  log_printf("EncoderRead(%d)", encoder_num);
+  encoders[encoder_num].report_requested = TRUE;
+}
+
+void EncoderUpdate() {
+  int i;
+  for (i = 0; i < NUM_ENCODERS; ++i) {
+    ENCODER* enc = &encoders[i];
+    BYTE state;
+    if (!enc->enabled) continue;
+    state = ReadState(enc);
+    enc->position += quad_delta[enc->state << 2 | state];
+    enc->state = state;
+  }
+}
+
+static void EncoderSendReport(int encoder_num) {
+  ENCODER* enc = &encoders[encoder_num];
+  OUTGOING_MESSAGE msg;
+  DWORD now;
+  LONG position;
+  BYTE prev = SyncInterruptLevel(1);
+  now = TimebaseNow();
+  position = enc->position;
+  msg.type = ENCODER_REPORT;
+  msg.args.encoder_report.encoder_num = encoder_num;
+  msg.args.encoder_report.position = position;
+  msg.args.encoder_report.delta = position - enc->last_report_position;
+  msg.args.encoder_report.interval = now - enc->last_report_time;
+  AppProtocolSendMessage(&msg);
+  SyncInterruptLevel(prev);
+  enc->last_report_time = now;
+  enc->last_report_position = position;
+  enc->report_requested = FALSE;
+}
+
+void EncoderTasks() {
+  int i;
+  for (i = 0; i < NUM_ENCODERS; ++i) {
+    ENCODER* enc = &encoders[i];
+    if (!enc->enabled) continue;
+    if (enc->report_requested
+        || (enc->period
+            && TimebaseNow() - enc->last_report_time
+               >= enc->period * 1000UL)) {
+      EncoderSendReport(i);
+    }
+  }
+}
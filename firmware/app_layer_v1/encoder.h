@@ -0,0 +1,58 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+// Quadrature encoder decoding.
+// The A and B lines are watched through change notification and every edge
+// moves a 32-bit position by one count, up when A leads B. Positions are
+// reported in ENCODER_REPORT messages, periodically and on request, along with
+// the counts and time since the previous report, from which the client gets
+// the velocity.
+
+#ifndef __ENCODER_H__
+#define __ENCODER_H__
+
+#define NUM_ENCODERS 4
+
+void EncoderInit();
+
+// Starts decoding on pins pin_a and pin_b, which need to be digital inputs,
+// from a position of 0, reporting every period ms or, when period is 0, only
+// on request. Stops decoding if !enable.
+void EncoderConfig(int encoder_num, int enable, int pin_a, int pin_b,
+                   int period);
+
+// Have the position of the encoder reported.
+void EncoderRead(int encoder_num);
+
+// Called from the change notification interrupt.
+void EncoderUpdate();
+
+void EncoderTasks();
+
+#endif  // __ENCODER_H__
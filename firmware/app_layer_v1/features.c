@@ -36,13 +36,19 @@
 #include "logging.h"
 #include "protocol.h"
 #include "adc.h"
+#include "digital.h"
+#include "encoder.h"
+#include "reflex.h"
+#include "control.h"
 #include "pwm.h"
 #include "uart.h"
 #include "spi.h"
 #include "i2c.h"
 #include "timers.h"
+#include "timebase.h"
 #include "pp_util.h"
 #include "incap.h"
+#include "scheduler.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 // Pin modes
@@ -232,27 +238,63 @@ void SoftReset() {
   SRbits.IPL = 7;  // disable interrupts
   log_printf("SoftReset()");
   TimersInit();
+  TimebaseInit();
   PinsInit();
+  DigitalInit();
+  EncoderInit();
+  ReflexInit();
+  ControlInit();
   PWMInit();
   ADCInit();
   UARTInit();
   SPIInit();
   I2CInit();
   InCapInit();
+  SchedulerInit();
 
   // TODO: reset all peripherals!
   SRbits.IPL = ipl_backup;  // enable interrupts
 }
 
-void CheckInterface(BYTE interface_id[8]) {
+void CheckInterface(const BYTE interface_id[8]) {
   OUTGOING_MESSAGE msg;
   msg.type = CHECK_INTERFACE_RESPONSE;
   msg.args.check_interface_response.supported
-      = (memcmp(interface_id, PROTOCOL_IID_IOIO0004, 8) == 0)
+      = (memcmp(interface_id, PROTOCOL_IID_IOIO0005, 8) == 0)
+        || (memcmp(interface_id, PROTOCOL_IID_IOIO0004, 8) == 0)
         || (memcmp(interface_id, PROTOCOL_IID_IOIO0003, 8) == 0)
         || (memcmp(interface_id, PROTOCOL_IID_IOIO0002, 8) == 0)
         || (memcmp(interface_id, PROTOCOL_IID_IOIO0001, 8) == 0);
   AppProtocolSendMessage(&msg);
 }
 
+void GetCapabilities() {
+  OUTGOING_MESSAGE msg;
+  msg.type = CAPABILITIES;
+  msg.args.capabilities.capabilities = CAPABILITY_ANALOG_SCAN
+                                       | CAPABILITY_ADC_CAPTURE
+                                       | CAPABILITY_ANALOG_TRIGGER
+                                       | CAPABILITY_ANALOG_DEADBAND
+                                       | CAPABILITY_ANALOG_DELTA
+                                       | CAPABILITY_TIMESTAMPS
+                                       | CAPABILITY_BATCH
+                                       | CAPABILITY_DIGITAL_OUT_LEVELS
+                                       | CAPABILITY_DIGITAL_IN_CHANGES
+                                       | CAPABILITY_PERIODIC_DIGITAL_IN
+                                       | CAPABILITY_ENCODER
+                                       | CAPABILITY_INCAP_EXTENDED
+                                       | CAPABILITY_FREQUENCY_COUNTER
+                                       | CAPABILITY_PWM_SEQUENCER
+                                       | CAPABILITY_PWM_GROUP
+                                       | CAPABILITY_SCHEDULER
+                                       | CAPABILITY_REFLEX
+                                       | CAPABILITY_CONTROL
+                                       | CAPABILITY_ANALOG_FILTER
+                                       | CAPABILITY_UART_RX_AGGREGATION;
+#if !ADC_CAPTURE_BUF_SIZE
+  msg.args.capabilities.capabilities &= ~CAPABILITY_ADC_CAPTURE;
+#endif
+  AppProtocolSendMessage(&msg);
+}
+
 // BOOKMARK(add_feature): Add feature implementation.
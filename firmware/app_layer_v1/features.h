@@ -42,7 +42,8 @@ void SetPinSpi(int pin, int spi_num, int mode, int enable);
 void SetPinInCap(int pin, int incap_num, int enable);
 void HardReset();
 void SoftReset();
-void CheckInterface(BYTE interface_id[8]);
+void CheckInterface(const BYTE interface_id[8]);
+void GetCapabilities();
 
 
 #endif  // __FEATURES_H__
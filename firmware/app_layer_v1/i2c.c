@@ -33,7 +33,7 @@
 #include "Compiler.h"
 #include "platform.h"
 #include "sync.h"
-#include "byte_queue.h"
+#include "byte_ring.h"
 #include "logging.h"
 #include "pp_util.h"
 #include "protocol.h"
@@ -74,9 +74,9 @@ typedef struct {
   int num_tx_since_last_report;
   int bytes_remaining;
 
-  BYTE_QUEUE rx_queue;
+  BYTE_RING rx_queue;
   int num_messages_rx_queue;
-  BYTE_QUEUE tx_queue;
+  BYTE_RING tx_queue;
 
   BYTE rx_buffer[RX_BUF_SIZE];
   BYTE tx_buffer[TX_BUF_SIZE];
@@ -134,8 +134,8 @@ static void I2CConfigMasterInternal(int i2c_num, int rate, int smbus_levels, int
   Set_MI2CIE[i2c_num](0);  // disable interrupt
   regs->con = 0x0000;  // disable module
   Set_MI2CIF[i2c_num](0);  // clear interrupt
-  ByteQueueInit(&i2c->tx_queue, i2c->tx_buffer, TX_BUF_SIZE);
-  ByteQueueInit(&i2c->rx_queue, i2c->rx_buffer, RX_BUF_SIZE);
+  ByteRingInit(&i2c->tx_queue, i2c->tx_buffer, TX_BUF_SIZE);
+  ByteRingInit(&i2c->rx_queue, i2c->rx_buffer, RX_BUF_SIZE);
   i2c->num_tx_since_last_report = 0;
   i2c->num_messages_rx_queue = 0;
   i2c->message_state = STATE_START;
@@ -180,26 +180,24 @@ void I2CTasks() {
     int size1, size2, size;
     const BYTE *data1, *data2;
     I2C_STATE* i2c = &i2c_states[i];
-    BYTE_QUEUE* q = &i2c->rx_queue;
+    BYTE_RING* q = &i2c->rx_queue;
     BYTE prev;
     while (i2c->num_messages_rx_queue) {
       OUTGOING_MESSAGE msg;
       msg.type = I2C_RESULT;
       msg.args.i2c_result.i2c_num = i;
+      msg.args.i2c_result.size = ByteRingPullByte(q);
       prev = SyncInterruptLevel(4);
-      msg.args.i2c_result.size = ByteQueuePullByte(q);
       --i2c->num_messages_rx_queue;
       SyncInterruptLevel(prev);
       log_printf("I2C %d received %d bytes", i, msg.args.i2c_result.size);
       if (msg.args.i2c_result.size != 0xFF && msg.args.i2c_result.size > 0) {
-        ByteQueuePeekMax(q, msg.args.i2c_result.size, &data1, &size1, &data2,
-                         &size2);
+        ByteRingPeekMax(q, msg.args.i2c_result.size, &data1, &size1, &data2,
+                        &size2);
         size = size1 + size2;
         assert(size == msg.args.i2c_result.size);
         AppProtocolSendMessageWithVarArgSplit(&msg, data1, size1, data2, size2);
-        prev = SyncInterruptLevel(4);
-        ByteQueuePull(q, size);
-        SyncInterruptLevel(prev);
+        ByteRingPull(q, size);
       } else {
         AppProtocolSendMessage(&msg);
       }
@@ -220,9 +218,15 @@ void I2CWriteRead(int i2c_num, unsigned int addr, const void* data,
   hdr.addr = addr;
   hdr.write_size = write_bytes;
   hdr.read_size = read_bytes;
+  // the ISR starts a transaction as soon as its header is visible, so the
+  // header and data must become visible together.
   prev = SyncInterruptLevel(4);
-  ByteQueuePushBuffer(&i2c->tx_queue, &hdr, sizeof hdr);
-  ByteQueuePushBuffer(&i2c->tx_queue, data, write_bytes);
+  if (ByteRingRemaining(&i2c->tx_queue) >= (int) sizeof hdr + write_bytes) {
+    ByteRingPushBuffer(&i2c->tx_queue, &hdr, sizeof hdr);
+    ByteRingPushBuffer(&i2c->tx_queue, data, write_bytes);
+  } else {
+    ByteRingOverflow(&i2c->tx_queue);
+  }
   Set_MI2CIE[i2c_num](1);
   SyncInterruptLevel(prev);
 }
@@ -234,7 +238,7 @@ static void MI2CInterrupt(int i2c_num) {
   Set_MI2CIF[i2c_num](0);  // clear interrupt
   switch (i2c->message_state) {
     case STATE_START:
-      ByteQueuePullToBuffer(&i2c->tx_queue, &i2c->cur_tx_header,
+      ByteRingPullToBuffer(&i2c->tx_queue, &i2c->cur_tx_header,
                             sizeof(TX_MESSAGE_HEADER));
       i2c->num_tx_since_last_report += sizeof(TX_MESSAGE_HEADER);
       i2c->bytes_remaining = i2c->cur_tx_header.write_size;
@@ -264,7 +268,7 @@ static void MI2CInterrupt(int i2c_num) {
     case STATE_WRITE_DATA:
       if (reg->stat >> 15) goto error;
       {
-        BYTE b = ByteQueuePullByte(&i2c->tx_queue);
+        BYTE b = ByteRingPullByte(&i2c->tx_queue);
         reg->trn = b;
       }
       ++i2c->num_tx_since_last_report;
@@ -277,7 +281,7 @@ static void MI2CInterrupt(int i2c_num) {
 
     case STATE_STOP_WRITE_ONLY:
       if (reg->stat >> 15) goto error;
-      ByteQueuePushByte(&i2c->rx_queue, 0x00);
+      ByteRingPushByte(&i2c->rx_queue, 0x00);
       goto done;
       
     case STATE_RESTART:
@@ -294,13 +298,13 @@ static void MI2CInterrupt(int i2c_num) {
       if (reg->stat >> 15) goto error;
       // from now on, we can no longer fail.
       i2c->bytes_remaining = i2c->cur_tx_header.read_size;
-      ByteQueuePushByte(&i2c->rx_queue, i2c->cur_tx_header.read_size);
+      ByteRingPushByte(&i2c->rx_queue, i2c->cur_tx_header.read_size);
       reg->con |= 0x0008;  // RCEN
       i2c->message_state = STATE_READ_DATA;
       break;
 
     case STATE_READ_DATA:
-      ByteQueuePushByte(&i2c->rx_queue, reg->rcv);
+      ByteRingPushByte(&i2c->rx_queue, reg->rcv);
       reg->con &= ~(1 << 5);  // reset ack state
       reg->con |= (1 << 4)
                   | (i2c->bytes_remaining == 1) << 5;  // nack last byte
@@ -321,15 +325,15 @@ static void MI2CInterrupt(int i2c_num) {
 error:
   log_printf("I2C error");
   // pull remainder of tx message
-  ByteQueuePull(&i2c->tx_queue, i2c->bytes_remaining);
+  ByteRingPull(&i2c->tx_queue, i2c->bytes_remaining);
   i2c->num_tx_since_last_report += i2c->bytes_remaining;
-  ByteQueuePushByte(&i2c->rx_queue, 0xFF);
+  ByteRingPushByte(&i2c->rx_queue, 0xFF);
 
 done:
   ++i2c->num_messages_rx_queue;
   reg->con |= (1 << 2);  // send stop bit
   i2c->message_state = STATE_START;
-  Set_MI2CIE[i2c_num](ByteQueueSize(&i2c->tx_queue) > 0);
+  Set_MI2CIE[i2c_num](ByteRingSize(&i2c->tx_queue) > 0);
 }
 
 #define DEFINE_INTERRUPT_HANDLERS(i2c_num)                                     \
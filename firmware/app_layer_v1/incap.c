@@ -29,10 +29,13 @@
 
 // Here's the deal:
 // We want to measure the time between two edges and report it. We do not want
-// our reports to happen more often than 200 times a second.
-// We set timer 5 to fire an interrupt 200 times a second and from within this
-// interrupt we start a capture on any modules that should be enabled and are
-// not currently capturing.
+// our reports to happen more often than the client asked for, by default 200
+// times a second.
+// We set timer 5 to fire an interrupt about every 1ms and every module counts
+// these down from its re-arm period, 5 by default. Whenever a module's count
+// runs out, we start a capture on it if it should be enabled and is not
+// currently capturing. A module with a re-arm period of 0 starts its next
+// capture right after the report, without waiting for the timer.
 //
 // When measuring pulses (rising-to-falling or falling-to-rising):
 // Once the first edge is detected, an incap interrupt will fire. We set this
@@ -47,18 +50,41 @@
 // This is simpler: we set the module to fire after two captures and we set the
 // interrupt priority directly to 1. Then we handle the interrupt the same as
 // we handle the trailing edge of the first case.
+//
+// When logging edges:
+// The module captures every edge and is never turned off. Its interrupt, at
+// priority 6, drains the FIFO into a ring of raw capture values, which
+// InCapTasks() sends out in INCAP_EDGES messages. If an edge is lost, because
+// either the FIFO or the ring overflowed, the interrupt turns the module off.
+// Once everything captured before the loss is out, InCapTasks() sends an empty
+// INCAP_EDGES to report it and restarts the module, whose timer starts again
+// from 0.
+//
+// When counting frequency:
+// The module captures every 1st, 4th or 16th rising edge, and its interrupt,
+// at priority 6, adds up how many edges there were and how many clock ticks
+// passed between the first and last capture it has seen. Every gate time, the
+// timer interrupt takes whatever is left in the FIFO, reports the sums in an
+// INCAP_COUNT message and starts new ones from the last capture. Since both
+// sums span whole periods of the signal, edges / ticks is as precise as the
+// clock, no matter where in the period the gate ends. If the FIFO overflows,
+// the interval in which captures were lost is left out of the sums and the
+// module is restarted.
 
 #include "incap.h"
 
 #include <assert.h>
 
 #include "Compiler.h"
+#include "byte_ring.h"
+#include "control.h"
 #include "platform.h"
 #include "logging.h"
 #include "pp_util.h"
 #include "sync.h"
 #include "protocol_defs.h"
 #include "protocol.h"
+#include "timebase.h"
 #include "uart2.h"
 
 DEFINE_REG_SETTERS_1B(NUM_INCAP_MODULES, _IC, IF)
@@ -74,6 +100,17 @@ typedef struct {
 
 static INCAP_REG* incap_regs = (INCAP_REG *) & IC1CON1;
 
+// con1
+#define ICBNE 0x0008
+#define ICOV 0x0010
+
+#define MODE_EDGES 6
+#define MODE_COUNT 7
+#define DEFAULT_REARM_PERIOD 5
+#define EDGE_BUF_SIZE 128
+#define DEFAULT_GATE 100
+#define DEFAULT_PRESCALE 2
+
 typedef enum {
   LEADING = 0,
   TRAILING = 1
@@ -92,8 +129,37 @@ static WORD con1_vals[NUM_INCAP_MODULES];
 static unsigned flip[NUM_INCAP_MODULES];
 
 // A bit mask, in which if bit k is set, module number k needs to be turned on
-// upon the next timer interrupt.
+// once its countdown of timer interrupts runs out.
 static unsigned armed = 0;
+static BYTE countdowns[NUM_INCAP_MODULES];
+
+// For each module, the number of timer interrupts between capture starts, 0
+// for starting right after each report.
+static BYTE rearm_periods[NUM_INCAP_MODULES];
+
+// For each module, whether it logs edges, and for those that do, the captures
+// waiting to be sent and whether edges have been lost.
+static BOOL log_edges[NUM_INCAP_MODULES];
+static BYTE_RING edge_rings[NUM_INCAP_MODULES];
+static BYTE edge_bufs[NUM_INCAP_MODULES][EDGE_BUF_SIZE] __attribute__((far));
+static volatile BOOL edges_lost[NUM_INCAP_MODULES];
+
+typedef struct {
+  WORD gate;  // in timer interrupts.
+  BYTE prescale;  // 0, 1, 2 for every 1st, 4th, 16th rising edge.
+  // The following are only valid while counting.
+  WORD countdown;
+  BYTE edges_per_capture;
+  BOOL started;  // whether last holds a capture.
+  BOOL overflow;
+  DWORD last;
+  DWORD edges;
+  DWORD ticks;
+} COUNTER;
+
+// For each module, whether it counts frequency, and the counting state.
+static volatile BOOL counting[NUM_INCAP_MODULES];
+static COUNTER counters[NUM_INCAP_MODULES];
 
 static void InCapConfigInternal(int incap_num, int double_prec, int mode,
                                 int clock, int external);
@@ -104,18 +170,35 @@ void InCapInit() {
   _T5IE = 0; // Make sure we don't trigger new captures.
   for (i = 0; i < NUM_INCAP_MODULES; ++i) {
     InCapConfigInternal(i, 0, 0, 0, 0);
+    rearm_periods[i] = DEFAULT_REARM_PERIOD;
+    countdowns[i] = DEFAULT_REARM_PERIOD;
+    counters[i].gate = DEFAULT_GATE;
+    counters[i].prescale = DEFAULT_PRESCALE;
   }
   // Now we're safe - all modules are off and all interrupts are clear.
   armed = 0;
 
-  PR5 = 312;  // 5ms period = 200Hz
+  PR5 = 61;  // 62 ticks, alternating with 63 for 1ms on average.
   TMR5 = 0x0000;
   _T5IF = 0;
   _T5IP = 1;
-  _T5IE = 1; // Now our timer will start firing 200 times a second.
+  _T5IE = 1; // Now our timer will start firing 1000 times a second.
+}
+
+// Turns the module on. In cascade (32-bit) mode, the higher module needs to be
+// started first.
+static inline void InCapStart(int incap_num, int double_prec) {
+  if (double_prec) {
+    incap_regs[incap_num + 1].con1 = con1_vals[incap_num + 1];
+  }
+  incap_regs[incap_num].con1 = con1_vals[incap_num];
 }
 
 static inline void InCapArm(int incap_num, int double_prec) {
+  if (!rearm_periods[incap_num]) {
+    InCapStart(incap_num, double_prec);
+    return;
+  }
   _T5IE = 0;
   if (double_prec) {
     armed |= 3 << incap_num;
@@ -153,12 +236,19 @@ static void InCapConfigInternal(int incap_num, int double_prec, int mode,
   if (double_prec) {
     reg2->con1 = 0x0000;
   }
+  log_edges[incap_num] = FALSE;
+  edges_lost[incap_num] = FALSE;
+  counting[incap_num] = FALSE;
 
   if (mode) {
     // Whether to flip, indexed by (mode - 1)
-    static const unsigned FLIPS[] = {1, 1, 0, 0, 0};
-    // The ICM and ICI bits values to use, indexed by (mode - 1)
-    static const unsigned int ICM_ICI[] = {3, 2, 3 | (1 << 5), 4 | (1 << 5), 5 | (1 << 5)};
+    static const unsigned FLIPS[] = {1, 1, 0, 0, 0, 0, 0};
+    // The ICM and ICI bits values to use, indexed by (mode - 1). When
+    // counting, ICM comes from the prescale, and an interrupt every 3rd
+    // capture leaves one free place in the FIFO for the interrupt latency.
+    static const unsigned int ICM_ICI[] = {3, 2, 3 | (1 << 5), 4 | (1 << 5), 5 | (1 << 5), 1, 2 << 5};
+    // The ICM bits values to use when counting, indexed by prescale
+    static const unsigned int COUNT_ICM[] = {3, 4, 5};
     // The ICTSEL (clock select) bits values to use, indexed by clock
     static const unsigned int ICTSEL[] = {7 << 10, 0 << 10, 2 << 10, 3 << 10};
 
@@ -179,16 +269,46 @@ static void InCapConfigInternal(int incap_num, int double_prec, int mode,
     // Prepare the values required to turn on the module in the right mode in
     // con1_vals, to be picked up by the timer interrupt.
     con1_vals[incap_num] = ICTSEL[clock] | ICM_ICI[mode - 1];
+    if (mode == MODE_COUNT) {
+      COUNTER * const c = counters + incap_num;
+      con1_vals[incap_num] |= COUNT_ICM[c->prescale];
+      c->countdown = c->gate;
+      c->edges_per_capture = 1 << (2 * c->prescale);
+      c->started = FALSE;
+      c->overflow = FALSE;
+      c->edges = 0;
+      c->ticks = 0;
+    }
     if (double_prec) {
       con1_vals[incap_num + 1] = con1_vals[incap_num];
+      // Both halves need to start on the same timer interrupt.
+      _T5IE = 0;
+      rearm_periods[incap_num + 1] = rearm_periods[incap_num];
+      countdowns[incap_num + 1] = countdowns[incap_num];
+      _T5IE = 1;
+    }
+
+    if (mode == MODE_EDGES) {
+      log_edges[incap_num] = TRUE;
+      ByteRingInit(&edge_rings[incap_num], edge_bufs[incap_num], EDGE_BUF_SIZE);
     }
 
     Set_ICIF[incap_num](0); // Clear interrupts
-    Set_ICIP[incap_num](edge_states[incap_num] == LEADING ? 6 : 1);  // First edge is high-priority.
+    // First edge is high-priority, and so is every edge when logging or
+    // counting.
+    Set_ICIP[incap_num](edge_states[incap_num] == LEADING
+                        || mode >= MODE_EDGES ? 6 : 1);
     Set_ICIE[incap_num](1); // Enable interrupts
 
-    InCapArm(incap_num, double_prec);
-    // The next T5 interrupt will enable the module.
+    if (mode == MODE_COUNT) {
+      counting[incap_num] = TRUE;
+      InCapStart(incap_num, double_prec);
+    } else if (mode == MODE_EDGES) {
+      InCapStart(incap_num, double_prec);
+    } else {
+      InCapArm(incap_num, double_prec);
+      // Unless the module re-arms right away, a T5 interrupt will enable it.
+    }
   } else {
     if (external) {
       msg.args.incap_status.enabled = 0;
@@ -203,6 +323,27 @@ void InCapConfig(int incap_num, int double_prec, int mode, int clock) {
   InCapConfigInternal(incap_num, double_prec, mode, clock, 1);
 }
 
+void InCapSetRearmPeriod(int incap_num, int period) {
+  log_printf("InCapSetRearmPeriod(%d, %d)", incap_num, period);
+  // Count down from 1, so that a module that is already armed gets started
+  // on the next timer interrupt even with the new period being 0.
+  _T5IE = 0;
+  rearm_periods[incap_num] = period;
+  countdowns[incap_num] = 1;
+  if (incap_regs[incap_num].con2 & (1 << 8)) {
+    // The lower half of a 32-bit module.
+    rearm_periods[incap_num + 1] = period;
+    countdowns[incap_num + 1] = 1;
+  }
+  _T5IE = 1;
+}
+
+void InCapSetGate(int incap_num, int prescale, int gate) {
+  log_printf("InCapSetGate(%d, %d, %d)", incap_num, prescale, gate);
+  counters[incap_num].prescale = prescale;
+  counters[incap_num].gate = gate;
+}
+
 inline static int NumBytes16(WORD val) {
   return val > 0xFF ? 2 : 1;
 }
@@ -220,6 +361,7 @@ inline static void ReportCapture(int incap_num, int double_prec) {
   INCAP_REG * const reg2 = reg + 1;
   int size;
   DWORD_VAL delta_time;
+  DWORD capture;
   OUTGOING_MESSAGE msg;
   msg.type = INCAP_REPORT;
   msg.args.incap_report.incap_num = incap_num;
@@ -236,6 +378,7 @@ inline static void ReportCapture(int incap_num, int double_prec) {
     delta_time.Val -= base.Val;
     log_printf("%lu", delta_time.Val);
     size = NumBytes32(delta_time.Val);
+    capture = delta_time.Val;
   } else {
     // 16-bit mode
     assert(reg->con1 & (1 << 3));  // Buffer not empty.
@@ -244,9 +387,116 @@ inline static void ReportCapture(int incap_num, int double_prec) {
     delta_time.word.LW = reg->buf - base;
     log_printf("%u", delta_time.word.LW);  // TEMP!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
     size = NumBytes16(delta_time.word.LW);
+    capture = delta_time.word.LW;
   }
   msg.args.incap_report.size = size;
+  TimebaseStamp(TIMESTAMP_INCAP, TimebaseNow());
   AppProtocolSendMessageWithVarArg(&msg, &delta_time, size);
+  ControlCapture(incap_num, capture);
+}
+
+static void LogEdges(int incap_num, int double_prec) {
+  INCAP_REG * const reg = incap_regs + incap_num;
+  INCAP_REG * const reg2 = reg + 1;
+  BYTE_RING * const ring = &edge_rings[incap_num];
+  const int size = double_prec ? 4 : 2;
+  WORD capture[2];
+  while ((reg->con1 & ICBNE) && ByteRingRemaining(ring) >= size) {
+    capture[0] = reg->buf;
+    if (double_prec) {
+      capture[1] = reg2->buf;
+    }
+    ByteRingPushBuffer(ring, capture, size);
+  }
+  if (reg->con1 & (ICBNE | ICOV)) {
+    // Lost an edge. Stop until InCapTasks() has reported it.
+    reg->con1 = 0x0000;
+    if (double_prec) {
+      reg2->con1 = 0x0000;
+    }
+    Set_ICIF[incap_num](0);
+    edges_lost[incap_num] = TRUE;
+  }
+}
+
+static void SendEdges(int incap_num, const BYTE* data1, int size1,
+                      const BYTE* data2, int size2) {
+  OUTGOING_MESSAGE msg;
+  msg.type = INCAP_EDGES;
+  msg.args.incap_edges.incap_num = incap_num;
+  msg.args.incap_edges.size = size1 + size2;
+  BYTE prev = SyncInterruptLevel(1);
+  AppProtocolSendMessageWithVarArgSplit(&msg, data1, size1, data2, size2);
+  SyncInterruptLevel(prev);
+}
+
+void InCapTasks() {
+  int i;
+  for (i = 0; i < NUM_INCAP_MODULES; ++i) {
+    int size1, size2;
+    const BYTE *data1, *data2;
+    BYTE_RING * const ring = &edge_rings[i];
+    if (!log_edges[i]) continue;
+    // A multiple of either capture size, so captures never straddle messages.
+    ByteRingPeekMax(ring, 64, &data1, &size1, &data2, &size2);
+    if (size1) {
+      SendEdges(i, data1, size1, data2, size2);
+      ByteRingPull(ring, size1 + size2);
+    } else if (edges_lost[i]) {
+      log_printf("Incap %d lost edges", i);
+      SendEdges(i, NULL, 0, NULL, 0);
+      edges_lost[i] = FALSE;
+      InCapStart(i, incap_regs[i].con2 & (1 << 8));
+    }
+  }
+}
+
+static void CountEdges(int incap_num, int double_prec) {
+  INCAP_REG * const reg = incap_regs + incap_num;
+  INCAP_REG * const reg2 = reg + 1;
+  COUNTER * const c = counters + incap_num;
+  while (reg->con1 & ICBNE) {
+    DWORD_VAL capture;
+    capture.word.LW = reg->buf;
+    capture.word.HW = double_prec ? reg2->buf : 0;
+    if (c->started) {
+      const DWORD ticks = capture.Val - c->last;
+      c->ticks += double_prec ? ticks : (WORD) ticks;
+      c->edges += c->edges_per_capture;
+    }
+    c->last = capture.Val;
+    c->started = TRUE;
+  }
+  if (reg->con1 & ICOV) {
+    // Turning the module off is the only way to clear the overflow.
+    reg->con1 = 0x0000;
+    if (double_prec) {
+      reg2->con1 = 0x0000;
+    }
+    InCapStart(incap_num, double_prec);
+    c->started = FALSE;
+    c->overflow = TRUE;
+  }
+}
+
+// Called from the timer interrupt, which is allowed to send.
+static void EndGate(int incap_num) {
+  COUNTER * const c = counters + incap_num;
+  OUTGOING_MESSAGE msg;
+  msg.type = INCAP_COUNT;
+  msg.args.incap_count.incap_num = incap_num;
+
+  Set_ICIE[incap_num](0);
+  CountEdges(incap_num, incap_regs[incap_num].con2 & (1 << 8));
+  msg.args.incap_count.overflow = c->overflow;
+  msg.args.incap_count.edges = c->edges;
+  msg.args.incap_count.ticks = c->ticks;
+  c->overflow = FALSE;
+  c->edges = 0;
+  c->ticks = 0;
+  Set_ICIE[incap_num](1);
+
+  AppProtocolSendMessage(&msg);
 }
 
 static void ICInterrupt(int incap_num) {
@@ -256,6 +506,15 @@ static void ICInterrupt(int incap_num) {
   INCAP_REG * const reg2 = reg + 1;
   const int double_prec = reg->con2 & (1 << 8);
 
+  if (log_edges[incap_num]) {
+    LogEdges(incap_num, double_prec);
+    return;
+  }
+  if (counting[incap_num]) {
+    CountEdges(incap_num, double_prec);
+    return;
+  }
+
   // Toggle bit 0 of con1 to invert edge polarity if we need to.
   const unsigned f = flip[incap_num];
   reg->con1 ^= f;
@@ -292,23 +551,26 @@ static void ICInterrupt(int incap_num) {
 }
 
 void __attribute__((__interrupt__, auto_psv)) _T5Interrupt() {
-  // Trigger all the armed modules by copying the value from con1_vals to their
-  // con1 register.
+  // Trigger all the armed modules whose countdown has run out by copying the
+  // value from con1_vals to their con1 register.
   // It is important that we do this in reverse order, since in cascade (32-bit)
   // mode, the higher module needs to be started first.
-  // At the end of the process - everything is un-armed.
-#define MASK (1 << (NUM_INCAP_MODULES - 1))
-  int i = NUM_INCAP_MODULES;
-  while (armed) {
-    --i;
-    if (armed & MASK) {
-      incap_regs[i].con1 = con1_vals[i];
-      armed &= ~MASK;
+  int i;
+  for (i = NUM_INCAP_MODULES - 1; i >= 0; --i) {
+    if (countdowns[i] && !--countdowns[i]) {
+      countdowns[i] = rearm_periods[i];
+      if (armed & (1 << i)) {
+        incap_regs[i].con1 = con1_vals[i];
+        armed &= ~(1 << i);
+      }
+    }
+    if (counting[i] && !--counters[i].countdown) {
+      counters[i].countdown = counters[i].gate;
+      EndGate(i);
     }
-    armed <<= 1;
   }
+  PR5 = PR5 == 61 ? 62 : 61;
   _T5IF = 0; // clear
-#undef MASK
 }
 
 #define DEFINE_INTERRUPT(num, unused) \
@@ -30,6 +30,7 @@
 #ifndef __INCAP_H__
 #define __INCAP_H__
 
+#include "GenericTypeDefs.h"
 
 void InCapInit();
 
@@ -40,6 +41,8 @@ void InCapInit();
 //   3: rise-to-rise
 //   4: rise-to-rise x 4
 //   5: rise-to-rise x 16
+//   6: every edge, logged in INCAP_EDGES messages
+//   7: frequency count, reported in INCAP_COUNT messages every gate time
 //
 // clock:
 //   0: 16MHz
@@ -48,5 +51,17 @@ void InCapInit();
 //   3: 62.5KHz
 void InCapConfig(int incap_num, int double_prec, int mode, int clock);
 
+// Sets the minimum time in ms between the starts of a module's captures, 0 for
+// starting a new capture right after each report. The default is 5. Does not
+// affect edge logging, which never stops capturing.
+void InCapSetRearmPeriod(int incap_num, int period);
+
+// Sets how a module counts frequency: which rising edges it captures (0, 1, 2
+// for every 1st, 4th, 16th) and the gate time in ms. Applies from the next
+// InCapConfig() on. The default is every 16th edge and 100ms.
+void InCapSetGate(int incap_num, int prescale, int gate);
+
+void InCapTasks();
+
 
 #endif  // __INCAP_H__
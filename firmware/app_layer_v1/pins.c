@@ -69,7 +69,10 @@ typedef struct {
 } PORT_INFO;
 
 #if defined(__PIC24FJ256GB206__) ||  defined(__PIC24FJ256DA206__) || defined(__PIC24FJ128DA106__) || defined(__PIC24FJ128DA206__)
-#define ANSE (*((SFR*) 0))  // hack: there is no ANSE register on 64-pin devices
+// hack: there is no ANSE register on 64-pin devices. writes go to a dummy
+// rather than to address 0, which is W0.
+static SFR ANSE_dummy;
+#define ANSE ANSE_dummy
 #endif
 
 #define MAKE_PORT_INFO(port, num) { &TRIS##port, &ANS##port, &PORT##port, &LAT##port, &ODC##port, &CNEN##port, &CNBACKUP##port, &CNFORCE##port, (1 << num), ~(1 << num) }
@@ -346,11 +349,52 @@ void PinSetLat(int pin, int val) {
   }
 }
 
+void PinSetLatMasked(int first_pin, int num_bytes, const BYTE* mask,
+                     const BYTE* value) {
+  // The ports written to, at most one per port.
+  struct {
+    SFR* lat;
+    unsigned int set;
+    unsigned int clear;
+  } ports[6];
+  int num_ports = 0;
+  int i, j;
+  for (i = 0; i < num_bytes * 8; ++i) {
+    const int pin = first_pin + i;
+    const PORT_INFO* info;
+    if (!(mask[i >> 3] & (1 << (i & 7)))) continue;
+    if (pin >= NUM_PINS) break;
+    info = &port_info[pin];
+    for (j = 0; j < num_ports && ports[j].lat != info->lat; ++j);
+    if (j == num_ports) {
+      assert(num_ports < ARRAY_SIZE(ports));
+      ports[j].lat = info->lat;
+      ports[j].set = 0;
+      ports[j].clear = 0;
+      ++num_ports;
+    }
+    if (value[i >> 3] & (1 << (i & 7))) {
+      ports[j].set |= info->pos_mask;
+    } else {
+      ports[j].clear |= info->pos_mask;
+    }
+  }
+  for (j = 0; j < num_ports; ++j) {
+    *ports[j].lat = (*ports[j].lat & ~ports[j].clear) | ports[j].set;
+  }
+}
+
 int PinGetPort(int pin) {
   const PORT_INFO* info = &port_info[pin];
   return (*info->port & info->pos_mask) != 0;
 }
 
+void PinGetPortReg(int pin, volatile unsigned int** port, unsigned int* mask) {
+  const PORT_INFO* info = &port_info[pin];
+  *port = info->port;
+  *mask = info->pos_mask;
+}
+
 void PinSetOdc(int pin, int val) {
   const PORT_INFO* info = &port_info[pin];
   if (val) {
@@ -360,21 +404,52 @@ void PinSetOdc(int pin, int val) {
   }
 }
 
+// Pins watched by modules through PinSetCnenQuiet(), a bit each. The CNEN bit
+// of a pin is on while either these or change reporting (fake_cnen) use it.
+static BYTE quiet_cnen[(NUM_PINS + 7) / 8];
+
+// Call with CN interrupts disabled.
+static void UpdateCnen(int pin) {
+  const CN_INFO* cinfo = &cn_info[pin];
+  const PORT_INFO* pinfo = &port_info[pin];
+  if ((*pinfo->fake_cnen & pinfo->pos_mask)
+      || (quiet_cnen[pin >> 3] & (1 << (pin & 7)))) {
+    *cinfo->cnen |= cinfo->pos_mask;
+  } else {
+    *cinfo->cnen &= cinfo->neg_mask;
+  }
+}
+
 void PinSetCnen(int pin, int cnen) {
   int cnie_backup = _CNIE;
-  const CN_INFO* cinfo = &cn_info[pin];
   const PORT_INFO* pinfo = &port_info[pin];
   _CNIE = 0;  // disable CN interrupts
   if (cnen) {
-    *cinfo->cnen |= cinfo->pos_mask;
     *pinfo->fake_cnen |= pinfo->pos_mask;
   } else {
-    *cinfo->cnen &= cinfo->neg_mask;
     *pinfo->fake_cnen &= pinfo->neg_mask;
   }
+  UpdateCnen(pin);
   _CNIE = cnie_backup;  // enable CN interrupts
 }
 
+void PinSetCnenQuiet(int pin, int cnen) {
+  int cnie_backup = _CNIE;
+  _CNIE = 0;  // disable CN interrupts
+  if (cnen) {
+    quiet_cnen[pin >> 3] |= 1 << (pin & 7);
+  } else {
+    quiet_cnen[pin >> 3] &= ~(1 << (pin & 7));
+  }
+  UpdateCnen(pin);
+  _CNIE = cnie_backup;  // enable CN interrupts
+}
+
+int PinGetCnen(int pin) {
+  const CN_INFO* cinfo = &cn_info[pin];
+  return (*cinfo->cnen & cinfo->pos_mask) != 0;
+}
+
 void PinSetCnforce(int pin) {
   int cnie_backup = _CNIE;
   const PORT_INFO* pinfo = &port_info[pin];
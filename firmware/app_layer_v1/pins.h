@@ -30,6 +30,7 @@
 #ifndef __PINS_H__
 #define __PINS_H__
 
+#include "GenericTypeDefs.h"
 #include "platform.h"
 
 extern unsigned int CNENB;
@@ -58,9 +59,22 @@ extern unsigned int CNFORCEG;
 void PinSetTris(int pin, int val);
 void PinSetAnsel(int pin, int val);
 void PinSetLat(int pin, int val);
+// Sets the latches of the pins whose bits are set in mask, where bit 0 of
+// mask[0] is first_pin, to the matching bits of value. Each port gets a
+// single write. Pins past the last one are ignored.
+void PinSetLatMasked(int first_pin, int num_bytes, const BYTE* mask,
+                     const BYTE* value);
 int PinGetPort(int pin);
+// The register the level of pin is read from, and its bit there, for reading
+// pins faster than PinGetPort() does.
+void PinGetPortReg(int pin, volatile unsigned int** port, unsigned int* mask);
 void PinSetOdc(int pin, int val);
 void PinSetCnen(int pin, int cnen);
+// Enables the change notification interrupt for pin without having its
+// changes reported, for modules that watch the pin themselves. The interrupt
+// stays on while either this or PinSetCnen() has it on.
+void PinSetCnenQuiet(int pin, int cnen);
+int PinGetCnen(int pin);
 void PinSetCnforce(int pin);
 void PinSetCnpu(int pin, int cnpu);
 void PinSetCnpd(int pin, int cnpd);
@@ -46,6 +46,12 @@
 #include "sync.h"
 #include "icsp.h"
 #include "incap.h"
+#include "encoder.h"
+#include "control.h"
+#include "pins.h"
+#include "reflex.h"
+#include "scheduler.h"
+#include "timebase.h"
 
 #define CHECK(cond) do { if (!(cond)) { log_printf("Check failed: %s", #cond); return FALSE; }} while(0)
 
@@ -81,7 +87,38 @@ const BYTE incoming_arg_size[MESSAGE_TYPE_LIMIT] = {
   sizeof(SET_PIN_INCAP_ARGS),
   sizeof(SOFT_CLOSE_ARGS),
   sizeof(SET_PIN_CAPSENSE_ARGS),
-  sizeof(SET_CAPSENSE_SAMPLING_ARGS)
+  sizeof(SET_CAPSENSE_SAMPLING_ARGS),
+  sizeof(SET_ANALOG_IN_PERIOD_ARGS),
+  sizeof(SET_ANALOG_IN_DECIMATION_ARGS),
+  sizeof(ADC_CAPTURE_ARM_ARGS),
+  sizeof(ADC_CAPTURE_TRIGGER_ARGS),
+  sizeof(ADC_CAPTURE_READ_ARGS),
+  sizeof(SET_ANALOG_TRIGGER_ARGS),
+  sizeof(RESERVED_ARGS),
+  sizeof(SET_ANALOG_IN_DEADBAND_ARGS),
+  sizeof(SET_ANALOG_IN_ENCODING_ARGS),
+  sizeof(SET_TIMESTAMPS_ARGS),
+  sizeof(SYNC_TIME_ARGS),
+  sizeof(BATCH_ARGS),
+  sizeof(SET_DIGITAL_OUT_LEVELS_ARGS),
+  sizeof(SET_DIGITAL_IN_BATCHING_ARGS),
+  sizeof(ENCODER_CONFIG_ARGS),
+  sizeof(ENCODER_READ_ARGS),
+  sizeof(SET_INCAP_REARM_PERIOD_ARGS),
+  sizeof(SET_INCAP_GATE_ARGS),
+  sizeof(PWM_SEQ_CONFIG_ARGS),
+  sizeof(PWM_SEQ_DATA_ARGS),
+  sizeof(SET_PWM_SYNC_ARGS),
+  sizeof(PWM_GROUP_UPDATE_ARGS),
+  sizeof(SCHEDULE_CONFIG_ARGS),
+  sizeof(SCHEDULE_DATA_ARGS),
+  sizeof(SET_REFLEX_ARGS),
+  sizeof(RESERVED_ARGS),
+  sizeof(CONTROL_CONFIG_ARGS),
+  sizeof(CONTROL_PARAMS_ARGS),
+  sizeof(SET_ANALOG_IN_FILTER_ARGS),
+  sizeof(SET_UART_RX_AGGREGATION_ARGS),
+  sizeof(GET_CAPABILITIES_ARGS)
   // BOOKMARK(add_feature): Add sizeof (argument for incoming message).
   // Array is indexed by message type enum.
 };
@@ -92,7 +129,7 @@ const BYTE outgoing_arg_size[MESSAGE_TYPE_LIMIT] = {
   sizeof(CHECK_INTERFACE_RESPONSE_ARGS),
   sizeof(RESERVED_ARGS),
   sizeof(REPORT_DIGITAL_IN_STATUS_ARGS),
-  sizeof(RESERVED_ARGS),
+  sizeof(REPORT_PERIODIC_DIGITAL_IN_STATUS_ARGS),
   sizeof(SET_CHANGE_NOTIFY_ARGS),
   sizeof(REGISTER_PERIODIC_DIGITAL_SAMPLING_ARGS),
   sizeof(RESERVED_ARGS),
@@ -118,7 +155,38 @@ const BYTE outgoing_arg_size[MESSAGE_TYPE_LIMIT] = {
   sizeof(INCAP_REPORT_ARGS),
   sizeof(SOFT_CLOSE_ARGS),
   sizeof(CAPSENSE_REPORT_ARGS),
-  sizeof(SET_CAPSENSE_SAMPLING_ARGS)
+  sizeof(SET_CAPSENSE_SAMPLING_ARGS),
+  sizeof(RESERVED_ARGS),
+  sizeof(RESERVED_ARGS),
+  sizeof(ADC_CAPTURE_STATUS_ARGS),
+  sizeof(ADC_CAPTURE_DATA_ARGS),
+  sizeof(RESERVED_ARGS),
+  sizeof(ANALOG_TRIGGER_STATUS_ARGS),
+  sizeof(ANALOG_TRIGGER_DATA_ARGS),
+  sizeof(RESERVED_ARGS),
+  sizeof(RESERVED_ARGS),
+  sizeof(TIMESTAMP_ARGS),
+  sizeof(SYNC_TIME_REPLY_ARGS),
+  sizeof(BATCH_DONE_ARGS),
+  sizeof(RESERVED_ARGS),
+  sizeof(REPORT_DIGITAL_IN_CHANGES_ARGS),
+  sizeof(ENCODER_STATUS_ARGS),
+  sizeof(ENCODER_REPORT_ARGS),
+  sizeof(INCAP_EDGES_ARGS),
+  sizeof(INCAP_COUNT_ARGS),
+  sizeof(PWM_SEQ_STATUS_ARGS),
+  sizeof(PWM_SEQ_REPORT_TX_STATUS_ARGS),
+  sizeof(RESERVED_ARGS),
+  sizeof(RESERVED_ARGS),
+  sizeof(SCHEDULE_STATUS_ARGS),
+  sizeof(RESERVED_ARGS),
+  sizeof(REFLEX_STATUS_ARGS),
+  sizeof(REFLEX_FIRED_ARGS),
+  sizeof(CONTROL_STATUS_ARGS),
+  sizeof(CONTROL_REPORT_ARGS),
+  sizeof(RESERVED_ARGS),
+  sizeof(UART_DATA_EXTENDED_ARGS),
+  sizeof(CAPABILITIES_ARGS)
 
   // BOOKMARK(add_feature): Add sizeof (argument for outgoing message).
   // Array is indexed by message type enum.
@@ -134,6 +202,12 @@ DEFINE_STATIC_BYTE_QUEUE(tx_queue, 8192);
 static int bytes_out;
 static int max_packet;
 static STATE state;
+// State of the message currently being constructed in place.
+static BYTE begin_prev_ipl;
+static int begin_header_size;
+// A TIMESTAMP to put in front of the next message.
+static BOOL stamp_pending;
+static OUTGOING_MESSAGE stamp_msg;
 
 typedef enum {
   WAIT_TYPE,
@@ -146,10 +220,22 @@ static int rx_buffer_cursor;
 static int rx_message_remaining;
 static RX_MESSAGE_STATE rx_message_state;
 
+// The BATCH currently being executed, if batch_active.
+static BOOL batch_active;
+static BYTE batch_seq;
+static BOOL batch_ack;
+static WORD batch_remaining;
+
 static inline BYTE OutgoingMessageLength(const OUTGOING_MESSAGE* msg) {
   return 1 + outgoing_arg_size[msg->type];
 }
 
+static inline BYTE BitCount(WORD w) {
+  BYTE count = 0;
+  for (; w; w &= w - 1) ++count;
+  return count;
+}
+
 static inline BYTE IncomingVarArgSize(const INCOMING_MESSAGE* msg) {
   switch (msg->type) {
     case UART_DATA:
@@ -167,6 +253,25 @@ static inline BYTE IncomingVarArgSize(const INCOMING_MESSAGE* msg) {
     case I2C_WRITE_READ:
       return msg->args.i2c_write_read.write_size;
 
+    case ADC_CAPTURE_ARM:
+      return msg->args.adc_capture_arm.num_pins;
+
+    case SET_DIGITAL_OUT_LEVELS:
+      return 2 * msg->args.set_digital_out_levels.num_bytes;
+
+    case PWM_SEQ_DATA:
+      return 3 * (msg->args.pwm_seq_data.size + 1);
+
+    case PWM_GROUP_UPDATE:
+      return 5 * BitCount(msg->args.pwm_group_update.mask);
+
+    case SCHEDULE_DATA:
+      return msg->args.schedule_data.size + 1;
+
+    case SET_ANALOG_IN_FILTER:
+      return msg->args.set_analog_in_filter.type == ADC_FILTER_FIR
+          ? 2 * (msg->args.set_analog_in_filter.param + 1) : 0;
+
     // BOOKMARK(add_feature): Add more cases here if incoming message has variable args.
     default:
       return 0;
@@ -180,6 +285,8 @@ void AppProtocolInit(CHANNEL_HANDLE h) {
   rx_message_remaining = 1;
   rx_message_state = WAIT_TYPE;
   ByteQueueClear(&tx_queue);
+  stamp_pending = FALSE;
+  batch_active = FALSE;
   max_packet = ConnectionGetMaxPacket(h);
   state = STATE_OPEN;
 
@@ -197,30 +304,84 @@ void AppProtocolInit(CHANNEL_HANDLE h) {
   AppProtocolSendMessage(&msg);
 }
 
+void AppProtocolMessageWrite(const OUTGOING_MESSAGE_BUFFER* buf, int offset,
+                             const void* data, int size) {
+  int size1;
+  if (!size) return;
+  if (offset >= buf->size1) {
+    memcpy(buf->data2 + (offset - buf->size1), data, size);
+    return;
+  }
+  size1 = buf->size1 - offset;
+  if (size1 > size) size1 = size;
+  memcpy(buf->data1 + offset, data, size1);
+  memcpy(buf->data2, ((const BYTE*) data) + size1, size - size1);
+}
+
+void AppProtocolTimestampNext(DWORD time) {
+  stamp_msg.type = TIMESTAMP;
+  stamp_msg.args.timestamp.time = time;
+  stamp_pending = TRUE;
+}
+
+BOOL AppProtocolBeginMessage(const OUTGOING_MESSAGE* msg, int var_size,
+                             OUTGOING_MESSAGE_BUFFER* buf) {
+  int header_size = OutgoingMessageLength(msg);
+  int stamp_size;
+  if (state != STATE_OPEN) return FALSE;
+  begin_prev_ipl = SyncInterruptLevel(1);
+  // The timestamp goes in with the message or not at all.
+  stamp_size = stamp_pending ? OutgoingMessageLength(&stamp_msg) : 0;
+  stamp_pending = FALSE;
+  if (!ByteQueueReserve(&tx_queue, stamp_size + header_size + var_size,
+                        &buf->data1, &buf->size1,
+                        &buf->data2, &buf->size2)) {
+    SyncInterruptLevel(begin_prev_ipl);
+    return FALSE;
+  }
+  AppProtocolMessageWrite(buf, 0, &stamp_msg, stamp_size);
+  AppProtocolMessageWrite(buf, stamp_size, msg, header_size);
+  header_size += stamp_size;
+  // Skip the header, leaving buf pointing to the var-arg.
+  if (header_size < buf->size1) {
+    buf->data1 += header_size;
+    buf->size1 -= header_size;
+  } else {
+    buf->data1 = buf->data2 + (header_size - buf->size1);
+    buf->size1 = buf->size2 - (header_size - buf->size1);
+    buf->size2 = 0;
+  }
+  begin_header_size = header_size;
+  return TRUE;
+}
+
+void AppProtocolEndMessage(int var_size) {
+  ByteQueueCommit(&tx_queue, begin_header_size + var_size);
+  SyncInterruptLevel(begin_prev_ipl);
+}
+
+int AppProtocolTxQueueSize() {
+  return ByteQueueSize(&tx_queue);
+}
+
 void AppProtocolSendMessage(const OUTGOING_MESSAGE* msg) {
-  if (state != STATE_OPEN) return;
-  BYTE prev = SyncInterruptLevel(1);
-  ByteQueuePushBuffer(&tx_queue, (const BYTE*) msg, OutgoingMessageLength(msg));
-  SyncInterruptLevel(prev);
+  AppProtocolSendMessageWithVarArgSplit(msg, NULL, 0, NULL, 0);
 }
 
 void AppProtocolSendMessageWithVarArg(const OUTGOING_MESSAGE* msg, const void* data, int size) {
-  if (state != STATE_OPEN) return;
-  BYTE prev = SyncInterruptLevel(1);
-  ByteQueuePushBuffer(&tx_queue, (const BYTE*) msg, OutgoingMessageLength(msg));
-  ByteQueuePushBuffer(&tx_queue, data, size);
-  SyncInterruptLevel(prev);
+  AppProtocolSendMessageWithVarArgSplit(msg, data, size, NULL, 0);
 }
 
 void AppProtocolSendMessageWithVarArgSplit(const OUTGOING_MESSAGE* msg,
                                            const void* data1, int size1,
                                            const void* data2, int size2) {
-  if (state != STATE_OPEN) return;
-  BYTE prev = SyncInterruptLevel(1);
-  ByteQueuePushBuffer(&tx_queue, (const BYTE*) msg, OutgoingMessageLength(msg));
-  ByteQueuePushBuffer(&tx_queue, data1, size1);
-  ByteQueuePushBuffer(&tx_queue, data2, size2);
-  SyncInterruptLevel(prev);
+  // Either the entire message goes in or nothing does, so that an overflow
+  // never leaves a partial message in the stream.
+  OUTGOING_MESSAGE_BUFFER buf;
+  if (!AppProtocolBeginMessage(msg, size1 + size2, &buf)) return;
+  AppProtocolMessageWrite(&buf, 0, data1, size1);
+  AppProtocolMessageWrite(&buf, size1, data2, size2);
+  AppProtocolEndMessage(size1 + size2);
 }
 
 void AppProtocolTasks(CHANNEL_HANDLE h) {
@@ -231,144 +392,160 @@ void AppProtocolTasks(CHANNEL_HANDLE h) {
     state = STATE_CLOSED;
     return;
   }
+  ADCTasks();
+  DigitalTasks();
+  EncoderTasks();
+  InCapTasks();
+  PWMTasks();
+  SchedulerTasks();
   UARTTasks();
   SPITasks();
   I2CTasks();
   ICSPTasks();
   if (ConnectionCanSend(h)) {
     BYTE prev = SyncInterruptLevel(1);
-    const BYTE* data;
+    const BYTE *data1, *data2;
+    int size1, size2;
     if (bytes_out) {
       ByteQueuePull(&tx_queue, bytes_out);
       bytes_out = 0;
     }
-    ByteQueuePeek(&tx_queue, &data, &bytes_out);
-    if (bytes_out > 0) {
-      if (bytes_out > max_packet) bytes_out = max_packet;
-      ConnectionSend(h, data, bytes_out);
+    // Peek across the wrap point, so that we always send a full packet when
+    // enough data is queued.
+    ByteQueuePeekMax(&tx_queue, max_packet, &data1, &size1, &data2, &size2);
+    if (size1 > 0) {
+      bytes_out = ConnectionSendSplit(h, data1, size1, data2, size2);
     }
     SyncInterruptLevel(prev);
   }
 }
 
-static void Echo() {
-  AppProtocolSendMessage((const OUTGOING_MESSAGE*) &rx_msg);
+static void Echo(const INCOMING_MESSAGE* msg) {
+  AppProtocolSendMessage((const OUTGOING_MESSAGE*) msg);
 }
 
-static BOOL MessageDone() {
+static BOOL MessageDone(const INCOMING_MESSAGE* msg) {
   // TODO: check pin capabilities
-  switch (rx_msg.type) {
+  switch (msg->type) {
     case HARD_RESET:
-      CHECK(rx_msg.args.hard_reset.magic == IOIO_MAGIC);
+      CHECK(msg->args.hard_reset.magic == IOIO_MAGIC);
       HardReset();
       break;
 
     case SOFT_RESET:
       SoftReset();
-      Echo();
+      Echo(msg);
       break;
 
     case SET_PIN_DIGITAL_OUT:
-      CHECK(rx_msg.args.set_pin_digital_out.pin < NUM_PINS);
-      SetPinDigitalOut(rx_msg.args.set_pin_digital_out.pin,
-                       rx_msg.args.set_pin_digital_out.value,
-                       rx_msg.args.set_pin_digital_out.open_drain);
+      CHECK(msg->args.set_pin_digital_out.pin < NUM_PINS);
+      SetPinDigitalOut(msg->args.set_pin_digital_out.pin,
+                       msg->args.set_pin_digital_out.value,
+                       msg->args.set_pin_digital_out.open_drain);
       break;
 
     case SET_DIGITAL_OUT_LEVEL:
-      CHECK(rx_msg.args.set_digital_out_level.pin < NUM_PINS);
-      SetDigitalOutLevel(rx_msg.args.set_digital_out_level.pin,
-                         rx_msg.args.set_digital_out_level.value);
+      CHECK(msg->args.set_digital_out_level.pin < NUM_PINS);
+      SetDigitalOutLevel(msg->args.set_digital_out_level.pin,
+                         msg->args.set_digital_out_level.value);
       break;
 
     case SET_PIN_DIGITAL_IN:
-      CHECK(rx_msg.args.set_pin_digital_in.pin < NUM_PINS);
-      CHECK(rx_msg.args.set_pin_digital_in.pull < 3);
-      SetPinDigitalIn(rx_msg.args.set_pin_digital_in.pin, rx_msg.args.set_pin_digital_in.pull);
+      CHECK(msg->args.set_pin_digital_in.pin < NUM_PINS);
+      CHECK(msg->args.set_pin_digital_in.pull < 3);
+      SetPinDigitalIn(msg->args.set_pin_digital_in.pin, msg->args.set_pin_digital_in.pull);
       break;
 
     case SET_CHANGE_NOTIFY:
-      CHECK(rx_msg.args.set_change_notify.pin < NUM_PINS);
-      if (rx_msg.args.set_change_notify.cn) {
-        Echo();
+      CHECK(msg->args.set_change_notify.pin < NUM_PINS);
+      if (msg->args.set_change_notify.cn) {
+        Echo(msg);
       }
-      SetChangeNotify(rx_msg.args.set_change_notify.pin, rx_msg.args.set_change_notify.cn);
-      if (!rx_msg.args.set_change_notify.cn) {
-        Echo();
+      SetChangeNotify(msg->args.set_change_notify.pin, msg->args.set_change_notify.cn);
+      if (!msg->args.set_change_notify.cn) {
+        Echo(msg);
       }
       break;
 
+    case REGISTER_PERIODIC_DIGITAL_SAMPLING:
+      CHECK(msg->args.register_periodic_digital_sampling.pin < NUM_PINS);
+      RegisterPeriodicDigitalSampling(
+          msg->args.register_periodic_digital_sampling.pin,
+          msg->args.register_periodic_digital_sampling.freq_scale);
+      Echo(msg);
+      break;
+
     case SET_PIN_PWM:
-      CHECK(rx_msg.args.set_pin_pwm.pin < NUM_PINS);
-      CHECK(rx_msg.args.set_pin_pwm.pwm_num < NUM_PWM_MODULES);
-      SetPinPwm(rx_msg.args.set_pin_pwm.pin, rx_msg.args.set_pin_pwm.pwm_num,
-                rx_msg.args.set_pin_pwm.enable);
+      CHECK(msg->args.set_pin_pwm.pin < NUM_PINS);
+      CHECK(msg->args.set_pin_pwm.pwm_num < NUM_PWM_MODULES);
+      SetPinPwm(msg->args.set_pin_pwm.pin, msg->args.set_pin_pwm.pwm_num,
+                msg->args.set_pin_pwm.enable);
       break;
 
     case SET_PWM_DUTY_CYCLE:
-      CHECK(rx_msg.args.set_pwm_duty_cycle.pwm_num < NUM_PWM_MODULES);
-      SetPwmDutyCycle(rx_msg.args.set_pwm_duty_cycle.pwm_num,
-                      rx_msg.args.set_pwm_duty_cycle.dc,
-                      rx_msg.args.set_pwm_duty_cycle.fraction);
+      CHECK(msg->args.set_pwm_duty_cycle.pwm_num < NUM_PWM_MODULES);
+      SetPwmDutyCycle(msg->args.set_pwm_duty_cycle.pwm_num,
+                      msg->args.set_pwm_duty_cycle.dc,
+                      msg->args.set_pwm_duty_cycle.fraction);
       break;
 
     case SET_PWM_PERIOD:
-      CHECK(rx_msg.args.set_pwm_period.pwm_num < NUM_PWM_MODULES);
-      SetPwmPeriod(rx_msg.args.set_pwm_period.pwm_num,
-                   rx_msg.args.set_pwm_period.period,
-                   rx_msg.args.set_pwm_period.scale_l
-                   | (rx_msg.args.set_pwm_period.scale_h) << 1);
+      CHECK(msg->args.set_pwm_period.pwm_num < NUM_PWM_MODULES);
+      SetPwmPeriod(msg->args.set_pwm_period.pwm_num,
+                   msg->args.set_pwm_period.period,
+                   msg->args.set_pwm_period.scale_l
+                   | (msg->args.set_pwm_period.scale_h) << 1);
       break;
 
     case SET_PIN_ANALOG_IN:
-      CHECK(rx_msg.args.set_pin_analog_in.pin < NUM_PINS);
-      SetPinAnalogIn(rx_msg.args.set_pin_analog_in.pin);
+      CHECK(msg->args.set_pin_analog_in.pin < NUM_PINS);
+      SetPinAnalogIn(msg->args.set_pin_analog_in.pin);
       break;
 
     case UART_DATA:
-      CHECK(rx_msg.args.uart_data.uart_num < NUM_UART_MODULES);
-      UARTTransmit(rx_msg.args.uart_data.uart_num,
-                   rx_msg.args.uart_data.data,
-                   rx_msg.args.uart_data.size + 1);
+      CHECK(msg->args.uart_data.uart_num < NUM_UART_MODULES);
+      UARTTransmit(msg->args.uart_data.uart_num,
+                   msg->args.uart_data.data,
+                   msg->args.uart_data.size + 1);
       break;
 
     case UART_CONFIG:
-      CHECK(rx_msg.args.uart_config.uart_num < NUM_UART_MODULES);
-      CHECK(rx_msg.args.uart_config.parity < 3);
-      UARTConfig(rx_msg.args.uart_config.uart_num,
-                 rx_msg.args.uart_config.rate,
-                 rx_msg.args.uart_config.speed4x,
-                 rx_msg.args.uart_config.two_stop_bits,
-                 rx_msg.args.uart_config.parity);
+      CHECK(msg->args.uart_config.uart_num < NUM_UART_MODULES);
+      CHECK(msg->args.uart_config.parity < 3);
+      UARTConfig(msg->args.uart_config.uart_num,
+                 msg->args.uart_config.rate,
+                 msg->args.uart_config.speed4x,
+                 msg->args.uart_config.two_stop_bits,
+                 msg->args.uart_config.parity);
       break;
 
     case SET_PIN_UART:
-      CHECK(rx_msg.args.set_pin_uart.pin < NUM_PINS);
-      CHECK(rx_msg.args.set_pin_uart.uart_num < NUM_UART_MODULES);
-      SetPinUart(rx_msg.args.set_pin_uart.pin,
-                 rx_msg.args.set_pin_uart.uart_num,
-                 rx_msg.args.set_pin_uart.dir,
-                 rx_msg.args.set_pin_uart.enable);
+      CHECK(msg->args.set_pin_uart.pin < NUM_PINS);
+      CHECK(msg->args.set_pin_uart.uart_num < NUM_UART_MODULES);
+      SetPinUart(msg->args.set_pin_uart.pin,
+                 msg->args.set_pin_uart.uart_num,
+                 msg->args.set_pin_uart.dir,
+                 msg->args.set_pin_uart.enable);
       break;
 
     case SPI_MASTER_REQUEST:
-      CHECK(rx_msg.args.spi_master_request.spi_num < NUM_SPI_MODULES);
-      CHECK(rx_msg.args.spi_master_request.ss_pin < NUM_PINS);
+      CHECK(msg->args.spi_master_request.spi_num < NUM_SPI_MODULES);
+      CHECK(msg->args.spi_master_request.ss_pin < NUM_PINS);
       {
-        const BYTE total_size = rx_msg.args.spi_master_request.total_size + 1;
-        const BYTE data_size = rx_msg.args.spi_master_request.data_size_neq_total
-            ? rx_msg.args.spi_master_request.data_size
+        const BYTE total_size = msg->args.spi_master_request.total_size + 1;
+        const BYTE data_size = msg->args.spi_master_request.data_size_neq_total
+            ? msg->args.spi_master_request.data_size
             : total_size;
-        const BYTE res_size = rx_msg.args.spi_master_request.res_size_neq_total
-            ? rx_msg.args.spi_master_request.vararg[
-                rx_msg.args.spi_master_request.data_size_neq_total]
+        const BYTE res_size = msg->args.spi_master_request.res_size_neq_total
+            ? msg->args.spi_master_request.vararg[
+                msg->args.spi_master_request.data_size_neq_total]
             : total_size;
-        const BYTE* const data = &rx_msg.args.spi_master_request.vararg[
-            rx_msg.args.spi_master_request.data_size_neq_total
-            + rx_msg.args.spi_master_request.res_size_neq_total];
+        const BYTE* const data = &msg->args.spi_master_request.vararg[
+            msg->args.spi_master_request.data_size_neq_total
+            + msg->args.spi_master_request.res_size_neq_total];
 
-        SPITransmit(rx_msg.args.spi_master_request.spi_num,
-                    rx_msg.args.spi_master_request.ss_pin,
+        SPITransmit(msg->args.spi_master_request.spi_num,
+                    msg->args.spi_master_request.ss_pin,
                     data,
                     data_size,
                     total_size,
@@ -377,71 +554,75 @@ static BOOL MessageDone() {
       break;
 
     case SPI_CONFIGURE_MASTER:
-      CHECK(rx_msg.args.spi_configure_master.spi_num < NUM_SPI_MODULES);
-      SPIConfigMaster(rx_msg.args.spi_configure_master.spi_num,
-                      rx_msg.args.spi_configure_master.scale,
-                      rx_msg.args.spi_configure_master.div,
-                      rx_msg.args.spi_configure_master.smp_end,
-                      rx_msg.args.spi_configure_master.clk_edge,
-                      rx_msg.args.spi_configure_master.clk_pol);
+      CHECK(msg->args.spi_configure_master.spi_num < NUM_SPI_MODULES);
+      SPIConfigMaster(msg->args.spi_configure_master.spi_num,
+                      msg->args.spi_configure_master.scale,
+                      msg->args.spi_configure_master.div,
+                      msg->args.spi_configure_master.smp_end,
+                      msg->args.spi_configure_master.clk_edge,
+                      msg->args.spi_configure_master.clk_pol);
       break;
 
     case SET_PIN_SPI:
-      CHECK(rx_msg.args.set_pin_spi.mode < 3);
-      CHECK((!rx_msg.args.set_pin_spi.enable
-            && rx_msg.args.set_pin_spi.mode == 1)
-            || rx_msg.args.set_pin_spi.pin < NUM_PINS);
-      CHECK((!rx_msg.args.set_pin_spi.enable
-            && rx_msg.args.set_pin_spi.mode != 1)
-            || rx_msg.args.set_pin_spi.spi_num < NUM_SPI_MODULES);
-      SetPinSpi(rx_msg.args.set_pin_spi.pin,
-                rx_msg.args.set_pin_spi.spi_num,
-                rx_msg.args.set_pin_spi.mode,
-                rx_msg.args.set_pin_spi.enable);
+      CHECK(msg->args.set_pin_spi.mode < 3);
+      CHECK((!msg->args.set_pin_spi.enable
+            && msg->args.set_pin_spi.mode == 1)
+            || msg->args.set_pin_spi.pin < NUM_PINS);
+      CHECK((!msg->args.set_pin_spi.enable
+            && msg->args.set_pin_spi.mode != 1)
+            || msg->args.set_pin_spi.spi_num < NUM_SPI_MODULES);
+      SetPinSpi(msg->args.set_pin_spi.pin,
+                msg->args.set_pin_spi.spi_num,
+                msg->args.set_pin_spi.mode,
+                msg->args.set_pin_spi.enable);
       break;
 
     case I2C_CONFIGURE_MASTER:
-      CHECK(rx_msg.args.i2c_configure_master.i2c_num < NUM_I2C_MODULES);
-      I2CConfigMaster(rx_msg.args.i2c_configure_master.i2c_num,
-                      rx_msg.args.i2c_configure_master.rate,
-                      rx_msg.args.i2c_configure_master.smbus_levels);
+      CHECK(msg->args.i2c_configure_master.i2c_num < NUM_I2C_MODULES);
+      I2CConfigMaster(msg->args.i2c_configure_master.i2c_num,
+                      msg->args.i2c_configure_master.rate,
+                      msg->args.i2c_configure_master.smbus_levels);
       break;
 
     case I2C_WRITE_READ:
-      CHECK(rx_msg.args.i2c_write_read.i2c_num < NUM_I2C_MODULES);
+      CHECK(msg->args.i2c_write_read.i2c_num < NUM_I2C_MODULES);
       {
         unsigned int addr;
-        if (rx_msg.args.i2c_write_read.ten_bit_addr) {
-          addr = rx_msg.args.i2c_write_read.addr_lsb;
+        if (msg->args.i2c_write_read.ten_bit_addr) {
+          addr = msg->args.i2c_write_read.addr_lsb;
           addr = addr << 8
-                  | ((rx_msg.args.i2c_write_read.addr_msb << 1)
+                  | ((msg->args.i2c_write_read.addr_msb << 1)
                     | 0b11110000);
         } else {
-          CHECK(rx_msg.args.i2c_write_read.addr_msb == 0
-                && rx_msg.args.i2c_write_read.addr_lsb >> 7 == 0
-                && rx_msg.args.i2c_write_read.addr_lsb >> 2 != 0b0011110);
-          addr = rx_msg.args.i2c_write_read.addr_lsb << 1;
+          CHECK(msg->args.i2c_write_read.addr_msb == 0
+                && msg->args.i2c_write_read.addr_lsb >> 7 == 0
+                && msg->args.i2c_write_read.addr_lsb >> 2 != 0b0011110);
+          addr = msg->args.i2c_write_read.addr_lsb << 1;
         }
-        I2CWriteRead(rx_msg.args.i2c_write_read.i2c_num,
+        I2CWriteRead(msg->args.i2c_write_read.i2c_num,
                      addr,
-                     rx_msg.args.i2c_write_read.data,
-                     rx_msg.args.i2c_write_read.write_size,
-                     rx_msg.args.i2c_write_read.read_size);
+                     msg->args.i2c_write_read.data,
+                     msg->args.i2c_write_read.write_size,
+                     msg->args.i2c_write_read.read_size);
       }
       break;
 
     case SET_ANALOG_IN_SAMPLING:
-      CHECK(rx_msg.args.set_analog_pin_sampling.pin < NUM_PINS);
-      ADCSetScan(rx_msg.args.set_analog_pin_sampling.pin,
-                 rx_msg.args.set_analog_pin_sampling.enable);
+      CHECK(msg->args.set_analog_pin_sampling.pin < NUM_PINS);
+      ADCSetScan(msg->args.set_analog_pin_sampling.pin,
+                 msg->args.set_analog_pin_sampling.enable);
       break;
 
     case CHECK_INTERFACE:
-      CheckInterface(rx_msg.args.check_interface.interface_id);
+      CheckInterface(msg->args.check_interface.interface_id);
+      break;
+
+    case GET_CAPABILITIES:
+      GetCapabilities();
       break;
 
     case ICSP_SIX:
-      ICSPSix(rx_msg.args.icsp_six.inst);
+      ICSPSix(msg->args.icsp_six.inst);
       break;
 
     case ICSP_REGOUT:
@@ -457,51 +638,345 @@ static BOOL MessageDone() {
       break;
 
     case ICSP_CONFIG:
-      if (rx_msg.args.icsp_config.enable) {
-        Echo();
+      if (msg->args.icsp_config.enable) {
+        Echo(msg);
       }
-      ICSPConfigure(rx_msg.args.icsp_config.enable);
-      if (!rx_msg.args.icsp_config.enable) {
-        Echo();
+      ICSPConfigure(msg->args.icsp_config.enable);
+      if (!msg->args.icsp_config.enable) {
+        Echo(msg);
       }
       break;
 
     case INCAP_CONFIG:
-      CHECK(rx_msg.args.incap_config.incap_num < NUM_INCAP_MODULES);
-      CHECK(!rx_msg.args.incap_config.double_prec
-            || 0 == (rx_msg.args.incap_config.incap_num & 0x01));
-      CHECK(rx_msg.args.incap_config.mode < 6);
-      CHECK(rx_msg.args.incap_config.clock < 4);
-      InCapConfig(rx_msg.args.incap_config.incap_num,
-                  rx_msg.args.incap_config.double_prec,
-                  rx_msg.args.incap_config.mode,
-                  rx_msg.args.incap_config.clock);
+      CHECK(msg->args.incap_config.incap_num < NUM_INCAP_MODULES);
+      CHECK(!msg->args.incap_config.double_prec
+            || 0 == (msg->args.incap_config.incap_num & 0x01));
+      CHECK(msg->args.incap_config.mode < 8);
+      CHECK(msg->args.incap_config.clock < 4);
+      InCapConfig(msg->args.incap_config.incap_num,
+                  msg->args.incap_config.double_prec,
+                  msg->args.incap_config.mode,
+                  msg->args.incap_config.clock);
       break;
 
     case SET_PIN_INCAP:
-      CHECK(rx_msg.args.set_pin_incap.incap_num < NUM_INCAP_MODULES);
-      CHECK(!rx_msg.args.set_pin_incap.enable
-            || rx_msg.args.set_pin_incap.pin < NUM_PINS);
-      SetPinInCap(rx_msg.args.set_pin_incap.pin,
-                  rx_msg.args.set_pin_incap.incap_num,
-                  rx_msg.args.set_pin_incap.enable);
+      CHECK(msg->args.set_pin_incap.incap_num < NUM_INCAP_MODULES);
+      CHECK(!msg->args.set_pin_incap.enable
+            || msg->args.set_pin_incap.pin < NUM_PINS);
+      SetPinInCap(msg->args.set_pin_incap.pin,
+                  msg->args.set_pin_incap.incap_num,
+                  msg->args.set_pin_incap.enable);
       break;
 
     case SOFT_CLOSE:
       log_printf("Soft close requested");
-      Echo();
+      Echo(msg);
       state = STATE_CLOSING;
       break;
 
     case SET_PIN_CAPSENSE:
-      CHECK(rx_msg.args.set_pin_capsense.pin < NUM_PINS);
-      SetPinCapSense(rx_msg.args.set_pin_capsense.pin);
+      CHECK(msg->args.set_pin_capsense.pin < NUM_PINS);
+      SetPinCapSense(msg->args.set_pin_capsense.pin);
       break;
 
     case SET_CAPSENSE_SAMPLING:
-      CHECK(rx_msg.args.set_capsense_sampling.pin < NUM_PINS);
-      ADCSetCapSense(rx_msg.args.set_capsense_sampling.pin,
-                     rx_msg.args.set_capsense_sampling.enable);
+      CHECK(msg->args.set_capsense_sampling.pin < NUM_PINS);
+      ADCSetCapSense(msg->args.set_capsense_sampling.pin,
+                     msg->args.set_capsense_sampling.enable);
+      break;
+
+    case SET_ANALOG_IN_PERIOD:
+      CHECK(msg->args.set_analog_in_period.period >= ADC_MIN_SCAN_PERIOD);
+      ADCSetScanPeriod(msg->args.set_analog_in_period.period);
+      break;
+
+    case SET_ANALOG_IN_DECIMATION:
+      CHECK(msg->args.set_analog_in_decimation.pin < NUM_PINS);
+      CHECK(!msg->args.set_analog_in_decimation.oversample
+            || msg->args.set_analog_in_decimation.decimation
+               < ADC_MAX_OVERSAMPLE);
+      ADCSetDecimation(msg->args.set_analog_in_decimation.pin,
+                       msg->args.set_analog_in_decimation.decimation,
+                       msg->args.set_analog_in_decimation.oversample);
+      break;
+
+    case ADC_CAPTURE_ARM:
+      CHECK(msg->args.adc_capture_arm.num_pins <= ADC_CAPTURE_MAX_PINS);
+      // Without a capture buffer, any request is taken as a disarm.
+      CHECK(msg->args.adc_capture_arm.num_pins == 0
+            || ADC_CAPTURE_BUF_SIZE == 0
+            || (msg->args.adc_capture_arm.num_scans > 0
+                && (DWORD) msg->args.adc_capture_arm.num_scans
+                   * msg->args.adc_capture_arm.num_pins
+                   <= ADC_CAPTURE_BUF_SIZE
+                && msg->args.adc_capture_arm.clock_div > 0
+                && msg->args.adc_capture_arm.sample_time > 0));
+      ADCCaptureArm(msg->args.adc_capture_arm.pins,
+                    msg->args.adc_capture_arm.num_pins,
+                    msg->args.adc_capture_arm.num_scans,
+                    msg->args.adc_capture_arm.clock_div,
+                    msg->args.adc_capture_arm.sample_time);
+      break;
+
+    case ADC_CAPTURE_TRIGGER:
+      ADCCaptureTrigger();
+      break;
+
+    case ADC_CAPTURE_READ:
+      ADCCaptureRead();
+      break;
+
+    case SET_ANALOG_TRIGGER:
+      CHECK(msg->args.set_analog_trigger.pin < NUM_PINS);
+      CHECK(msg->args.set_analog_trigger.mode == ADC_TRIGGER_OFF
+            || (msg->args.set_analog_trigger.low
+                <= msg->args.set_analog_trigger.high
+                && msg->args.set_analog_trigger.high < 1024
+                && msg->args.set_analog_trigger.post > 0
+                && (DWORD) msg->args.set_analog_trigger.pre
+                   + msg->args.set_analog_trigger.post
+                   <= ADC_TRIGGER_BUF_SIZE));
+      ADCSetTrigger(msg->args.set_analog_trigger.pin,
+                    msg->args.set_analog_trigger.mode,
+                    msg->args.set_analog_trigger.invert,
+                    msg->args.set_analog_trigger.repeat,
+                    msg->args.set_analog_trigger.low,
+                    msg->args.set_analog_trigger.high,
+                    msg->args.set_analog_trigger.pre,
+                    msg->args.set_analog_trigger.post);
+      break;
+
+    case SET_ANALOG_IN_DEADBAND:
+      CHECK(msg->args.set_analog_in_deadband.pin < NUM_PINS);
+      CHECK(msg->args.set_analog_in_deadband.deadband < 1024);
+      ADCSetDeadband(msg->args.set_analog_in_deadband.pin,
+                     msg->args.set_analog_in_deadband.deadband);
+      break;
+
+    case SET_ANALOG_IN_ENCODING:
+      ADCSetEncoding(msg->args.set_analog_in_encoding.delta,
+                     msg->args.set_analog_in_encoding.keyframe_interval);
+      break;
+
+    case SET_TIMESTAMPS:
+      TimebaseSetTimestamps(msg->args.set_timestamps.sources);
+      break;
+
+    case SYNC_TIME:
+      TimebaseSync(msg->args.sync_time.seq);
+      break;
+
+    case SET_DIGITAL_OUT_LEVELS:
+      CHECK(msg->args.set_digital_out_levels.first_pin
+            + 8 * msg->args.set_digital_out_levels.num_bytes <= NUM_PINS + 7);
+      SetDigitalOutLevels(msg->args.set_digital_out_levels.first_pin,
+                          msg->args.set_digital_out_levels.num_bytes,
+                          msg->args.set_digital_out_levels.mask_and_value);
+      break;
+
+    case SET_DIGITAL_IN_BATCHING:
+      SetDigitalInBatching(msg->args.set_digital_in_batching.enable);
+      break;
+
+    case ENCODER_CONFIG:
+      CHECK(msg->args.encoder_config.encoder_num < NUM_ENCODERS);
+      CHECK(msg->args.encoder_config.pin_a < NUM_PINS);
+      CHECK(msg->args.encoder_config.pin_b < NUM_PINS);
+      CHECK(msg->args.encoder_config.pin_a != msg->args.encoder_config.pin_b);
+      EncoderConfig(msg->args.encoder_config.encoder_num,
+                    msg->args.encoder_config.enable,
+                    msg->args.encoder_config.pin_a,
+                    msg->args.encoder_config.pin_b,
+                    msg->args.encoder_config.period);
+      break;
+
+    case ENCODER_READ:
+      CHECK(msg->args.encoder_read.encoder_num < NUM_ENCODERS);
+      EncoderRead(msg->args.encoder_read.encoder_num);
+      break;
+
+    case SET_INCAP_REARM_PERIOD:
+      CHECK(msg->args.set_incap_rearm_period.incap_num < NUM_INCAP_MODULES);
+      InCapSetRearmPeriod(msg->args.set_incap_rearm_period.incap_num,
+                          msg->args.set_incap_rearm_period.period);
+      break;
+
+    case SET_INCAP_GATE:
+      CHECK(msg->args.set_incap_gate.incap_num < NUM_INCAP_MODULES);
+      CHECK(msg->args.set_incap_gate.prescale < 3);
+      CHECK(msg->args.set_incap_gate.gate > 0);
+      InCapSetGate(msg->args.set_incap_gate.incap_num,
+                   msg->args.set_incap_gate.prescale,
+                   msg->args.set_incap_gate.gate);
+      break;
+
+    case PWM_SEQ_CONFIG:
+      CHECK(msg->args.pwm_seq_config.pwm_num < NUM_PWM_MODULES);
+      CHECK(!msg->args.pwm_seq_config.enable
+            || msg->args.pwm_seq_config.periods > 0);
+      PWMSequencerConfig(msg->args.pwm_seq_config.pwm_num,
+                         msg->args.pwm_seq_config.enable,
+                         msg->args.pwm_seq_config.loop,
+                         msg->args.pwm_seq_config.periods);
+      break;
+
+    case PWM_SEQ_DATA:
+      CHECK(msg->args.pwm_seq_data.pwm_num < NUM_PWM_MODULES);
+      PWMSequencerData(msg->args.pwm_seq_data.pwm_num,
+                       msg->args.pwm_seq_data.steps,
+                       msg->args.pwm_seq_data.size + 1);
+      break;
+
+    case SET_PWM_SYNC:
+      CHECK(msg->args.set_pwm_sync.pwm_num < NUM_PWM_MODULES);
+      CHECK(msg->args.set_pwm_sync.sync_num < NUM_PWM_MODULES);
+      SetPwmSync(msg->args.set_pwm_sync.pwm_num,
+                 msg->args.set_pwm_sync.sync_num);
+      break;
+
+    case PWM_GROUP_UPDATE:
+      CHECK(msg->args.pwm_group_update.mask != 0);
+      CHECK(msg->args.pwm_group_update.mask < (1 << NUM_PWM_MODULES));
+      PWMGroupUpdate(msg->args.pwm_group_update.mask,
+                     msg->args.pwm_group_update.entries);
+      break;
+
+    case SCHEDULE_CONFIG:
+      CHECK(msg->args.schedule_config.schedule_num < NUM_SCHEDULES);
+      CHECK(!msg->args.schedule_config.enable
+            || msg->args.schedule_config.period > 0);
+      SchedulerConfig(msg->args.schedule_config.schedule_num,
+                      msg->args.schedule_config.enable,
+                      msg->args.schedule_config.period);
+      break;
+
+    case SCHEDULE_DATA:
+      CHECK(msg->args.schedule_data.schedule_num < NUM_SCHEDULES);
+      SchedulerAppend(msg->args.schedule_data.schedule_num,
+                      msg->args.schedule_data.data,
+                      msg->args.schedule_data.size + 1);
+      break;
+
+    case SET_REFLEX:
+      CHECK(msg->args.set_reflex.reflex_num < NUM_REFLEXES);
+      if (msg->args.set_reflex.condition != REFLEX_OFF) {
+        CHECK(msg->args.set_reflex.pin < NUM_PINS);
+        switch (msg->args.set_reflex.condition) {
+          case REFLEX_DIGITAL:
+            break;
+
+          case REFLEX_ANALOG:
+            CHECK(PinToAnalogChannel(msg->args.set_reflex.pin) != -1);
+            CHECK(msg->args.set_reflex.low <= msg->args.set_reflex.high);
+            break;
+
+          default:
+            return FALSE;
+        }
+        switch (msg->args.set_reflex.action) {
+          case REFLEX_ACTION_DIGITAL_OUT:
+            CHECK(msg->args.set_reflex.target < NUM_PINS);
+            CHECK(msg->args.set_reflex.value <= 1);
+            break;
+
+          case REFLEX_ACTION_PWM:
+            CHECK(msg->args.set_reflex.target < NUM_PWM_MODULES);
+            break;
+
+          case REFLEX_ACTION_UART_HALT:
+            CHECK(msg->args.set_reflex.target < NUM_UART_MODULES);
+            break;
+
+          default:
+            return FALSE;
+        }
+      }
+      ReflexSet(msg->args.set_reflex.reflex_num,
+                msg->args.set_reflex.condition,
+                msg->args.set_reflex.pin,
+                msg->args.set_reflex.level,
+                msg->args.set_reflex.low,
+                msg->args.set_reflex.high,
+                msg->args.set_reflex.action,
+                msg->args.set_reflex.target,
+                msg->args.set_reflex.value,
+                msg->args.set_reflex.fraction);
+      break;
+
+    case CONTROL_CONFIG:
+      CHECK(msg->args.control_config.loop_num < NUM_CONTROL_LOOPS);
+      switch (msg->args.control_config.source) {
+        case CONTROL_OFF:
+          break;
+
+        case CONTROL_ANALOG:
+          CHECK(msg->args.control_config.input < NUM_PINS);
+          CHECK(PinToAnalogChannel(msg->args.control_config.input) != -1);
+          break;
+
+        case CONTROL_INCAP:
+          CHECK(msg->args.control_config.input < NUM_INCAP_MODULES);
+          break;
+
+        default:
+          return FALSE;
+      }
+      if (msg->args.control_config.source != CONTROL_OFF) {
+        CHECK(msg->args.control_config.pwm_num < NUM_PWM_MODULES);
+        CHECK(msg->args.control_config.out_min
+              <= msg->args.control_config.out_max);
+      }
+      ControlConfig(msg->args.control_config.loop_num,
+                    msg->args.control_config.source,
+                    msg->args.control_config.input,
+                    msg->args.control_config.pwm_num,
+                    msg->args.control_config.out_min,
+                    msg->args.control_config.out_max,
+                    msg->args.control_config.report_interval);
+      break;
+
+    case CONTROL_PARAMS:
+      CHECK(msg->args.control_params.loop_num < NUM_CONTROL_LOOPS);
+      CHECK(msg->args.control_params.shift <= CONTROL_MAX_SHIFT);
+      CHECK(msg->args.control_params.setpoint >= 0);
+      ControlSetParams(msg->args.control_params.loop_num,
+                       msg->args.control_params.setpoint,
+                       msg->args.control_params.kp,
+                       msg->args.control_params.ki,
+                       msg->args.control_params.kd,
+                       msg->args.control_params.shift);
+      break;
+
+    case SET_ANALOG_IN_FILTER:
+      CHECK(msg->args.set_analog_in_filter.pin < NUM_PINS);
+      // param is the shift of an IIR, and one less than the length of the
+      // others.
+      ADCSetFilter(msg->args.set_analog_in_filter.pin,
+                   msg->args.set_analog_in_filter.type,
+                   msg->args.set_analog_in_filter.type == ADC_FILTER_IIR
+                   ? msg->args.set_analog_in_filter.param
+                   : msg->args.set_analog_in_filter.param + 1,
+                   msg->args.set_analog_in_filter.taps);
+      break;
+
+    case SET_UART_RX_AGGREGATION:
+      CHECK(msg->args.set_uart_rx_aggregation.uart_num < NUM_UART_MODULES);
+      // Sizes are sent minus 1.
+      CHECK(msg->args.set_uart_rx_aggregation.min_batch
+            <= msg->args.set_uart_rx_aggregation.max_frame);
+      UARTSetRxAggregation(msg->args.set_uart_rx_aggregation.uart_num,
+                           msg->args.set_uart_rx_aggregation.min_batch + 1,
+                           msg->args.set_uart_rx_aggregation.max_frame + 1,
+                           msg->args.set_uart_rx_aggregation.idle_timeout,
+                           msg->args.set_uart_rx_aggregation.max_latency);
+      break;
+
+    case BATCH:
+      CHECK(!batch_active);
+      batch_active = TRUE;
+      batch_seq = msg->args.batch.seq;
+      batch_ack = msg->args.batch.ack;
+      batch_remaining = msg->args.batch.size;
       break;
 
     // BOOKMARK(add_feature): Add incoming message handling to switch clause.
@@ -513,6 +988,90 @@ static BOOL MessageDone() {
   return TRUE;
 }
 
+static void BatchDone() {
+  OUTGOING_MESSAGE msg;
+  batch_active = FALSE;
+  if (!batch_ack) return;
+  msg.type = BATCH_DONE;
+  msg.args.batch_done.seq = batch_seq;
+  AppProtocolSendMessage(&msg);
+}
+
+// Handles a complete incoming message, size bytes long, keeping track of the
+// enclosing BATCH, if any.
+static BOOL HandleMessage(const INCOMING_MESSAGE* msg, int size) {
+  if (batch_active) {
+    // A message may not straddle the end of the batch it is in.
+    CHECK(size <= batch_remaining);
+    batch_remaining -= size;
+  }
+  if (!MessageDone(msg)) return FALSE;
+  // This also completes a batch that has just started empty.
+  if (batch_active && batch_remaining == 0) BatchDone();
+  return TRUE;
+}
+
+// Returns the size of the message at data if all of it is within the first
+// len bytes, 0 otherwise.
+static int CompleteMessageSize(const BYTE* data, UINT32 len) {
+  const INCOMING_MESSAGE* msg = (const INCOMING_MESSAGE*) data;
+  int size;
+  if (msg->type >= MESSAGE_TYPE_LIMIT) return 1;  // MessageDone() rejects it
+  size = 1 + incoming_arg_size[msg->type];
+  if (len < size) return 0;
+  size += IncomingVarArgSize(msg);
+  return len < size ? 0 : size;
+}
+
+// Whether a message may be replayed by a schedule. Those affecting the
+// connection or the schedules may not, nor those which are flow controlled or
+// answered: the client would account for their TX credits and replies as if
+// it had sent them itself.
+static BOOL Schedulable(BYTE type) {
+  switch (type) {
+    case HARD_RESET:
+    case SOFT_RESET:
+    case SOFT_CLOSE:
+    case BATCH:
+    case SCHEDULE_CONFIG:
+    case SCHEDULE_DATA:
+    case UART_DATA:
+    case SPI_MASTER_REQUEST:
+    case I2C_WRITE_READ:
+    case ICSP_SIX:
+    case ICSP_REGOUT:
+    case CHECK_INTERFACE:
+    case GET_CAPABILITIES:
+    case SYNC_TIME:
+    case ENCODER_READ:
+    case ADC_CAPTURE_READ:
+      return FALSE;
+
+    default:
+      return type < MESSAGE_TYPE_LIMIT;
+  }
+}
+
+BOOL AppProtocolCheckCommands(const BYTE* data, int size) {
+  while (size > 0) {
+    const int msg_size = CompleteMessageSize(data, size);
+    if (!msg_size || !Schedulable(data[0])) return FALSE;
+    data += msg_size;
+    size -= msg_size;
+  }
+  return TRUE;
+}
+
+BOOL AppProtocolReplayCommands(const BYTE* data, int size) {
+  while (size > 0) {
+    const int msg_size = CompleteMessageSize(data, size);
+    if (!MessageDone((const INCOMING_MESSAGE*) data)) return FALSE;
+    data += msg_size;
+    size -= msg_size;
+  }
+  return TRUE;
+}
+
 BOOL AppProtocolHandleIncoming(const BYTE* data, UINT32 data_len) {
   assert(data);
   if (state != STATE_OPEN) {
@@ -521,6 +1080,18 @@ BOOL AppProtocolHandleIncoming(const BYTE* data, UINT32 data_len) {
   }
 
   while (data_len > 0) {
+    if (rx_message_state == WAIT_TYPE) {
+      // Messages that are entirely in the buffer are handled right from it,
+      // which is the common case, especially in batches.
+      const int size = CompleteMessageSize(data, data_len);
+      if (size) {
+        if (!HandleMessage((const INCOMING_MESSAGE*) data, size)) return FALSE;
+        data += size;
+        data_len -= size;
+        continue;
+      }
+    }
+
     // copy a chunk of data to rx_msg
     if (data_len >= rx_message_remaining) {
       memcpy(((BYTE *) &rx_msg) + rx_buffer_cursor, data, rx_message_remaining);
@@ -551,10 +1122,13 @@ BOOL AppProtocolHandleIncoming(const BYTE* data, UINT32 data_len) {
           // fall-through on purpose
 
         case WAIT_VAR_ARGS:
-          rx_message_state = WAIT_TYPE;
-          rx_message_remaining = 1;
-          rx_buffer_cursor = 0;
-          if (!MessageDone()) return FALSE;
+          {
+            const int size = rx_buffer_cursor;
+            rx_message_state = WAIT_TYPE;
+            rx_message_remaining = 1;
+            rx_buffer_cursor = 0;
+            if (!HandleMessage(&rx_msg, size)) return FALSE;
+          }
           break;
       }
     }
@@ -66,6 +66,14 @@ void AppProtocolTasks(CHANNEL_HANDLE h);
 // data may not be NULL.
 BOOL AppProtocolHandleIncoming(const BYTE* data, UINT32 data_len);
 
+// Check that size bytes at data are whole incoming messages, which are fit
+// for AppProtocolReplayCommands().
+BOOL AppProtocolCheckCommands(const BYTE* data, int size);
+
+// Handle the incoming messages at data, checked by AppProtocolCheckCommands(),
+// as if they came from the client. Returns FALSE if one of them is rejected.
+BOOL AppProtocolReplayCommands(const BYTE* data, int size);
+
 // Send a protocol message.
 // This is not intended for usage of the bootstrap code that glues the protocol
 // to the underlying serial connection layer, but rather for use of modules
@@ -86,4 +94,48 @@ void AppProtocolSendMessageWithVarArgSplit(const OUTGOING_MESSAGE* msg,
                                           const void* data1, int size1,
                                           const void* data2, int size2);
 
+// The location of the variable-size argument of a message being constructed in
+// place, which may wrap around the end of the outgoing buffer.
+typedef struct {
+  BYTE* data1;
+  int size1;
+  BYTE* data2;
+  int size2;
+} OUTGOING_MESSAGE_BUFFER;
+
+// Start constructing a message directly in the outgoing buffer, avoiding an
+// intermediate copy of its variable-size argument.
+// Room is reserved for the message with up to var_size bytes of variable-size
+// argument, whose location is written to buf. The producer then fills it in,
+// e.g. using AppProtocolMessageByte(), and calls AppProtocolEndMessage().
+// Returns FALSE if the message cannot be sent (e.g. no room), in which case
+// nothing is reserved and AppProtocolEndMessage() must not be called.
+// Interrupts at or below priority 1 are blocked until the message is ended.
+BOOL AppProtocolBeginMessage(const OUTGOING_MESSAGE* msg, int var_size,
+                             OUTGOING_MESSAGE_BUFFER* buf);
+
+// Have the next message sent preceded by a TIMESTAMP message of time, both
+// going into the outgoing buffer together. Interrupts at or below priority 1
+// must be blocked from this call until the message is sent.
+void AppProtocolTimestampNext(DWORD time);
+
+// Finish constructing a message started with AppProtocolBeginMessage(), with
+// var_size bytes of variable-size argument, which may be less than reserved.
+// The message becomes visible to the consumer all at once.
+void AppProtocolEndMessage(int var_size);
+
+// Get a pointer to the i'th byte of the variable-size argument.
+static inline BYTE* AppProtocolMessageByte(const OUTGOING_MESSAGE_BUFFER* buf,
+                                           int i) {
+  return i < buf->size1 ? buf->data1 + i : buf->data2 + (i - buf->size1);
+}
+
+// Copy data into the variable-size argument, starting at offset.
+void AppProtocolMessageWrite(const OUTGOING_MESSAGE_BUFFER* buf, int offset,
+                             const void* data, int size);
+
+// The number of bytes waiting in the outgoing buffer. Producers of bulk data
+// can use it to leave room for other messages.
+int AppProtocolTxQueueSize();
+
 #endif  // __PROTOCOL_H__
@@ -39,6 +39,31 @@
 #define PROTOCOL_IID_IOIO0002 "IOIO0002"
 #define PROTOCOL_IID_IOIO0003 "IOIO0003"
 #define PROTOCOL_IID_IOIO0004 "IOIO0004"
+#define PROTOCOL_IID_IOIO0005 "IOIO0005"
+
+// Capabilities reported in reply to GET_CAPABILITIES, one bit per group of
+// messages added on top of IOIO0004. Firmware supporting IOIO0005 answers
+// GET_CAPABILITIES, so clients should check that interface ID first.
+#define CAPABILITY_ANALOG_SCAN           0x00000001UL
+#define CAPABILITY_ADC_CAPTURE           0x00000002UL
+#define CAPABILITY_ANALOG_TRIGGER        0x00000004UL
+#define CAPABILITY_ANALOG_DEADBAND       0x00000008UL
+#define CAPABILITY_ANALOG_DELTA          0x00000010UL
+#define CAPABILITY_TIMESTAMPS            0x00000020UL
+#define CAPABILITY_BATCH                 0x00000040UL
+#define CAPABILITY_DIGITAL_OUT_LEVELS    0x00000080UL
+#define CAPABILITY_DIGITAL_IN_CHANGES    0x00000100UL
+#define CAPABILITY_PERIODIC_DIGITAL_IN   0x00000200UL
+#define CAPABILITY_ENCODER               0x00000400UL
+#define CAPABILITY_INCAP_EXTENDED        0x00000800UL
+#define CAPABILITY_FREQUENCY_COUNTER     0x00001000UL
+#define CAPABILITY_PWM_SEQUENCER         0x00002000UL
+#define CAPABILITY_PWM_GROUP             0x00004000UL
+#define CAPABILITY_SCHEDULER             0x00008000UL
+#define CAPABILITY_REFLEX                0x00010000UL
+#define CAPABILITY_CONTROL               0x00020000UL
+#define CAPABILITY_ANALOG_FILTER         0x00040000UL
+#define CAPABILITY_UART_RX_AGGREGATION   0x00080000UL
 
 // hard reset
 typedef struct PACKED {
@@ -147,7 +172,9 @@ typedef struct PACKED {
 
 // report analog in format
 typedef struct PACKED {
-  BYTE num_pins;
+  BYTE num_pins : 6;
+  BYTE delta : 1;
+  BYTE extended : 1;
 } REPORT_ANALOG_IN_FORMAT_ARGS;
 
 // report analog in status
@@ -392,6 +419,391 @@ typedef struct PACKED {
   BYTE enable : 1;
 } SET_CAPSENSE_SAMPLING_ARGS;
 
+// set analog in period
+typedef struct PACKED {
+  WORD period;
+} SET_ANALOG_IN_PERIOD_ARGS;
+
+// set analog in decimation
+typedef struct PACKED {
+  BYTE pin : 6;
+  BYTE : 1;
+  BYTE oversample : 1;
+  BYTE decimation;
+} SET_ANALOG_IN_DECIMATION_ARGS;
+
+// adc capture arm
+typedef struct PACKED {
+  BYTE num_pins : 4;
+  BYTE : 4;
+  BYTE clock_div;
+  BYTE sample_time : 5;
+  BYTE : 3;
+  WORD num_scans;
+  BYTE pins[0];
+} ADC_CAPTURE_ARM_ARGS;
+
+// adc capture status
+typedef struct PACKED {
+  BYTE state : 3;
+  BYTE : 4;
+  BYTE overflow : 1;
+  WORD count;
+} ADC_CAPTURE_STATUS_ARGS;
+
+// adc capture trigger
+typedef struct PACKED {
+} ADC_CAPTURE_TRIGGER_ARGS;
+
+// adc capture data
+typedef struct PACKED {
+  BYTE size : 6;
+  BYTE : 2;
+  WORD offset;
+} ADC_CAPTURE_DATA_ARGS;
+
+// adc capture read
+typedef struct PACKED {
+} ADC_CAPTURE_READ_ARGS;
+
+// set analog trigger
+typedef struct PACKED {
+  BYTE pin : 6;
+  BYTE mode : 2;
+  BYTE invert : 1;
+  BYTE repeat : 1;
+  BYTE : 6;
+  WORD low;
+  WORD high;
+  WORD pre;
+  WORD post;
+} SET_ANALOG_TRIGGER_ARGS;
+
+// analog trigger status
+typedef struct PACKED {
+  BYTE state : 2;
+  BYTE : 6;
+} ANALOG_TRIGGER_STATUS_ARGS;
+
+// analog trigger data
+typedef struct PACKED {
+  BYTE size : 6;
+  BYTE : 2;
+  WORD offset;
+} ANALOG_TRIGGER_DATA_ARGS;
+
+// set analog in deadband
+typedef struct PACKED {
+  BYTE pin : 6;
+  BYTE : 2;
+  WORD deadband;
+} SET_ANALOG_IN_DEADBAND_ARGS;
+
+// set analog in encoding
+typedef struct PACKED {
+  BYTE delta : 1;
+  BYTE : 7;
+  BYTE keyframe_interval;
+} SET_ANALOG_IN_ENCODING_ARGS;
+
+// set timestamps
+typedef struct PACKED {
+  BYTE sources : 4;
+  BYTE : 4;
+} SET_TIMESTAMPS_ARGS;
+
+// timestamp
+typedef struct PACKED {
+  DWORD time;
+} TIMESTAMP_ARGS;
+
+// sync time
+typedef struct PACKED {
+  BYTE seq;
+} SYNC_TIME_ARGS;
+
+// sync time reply
+typedef struct PACKED {
+  BYTE seq;
+  DWORD time;
+} SYNC_TIME_REPLY_ARGS;
+
+// batch
+typedef struct PACKED {
+  BYTE seq;
+  WORD size : 15;
+  WORD ack : 1;
+} BATCH_ARGS;
+
+// batch done
+typedef struct PACKED {
+  BYTE seq;
+} BATCH_DONE_ARGS;
+
+// set digital out levels
+typedef struct PACKED {
+  BYTE first_pin : 6;
+  BYTE : 2;
+  BYTE num_bytes : 4;
+  BYTE : 4;
+  BYTE mask_and_value[0];
+} SET_DIGITAL_OUT_LEVELS_ARGS;
+
+// set digital in batching
+typedef struct PACKED {
+  BYTE enable : 1;
+  BYTE : 7;
+} SET_DIGITAL_IN_BATCHING_ARGS;
+
+// report digital in changes
+typedef struct PACKED {
+  BYTE first_pin : 6;
+  BYTE : 2;
+  BYTE num_bytes : 4;
+  BYTE : 4;
+  BYTE mask_and_levels[0];
+} REPORT_DIGITAL_IN_CHANGES_ARGS;
+
+// encoder config
+typedef struct PACKED {
+  BYTE encoder_num : 2;
+  BYTE : 5;
+  BYTE enable : 1;
+  BYTE pin_a : 6;
+  BYTE : 2;
+  BYTE pin_b : 6;
+  BYTE : 2;
+  WORD period;
+} ENCODER_CONFIG_ARGS;
+
+// encoder status
+typedef struct PACKED {
+  BYTE encoder_num : 2;
+  BYTE : 5;
+  BYTE enabled : 1;
+} ENCODER_STATUS_ARGS;
+
+// encoder read
+typedef struct PACKED {
+  BYTE encoder_num : 2;
+  BYTE : 6;
+} ENCODER_READ_ARGS;
+
+// encoder report
+typedef struct PACKED {
+  BYTE encoder_num : 2;
+  BYTE : 6;
+  LONG position;
+  LONG delta;
+  DWORD interval;
+} ENCODER_REPORT_ARGS;
+
+// set incap rearm period
+typedef struct PACKED {
+  BYTE incap_num : 4;
+  BYTE : 4;
+  BYTE period;
+} SET_INCAP_REARM_PERIOD_ARGS;
+
+// incap edges
+typedef struct PACKED {
+  BYTE incap_num : 4;
+  BYTE : 4;
+  BYTE size;
+  BYTE data[0];
+} INCAP_EDGES_ARGS;
+
+// set incap gate
+typedef struct PACKED {
+  BYTE incap_num : 4;
+  BYTE : 2;
+  BYTE prescale : 2;
+  WORD gate;
+} SET_INCAP_GATE_ARGS;
+
+// incap count
+typedef struct PACKED {
+  BYTE incap_num : 4;
+  BYTE : 3;
+  BYTE overflow : 1;
+  DWORD edges;
+  DWORD ticks;
+} INCAP_COUNT_ARGS;
+
+// pwm seq config
+typedef struct PACKED {
+  BYTE pwm_num : 4;
+  BYTE : 2;
+  BYTE loop : 1;
+  BYTE enable : 1;
+  WORD periods;
+} PWM_SEQ_CONFIG_ARGS;
+
+// pwm seq status
+typedef struct PACKED {
+  BYTE pwm_num : 4;
+  BYTE : 3;
+  BYTE enabled : 1;
+} PWM_SEQ_STATUS_ARGS;
+
+// pwm seq data
+typedef struct PACKED {
+  BYTE pwm_num : 4;
+  BYTE size : 4;
+  BYTE steps[0];
+} PWM_SEQ_DATA_ARGS;
+
+// pwm seq report tx status
+typedef struct PACKED {
+  BYTE pwm_num : 4;
+  BYTE : 4;
+  BYTE steps_to_add;
+} PWM_SEQ_REPORT_TX_STATUS_ARGS;
+
+// set pwm sync
+typedef struct PACKED {
+  BYTE pwm_num : 4;
+  BYTE sync_num : 4;
+} SET_PWM_SYNC_ARGS;
+
+// pwm group update
+typedef struct PACKED {
+  WORD mask : 9;
+  WORD : 7;
+  BYTE entries[0];
+} PWM_GROUP_UPDATE_ARGS;
+
+// schedule config
+typedef struct PACKED {
+  BYTE schedule_num : 2;
+  BYTE : 5;
+  BYTE enable : 1;
+  DWORD period;
+} SCHEDULE_CONFIG_ARGS;
+
+// schedule status
+typedef struct PACKED {
+  BYTE schedule_num : 2;
+  BYTE : 5;
+  BYTE enabled : 1;
+} SCHEDULE_STATUS_ARGS;
+
+// schedule data
+typedef struct PACKED {
+  BYTE schedule_num : 2;
+  BYTE size : 6;
+  BYTE data[0];
+} SCHEDULE_DATA_ARGS;
+
+// set reflex
+typedef struct PACKED {
+  BYTE reflex_num : 3;
+  BYTE : 2;
+  BYTE condition : 2;
+  BYTE level : 1;
+  BYTE pin : 6;
+  BYTE : 2;
+  WORD low;
+  WORD high;
+  BYTE action : 2;
+  BYTE fraction : 2;
+  BYTE : 4;
+  BYTE target : 6;
+  BYTE : 2;
+  WORD value;
+} SET_REFLEX_ARGS;
+
+// reflex status
+typedef struct PACKED {
+  BYTE reflex_num : 3;
+  BYTE : 4;
+  BYTE enabled : 1;
+} REFLEX_STATUS_ARGS;
+
+// reflex fired
+typedef struct PACKED {
+  BYTE reflex_num : 3;
+  BYTE : 5;
+  DWORD time;
+} REFLEX_FIRED_ARGS;
+
+// control config
+typedef struct PACKED {
+  BYTE loop_num : 2;
+  BYTE : 4;
+  BYTE source : 2;
+  BYTE input : 6;
+  BYTE : 2;
+  BYTE pwm_num : 4;
+  BYTE : 4;
+  WORD out_min;
+  WORD out_max;
+  WORD report_interval;
+} CONTROL_CONFIG_ARGS;
+
+// control status
+typedef struct PACKED {
+  BYTE loop_num : 2;
+  BYTE : 5;
+  BYTE enabled : 1;
+} CONTROL_STATUS_ARGS;
+
+// control params
+typedef struct PACKED {
+  BYTE loop_num : 2;
+  BYTE : 2;
+  BYTE shift : 4;
+  LONG setpoint;
+  SHORT kp;
+  SHORT ki;
+  SHORT kd;
+} CONTROL_PARAMS_ARGS;
+
+// control report
+typedef struct PACKED {
+  BYTE loop_num : 2;
+  BYTE : 5;
+  BYTE saturated : 1;
+  DWORD input;
+  WORD output;
+} CONTROL_REPORT_ARGS;
+
+// set analog in filter
+typedef struct PACKED {
+  BYTE pin : 6;
+  BYTE type : 2;
+  BYTE param : 4;
+  BYTE : 4;
+  BYTE taps[0];
+} SET_ANALOG_IN_FILTER_ARGS;
+
+// set uart rx aggregation
+typedef struct PACKED {
+  BYTE uart_num : 2;
+  BYTE : 6;
+  BYTE min_batch;
+  BYTE max_frame;
+  WORD idle_timeout;  // 100us units
+  WORD max_latency;  // ms
+} SET_UART_RX_AGGREGATION_ARGS;
+
+// uart data extended
+typedef struct PACKED {
+  BYTE uart_num : 2;
+  BYTE : 6;
+  BYTE size;
+  BYTE data[0];
+} UART_DATA_EXTENDED_ARGS;
+
+// get capabilities
+typedef struct PACKED {
+} GET_CAPABILITIES_ARGS;
+
+// capabilities
+typedef struct PACKED {
+  DWORD capabilities;
+} CAPABILITIES_ARGS;
+
 // BOOKMARK(add_feature): Add a struct for the new incoming / outgoing message
 // arguments.
 
@@ -429,6 +841,35 @@ typedef struct PACKED {
     SOFT_CLOSE_ARGS                          soft_close;
     SET_PIN_CAPSENSE_ARGS                    set_pin_capsense;
     SET_CAPSENSE_SAMPLING_ARGS               set_capsense_sampling;
+    SET_ANALOG_IN_PERIOD_ARGS                set_analog_in_period;
+    SET_ANALOG_IN_DECIMATION_ARGS            set_analog_in_decimation;
+    ADC_CAPTURE_ARM_ARGS                     adc_capture_arm;
+    ADC_CAPTURE_TRIGGER_ARGS                 adc_capture_trigger;
+    ADC_CAPTURE_READ_ARGS                    adc_capture_read;
+    SET_ANALOG_TRIGGER_ARGS                  set_analog_trigger;
+    SET_ANALOG_IN_DEADBAND_ARGS              set_analog_in_deadband;
+    SET_ANALOG_IN_ENCODING_ARGS              set_analog_in_encoding;
+    SET_TIMESTAMPS_ARGS                      set_timestamps;
+    SYNC_TIME_ARGS                           sync_time;
+    BATCH_ARGS                               batch;
+    SET_DIGITAL_OUT_LEVELS_ARGS              set_digital_out_levels;
+    SET_DIGITAL_IN_BATCHING_ARGS             set_digital_in_batching;
+    ENCODER_CONFIG_ARGS                      encoder_config;
+    ENCODER_READ_ARGS                        encoder_read;
+    SET_INCAP_REARM_PERIOD_ARGS              set_incap_rearm_period;
+    SET_INCAP_GATE_ARGS                      set_incap_gate;
+    PWM_SEQ_CONFIG_ARGS                      pwm_seq_config;
+    PWM_SEQ_DATA_ARGS                        pwm_seq_data;
+    SET_PWM_SYNC_ARGS                        set_pwm_sync;
+    PWM_GROUP_UPDATE_ARGS                    pwm_group_update;
+    SCHEDULE_CONFIG_ARGS                     schedule_config;
+    SCHEDULE_DATA_ARGS                       schedule_data;
+    SET_REFLEX_ARGS                          set_reflex;
+    CONTROL_CONFIG_ARGS                      control_config;
+    CONTROL_PARAMS_ARGS                      control_params;
+    SET_ANALOG_IN_FILTER_ARGS                set_analog_in_filter;
+    SET_UART_RX_AGGREGATION_ARGS             set_uart_rx_aggregation;
+    GET_CAPABILITIES_ARGS                    get_capabilities;
     // BOOKMARK(add_feature): Add argument struct to the union.
   } args;
   BYTE __vabuf[64];  // buffer for var args. never access directly!
@@ -459,6 +900,27 @@ typedef struct PACKED {
     SOFT_CLOSE_ARGS                         soft_close;
     CAPSENSE_REPORT_ARGS                    capsense_report;
     SET_CAPSENSE_SAMPLING_ARGS              set_capsense_sampling;
+    ADC_CAPTURE_STATUS_ARGS                 adc_capture_status;
+    ADC_CAPTURE_DATA_ARGS                   adc_capture_data;
+    ANALOG_TRIGGER_STATUS_ARGS              analog_trigger_status;
+    ANALOG_TRIGGER_DATA_ARGS                analog_trigger_data;
+    TIMESTAMP_ARGS                          timestamp;
+    SYNC_TIME_REPLY_ARGS                    sync_time_reply;
+    BATCH_DONE_ARGS                         batch_done;
+    REPORT_DIGITAL_IN_CHANGES_ARGS          report_digital_in_changes;
+    ENCODER_STATUS_ARGS                     encoder_status;
+    ENCODER_REPORT_ARGS                     encoder_report;
+    INCAP_EDGES_ARGS                        incap_edges;
+    INCAP_COUNT_ARGS                        incap_count;
+    PWM_SEQ_STATUS_ARGS                     pwm_seq_status;
+    PWM_SEQ_REPORT_TX_STATUS_ARGS           pwm_seq_report_tx_status;
+    SCHEDULE_STATUS_ARGS                    schedule_status;
+    REFLEX_STATUS_ARGS                      reflex_status;
+    REFLEX_FIRED_ARGS                       reflex_fired;
+    CONTROL_STATUS_ARGS                     control_status;
+    CONTROL_REPORT_ARGS                     control_report;
+    UART_DATA_EXTENDED_ARGS                 uart_data_extended;
+    CAPABILITIES_ARGS                       capabilities;
     // BOOKMARK(add_feature): Add argument struct to the union.
   } args;
 } OUTGOING_MESSAGE;
@@ -526,6 +988,61 @@ typedef enum {
   CAPSENSE_REPORT                     = 0x1E,
   SET_CAPSENSE_SAMPLING               = 0x1F,
 
+  SET_ANALOG_IN_PERIOD                = 0x20,
+  SET_ANALOG_IN_DECIMATION            = 0x21,
+
+  ADC_CAPTURE_ARM                     = 0x22,
+  ADC_CAPTURE_STATUS                  = 0x22,
+  ADC_CAPTURE_TRIGGER                 = 0x23,
+  ADC_CAPTURE_DATA                    = 0x23,
+  ADC_CAPTURE_READ                    = 0x24,
+
+  SET_ANALOG_TRIGGER                  = 0x25,
+  ANALOG_TRIGGER_STATUS               = 0x25,
+  ANALOG_TRIGGER_DATA                 = 0x26,
+
+  SET_ANALOG_IN_DEADBAND              = 0x27,
+  SET_ANALOG_IN_ENCODING              = 0x28,
+
+  SET_TIMESTAMPS                      = 0x29,
+  TIMESTAMP                           = 0x29,
+  SYNC_TIME                           = 0x2A,
+  SYNC_TIME_REPLY                     = 0x2A,
+  BATCH                               = 0x2B,
+  BATCH_DONE                          = 0x2B,
+  SET_DIGITAL_OUT_LEVELS              = 0x2C,
+  SET_DIGITAL_IN_BATCHING             = 0x2D,
+  REPORT_DIGITAL_IN_CHANGES           = 0x2D,
+  ENCODER_CONFIG                      = 0x2E,
+  ENCODER_STATUS                      = 0x2E,
+  ENCODER_READ                        = 0x2F,
+  ENCODER_REPORT                      = 0x2F,
+  SET_INCAP_REARM_PERIOD              = 0x30,
+  INCAP_EDGES                         = 0x30,
+  SET_INCAP_GATE                      = 0x31,
+  INCAP_COUNT                         = 0x31,
+  PWM_SEQ_CONFIG                      = 0x32,
+  PWM_SEQ_STATUS                      = 0x32,
+  PWM_SEQ_DATA                        = 0x33,
+  PWM_SEQ_REPORT_TX_STATUS            = 0x33,
+  SET_PWM_SYNC                        = 0x34,
+  PWM_GROUP_UPDATE                    = 0x35,
+  SCHEDULE_CONFIG                     = 0x36,
+  SCHEDULE_STATUS                     = 0x36,
+  SCHEDULE_DATA                       = 0x37,
+  SET_REFLEX                          = 0x38,
+  REFLEX_STATUS                       = 0x38,
+  REFLEX_FIRED                        = 0x39,
+  CONTROL_CONFIG                      = 0x3A,
+  CONTROL_STATUS                      = 0x3A,
+  CONTROL_PARAMS                      = 0x3B,
+  CONTROL_REPORT                      = 0x3B,
+  SET_ANALOG_IN_FILTER                = 0x3C,
+  SET_UART_RX_AGGREGATION             = 0x3D,
+  UART_DATA_EXTENDED                  = 0x3D,
+  GET_CAPABILITIES                    = 0x3E,
+  CAPABILITIES                        = 0x3E,
+
   // BOOKMARK(add_feature): Add new message type to enum.
   MESSAGE_TYPE_LIMIT
 } MESSAGE_TYPE;
@@ -27,11 +27,37 @@
  * or implied.
  */
 
+// The waveform sequencer plays a queue of duty cycles on a PWM module, one
+// step every given number of PWM periods. The steps are applied from the
+// module's own interrupt, which fires on period match, so every change takes
+// effect on a period boundary with no dependence on the host's timing.
+// The queue is a single-producer, single-consumer ring of steps: the main loop
+// appends at head, the interrupt plays from tail. In loop mode the interrupt
+// never consumes: it keeps cycling through whatever is in the queue, which
+// the host may still extend.
+// Flow control works like UART TX: the number of steps consumed is reported
+// back, starting with the whole queue on enabling.
+//
+// A group update stages new duty cycles (and optionally periods) for a set of
+// modules, and commits them all from a single interrupt: that of the module
+// the first of them is synchronized to. When the modules of the group are
+// synchronized to a common one, the update thus lands in the same period on
+// all of them. Updates staged before a pending one is committed are merged
+// into it.
+
 #include "pwm.h"
 
 #include "Compiler.h"
 #include "logging.h"
 #include "platform.h"
+#include "pp_util.h"
+#include "protocol.h"
+#include "protocol_defs.h"
+#include "sync.h"
+
+DEFINE_REG_SETTERS_1B(NUM_PWM_MODULES, _OC, IF)
+DEFINE_REG_SETTERS_1B(NUM_PWM_MODULES, _OC, IE)
+DEFINE_REG_SETTERS_1B(NUM_PWM_MODULES, _OC, IP)
 
 typedef struct {
   unsigned int con1;
@@ -43,23 +69,78 @@ typedef struct {
 
 #define OC_REG(num) (((volatile OC_REGS *) &OC1CON1) + num)
 
+#define SEQ_SIZE 64  // Steps. Has to divide 256, for the BYTE indices.
+#define OC_PRIORITY 3
+
+typedef struct {
+  WORD dc[SEQ_SIZE];
+  BYTE fraction[SEQ_SIZE];
+  volatile BYTE head;
+  volatile BYTE tail;
+  BYTE cursor;  // Next step to play in loop mode.
+  BOOL loop;
+  WORD periods;  // 0 when disabled.
+  WORD countdown;
+  int num_tx_since_last_report;
+} SEQUENCER;
+
+static SEQUENCER seqs[NUM_PWM_MODULES] __attribute__((far));
+
+typedef struct {
+  WORD dc;
+  WORD period;
+  BYTE fraction;
+  BOOL set_period;
+} STAGED;
+
+static STAGED staged[NUM_PWM_MODULES];
+static volatile WORD staged_mask;
+static BYTE commit_num;  // The module whose interrupt commits the staged.
+
+// Whether the module's interrupt is needed, either for a sequencer or for
+// committing.
+#define OC_ARMED(num) \
+  (seqs[num].periods || (staged_mask && commit_num == (num)))
+
+static void PWMSequencerConfigInternal(int pwm_num, int enable, int loop,
+                                       int periods, int external);
+
 void PWMInit() {
   int i;
+  staged_mask = 0;
   // disable PWMs
   for (i = 0; i < NUM_PWM_MODULES; ++i) {
+    PWMSequencerConfigInternal(i, 0, 0, 0, 0);
     SetPwmPeriod(i, 0, 0);
   }
 }
 
-void SetPwmDutyCycle(int pwm_num, int dc, int fraction) {
-  volatile OC_REGS* regs;
-  log_printf("SetPwmDutyCycle(%d, %d, %d)", pwm_num, dc, fraction);
-  regs = OC_REG(pwm_num);
+static inline void SetDuty(volatile OC_REGS* regs, WORD dc, int fraction) {
   regs->con2 &= ~0x0600;
   regs->con2 |= fraction << 9;
   regs->r = dc;
 }
 
+void SetPwmDutyCycle(int pwm_num, int dc, int fraction) {
+  log_printf("SetPwmDutyCycle(%d, %d, %d)", pwm_num, dc, fraction);
+  SetDuty(OC_REG(pwm_num), dc, fraction);
+}
+
+void PWMForceDutyCycle(int pwm_num, int dc, int fraction) {
+  BYTE prev;
+  log_printf("PWMForceDutyCycle(%d, %d, %d)", pwm_num, dc, fraction);
+  if (seqs[pwm_num].periods) {
+    PWMSequencerConfigInternal(pwm_num, 0, 0, 0, 1);
+  }
+  prev = SyncInterruptLevel(OC_PRIORITY);
+  if (staged_mask & (1 << pwm_num)) {
+    staged_mask &= ~(1 << pwm_num);
+    Set_OCIE[commit_num](OC_ARMED(commit_num));
+  }
+  SetDuty(OC_REG(pwm_num), dc, fraction);
+  SyncInterruptLevel(prev);
+}
+
 void SetPwmPeriod(int pwm_num, int period, int scale) {
   volatile OC_REGS* regs;
   log_printf("SetPwmPeriod(%d, %d, %d)", pwm_num, period, scale);
@@ -78,3 +159,169 @@ void SetPwmPeriod(int pwm_num, int period, int scale) {
     regs->con1 = 0x0006 | CLK_SRC[scale];
   }
 }
+
+// The module whose period a module follows.
+static inline int SyncSource(int pwm_num) {
+  const int syncsel = OC_REG(pwm_num)->con2 & 0x001F;
+  return syncsel >= 1 && syncsel <= NUM_PWM_MODULES ? syncsel - 1 : pwm_num;
+}
+
+void SetPwmSync(int pwm_num, int sync_num) {
+  volatile OC_REGS* regs;
+  log_printf("SetPwmSync(%d, %d)", pwm_num, sync_num);
+  regs = OC_REG(pwm_num);
+  regs->con2 &= ~0x001F;
+  regs->con2 |= sync_num == pwm_num ? 0x001F : sync_num + 1;
+}
+
+void PWMGroupUpdate(int mask, const void* data) {
+  const BYTE* entry = (const BYTE*) data;
+  int i, clock = -1;
+  BYTE prev;
+  log_printf("PWMGroupUpdate(0x%x, %p)", mask, data);
+  prev = SyncInterruptLevel(OC_PRIORITY);
+  for (i = 0; i < NUM_PWM_MODULES; ++i) {
+    if (!(mask & (1 << i))) continue;
+    if (clock < 0) clock = SyncSource(i);
+    staged[i].fraction = entry[0] & 0x03;
+    staged[i].set_period = entry[0] >> 7;
+    staged[i].dc = entry[1] | (entry[2] << 8);
+    staged[i].period = entry[3] | (entry[4] << 8);
+    entry += 5;
+  }
+  if (staged_mask && commit_num != clock) {
+    Set_OCIE[commit_num](seqs[commit_num].periods != 0);
+  }
+  if (!OC_ARMED(clock)) {
+    // Make sure we only commit after the next period match.
+    Set_OCIF[clock](0);
+  }
+  staged_mask |= mask;
+  commit_num = clock;
+  Set_OCIP[clock](OC_PRIORITY);
+  Set_OCIE[clock](1);
+  SyncInterruptLevel(prev);
+}
+
+static void CommitStaged() {
+  int i;
+  for (i = 0; i < NUM_PWM_MODULES; ++i) {
+    if (staged_mask & (1 << i)) {
+      volatile OC_REGS* regs = OC_REG(i);
+      if (staged[i].set_period) {
+        regs->rs = staged[i].period;
+      }
+      SetDuty(regs, staged[i].dc, staged[i].fraction);
+    }
+  }
+  staged_mask = 0;
+}
+
+static void PWMSequencerConfigInternal(int pwm_num, int enable, int loop,
+                                       int periods, int external) {
+  SEQUENCER* seq = &seqs[pwm_num];
+  OUTGOING_MESSAGE msg;
+  msg.type = PWM_SEQ_STATUS;
+  msg.args.pwm_seq_status.pwm_num = pwm_num;
+  msg.args.pwm_seq_status.enabled = enable;
+
+  Set_OCIE[pwm_num](0);
+  // We're safe here - nobody will touch the variables we're modifying.
+  seq->periods = 0;
+  seq->head = 0;
+  seq->tail = 0;
+  seq->cursor = 0;
+  seq->num_tx_since_last_report = 0;
+  if (external) {
+    AppProtocolSendMessage(&msg);
+  }
+  if (enable) {
+    seq->loop = loop;
+    seq->periods = periods;
+    seq->countdown = periods;
+    seq->num_tx_since_last_report = SEQ_SIZE;
+    Set_OCIF[pwm_num](0);
+    Set_OCIP[pwm_num](OC_PRIORITY);
+  }
+  Set_OCIE[pwm_num](OC_ARMED(pwm_num));
+}
+
+void PWMSequencerConfig(int pwm_num, int enable, int loop, int periods) {
+  log_printf("PWMSequencerConfig(%d, %d, %d, %d)", pwm_num, enable, loop,
+             periods);
+  PWMSequencerConfigInternal(pwm_num, enable, loop, periods, 1);
+}
+
+void PWMSequencerData(int pwm_num, const void* data, int num_steps) {
+  SEQUENCER* seq = &seqs[pwm_num];
+  const BYTE* step = (const BYTE*) data;
+  log_printf("PWMSequencerData(%d, %p, %d)", pwm_num, data, num_steps);
+  while (num_steps--) {
+    const BYTE i = seq->head % SEQ_SIZE;
+    if ((BYTE) (seq->head - seq->tail) == SEQ_SIZE) {
+      log_printf("PWM sequencer %d overflow", pwm_num);
+      return;
+    }
+    seq->fraction[i] = step[0] & 0x03;
+    seq->dc[i] = step[1] | (step[2] << 8);
+    step += 3;
+    ++seq->head;  // Publishes the step to the interrupt.
+  }
+}
+
+static void PWMSequencerReportTxStatus(int pwm_num) {
+  int report;
+  SEQUENCER* seq = &seqs[pwm_num];
+  OUTGOING_MESSAGE msg;
+  BYTE prev = SyncInterruptLevel(OC_PRIORITY);
+  report = seq->num_tx_since_last_report;
+  seq->num_tx_since_last_report = 0;
+  SyncInterruptLevel(prev);
+  msg.type = PWM_SEQ_REPORT_TX_STATUS;
+  msg.args.pwm_seq_report_tx_status.pwm_num = pwm_num;
+  msg.args.pwm_seq_report_tx_status.steps_to_add = report;
+  AppProtocolSendMessage(&msg);
+}
+
+void PWMTasks() {
+  int i;
+  for (i = 0; i < NUM_PWM_MODULES; ++i) {
+    if (seqs[i].num_tx_since_last_report > SEQ_SIZE / 2) {
+      PWMSequencerReportTxStatus(i);
+    }
+  }
+}
+
+static void OCInterrupt(int pwm_num) {
+  SEQUENCER* seq = &seqs[pwm_num];
+  BYTE fill, i;
+  Set_OCIF[pwm_num](0);
+  if (staged_mask && commit_num == pwm_num) {
+    CommitStaged();
+    if (!seq->periods) {
+      Set_OCIE[pwm_num](0);
+    }
+  }
+  if (!seq->periods || --seq->countdown) return;
+  seq->countdown = seq->periods;
+  fill = seq->head - seq->tail;
+  if (!fill) return;  // Underrun. Keep the last step.
+  if (seq->loop) {
+    if ((BYTE) (seq->cursor - seq->tail) >= fill) {
+      seq->cursor = seq->tail;
+    }
+    i = seq->cursor++;
+  } else {
+    i = seq->tail++;
+    ++seq->num_tx_since_last_report;
+  }
+  i %= SEQ_SIZE;
+  SetDuty(OC_REG(pwm_num), seq->dc[i], seq->fraction[i]);
+}
+
+#define DEFINE_INTERRUPT(num, unused) \
+void __attribute__((__interrupt__, auto_psv)) _OC##num##Interrupt() { \
+  OCInterrupt(num - 1); \
+}
+
+REPEAT_1B(DEFINE_INTERRUPT, NUM_PWM_MODULES)
@@ -35,5 +35,33 @@ void PWMInit();
 void SetPwmDutyCycle(int pwm_num, int dc, int fraction);
 void SetPwmPeriod(int pwm_num, int period, int scale);
 
+// Sets the duty cycle of a module, stopping its sequencer and dropping its
+// part of a pending group update, so that neither overrides it later. May be
+// called from interrupts of priority 1.
+void PWMForceDutyCycle(int pwm_num, int dc, int fraction);
+
+// Synchronizes the timer of a module to that of another, so that it follows
+// its period and phase. Synchronizing a module to itself undoes this, and so
+// does SetPwmPeriod().
+void SetPwmSync(int pwm_num, int sync_num);
+
+// Stages new values for the modules in mask, and commits them together on
+// the next period match of the module the lowest of them is synchronized to.
+// data has 5 bytes per module, in ascending order: the fraction in the low 2
+// bits of the first, with bit 7 set if the period is to be set too, then the
+// duty cycle and the period, LSB first.
+void PWMGroupUpdate(int mask, const void* data);
+
+// Starts or stops the waveform sequencer of a module, which plays a step
+// every given number of PWM periods. In loop mode it cycles through the steps
+// it has instead of consuming them. Either way, the queue starts out empty.
+void PWMSequencerConfig(int pwm_num, int enable, int loop, int periods);
+
+// Appends steps to the queue of a sequencer. Every step is 3 bytes: the
+// fraction in the low 2 bits of the first, then the duty cycle, LSB first.
+void PWMSequencerData(int pwm_num, const void* data, int num_steps);
+
+void PWMTasks();
+
 
 #endif  // __PWM_H__
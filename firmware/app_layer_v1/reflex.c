@@ -0,0 +1,182 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+#include "reflex.h"
+
+#include <string.h>
+
+#include "Compiler.h"
+#include "adc.h"
+#include "digital.h"
+#include "logging.h"
+#include "pins.h"
+#include "protocol.h"
+#include "pwm.h"
+#include "sync.h"
+#include "timebase.h"
+#include "uart.h"
+
+typedef struct {
+  BYTE pin;
+  BOOL level;
+  // Digital: the level last seen. Analog: whether the value has been seen on
+  // the starting side of the thresholds since the rule last fired.
+  BOOL state;
+  volatile unsigned int* port;
+  unsigned int mask;
+  BYTE channel;
+  WORD low;
+  WORD high;
+  BYTE action;
+  BYTE target;
+  BYTE fraction;
+  WORD value;
+} REFLEX;
+
+static REFLEX reflexes[NUM_REFLEXES];
+// The rules set for each kind of condition, as bitmasks. Owned by the
+// interrupts, along with the rules in them.
+static BYTE digital_mask;
+static BYTE analog_mask;
+
+void ReflexInit() {
+  BYTE prev = SyncInterruptLevel(1);
+  digital_mask = 0;
+  analog_mask = 0;
+  memset(reflexes, 0, sizeof reflexes);
+  SyncInterruptLevel(prev);
+}
+
+static void ReflexSendStatus(int reflex_num, int enabled) {
+  OUTGOING_MESSAGE msg;
+  msg.type = REFLEX_STATUS;
+  msg.args.reflex_status.reflex_num = reflex_num;
+  msg.args.reflex_status.enabled = enabled;
+  AppProtocolSendMessage(&msg);
+}
+
+void ReflexSet(int reflex_num, int condition, int pin, int level, int low,
+               int high, int action, int target, int value, int fraction) {
+  REFLEX* r = &reflexes[reflex_num];
+  const BYTE bit = 1 << reflex_num;
+  BOOL was_set;
+  BYTE prev;
+  log_printf("ReflexSet(%d, %d, %d, %d, %d, %d, %d, %d, %d, %d)", reflex_num,
+             condition, pin, level, low, high, action, target, value,
+             fraction);
+  prev = SyncInterruptLevel(1);
+  was_set = ((digital_mask | analog_mask) & bit) != 0;
+  digital_mask &= ~bit;
+  analog_mask &= ~bit;
+  SyncInterruptLevel(prev);
+  if (was_set) ReflexSendStatus(reflex_num, 0);
+  if (condition == REFLEX_OFF) return;
+
+  r->pin = pin;
+  r->level = level;
+  r->low = low;
+  r->high = high;
+  r->action = action;
+  r->target = target;
+  r->value = value;
+  r->fraction = fraction;
+  if (condition == REFLEX_DIGITAL) {
+    PinGetPortReg(pin, &r->port, &r->mask);
+    // As if the pin had been at the other level, so that the rule fires on
+    // the first evaluation if it is at this one already.
+    r->state = !level;
+  } else {
+    r->channel = PinToAnalogChannel(pin);
+    r->state = TRUE;
+  }
+  // Before the rule can fire.
+  ReflexSendStatus(reflex_num, 1);
+
+  prev = SyncInterruptLevel(1);
+  if (condition == REFLEX_DIGITAL) {
+    digital_mask |= bit;
+    _CNIF = 1;  // evaluate it right away
+  } else {
+    analog_mask |= bit;
+  }
+  SyncInterruptLevel(prev);
+}
+
+static void Fire(int reflex_num) {
+  const REFLEX* r = &reflexes[reflex_num];
+  OUTGOING_MESSAGE msg;
+  switch (r->action) {
+    case REFLEX_ACTION_DIGITAL_OUT:
+      SetDigitalOutLevel(r->target, r->value);
+      break;
+
+    case REFLEX_ACTION_PWM:
+      PWMForceDutyCycle(r->target, r->value, r->fraction);
+      break;
+
+    case REFLEX_ACTION_UART_HALT:
+      UARTHaltTransmit(r->target);
+      break;
+  }
+  msg.type = REFLEX_FIRED;
+  msg.args.reflex_fired.reflex_num = reflex_num;
+  msg.args.reflex_fired.time = TimebaseNow();
+  AppProtocolSendMessage(&msg);
+}
+
+void ReflexDigitalUpdate() {
+  int i;
+  for (i = 0; i < NUM_REFLEXES; ++i) {
+    REFLEX* r = &reflexes[i];
+    BOOL level;
+    if (!(digital_mask & (1 << i))) continue;
+    level = (*r->port & r->mask) != 0;
+    if (level == r->state) continue;
+    r->state = level;
+    if (level == r->level) Fire(i);
+  }
+}
+
+void ReflexAnalogUpdate(const volatile unsigned int* buf, unsigned int mask) {
+  int i;
+  for (i = 0; i < NUM_REFLEXES; ++i) {
+    REFLEX* r = &reflexes[i];
+    int value;
+    if (!(analog_mask & (1 << i))) continue;
+    value = ADCScanSample(buf, mask, r->channel);
+    if (value == -1) continue;  // not scanned
+    // Same hysteresis as the analog trigger's edge condition.
+    if (r->level ? value < r->low : value > r->high) {
+      r->state = TRUE;
+    } else if (r->state && (r->level ? value >= r->high : value <= r->low)) {
+      r->state = FALSE;
+      Fire(i);
+    }
+  }
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+// Reflexes: rules that drive outputs straight from input events, with no
+// round trip to the client. A rule watches one input and fires when it enters
+// a condition:
+// - REFLEX_DIGITAL: the level of a digital pin changes to the given one. Only
+//   seen while the change notification interrupt is enabled for the pin, as
+//   it is for digital inputs.
+// - REFLEX_ANALOG: the value of a scanned analog pin rises from below low to
+//   high or above (falls from above high to low or below if !level).
+// A condition that already holds when the rule is set fires it on the next
+// evaluation. On firing, the rule applies its action right away, from the
+// interrupt that evaluated it, then sends a REFLEX_FIRED message with the
+// device time of the action. The actions are:
+// - REFLEX_ACTION_DIGITAL_OUT: set the level of an output pin to value.
+// - REFLEX_ACTION_PWM: set the duty cycle of a PWM module to value and
+//   fraction, stopping its sequencer and dropping its staged group update, if
+//   any, so that they don't override it.
+// - REFLEX_ACTION_UART_HALT: stop transmitting on a UART, until it is
+//   configured again.
+
+#ifndef __REFLEX_H__
+#define __REFLEX_H__
+
+#include "GenericTypeDefs.h"
+
+#define NUM_REFLEXES 8
+
+// Conditions.
+#define REFLEX_OFF     0
+#define REFLEX_DIGITAL 1
+#define REFLEX_ANALOG  2
+
+// Actions.
+#define REFLEX_ACTION_DIGITAL_OUT 0
+#define REFLEX_ACTION_PWM         1
+#define REFLEX_ACTION_UART_HALT   2
+
+void ReflexInit();
+
+// Sets a rule, replacing the previous one, or clears it if condition is
+// REFLEX_OFF. Either way, a REFLEX_STATUS message is sent.
+void ReflexSet(int reflex_num, int condition, int pin, int level, int low,
+               int high, int action, int target, int value, int fraction);
+
+// Called from the change notification interrupt.
+void ReflexDigitalUpdate();
+
+// Called from the ADC scan done interrupt, with the results of a scan of the
+// analog channels in mask, in ascending channel order.
+void ReflexAnalogUpdate(const volatile unsigned int* buf, unsigned int mask);
+
+#endif  // __REFLEX_H__
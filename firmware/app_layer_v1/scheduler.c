@@ -0,0 +1,122 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+#include "scheduler.h"
+
+#include <string.h>
+
+#include "Compiler.h"
+#include "logging.h"
+#include "protocol.h"
+#include "timebase.h"
+
+#define SCHEDULE_SIZE 128  // Bytes of commands.
+
+typedef struct {
+  BYTE commands[SCHEDULE_SIZE];
+  int size;
+  BOOL overflow;  // Some of the commands did not fit.
+  BOOL enabled;
+  DWORD period;  // us
+  DWORD next_run_time;
+} SCHEDULE;
+
+static SCHEDULE schedules[NUM_SCHEDULES] __attribute__((far));
+
+void SchedulerInit() {
+  memset(schedules, 0, sizeof schedules);
+}
+
+static void SchedulerSendStatus(int schedule_num, int enabled) {
+  OUTGOING_MESSAGE msg;
+  msg.type = SCHEDULE_STATUS;
+  msg.args.schedule_status.schedule_num = schedule_num;
+  msg.args.schedule_status.enabled = enabled;
+  AppProtocolSendMessage(&msg);
+}
+
+static void SchedulerStop(int schedule_num) {
+  memset(&schedules[schedule_num], 0, sizeof(SCHEDULE));
+  SchedulerSendStatus(schedule_num, 0);
+}
+
+void SchedulerConfig(int schedule_num, int enable, DWORD period) {
+  SCHEDULE* sched = &schedules[schedule_num];
+  log_printf("SchedulerConfig(%d, %d, %ld)", schedule_num, enable, period);
+  if (enable) {
+    // Even a schedule that fails the check starts, only to stop right away,
+    // so that every start is matched by a stop.
+    SchedulerSendStatus(schedule_num, 1);
+    if (!sched->overflow
+        && AppProtocolCheckCommands(sched->commands, sched->size)) {
+      sched->enabled = TRUE;
+      sched->period = period;
+      sched->next_run_time = TimebaseNow();
+      return;
+    }
+    log_printf("Schedule %d is not valid", schedule_num);
+  }
+  SchedulerStop(schedule_num);
+}
+
+void SchedulerAppend(int schedule_num, const void* data, int size) {
+  SCHEDULE* sched = &schedules[schedule_num];
+  log_printf("SchedulerAppend(%d, %p, %d)", schedule_num, data, size);
+  if (sched->enabled) {
+    log_printf("Schedule %d is running", schedule_num);
+    return;
+  }
+  if (sched->size + size > SCHEDULE_SIZE) {
+    log_printf("Schedule %d overflow", schedule_num);
+    sched->overflow = TRUE;
+    return;
+  }
+  memcpy(sched->commands + sched->size, data, size);
+  sched->size += size;
+}
+
+void SchedulerTasks() {
+  int i;
+  for (i = 0; i < NUM_SCHEDULES; ++i) {
+    SCHEDULE* sched = &schedules[i];
+    DWORD now;
+    if (!sched->enabled) continue;
+    now = TimebaseNow();
+    if ((LONG) (now - sched->next_run_time) < 0) continue;
+    sched->next_run_time += sched->period;
+    if ((LONG) (now - sched->next_run_time) >= 0) {
+      // Missed runs. Resume the period from now.
+      sched->next_run_time = now + sched->period;
+    }
+    if (!AppProtocolReplayCommands(sched->commands, sched->size)) {
+      log_printf("Schedule %d failed", i);
+      SchedulerStop(i);
+    }
+  }
+}
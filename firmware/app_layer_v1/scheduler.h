@@ -0,0 +1,62 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+// Periodic replay of command lists on the device.
+// A schedule is a list of incoming protocol messages, stored as they were
+// encoded by the client, which is handled every period as if it had just
+// arrived, so a control loop runs with no round trips to the client. A
+// schedule is filled while stopped, and checked on starting, so that it only
+// holds complete messages of types which do not affect the connection or the
+// schedules themselves, and are neither flow controlled nor answered (UART,
+// SPI, I2C and ICSP data, reads and queries). The client could not tell their
+// TX credits and replies from those of its own commands.
+// Schedules run from the main loop, against the device timebase, so a run is
+// late by as long as the longest main loop pass. If a run is so late that the
+// next one is due too, the missed runs are dropped rather than bunched up.
+
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+
+#include "GenericTypeDefs.h"
+
+#define NUM_SCHEDULES 4
+
+void SchedulerInit();
+
+// Starts running a schedule every period us, first thing on the next pass.
+// If the schedule is not valid, it stops right away and is cleared. If
+// !enable, stops the schedule and clears it.
+void SchedulerConfig(int schedule_num, int enable, DWORD period);
+
+// Appends size bytes of commands to a stopped schedule.
+void SchedulerAppend(int schedule_num, const void* data, int size);
+
+void SchedulerTasks();
+
+#endif  // __SCHEDULER_H__
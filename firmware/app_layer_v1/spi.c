@@ -30,7 +30,8 @@
 #include "spi.h"
 
 #include <assert.h>
-#include "byte_queue.h"
+#include "Compiler.h"
+#include "byte_ring.h"
 #include "platform.h"
 #include "logging.h"
 #include "pins.h"
@@ -62,7 +63,7 @@ typedef struct {
   // BYTE dest
   // BYTE tx_size
   // BYTE tx_data[tx_size]
-  BYTE_QUEUE rx_queue;
+  BYTE_RING rx_queue;
 
   int num_messages_rx_queue;
 
@@ -72,7 +73,7 @@ typedef struct {
   // BYTE data_size
   // BYTE rx_trim
   // BYTE tx_data[tx_size]
-  BYTE_QUEUE tx_queue;
+  BYTE_RING tx_queue;
 
   BYTE rx_buffer[RX_BUF_SIZE];
   BYTE tx_buffer[TX_BUF_SIZE];
@@ -128,8 +129,8 @@ static void SPIConfigMasterInternal(int spi_num, int scale, int div, int smp_end
   Set_SPIIE[spi_num](0);  // disable int.
   regs->spixstat = 0x0000;  // disable SPI
   // clear SW buffers
-  ByteQueueInit(&spi->rx_queue, spi->rx_buffer, RX_BUF_SIZE);
-  ByteQueueInit(&spi->tx_queue, spi->tx_buffer, TX_BUF_SIZE);
+  ByteRingInit(&spi->rx_queue, spi->rx_buffer, RX_BUF_SIZE);
+  ByteRingInit(&spi->tx_queue, spi->tx_buffer, TX_BUF_SIZE);
   spi->num_tx_since_last_report = 0;
   spi->num_messages_rx_queue = 0;
   spi->packet_state = PACKET_STATE_IDLE;
@@ -181,24 +182,22 @@ void SPITasks() {
     int size1, size2, size;
     const BYTE *data1, *data2;
     SPI_STATE* spi = &spis[i];
-    BYTE_QUEUE* q = &spi->rx_queue;
+    BYTE_RING* q = &spi->rx_queue;
     BYTE prev;
     while (spi->num_messages_rx_queue) {
       OUTGOING_MESSAGE msg;
       msg.type = SPI_DATA;
       msg.args.spi_data.spi_num = i;
-      prev = SyncInterruptLevel(5);
-      msg.args.spi_data.ss_pin = ByteQueuePullByte(q);
-      msg.args.spi_data.size = ByteQueuePullByte(q) - 1;
-      SyncInterruptLevel(prev);
-      ByteQueuePeekMax(q, msg.args.spi_data.size + 1, &data1, &size1, &data2,
-                       &size2);
+      msg.args.spi_data.ss_pin = ByteRingPullByte(q);
+      msg.args.spi_data.size = ByteRingPullByte(q) - 1;
+      ByteRingPeekMax(q, msg.args.spi_data.size + 1, &data1, &size1, &data2,
+                      &size2);
       size = size1 + size2;
       assert(size == msg.args.spi_data.size + 1);
       log_printf("SPI %d received %d bytes", i, size);
       AppProtocolSendMessageWithVarArgSplit(&msg, data1, size1, data2, size2);
+      ByteRingPull(q, size);
       prev = SyncInterruptLevel(5);
-      ByteQueuePull(q, size);
       --spi->num_messages_rx_queue;
       SyncInterruptLevel(prev);
     }
@@ -211,28 +210,28 @@ void SPITasks() {
 static void SPIInterrupt(int spi_num) {
   volatile SPIREG* reg = spi_reg[spi_num];
   SPI_STATE* spi = &spis[spi_num];
-  BYTE_QUEUE* tx_queue = &spi->tx_queue;
-  BYTE_QUEUE* rx_queue = &spi->rx_queue;
+  BYTE_RING* tx_queue = &spi->tx_queue;
+  BYTE_RING* rx_queue = &spi->rx_queue;
   int bytes_to_write;
 
   // packet initialiation if needed
   if (spi->packet_state == PACKET_STATE_IDLE) {
-      assert(ByteQueueSize(tx_queue) >= 4);
+      assert(ByteRingSize(tx_queue) >= 4);
       // can't have incoming data on idle state. if we do - it's a bug
       assert(reg->spixstat & (1 << 5));
-      spi->cur_msg_dest = ByteQueuePullByte(tx_queue);
-      spi->cur_msg_total_tx = ByteQueuePullByte(tx_queue);
+      spi->cur_msg_dest = ByteRingPullByte(tx_queue);
+      spi->cur_msg_total_tx = ByteRingPullByte(tx_queue);
       spi->cur_msg_total_rx = spi->cur_msg_total_tx;
-      spi->cur_msg_data_tx = ByteQueuePullByte(tx_queue);
-      spi->cur_msg_trim_rx = ByteQueuePullByte(tx_queue);
+      spi->cur_msg_data_tx = ByteRingPullByte(tx_queue);
+      spi->cur_msg_trim_rx = ByteRingPullByte(tx_queue);
       spi->can_send = 8;
       spi->num_tx_since_last_report += 4;
 
       // write packet header to rx_queue, if non-empty
       spi->cur_msg_rx_size = spi->cur_msg_total_rx - spi->cur_msg_trim_rx;
       if (spi->cur_msg_rx_size > 0) {
-        ByteQueuePushByte(rx_queue, spi->cur_msg_dest);
-        ByteQueuePushByte(rx_queue, spi->cur_msg_rx_size);
+        ByteRingPushByte(rx_queue, spi->cur_msg_dest);
+        ByteRingPushByte(rx_queue, spi->cur_msg_rx_size);
       }
 
       PinSetLat(spi->cur_msg_dest, 0);  // activate SS
@@ -245,7 +244,7 @@ static void SPIInterrupt(int spi_num) {
       if (spi->cur_msg_trim_rx) {
         --spi->cur_msg_trim_rx;
       } else {
-        ByteQueuePushByte(rx_queue, rx_byte);
+        ByteRingPushByte(rx_queue, rx_byte);
       }
       --spi->cur_msg_total_rx;
       ++spi->can_send;  // for every byte read we can write one
@@ -264,7 +263,7 @@ static void SPIInterrupt(int spi_num) {
     while (bytes_to_write-- > 0) {
       BYTE tx_byte = 0xFF;
       if (spi->cur_msg_data_tx) {
-        tx_byte = ByteQueuePullByte(tx_queue);
+        tx_byte = ByteRingPullByte(tx_queue);
         --spi->cur_msg_data_tx;
         ++spi->num_tx_since_last_report;
       }
@@ -281,20 +280,24 @@ static void SPIInterrupt(int spi_num) {
       ++spi->num_messages_rx_queue;
     }
     spi->packet_state = PACKET_STATE_IDLE;
-    Set_SPIIE[spi_num](ByteQueueSize(tx_queue) > 0);
+    Set_SPIIE[spi_num](ByteRingSize(tx_queue) > 0);
     Set_SPIIF[spi_num](1);
   }
 }
 
 void SPITransmit(int spi_num, int dest, const void* data, int data_size,
                  int total_size, int trim_rx) {
-  BYTE_QUEUE* q = &spis[spi_num].tx_queue;
+  BYTE_RING* q = &spis[spi_num].tx_queue;
+  BYTE header[4] = { dest, total_size, data_size, trim_rx };
+  // the ISR starts reading a packet as soon as its header is visible, so
+  // the header and data must become visible together.
   BYTE prev = SyncInterruptLevel(5);
-  ByteQueuePushByte(q, dest);
-  ByteQueuePushByte(q, total_size);
-  ByteQueuePushByte(q, data_size);
-  ByteQueuePushByte(q, trim_rx);
-  ByteQueuePushBuffer(q, data, data_size);
+  if (ByteRingRemaining(q) >= (int) sizeof header + data_size) {
+    ByteRingPushBuffer(q, header, sizeof header);
+    ByteRingPushBuffer(q, data, data_size);
+  } else {
+    ByteRingOverflow(q);
+  }
   Set_SPIIE[spi_num](1);  // enable int.
   SyncInterruptLevel(prev);
 }
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+#include "timebase.h"
+
+#include "Compiler.h"
+#include "logging.h"
+#include "protocol.h"
+#include "sync.h"
+
+// Timer 2 counts half-microseconds, wrapping around every 32.768ms. Its
+// interrupt keeps count of the wrap-arounds.
+static volatile DWORD timebase_high;
+static BYTE timestamp_sources;
+
+void TimebaseInit() {
+  log_printf("TimebaseInit()");
+  timestamp_sources = 0;
+  if (T2CON & 0x8000) return;
+  TMR2 = 0x0000;
+  PR2 = 0xFFFF;
+  timebase_high = 0;
+  _T2IF = 0;
+  _T2IP = 6;  // above anything that may keep it waiting for long.
+  _T2IE = 1;
+  T2CON = 0x8010;  // sysclk / 8 = 2MHz
+}
+
+DWORD TimebaseNow() {
+  BYTE prev = SyncInterruptLevel(7);
+  WORD low = TMR2;
+  DWORD high = timebase_high;
+  // The timer may have wrapped around without the interrupt getting a chance
+  // to count it. If so, the value we read is from after the wrap-around,
+  // unless it is close to the end of the period.
+  if (_T2IF && low < 0x8000) ++high;
+  SyncInterruptLevel(prev);
+  return (high << 15) | (low >> 1);
+}
+
+void TimebaseSetTimestamps(BYTE sources) {
+  log_printf("TimebaseSetTimestamps(0x%x)", sources);
+  timestamp_sources = sources;
+}
+
+void TimebaseStamp(BYTE source, DWORD time) {
+  if (timestamp_sources & source) {
+    AppProtocolTimestampNext(time);
+  }
+}
+
+void TimebaseSync(BYTE seq) {
+  OUTGOING_MESSAGE msg;
+  msg.type = SYNC_TIME_REPLY;
+  msg.args.sync_time_reply.seq = seq;
+  msg.args.sync_time_reply.time = TimebaseNow();
+  AppProtocolSendMessage(&msg);
+}
+
+void __attribute__((__interrupt__, auto_psv)) _T2Interrupt() {
+  ++timebase_high;
+  _T2IF = 0;
+}
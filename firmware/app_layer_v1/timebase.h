@@ -0,0 +1,72 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+// Device timebase: a free-running microsecond counter, used to timestamp the
+// messages carrying samples and to sync the client's clock to ours.
+// Usage:
+// TimebaseInit();
+// ...
+// BYTE prev = SyncInterruptLevel(1);
+// TimebaseStamp(TIMESTAMP_DIGITAL, TimebaseNow());
+// AppProtocolSendMessage(&msg);  // preceded by a TIMESTAMP if enabled.
+// SyncInterruptLevel(prev);
+
+#ifndef __TIMEBASE_H__
+#define __TIMEBASE_H__
+
+#include "GenericTypeDefs.h"
+
+// Sources of timestamped messages, as a bitmask.
+#define TIMESTAMP_ANALOG  0x01  // REPORT_ANALOG_IN_STATUS
+#define TIMESTAMP_DIGITAL 0x02  // REPORT_DIGITAL_IN_STATUS
+#define TIMESTAMP_INCAP   0x04  // INCAP_REPORT
+#define TIMESTAMP_UART    0x08  // UART_DATA, UART_DATA_EXTENDED
+
+// Initialize this module.
+// Starts the counter the first time. Later calls leave it running, so that
+// device time is continuous across soft resets, and only disable timestamps.
+void TimebaseInit();
+
+// Microseconds since the first TimebaseInit(), wrapping around every 2^32us
+// (about 71.6 minutes). May be called from any context.
+DWORD TimebaseNow();
+
+// Enable timestamps for the given sources, disable them for the others.
+void TimebaseSetTimestamps(BYTE sources);
+
+// If timestamps are enabled for source, have the next message sent preceded by
+// a TIMESTAMP message of time. Call with interrupts at or below priority 1
+// blocked, which is always the case in interrupts that send messages, right
+// before sending the message.
+void TimebaseStamp(BYTE source, DWORD time);
+
+// Reply to a clock sync request with the current time.
+void TimebaseSync(BYTE seq);
+
+#endif  // __TIMEBASE_H__
@@ -33,18 +33,31 @@
 #include "Compiler.h"
 #include "logging.h"
 #include "platform.h"
-#include "byte_queue.h"
+#include "byte_ring.h"
 #include "pp_util.h"
 #include "protocol.h"
 #include "sync.h"
+#include "timebase.h"
 
 #define RX_BUF_SIZE 256
 #define TX_BUF_SIZE 256
 
 typedef struct {
   int num_tx_since_last_report;
-  BYTE_QUEUE rx_queue;
-  BYTE_QUEUE tx_queue;
+  BOOL tx_halted;
+  // When the first byte now in rx_queue came in. Written by the RX interrupt
+  // when the queue is empty, by UARTTasks() when it isn't.
+  DWORD rx_time;
+  // When the last byte came in. Written by the RX interrupt.
+  DWORD rx_last_time;
+  // Aggregation, as in UARTSetRxAggregation(), with the timeouts in
+  // microseconds.
+  int rx_min_batch;
+  int rx_max_frame;
+  DWORD rx_idle_timeout;
+  DWORD rx_max_latency;
+  BYTE_RING rx_queue;
+  BYTE_RING tx_queue;
   BYTE rx_buffer[RX_BUF_SIZE];
   BYTE tx_buffer[TX_BUF_SIZE];
 } UART_STATE;
@@ -95,9 +108,14 @@ static void UARTConfigInternal(int uart_num, int rate, int speed4x, int two_stop
   Set_UTXIE[uart_num](0);  // disable TX int.
   regs->uxmode = 0x0000;  // disable UART.
   // clear SW buffers
-  ByteQueueInit(&uart->rx_queue, uart->rx_buffer, RX_BUF_SIZE);
-  ByteQueueInit(&uart->tx_queue, uart->tx_buffer, TX_BUF_SIZE);
+  ByteRingInit(&uart->rx_queue, uart->rx_buffer, RX_BUF_SIZE);
+  ByteRingInit(&uart->tx_queue, uart->tx_buffer, TX_BUF_SIZE);
   uart->num_tx_since_last_report = 0;
+  uart->tx_halted = FALSE;
+  uart->rx_min_batch = 1;
+  uart->rx_max_frame = 64;
+  uart->rx_idle_timeout = 0;
+  uart->rx_max_latency = 0;
   if (rate) {
     if (external) {
       UARTSendStatus(uart_num, 1);
@@ -120,6 +138,19 @@ void UARTConfig(int uart_num, int rate, int speed4x, int two_stop_bits, int pari
   UARTConfigInternal(uart_num, rate, speed4x, two_stop_bits, parity, 1);
 }
 
+void UARTSetRxAggregation(int uart_num, int min_batch, int max_frame,
+                          unsigned int idle_timeout_100us,
+                          unsigned int max_latency_ms) {
+  log_printf("UARTSetRxAggregation(%d, %d, %d, %u, %u)", uart_num, min_batch,
+             max_frame, idle_timeout_100us, max_latency_ms);
+  SAVE_UART_FOR_LOG(uart_num);
+  UART_STATE* uart = &uarts[uart_num];
+  // Only UARTTasks() reads these, so no need to raise IPL.
+  uart->rx_min_batch = min_batch;
+  uart->rx_max_frame = max_frame;
+  uart->rx_idle_timeout = idle_timeout_100us * 100ul;
+  uart->rx_max_latency = max_latency_ms * 1000ul;
+}
 
 static void UARTReportTxStatus(int uart_num) {
   int report;
@@ -135,25 +166,64 @@ static void UARTReportTxStatus(int uart_num) {
   AppProtocolSendMessage(&msg);
 }
 
+// Whether what is in rx_queue is to be sent now, as opposed to waiting for
+// more to come in.
+static BOOL RxDue(UART_STATE* uart, int size) {
+  DWORD now, last_time;
+  BYTE prev;
+  if (size >= uart->rx_min_batch) return TRUE;
+  now = TimebaseNow();
+  if (uart->rx_max_latency && now - uart->rx_time >= uart->rx_max_latency) {
+    return TRUE;
+  }
+  if (!uart->rx_idle_timeout) return FALSE;
+  prev = SyncInterruptLevel(4);
+  last_time = uart->rx_last_time;
+  SyncInterruptLevel(prev);
+  return now - last_time >= uart->rx_idle_timeout;
+}
+
+static void SendRxFrame(int uart_num, int max_size) {
+  int size1, size2;
+  const BYTE *data1, *data2;
+  UART_STATE* uart = &uarts[uart_num];
+  BYTE_RING* q = &uart->rx_queue;
+  OUTGOING_MESSAGE msg;
+  ByteRingPeekMax(q, max_size, &data1, &size1, &data2, &size2);
+  log_printf("UART %d received %d bytes", uart_num, size1 + size2);
+  if (size1 + size2 > 64) {
+    msg.type = UART_DATA_EXTENDED;
+    msg.args.uart_data_extended.uart_num = uart_num;
+    msg.args.uart_data_extended.size = size1 + size2 - 1;
+  } else {
+    msg.type = UART_DATA;
+    msg.args.uart_data.uart_num = uart_num;
+    msg.args.uart_data.size = size1 + size2 - 1;
+  }
+  BYTE prev = SyncInterruptLevel(1);
+  TimebaseStamp(TIMESTAMP_UART, uart->rx_time);
+  AppProtocolSendMessageWithVarArgSplit(&msg, data1, size1, data2, size2);
+  SyncInterruptLevel(prev);
+  ByteRingPull(q, size1 + size2);
+  if (ByteRingSize(q)) {
+    // We don't know when the rest came in, only that it wasn't later than now.
+    uart->rx_time = TimebaseNow();
+  }
+}
+
 void UARTTasks() {
   int i;
   for (i = 0; i < NUM_UART_MODULES; ++i) {
-    int size1, size2;
-    const BYTE *data1, *data2;
     UART_STATE* uart = &uarts[i];
-    BYTE_QUEUE* q = &uart->rx_queue;
-    BYTE prev;
-    ByteQueuePeekMax(q, 64, &data1, &size1, &data2, &size2);
-    if (size1) {
-      log_printf("UART %d received %d bytes", i, size1 + size2);
-      OUTGOING_MESSAGE msg;
-      msg.type = UART_DATA;
-      msg.args.uart_data.uart_num = i;
-      msg.args.uart_data.size = size1 + size2 - 1;
-      AppProtocolSendMessageWithVarArgSplit(&msg, data1, size1, data2, size2);
-      prev = SyncInterruptLevel(4);
-      ByteQueuePull(q, size1 + size2);
-      SyncInterruptLevel(prev);
+    int size = ByteRingSize(&uart->rx_queue);
+    if (size && RxDue(uart, size)) {
+      // Send what we have now, and leave what comes in meanwhile for the next
+      // round, so that it starts its own batch.
+      while (size) {
+        int frame = size < uart->rx_max_frame ? size : uart->rx_max_frame;
+        SendRxFrame(i, frame);
+        size -= frame;
+      }
     }
     if (uart->num_tx_since_last_report > TX_BUF_SIZE / 2) {
       UARTReportTxStatus(i);
@@ -164,35 +234,74 @@ void UARTTasks() {
 static void TXInterrupt(int uart_num) {
   volatile UART* reg = uart_reg[uart_num];
   UART_STATE* uart = &uarts[uart_num];
-  BYTE_QUEUE* q = &uart->tx_queue;
-  while (ByteQueueSize(q) && !(reg->uxsta & 0x0200)) {
-    Set_UTXIF[uart_num](0);
-    reg->uxtxreg = ByteQueuePullByte(q);
-    ++uart->num_tx_since_last_report;
+  BYTE_RING* q = &uart->tx_queue;
+  const BYTE* data;
+  int size, n;
+  if (uart->tx_halted) {
+    Set_UTXIE[uart_num](0);
+    return;
   }
-  Set_UTXIE[uart_num](ByteQueueSize(q) != 0);
+  // at most two passes, in case the pending data wraps around.
+  while ((size = ByteRingPeek(q, &data)) && !(reg->uxsta & 0x0200)) {
+    n = 0;
+    do {
+      Set_UTXIF[uart_num](0);
+      reg->uxtxreg = data[n++];
+    } while (n < size && !(reg->uxsta & 0x0200));
+    ByteRingPull(q, n);
+    uart->num_tx_since_last_report += n;
+  }
+  Set_UTXIE[uart_num](ByteRingSize(q) != 0);
 }
 
 static void RXInterrupt(int uart_num) {
   volatile UART* reg = uart_reg[uart_num];
-  BYTE_QUEUE* q = &uarts[uart_num].rx_queue;
+  BYTE_RING* q = &uarts[uart_num].rx_queue;
+  BYTE* data;
+  int space = ByteRingReserve(q, &data);
+  int n = 0;
+  DWORD now = TimebaseNow();
+  if (!ByteRingSize(q)) {
+    uarts[uart_num].rx_time = now;
+  }
+  uarts[uart_num].rx_last_time = now;
   while (reg->uxsta & 0x0001) {
     if (reg->uxsta & 0x000C) {
       // skip character with frame/parity err
       (void) reg->uxrxreg;
       continue;
     }
-    ByteQueuePushByte(q, reg->uxrxreg);
+    if (n == space) {
+      // reached the wrap point or the ring is full.
+      ByteRingCommit(q, n);
+      n = 0;
+      space = ByteRingReserve(q, &data);
+      if (!space) {
+        ByteRingOverflow(q);
+        (void) reg->uxrxreg;
+        continue;
+      }
+    }
+    data[n++] = reg->uxrxreg;
   }
+  ByteRingCommit(q, n);
 }
 
 void UARTTransmit(int uart_num, const void* data, int size) {
   log_printf("UARTTransmit(%d, %p, %d)", uart_num, data, size);
   SAVE_UART_FOR_LOG(uart_num);
-  BYTE_QUEUE* q = &uarts[uart_num].tx_queue;
-  BYTE prev = SyncInterruptLevel(4);
-  ByteQueuePushBuffer(q, data, size);
+  BYTE_RING* q = &uarts[uart_num].tx_queue;
+  // no need to raise IPL: the TX ISR is the only consumer of this ring.
+  ByteRingPushBuffer(q, data, size);
   Set_UTXIE[uart_num](1);  // enable TX int.
+}
+
+void UARTHaltTransmit(int uart_num) {
+  log_printf("UARTHaltTransmit(%d)", uart_num);
+  SAVE_UART_FOR_LOG(uart_num);
+  BYTE prev = SyncInterruptLevel(4);
+  uarts[uart_num].tx_halted = TRUE;
+  Set_UTXIE[uart_num](0);
   SyncInterruptLevel(prev);
 }
 
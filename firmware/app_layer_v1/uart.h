@@ -34,6 +34,27 @@ void UARTInit();
 void UARTConfig(int uart_num, int rate, int speed4x, int two_stop_bits,
                 int parity);
 void UARTTransmit(int uart_num, const void* data, int size);
+
+// Stops feeding the transmitter, leaving what is queued in place, until the
+// UART is configured again. Only the bytes already in the hardware buffer
+// still go out. May be called from interrupts of priority 1.
+void UARTHaltTransmit(int uart_num);
+
+// How received bytes are batched into messages to the client. They are held
+// back until min_batch of them are queued, the line has been idle for
+// idle_timeout_100us times 100us since the last one, or the first has waited
+// max_latency_ms milliseconds; a timeout of 0 disables that condition. Both
+// timeouts go up to 65535, i.e. about 6.5s idle and 65s latency. Then
+// everything queued goes out, in messages of up to max_frame bytes. Frames
+// over 64 bytes go in UART_DATA_EXTENDED. The default, restored whenever the
+// UART is configured, is min_batch 1 and max_frame 64: every byte goes out as
+// soon as possible. min_batch can be at most max_frame, which can be at most
+// UART_MAX_FRAME. The RX buffer holds UART_MAX_FRAME bytes, so batches close
+// to that risk dropping bytes at high baud rates.
+#define UART_MAX_FRAME 256
+void UARTSetRxAggregation(int uart_num, int min_batch, int max_frame,
+                          unsigned int idle_timeout_100us,
+                          unsigned int max_latency_ms);
 void UARTTasks();
 
 
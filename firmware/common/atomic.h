@@ -33,11 +33,16 @@
 #define __ATOMIC_H__
 
 // Atomically execute: *addr += value
+#ifdef __C30__
 #define atomic16_add(addr, value) \
     asm volatile(                 \
         "add %1  ,[%0], [%0] \n"  \
         :                         \
         : "r"(addr), "r"(value))
+#else
+// Host builds (firmware/host).
+#define atomic16_add(addr, value) __atomic_fetch_add((addr), (value), __ATOMIC_SEQ_CST)
+#endif
 
 
 #endif  // __ATOMIC_H__
@@ -140,3 +140,31 @@ void ByteQueuePull(BYTE_QUEUE* q, int size) {
     q->read_cursor -= q->capacity;
   }
 }
+
+BOOL ByteQueueReserve(BYTE_QUEUE* q, int len, BYTE** data1, int* size1,
+                      BYTE** data2, int* size2) {
+  if (q->size + len > q->capacity) {
+    ByteQueueOverflow();
+    return FALSE;
+  }
+  *data1 = q->buf + q->write_cursor;
+  *data2 = q->buf;
+  if (q->write_cursor + len > q->capacity) {
+    *size1 = q->capacity - q->write_cursor;
+    *size2 = len - *size1;
+  } else {
+    *size1 = len;
+    *size2 = 0;
+  }
+  return TRUE;
+}
+
+void ByteQueueCommit(BYTE_QUEUE* q, int len) {
+  if (!len) return;
+  assert(q->size + len <= q->capacity);
+  q->write_cursor += len;
+  if (q->write_cursor >= q->capacity) {
+    q->write_cursor -= q->capacity;
+  }
+  atomic16_add(&q->size, len);
+}
@@ -72,6 +72,19 @@ void ByteQueuePullToBuffer(BYTE_QUEUE* q, void* buffer, int size);
 void ByteQueuePushByte(BYTE_QUEUE* q, BYTE b);
 BYTE ByteQueuePullByte(BYTE_QUEUE* q);
 
+// Reserve len bytes at the end of the queue, to be written in place by the
+// producer. Since the reserved space may wrap around, it is given in two parts.
+// The reserved bytes are invisible to the consumer until ByteQueueCommit() is
+// called. Returns FALSE and reserves nothing if there is not enough room.
+// There can be at most one outstanding reservation per queue, and the producer
+// must not push other data until it is committed.
+BOOL ByteQueueReserve(BYTE_QUEUE* q, int len, BYTE** data1, int* size1,
+                      BYTE** data2, int* size2);
+// Make the first len bytes of the last reservation visible to the consumer.
+// len may be smaller than the reserved size, in which case the rest of the
+// reservation is discarded. Committing 0 bytes cancels the reservation.
+void ByteQueueCommit(BYTE_QUEUE* q, int len);
+
 static inline int ByteQueueSize(BYTE_QUEUE* q) { return q->size; }
 static inline int ByteQueueRemaining(BYTE_QUEUE* q) { return q->capacity - q->size; }
 
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+#include "byte_ring.h"
+
+#include <string.h>
+
+BOOL ByteRingPushBuffer(BYTE_RING* r, const void* buf, int len) {
+  unsigned int head = r->head;
+  unsigned int pos = head & r->mask;
+  int size_first = r->mask + 1 - pos;
+  if (!len) return TRUE;
+  if (len > ByteRingRemaining(r)) {
+    ByteRingOverflow(r);
+    return FALSE;
+  }
+  if (len <= size_first) {
+    memcpy(r->buf + pos, buf, len);
+  } else {
+    memcpy(r->buf + pos, buf, size_first);
+    memcpy(r->buf, ((const BYTE*) buf) + size_first, len - size_first);
+  }
+  BYTE_RING_BARRIER();
+  r->head = head + len;
+  return TRUE;
+}
+
+int ByteRingReserve(BYTE_RING* r, BYTE** data) {
+  unsigned int pos = r->head & r->mask;
+  int remaining = ByteRingRemaining(r);
+  int size_first = r->mask + 1 - pos;
+  *data = r->buf + pos;
+  return remaining < size_first ? remaining : size_first;
+}
+
+int ByteRingPeek(BYTE_RING* r, const BYTE** data) {
+  unsigned int pos = r->tail & r->mask;
+  int size = ByteRingSize(r);
+  int size_first = r->mask + 1 - pos;
+  *data = r->buf + pos;
+  return size < size_first ? size : size_first;
+}
+
+void ByteRingPeekMax(BYTE_RING* r, int max_size, const BYTE** data1,
+                     int* size1, const BYTE** data2, int* size2) {
+  unsigned int pos = r->tail & r->mask;
+  int size_first = r->mask + 1 - pos;
+  int size = ByteRingSize(r);
+  if (max_size > size) max_size = size;
+  *data1 = r->buf + pos;
+  *data2 = r->buf;
+  if (max_size > size_first) {
+    *size1 = size_first;
+    *size2 = max_size - size_first;
+  } else {
+    *size1 = max_size;
+    *size2 = 0;
+  }
+}
+
+void ByteRingPullToBuffer(BYTE_RING* r, void* buffer, int size) {
+  const BYTE *data1, *data2;
+  int size1, size2;
+  assert(size <= ByteRingSize(r));
+  ByteRingPeekMax(r, size, &data1, &size1, &data2, &size2);
+  if (size1) memcpy(buffer, data1, size1);
+  if (size2) memcpy(((BYTE *) buffer) + size1, data2, size2);
+  ByteRingPull(r, size);
+}
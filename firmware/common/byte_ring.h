@@ -0,0 +1,145 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+// A lock-free single-producer / single-consumer byte ring.
+//
+// Unlike BYTE_QUEUE, there is no shared size counter: the producer owns the
+// head index and the consumer owns the tail index, and each side only ever
+// reads the other's index. Both indices are free-running and are masked on
+// access, so the capacity must be a power of two. As long as every 16-bit load
+// and store is atomic (true on the PIC24), the producer and consumer may run
+// in different interrupt levels without raising IPL around ring operations.
+// Anything else shared between the two sides (e.g. sequences of pushes that
+// must appear together) still needs its own synchronization.
+
+#ifndef __BYTERING_H__
+#define __BYTERING_H__
+
+#include <assert.h>
+#include "GenericTypeDefs.h"
+
+typedef struct {
+  BYTE* buf;
+  unsigned int mask;           // capacity - 1
+  volatile unsigned int head;  // written only by the producer
+  volatile unsigned int tail;  // written only by the consumer
+  unsigned int overflows;      // pushes that did not fit, by the producer
+} BYTE_RING;
+
+#define DEFINE_STATIC_BYTE_RING(name, size)               \
+  static BYTE name##_buf[size] __attribute__((far));      \
+  static BYTE_RING name = { name##_buf, (size) - 1, 0, 0, 0 }
+
+// Keeps the compiler from moving buffer accesses across index updates.
+#define BYTE_RING_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+// Only safe when neither side is active.
+static inline void ByteRingClear(BYTE_RING* r) {
+  r->head = 0;
+  r->tail = 0;
+  r->overflows = 0;
+}
+
+static inline void ByteRingInit(BYTE_RING* r, BYTE* buf, int capacity) {
+  assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+  r->buf = buf;
+  r->mask = capacity - 1;
+  ByteRingClear(r);
+}
+
+static inline int ByteRingCapacity(const BYTE_RING* r) { return r->mask + 1; }
+static inline int ByteRingSize(const BYTE_RING* r) { return r->head - r->tail; }
+static inline int ByteRingRemaining(const BYTE_RING* r) {
+  return r->mask + 1 - (r->head - r->tail);
+}
+
+// Counts a push that was dropped for lack of room, in r->overflows. Producer
+// side, for producers that check the room themselves.
+static inline void ByteRingOverflow(BYTE_RING* r) {
+  ++r->overflows;
+}
+
+// Producer side.
+
+static inline BOOL ByteRingPushByte(BYTE_RING* r, BYTE b) {
+  unsigned int head = r->head;
+  if (head - r->tail > r->mask) {
+    ByteRingOverflow(r);
+    return FALSE;
+  }
+  r->buf[head & r->mask] = b;
+  BYTE_RING_BARRIER();
+  r->head = head + 1;
+  return TRUE;
+}
+
+// Pushes all of buf, or nothing if there is not enough room, which counts as
+// an overflow like a byte that does not fit.
+BOOL ByteRingPushBuffer(BYTE_RING* r, const void* buf, int len);
+
+// Returns the number of bytes that can be written contiguously at *data,
+// which may be less than ByteRingRemaining() when the free space wraps.
+// Bytes written there become visible to the consumer on ByteRingCommit().
+// Meant for ISRs that drain a hardware FIFO straight into the ring.
+int ByteRingReserve(BYTE_RING* r, BYTE** data);
+
+static inline void ByteRingCommit(BYTE_RING* r, int len) {
+  assert(len <= ByteRingRemaining(r));
+  BYTE_RING_BARRIER();
+  r->head += len;
+}
+
+// Consumer side.
+
+static inline BYTE ByteRingPullByte(BYTE_RING* r) {
+  unsigned int tail = r->tail;
+  BYTE ret;
+  assert(r->head != tail);
+  ret = r->buf[tail & r->mask];
+  BYTE_RING_BARRIER();
+  r->tail = tail + 1;
+  return ret;
+}
+
+// Returns the number of bytes that can be read contiguously at *data.
+// Meant for ISRs that feed a hardware FIFO straight from the ring, followed by
+// a single ByteRingPull().
+int ByteRingPeek(BYTE_RING* r, const BYTE** data);
+void ByteRingPeekMax(BYTE_RING* r, int max_size, const BYTE** data1,
+                     int* size1, const BYTE** data2, int* size2);
+
+static inline void ByteRingPull(BYTE_RING* r, int size) {
+  assert(size <= ByteRingSize(r));
+  BYTE_RING_BARRIER();
+  r->tail += size;
+}
+
+void ByteRingPullToBuffer(BYTE_RING* r, void* buffer, int size);
+
+#endif  // __BYTERING_H__
@@ -0,0 +1,442 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+// fwbench
+// Micro-benchmarks for the hot paths of the firmware, built for the host.
+// Usage: fwbench [filter]
+//
+// Runs every benchmark whose name contains filter (all of them by default)
+// and writes the results to stdout as JSON:
+// { "benchmarks": [ { "name": ..., "iterations": ..., "ns_per_op": ...,
+//                     "bytes_per_sec": ... }, ... ] }
+// The outgoing frame benchmarks add "bytes_per_frame".
+//
+// What an "op" is depends on the benchmark and is spelled out next to each
+// one below. Numbers are host numbers: they are meant for spotting
+// regressions between revisions, not for predicting timing on the PIC.
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "GenericTypeDefs.h"
+#include "byte_queue.h"
+#include "byte_ring.h"
+#include "protocol.h"
+#include "adc_filter.h"
+#include "ioio_file.h"
+#include "bootloader_defs.h"
+#include "connection_private.h"
+#include "host_stubs.h"
+
+#define MIN_TIME_NS 200000000ll  // run each benchmark for at least 200ms
+
+// Keeps the compiler from optimizing benchmarked work away.
+static volatile BYTE sink;
+
+////////////////////////////////////////////////////////////////////////////////
+// Byte queues
+
+static BYTE queue_buf[256];
+static BYTE ring_buf[256];
+static BYTE_QUEUE queue;
+static BYTE_RING ring;
+static BYTE chunk[64];
+
+// op: push and pull a single byte.
+static void BenchByteQueueByte(long iters) {
+  while (iters--) {
+    ByteQueuePushByte(&queue, (BYTE) iters);
+    sink = ByteQueuePullByte(&queue);
+  }
+}
+
+// op: push and pull a 64-byte buffer.
+static void BenchByteQueueBuffer(long iters) {
+  while (iters--) {
+    ByteQueuePushBuffer(&queue, chunk, sizeof chunk);
+    ByteQueuePullToBuffer(&queue, chunk, sizeof chunk);
+  }
+}
+
+// op: push and pull a single byte.
+static void BenchByteRingByte(long iters) {
+  while (iters--) {
+    ByteRingPushByte(&ring, (BYTE) iters);
+    sink = ByteRingPullByte(&ring);
+  }
+}
+
+// op: push and pull a 64-byte buffer.
+static void BenchByteRingBuffer(long iters) {
+  while (iters--) {
+    ByteRingPushBuffer(&ring, chunk, sizeof chunk);
+    ByteRingPullToBuffer(&ring, chunk, sizeof chunk);
+  }
+}
+
+// op: move 48 bytes the way the UART does: reserve / commit from the RX ISR,
+// then peek across the wrap point and pull from the main loop. 48 does not
+// divide the capacity, so most of the time the data wraps.
+static void BenchByteRingReservePeek(long iters) {
+  while (iters--) {
+    BYTE* data;
+    const BYTE *data1, *data2;
+    int size1, size2;
+    int n = 0;
+    while (n < 48) {
+      int size = ByteRingReserve(&ring, &data);
+      if (size > 48 - n) size = 48 - n;
+      memcpy(data, chunk, size);
+      ByteRingCommit(&ring, size);
+      n += size;
+    }
+    ByteRingPeekMax(&ring, 64, &data1, &size1, &data2, &size2);
+    sink = data1[0] + (size2 ? data2[0] : 0);
+    ByteRingPull(&ring, size1 + size2);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Incoming message parsing
+
+#define DIGITAL_OUT_PER_PACKET 32
+
+static BYTE digital_out_packet[DIGITAL_OUT_PER_PACKET * 2];
+static BYTE uart_data_msg[2 + 64];
+
+static void InitIncoming() {
+  int i;
+  INCOMING_MESSAGE msg;
+  for (i = 0; i < DIGITAL_OUT_PER_PACKET; ++i) {
+    msg.type = SET_DIGITAL_OUT_LEVEL;
+    msg.args.set_digital_out_level.pin = i + 1;
+    msg.args.set_digital_out_level.value = i & 1;
+    memcpy(digital_out_packet + i * 2, &msg,
+           1 + sizeof(SET_DIGITAL_OUT_LEVEL_ARGS));
+  }
+  msg.type = UART_DATA;
+  msg.args.uart_data.uart_num = 0;
+  msg.args.uart_data.size = 64 - 1;
+  memcpy(uart_data_msg, &msg, 2);
+  memset(uart_data_msg + 2, 0x55, 64);
+}
+
+// op: parse a 64-byte packet of SET_DIGITAL_OUT_LEVEL messages.
+static void BenchParseDigitalOut(long iters) {
+  while (iters--) {
+    AppProtocolHandleIncoming(digital_out_packet, sizeof digital_out_packet);
+  }
+}
+
+// op: parse a UART_DATA message with 64 bytes of data.
+static void BenchParseUartData(long iters) {
+  while (iters--) {
+    AppProtocolHandleIncoming(uart_data_msg, sizeof uart_data_msg);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Outgoing report serialization
+// The outgoing queue is flushed to the (stub) connection every 64 ops, and the
+// flushing is included in the measurement.
+
+void _CRCInterrupt();
+
+static void Flush() {
+  // The first call releases what was sent last time, the second sends the rest.
+  AppProtocolTasks(0);
+  AppProtocolTasks(0);
+}
+
+// op: serialize a REPORT_DIGITAL_IN_STATUS message.
+static void BenchReportDigitalIn(long iters) {
+  OUTGOING_MESSAGE msg;
+  msg.type = REPORT_DIGITAL_IN_STATUS;
+  msg.args.report_digital_in_status.pin = 5;
+  while (iters--) {
+    msg.args.report_digital_in_status.level = iters & 1;
+    AppProtocolSendMessage(&msg);
+    if ((iters & 63) == 0) Flush();
+  }
+}
+
+// op: serialize a REPORT_ANALOG_IN_STATUS message for 16 channels, starting
+// from the ADC's done interrupt.
+static void BenchReportAnalogIn(long iters) {
+  int i;
+  for (i = 0; i < 16; ++i) ADC1BUF[i] = i * 64 + i;
+  AD1CSSL = 0xFFFF;
+  while (iters--) {
+    _CRCInterrupt();
+    if ((iters & 63) == 0) Flush();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Outgoing frames
+// A backlog of outgoing messages, kept at TX_BACKLOG bytes, drained by
+// AppProtocolTasks() one frame at a time across the wrap point of the 8KB
+// tx_queue, with and without sending the parts on both sides of it together.
+// These report the mean frame size as bytes_per_frame: the fewer and fuller
+// the frames, the less each one costs on the link.
+
+#define TX_BACKLOG 1024
+
+static BYTE tx_payload[64];
+
+// op: top the backlog up with 66-byte UART_DATA messages, send a frame.
+static void RunTxFrames(long iters, int max_packet, BOOL split,
+                        int gather_size) {
+  OUTGOING_MESSAGE msg;
+  int prev_max_packet = host_max_packet;
+  unsigned long in_flight = 0;
+  msg.type = UART_DATA;
+  msg.args.uart_data.uart_num = 0;
+  msg.args.uart_data.size = sizeof tx_payload - 1;
+  host_max_packet = max_packet;
+  host_split_send = split;
+  host_gather_size = gather_size;
+  AppProtocolInit(0);
+  host_bytes_sent = 0;
+  host_frames_sent = 0;
+  while (iters--) {
+    // The last frame stays queued until the next AppProtocolTasks().
+    while (AppProtocolTxQueueSize() - in_flight < TX_BACKLOG) {
+      AppProtocolSendMessageWithVarArg(&msg, tx_payload, sizeof tx_payload);
+    }
+    in_flight = host_bytes_sent;
+    AppProtocolTasks(0);
+    in_flight = host_bytes_sent - in_flight;
+  }
+  host_max_packet = prev_max_packet;
+  host_split_send = TRUE;
+  host_gather_size = 0;
+  AppProtocolInit(0);
+}
+
+// Bluetooth: 242-byte packets.
+static void BenchTxFramesBt(long iters) {
+  RunTxFrames(iters, 242, TRUE, CONNECTION_GATHER_SIZE);
+}
+
+static void BenchTxFramesBtNoSplit(long iters) {
+  RunTxFrames(iters, 242, FALSE, 0);
+}
+
+// ADB and accessory: no packet limit. Also with a gather buffer 4 times as
+// large, to see what it would gain.
+static void BenchTxFramesAdb(long iters) {
+  RunTxFrames(iters, INT_MAX, TRUE, CONNECTION_GATHER_SIZE);
+}
+
+static void BenchTxFramesAdbGather1024(long iters) {
+  RunTxFrames(iters, INT_MAX, TRUE, 1024);
+}
+
+static void BenchTxFramesAdbNoSplit(long iters) {
+  RunTxFrames(iters, INT_MAX, FALSE, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Analog input filters
+// These run in the ADC's done interrupt, once per scanned channel per scan.
+
+#define FILTER_SAMPLES 4096
+
+static WORD filter_input[FILTER_SAMPLES];
+static ADC_FILTER filters[16];
+
+// A 16-tap low-pass, Q14, summing to 1.0.
+static const SHORT fir_taps[ADC_FILTER_MAX_LENGTH] = {
+  112, 244, 512, 872, 1264, 1616, 1856, 1716,
+  1716, 1856, 1616, 1264, 872, 512, 244, 112
+};
+
+// A slow sine over the whole range, plus noise, plus the occasional spike.
+static void InitFilterInput() {
+  int i;
+  srand(1);
+  for (i = 0; i < FILTER_SAMPLES; ++i) {
+    double v = 512 + 400 * sin(i * 0.01) + (rand() % 65) - 32;
+    if (rand() % 100 == 0) v = rand() % 1024;
+    filter_input[i] = v < 0 ? 0 : v > 1023 ? 1023 : (WORD) v;
+  }
+}
+
+static void RunFilters(long iters, int type, int param) {
+  int i;
+  for (i = 0; i < 16; ++i) ADCFilterSet(&filters[i], type, param, fir_taps);
+  while (iters--) {
+    const WORD x = filter_input[iters & (FILTER_SAMPLES - 1)];
+    for (i = 0; i < 16; ++i) sink = ADCFilterApply(&filters[i], x);
+  }
+}
+
+// op: filter one sample on each of 16 channels.
+static void BenchFilterBoxcar(long iters) {
+  RunFilters(iters, ADC_FILTER_BOXCAR, 16);
+}
+
+// op: filter one sample on each of 16 channels.
+static void BenchFilterIIR(long iters) {
+  RunFilters(iters, ADC_FILTER_IIR, 4);
+}
+
+// op: filter one sample on each of 16 channels.
+static void BenchFilterFIR(long iters) {
+  RunFilters(iters, ADC_FILTER_FIR, 16);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Image block decoding
+
+#define IMAGE_BLOCKS 1024
+#define IMAGE_SIZE (8 + IMAGE_BLOCKS * 196)
+
+static BYTE image[IMAGE_SIZE];
+
+// Same format as produced by tools/hex2ioio.
+static void InitImage() {
+  static const BYTE header[8] = { 'I', 'O', 'I', 'O', 1, 0, 0, 0 };
+  BYTE* p = image;
+  DWORD address = BOOTLOADER_MIN_APP_ADDRESS;
+  int i;
+  memcpy(p, header, sizeof header);
+  p += sizeof header;
+  for (i = 0; i < IMAGE_BLOCKS; ++i) {
+    memcpy(p, &address, 4);
+    memset(p + 4, i, 192);
+    p += 196;
+    address += 0x80;
+  }
+}
+
+// op: decode a whole image of IMAGE_BLOCKS blocks, fed in 64-byte chunks.
+static void BenchIOIOFile(long iters) {
+  while (iters--) {
+    const BYTE* p = image;
+    int remaining = sizeof image;
+    IOIOFileInit();
+    while (remaining) {
+      int size = remaining < 64 ? remaining : 64;
+      IOIOFileHandleBuffer(p, size);
+      p += size;
+      remaining -= size;
+    }
+    sink = IOIOFileDone();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct {
+  const char* name;
+  void (*run)(long iters);
+  int bytes_per_op;  // 0 to count what went out through the connection.
+  BOOL frames;  // Whether to report bytes_per_frame.
+} BENCHMARK;
+
+static const BENCHMARK benchmarks[] = {
+  { "byte_queue_byte",              BenchByteQueueByte,   1 },
+  { "byte_queue_buffer_64",         BenchByteQueueBuffer, 64 },
+  { "byte_ring_byte",               BenchByteRingByte,    1 },
+  { "byte_ring_buffer_64",          BenchByteRingBuffer,  64 },
+  { "byte_ring_reserve_peek_48",    BenchByteRingReservePeek, 48 },
+  { "parse_digital_out_packet_64",  BenchParseDigitalOut, sizeof digital_out_packet },
+  { "parse_uart_data_64",           BenchParseUartData,   sizeof uart_data_msg },
+  { "report_digital_in",            BenchReportDigitalIn, 1 + sizeof(REPORT_DIGITAL_IN_STATUS_ARGS) },
+  { "report_analog_in_16ch",        BenchReportAnalogIn,  1 + 16 + 4 },
+  { "tx_frames_bt",                 BenchTxFramesBt,            0, TRUE },
+  { "tx_frames_bt_nosplit",         BenchTxFramesBtNoSplit,     0, TRUE },
+  { "tx_frames_adb",                BenchTxFramesAdb,           0, TRUE },
+  { "tx_frames_adb_gather1024",     BenchTxFramesAdbGather1024, 0, TRUE },
+  { "tx_frames_adb_nosplit",        BenchTxFramesAdbNoSplit,    0, TRUE },
+  { "analog_filter_boxcar16_16ch",  BenchFilterBoxcar,    16 * 2 },
+  { "analog_filter_iir_16ch",       BenchFilterIIR,       16 * 2 },
+  { "analog_filter_fir16_16ch",     BenchFilterFIR,       16 * 2 },
+  { "ioio_file_decode",             BenchIOIOFile,        IMAGE_SIZE },
+};
+
+static long long NowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+// Doubles the iteration count until a run takes at least MIN_TIME_NS.
+static void RunBenchmark(const BENCHMARK* b, int first) {
+  long iters = 1;
+  long long elapsed;
+  double bytes;
+  for (;;) {
+    long long start = NowNs();
+    b->run(iters);
+    elapsed = NowNs() - start;
+    if (elapsed >= MIN_TIME_NS) break;
+    iters *= 2;
+  }
+  bytes = b->bytes_per_op ? (double) b->bytes_per_op * iters
+                          : (double) host_bytes_sent;
+  printf("%s    { \"name\": \"%s\", \"iterations\": %ld, \"ns_per_op\": %.2f, "
+         "\"bytes_per_sec\": %.0f",
+         first ? "" : ",\n", b->name, iters, (double) elapsed / iters,
+         bytes * 1e9 / elapsed);
+  if (b->frames) {
+    printf(", \"bytes_per_frame\": %.1f",
+           (double) host_bytes_sent / host_frames_sent);
+  }
+  printf(" }");
+  fflush(stdout);
+}
+
+int main(int argc, char* argv[]) {
+  const char* filter = argc > 1 ? argv[1] : "";
+  int first = 1;
+  unsigned int i;
+
+  ByteQueueInit(&queue, queue_buf, sizeof queue_buf);
+  ByteRingInit(&ring, ring_buf, sizeof ring_buf);
+  InitIncoming();
+  InitImage();
+  InitFilterInput();
+  AppProtocolInit(0);
+
+  printf("{\n  \"benchmarks\": [\n");
+  for (i = 0; i < sizeof benchmarks / sizeof benchmarks[0]; ++i) {
+    if (!strstr(benchmarks[i].name, filter)) continue;
+    RunBenchmark(&benchmarks[i], first);
+    first = 0;
+  }
+  printf("\n  ]\n}\n");
+  return 0;
+}
@@ -0,0 +1,335 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+// deltatest
+// Round trip of the delta encoded analog frames of app_layer_v1/adc.c, built
+// for the host, through a decoder that follows readDelta() and the
+// REPORT_ANALOG_IN_STATUS handling of IOIOProtocol.java.
+// Usage: deltatest
+//
+// Runs the scan interrupts over known samples, drains what the protocol sends
+// after each scan and decodes it, checking that the client ends up with the
+// sampled values. Covers keyframes, channels skipped for being within their
+// deadband, and frames dropped because tx_queue was full, which must leave the
+// encoder where the decoder is.
+// Prints every failed check to stderr, and exits with 1 if there were any.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <p24Fxxxx.h>
+
+#include "GenericTypeDefs.h"
+#include "protocol.h"
+#include "protocol_defs.h"
+#include "adc.h"
+#include "host_stubs.h"
+
+// The analog pins scanned, which the host stubs map to channels 0 to 3.
+#define FIRST_PIN 31
+#define NUM_CHANNELS 4
+#define NUM_SCANS 40
+#define KEYFRAME_INTERVAL 4
+#define DEADBAND 3
+
+static int failures;
+
+#define CHECK(cond)                                                   \
+  do {                                                                \
+    if (!(cond)) {                                                    \
+      fprintf(stderr, "%s:%d: %s failed\n", __FILE__, __LINE__, #cond); \
+      ++failures;                                                     \
+    }                                                                 \
+  } while (0)
+
+void _T3Interrupt();
+void _CRCInterrupt();
+
+////////////////////////////////////////////////////////////////////////////////
+// The client side
+
+// What was sent and not decoded yet, from sent_pos on.
+static BYTE sent[16384];
+static int sent_size;
+static int sent_pos;
+
+static void Sent(const void* data, int size) {
+  if (sent_size + size > (int) sizeof sent) {
+    fprintf(stderr, "deltatest: sent too much\n");
+    exit(1);
+  }
+  memcpy(sent + sent_size, data, size);
+  sent_size += size;
+}
+
+// The format, and what the decoder knows of each pin of it.
+static int num_pins;
+static BOOL delta_frames;
+static BOOL extended_frames;
+static int last_value[16];
+static DWORD bits;
+static int num_bits;
+
+// The last REPORT_ANALOG_IN_STATUS decoded: the pins it had, and those of
+// them sent as whole values rather than differences.
+typedef struct {
+  WORD present;
+  WORD literal;
+} FRAME;
+
+static int ReadByte() {
+  CHECK(sent_pos < sent_size);
+  return sent_pos < sent_size ? sent[sent_pos++] : 0;
+}
+
+static int ReadBits(int count) {
+  int result;
+  while (num_bits < count) {
+    bits |= (DWORD) ReadByte() << num_bits;
+    num_bits += 8;
+  }
+  result = bits & ((1 << count) - 1);
+  bits >>= count;
+  num_bits -= count;
+  return result;
+}
+
+static int SignExtend(int value, int num_bits) {
+  return value & (1 << (num_bits - 1)) ? value - (1 << num_bits) : value;
+}
+
+static void ReadDelta(int i, FRAME* frame) {
+  if (ReadBits(1) == 0) {
+    last_value[i] += SignExtend(ReadBits(4), 4);
+  } else if (ReadBits(1) == 0) {
+    last_value[i] += SignExtend(ReadBits(7), 7);
+  } else {
+    last_value[i] = ReadBits(10);
+    frame->literal |= 1 << i;
+  }
+  frame->present |= 1 << i;
+}
+
+static void ReadAnalogInStatus(FRAME* frame) {
+  WORD due = (1 << num_pins) - 1;
+  int i;
+  bits = 0;
+  num_bits = 0;
+  frame->present = 0;
+  frame->literal = 0;
+  if (extended_frames) {
+    due = ReadByte();
+    due |= ReadByte() << 8;
+  }
+  for (i = 0; i < num_pins; ++i) {
+    if (due & (1 << i)) ReadDelta(i, frame);
+  }
+}
+
+// Decodes everything sent since the last call. Returns the number of
+// REPORT_ANALOG_IN_STATUS messages, the last of which goes to *frame.
+static int Decode(FRAME* frame) {
+  int frames = 0;
+  int i;
+  while (sent_pos < sent_size) {
+    switch (ReadByte()) {
+      case ESTABLISH_CONNECTION:
+        sent_pos += sizeof(ESTABLISH_CONNECTION_ARGS);
+        break;
+
+      case REPORT_DIGITAL_IN_STATUS:
+        sent_pos += sizeof(REPORT_DIGITAL_IN_STATUS_ARGS);
+        break;
+
+      case REPORT_ANALOG_IN_FORMAT:
+        i = ReadByte();
+        num_pins = i & 0x3F;
+        delta_frames = (i & 0x40) != 0;
+        extended_frames = (i & 0x80) != 0;
+        CHECK(num_pins == NUM_CHANNELS);
+        for (i = 0; i < num_pins; ++i) {
+          CHECK(ReadByte() == FIRST_PIN + i);
+        }
+        break;
+
+      case REPORT_ANALOG_IN_STATUS:
+        CHECK(delta_frames);
+        ReadAnalogInStatus(frame);
+        ++frames;
+        break;
+
+      default:
+        CHECK(!"unexpected message");
+        sent_pos = sent_size;
+    }
+  }
+  sent_pos = sent_size = 0;
+  return frames;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The device side
+
+// Runs a scan of values, as the timer and the scan done interrupts would.
+static void Scan(const WORD* values) {
+  int i;
+  _T3Interrupt();
+  for (i = 0; i < NUM_CHANNELS; ++i) ADC1BUF[i] = values[i];
+  _CRCInterrupt();
+}
+
+// Sends all that is queued, as the main loop would.
+static void Drain() {
+  int i;
+  for (i = 0; AppProtocolTxQueueSize() && i < 1000; ++i) AppProtocolTasks(0);
+  CHECK(AppProtocolTxQueueSize() == 0);
+}
+
+// Fills tx_queue up, so that the next frame does not fit.
+static void FillTxQueue() {
+  OUTGOING_MESSAGE msg;
+  int size;
+  msg.type = REPORT_DIGITAL_IN_STATUS;
+  msg.args.report_digital_in_status.pin = 0;
+  msg.args.report_digital_in_status.level = 0;
+  do {
+    size = AppProtocolTxQueueSize();
+    AppProtocolSendMessage(&msg);
+  } while (AppProtocolTxQueueSize() > size);
+}
+
+// Samples of scan n: small steps, steps for the 7-bit code, jumps needing the
+// whole value, and a constant, which only a keyframe sends whole.
+static void Samples(int n, WORD* values) {
+  values[0] = 300 + 3 * (n % 8);
+  values[1] = 500 + 40 * (n % 5);
+  values[2] = (n * 389) % 1024;
+  values[3] = 700;
+}
+
+static void Start(int keyframe_interval, int deadband) {
+  int i;
+  ADCInit();
+  AppProtocolInit(0);
+  sent_pos = sent_size = 0;
+  ADCSetEncoding(1, keyframe_interval);
+  for (i = 0; i < NUM_CHANNELS; ++i) {
+    if (deadband) ADCSetDeadband(FIRST_PIN + i, deadband);
+    ADCSetScan(FIRST_PIN + i, 1);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Tests
+
+// Every scan is sent, with every channel, and every KEYFRAME_INTERVAL'th frame
+// is a keyframe. The frame due to be a keyframe is dropped: the next one sent
+// takes its place.
+static void TestKeyframes() {
+  const int drop = 2 * KEYFRAME_INTERVAL - 1;
+  WORD values[NUM_CHANNELS];
+  FRAME frame;
+  int frames_sent = 0;
+  int n, i;
+  Start(KEYFRAME_INTERVAL, 0);
+  for (n = 0; n < NUM_SCANS; ++n) {
+    Samples(n, values);
+    if (n == drop) FillTxQueue();
+    Scan(values);
+    Drain();
+    if (n == drop) {
+      CHECK(Decode(&frame) == 0);
+      continue;
+    }
+    CHECK(Decode(&frame) == 1);
+    CHECK(frame.present == (1 << NUM_CHANNELS) - 1);
+    for (i = 0; i < NUM_CHANNELS; ++i) CHECK(last_value[i] == values[i]);
+    // The first frame has no previous values to go from.
+    CHECK(!!(frame.literal & (1 << 3))
+          == (frames_sent == 0
+              || (frames_sent + 1) % KEYFRAME_INTERVAL == 0));
+    ++frames_sent;
+  }
+}
+
+// A channel is only sent when it moved by more than DEADBAND from the value
+// last sent, and a scan where none did sends nothing. No keyframes, so that a
+// dropped frame would throw the decoder off for good.
+static void TestDeadband() {
+  WORD values[NUM_CHANNELS];
+  FRAME frame;
+  BOOL known = FALSE;
+  int drops = 0;
+  int n, i;
+  Start(0, DEADBAND);
+  for (n = 0; n < NUM_SCANS; ++n) {
+    WORD expected = 0;
+    int frames;
+    Samples(n, values);
+    for (i = 0; i < NUM_CHANNELS; ++i) {
+      if (!known || abs(values[i] - last_value[i]) > DEADBAND) {
+        expected |= 1 << i;
+      }
+    }
+    // Drop frames which move the first channel, so that the decoder has a
+    // stale value if the encoder takes them as sent.
+    if (n > 0 && (expected & 1) && drops < 3) {
+      FillTxQueue();
+      Scan(values);
+      Drain();
+      CHECK(Decode(&frame) == 0);
+      ++drops;
+      continue;
+    }
+    Scan(values);
+    Drain();
+    frames = Decode(&frame);
+    CHECK(frames == (expected != 0));
+    if (!frames) continue;
+    CHECK(frame.present == expected);
+    for (i = 0; i < NUM_CHANNELS; ++i) {
+      CHECK(abs(values[i] - last_value[i]) <= DEADBAND);
+      if (expected & (1 << i)) CHECK(last_value[i] == values[i]);
+    }
+    known = TRUE;
+  }
+  CHECK(drops == 3);
+}
+
+int main() {
+  host_sent = Sent;
+  TestKeyframes();
+  TestDeadband();
+  if (failures) {
+    fprintf(stderr, "deltatest: %d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("deltatest: all passed\n");
+  return 0;
+}
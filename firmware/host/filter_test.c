@@ -0,0 +1,132 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+// filtertest
+// Tests of the fixed-point analog filters (app_layer_v1/adc_filter.h), built
+// for the host.
+// Usage: filtertest
+//
+// Runs each filter over a noisy sine against a floating-point reference,
+// printing its largest error to stderr. Exits with 1 if any of them is off by
+// more than TOLERANCE.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "GenericTypeDefs.h"
+#include "adc_filter.h"
+
+#define SAMPLES 4096
+#define TOLERANCE 1.0  // LSB
+
+static WORD input[SAMPLES];
+
+// A 16-tap low-pass, Q14, summing to 1.0.
+static const SHORT fir_taps[ADC_FILTER_MAX_LENGTH] = {
+  112, 244, 512, 872, 1264, 1616, 1856, 1716,
+  1716, 1856, 1616, 1264, 872, 512, 244, 112
+};
+
+// A slow sine over the whole range, plus noise, plus the occasional spike.
+static void InitInput() {
+  int i;
+  srand(1);
+  for (i = 0; i < SAMPLES; ++i) {
+    double v = 512 + 400 * sin(i * 0.01) + (rand() % 65) - 32;
+    if (rand() % 100 == 0) v = rand() % 1024;
+    input[i] = v < 0 ? 0 : v > 1023 ? 1023 : (WORD) v;
+  }
+}
+
+// Returns the largest difference between the filter and the reference, in LSB.
+static double FilterError(int type, int param) {
+  ADC_FILTER f;
+  double history[ADC_FILTER_MAX_LENGTH];
+  double state = input[0];
+  double max_error = 0;
+  int i, j;
+  ADCFilterSet(&f, type, param, fir_taps);
+  for (j = 0; j < ADC_FILTER_MAX_LENGTH; ++j) history[j] = input[0];
+  for (i = 0; i < SAMPLES; ++i) {
+    const WORD x = input[i];
+    double expected = 0;
+    double error;
+    memmove(history + 1, history, sizeof history - sizeof history[0]);
+    history[0] = x;
+    switch (type) {
+      case ADC_FILTER_BOXCAR:
+        for (j = 0; j < param; ++j) expected += history[j];
+        expected /= param;
+        break;
+
+      case ADC_FILTER_IIR:
+        state += (x - state) / (1 << param);
+        expected = state;
+        break;
+
+      case ADC_FILTER_FIR:
+        for (j = 0; j < param; ++j) expected += history[j] * fir_taps[j];
+        expected /= 1 << 14;
+        expected = expected < 0 ? 0 : expected > 1023 ? 1023 : expected;
+        break;
+    }
+    error = fabs(ADCFilterApply(&f, x) - expected);
+    if (error > max_error) max_error = error;
+  }
+  return max_error;
+}
+
+int main() {
+  static const struct { const char* name; int type; int param; } checks[] = {
+    { "boxcar_2",  ADC_FILTER_BOXCAR, 2 },
+    { "boxcar_16", ADC_FILTER_BOXCAR, 16 },
+    { "iir_1",     ADC_FILTER_IIR,    1 },
+    { "iir_4",     ADC_FILTER_IIR,    4 },
+    { "iir_15",    ADC_FILTER_IIR,    15 },
+    { "fir_1",     ADC_FILTER_FIR,    1 },
+    { "fir_16",    ADC_FILTER_FIR,    16 },
+  };
+  int failures = 0;
+  unsigned int i;
+  InitInput();
+  for (i = 0; i < sizeof checks / sizeof checks[0]; ++i) {
+    double error = FilterError(checks[i].type, checks[i].param);
+    fprintf(stderr, "filter %-10s max error %.3f LSB%s\n", checks[i].name,
+            error, error > TOLERANCE ? "  FAIL" : "");
+    if (error > TOLERANCE) ++failures;
+  }
+  if (failures) {
+    fprintf(stderr, "filtertest: %d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("filtertest: all passed\n");
+  return 0;
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+// No-op implementations of everything the host-built firmware modules call
+// but which is not part of the host build: the peripheral drivers, the
+// connection layer and Flash.
+// The connection accepts whatever it is given and counts it, so that the
+// outgoing queue always drains.
+
+#include "host_stubs.h"
+
+#include "GenericTypeDefs.h"
+#include "connection.h"
+#include "connection_private.h"
+#include "features.h"
+#include "digital.h"
+#include "pwm.h"
+#include "reflex.h"
+#include "scheduler.h"
+#include "uart.h"
+#include "spi.h"
+#include "i2c.h"
+#include "icsp.h"
+#include "incap.h"
+#include "pins.h"
+#include "flash.h"
+
+int host_max_packet = 0x4000;
+BOOL host_split_send = TRUE;
+int host_gather_size;
+unsigned long host_bytes_sent;
+unsigned long host_frames_sent;
+void (*host_sent)(const void* data, int size);
+unsigned long host_flash_blocks_written;
+
+const char bootloader_version[8] = "HOST0000";
+const char hardware_version[8] = "HOST0000";
+
+// connection
+BOOL ConnectionCanSend(CHANNEL_HANDLE ch) { return TRUE; }
+void ConnectionCloseChannel(CHANNEL_HANDLE ch) {}
+int ConnectionGetMaxPacket(CHANNEL_HANDLE ch) { return host_max_packet; }
+int ConnectionSendSplit(CHANNEL_HANDLE ch, const void *data1, int size1,
+                        const void *data2, int size2) {
+  static uint8_t gather_buf[HOST_MAX_GATHER_SIZE];
+  const void *data;
+  int size = size1 + size2;
+  if (!host_split_send) {
+    size = size1;
+    if (host_sent) host_sent(data1, size1);
+  } else if (host_gather_size) {
+    size = ConnectionGather(gather_buf, host_gather_size, &data,
+                            data1, size1, data2, size2);
+    if (host_sent) host_sent(data, size);
+  } else if (host_sent) {
+    host_sent(data1, size1);
+    host_sent(data2, size2);
+  }
+  host_bytes_sent += size;
+  ++host_frames_sent;
+  return size;
+}
+
+// features
+void HardReset() {}
+void SoftReset() {}
+void CheckInterface(const BYTE interface_id[8]) {}
+void GetCapabilities() {}
+
+// pins
+int PinFromAnalogChannel(int ch) { return ch + 31; }
+int PinToAnalogChannel(int pin) { return pin - 31; }
+void PinSetTris(int pin, int val) {}
+
+// digital
+void SetPinDigitalOut(int pin, int value, int open_drain) {}
+void SetDigitalOutLevel(int pin, int value) {}
+void SetDigitalOutLevels(int first_pin, int num_bytes,
+                         const BYTE* mask_and_value) {}
+void SetPinDigitalIn(int pin, int pull) {}
+void SetChangeNotify(int pin, int changeNotify) {}
+void SetDigitalInBatching(int enable) {}
+void RegisterPeriodicDigitalSampling(int pin, int freq_scale) {}
+void DigitalTasks() {}
+
+// encoder
+void EncoderConfig(int encoder_num, int enable, int pin_a, int pin_b,
+                   int period) {}
+void EncoderRead(int encoder_num) {}
+void EncoderTasks() {}
+
+// analog
+void SetPinAnalogIn(int pin) {}
+void SetPinCapSense(int pin) {}
+
+// pwm
+void SetPinPwm(int pin, int pwm_num, int enable) {}
+void SetPwmDutyCycle(int pwm_num, int dc, int fraction) {}
+void SetPwmPeriod(int pwm_num, int period, int scale) {}
+void PWMSequencerConfig(int pwm_num, int enable, int loop, int periods) {}
+void PWMSequencerData(int pwm_num, const void* data, int num_steps) {}
+void PWMTasks() {}
+void SetPwmSync(int pwm_num, int sync_num) {}
+void PWMGroupUpdate(int mask, const void* data) {}
+
+// reflex
+void ReflexSet(int reflex_num, int condition, int pin, int level, int low,
+               int high, int action, int target, int value, int fraction) {}
+void ReflexAnalogUpdate(const volatile unsigned int* buf, unsigned int mask) {}
+
+// control
+void ControlConfig(int loop_num, int source, int input, int pwm_num,
+                   WORD out_min, WORD out_max, WORD report_interval) {}
+void ControlSetParams(int loop_num, LONG setpoint, SHORT kp, SHORT ki,
+                      SHORT kd, int shift) {}
+void ControlUpdate(const volatile unsigned int* buf, unsigned int mask) {}
+
+// scheduler
+void SchedulerConfig(int schedule_num, int enable, DWORD period) {}
+void SchedulerAppend(int schedule_num, const void* data, int size) {}
+void SchedulerTasks() {}
+
+// uart
+void UARTConfig(int uart_num, int rate, int speed4x, int two_stop_bits,
+                int parity) {}
+void UARTTransmit(int uart_num, const void* data, int size) {}
+void UARTSetRxAggregation(int uart_num, int min_batch, int max_frame,
+                          unsigned int idle_timeout_100us,
+                          unsigned int max_latency_ms) {}
+void UARTTasks() {}
+void SetPinUart(int pin, int uart_num, int dir, int enable) {}
+
+// spi
+void SPIConfigMaster(int spi_num, int scale, int div, int smp_end, int clk_edge,
+                     int clk_pol) {}
+void SPITransmit(int spi_num, int dest, const void* data, int data_size,
+                 int total_size, int trim_rx) {}
+void SPITasks() {}
+void SetPinSpi(int pin, int spi_num, int mode, int enable) {}
+
+// i2c
+void I2CConfigMaster(int i2c_num, int rate, int smbus_levels) {}
+void I2CWriteRead(int i2c_num, unsigned int addr, const void* data,
+                  int write_bytes, int read_bytes) {}
+void I2CTasks() {}
+
+// icsp
+void ICSPConfigure(int enable) {}
+void ICSPEnter() {}
+void ICSPExit() {}
+void ICSPSix(DWORD inst) {}
+void ICSPRegout() {}
+void ICSPTasks() {}
+
+// incap
+void InCapConfig(int incap_num, int double_prec, int mode, int clock) {}
+void SetPinInCap(int pin, int incap_num, int enable) {}
+void InCapSetRearmPeriod(int incap_num, int period) {}
+void InCapSetGate(int incap_num, int prescale, int gate) {}
+void InCapTasks() {}
+
+// flash
+BOOL FlashErasePage(DWORD address) { return TRUE; }
+BOOL FlashWriteBlock(DWORD address, const BYTE block[192]) {
+  ++host_flash_blocks_written;
+  return TRUE;
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+// Knobs and counters of the stubbed-out parts of the firmware in a host build.
+
+#ifndef __HOSTSTUBS_H__
+#define __HOSTSTUBS_H__
+
+#include "GenericTypeDefs.h"
+
+// Returned by ConnectionGetMaxPacket().
+extern int host_max_packet;
+// How ConnectionSendSplit() behaves: with host_split_send cleared, it only
+// sends the first part, like a plain ConnectionSend() of the contiguous data.
+// Otherwise, with a host_gather_size it gathers both parts into a buffer of
+// that size with ConnectionGather(), like the USB and Bluetooth transports
+// (up to HOST_MAX_GATHER_SIZE), and with 0 it sends both parts whole.
+#define HOST_MAX_GATHER_SIZE 1024
+extern BOOL host_split_send;
+extern int host_gather_size;
+// Total number of bytes sent by, and calls to, ConnectionSendSplit().
+extern unsigned long host_bytes_sent;
+extern unsigned long host_frames_sent;
+// If set, gets the bytes ConnectionSendSplit() sends, in order.
+extern void (*host_sent)(const void* data, int size);
+// Total number of FlashWriteBlock() calls.
+extern unsigned long host_flash_blocks_written;
+
+#endif  // __HOSTSTUBS_H__
@@ -0,0 +1,210 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+// ringtest
+// Tests of the BYTE_RING (common/byte_ring.h), built for the host.
+// Usage: ringtest
+//
+// Prints every failed check to stderr, and exits with 1 if there were any.
+// The free-running head and tail are started just short of UINT_MAX, so that
+// every test also runs them across the point where they wrap around.
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "GenericTypeDefs.h"
+#include "byte_ring.h"
+
+#define CAPACITY 16
+
+static int failures;
+
+#define CHECK(cond)                                                   \
+  do {                                                                \
+    if (!(cond)) {                                                    \
+      fprintf(stderr, "%s:%d: %s failed\n", __FILE__, __LINE__, #cond); \
+      ++failures;                                                     \
+    }                                                                 \
+  } while (0)
+
+static BYTE buf[CAPACITY];
+static BYTE_RING ring;
+
+// An empty ring whose indices wrap around after offset more bytes go through.
+// As CAPACITY divides UINT_MAX + 1, that is also where they wrap around buf.
+static void Reset(unsigned int offset) {
+  ByteRingInit(&ring, buf, CAPACITY);
+  memset(buf, 0xEE, sizeof buf);
+  ring.head = ring.tail = UINT_MAX - offset + 1;
+}
+
+static void TestEmpty() {
+  const BYTE *data1, *data2;
+  int size1, size2;
+  Reset(3);
+  CHECK(ByteRingSize(&ring) == 0);
+  CHECK(ByteRingRemaining(&ring) == CAPACITY);
+  CHECK(ByteRingPeek(&ring, &data1) == 0);
+  ByteRingPeekMax(&ring, CAPACITY, &data1, &size1, &data2, &size2);
+  CHECK(size1 == 0 && size2 == 0);
+}
+
+static void TestFull() {
+  BYTE in[CAPACITY + 1];
+  BYTE out[CAPACITY];
+  BYTE* data;
+  int i;
+  for (i = 0; i < sizeof in; ++i) in[i] = i;
+  Reset(5);
+  CHECK(ByteRingPushBuffer(&ring, in, CAPACITY + 1) == FALSE);
+  CHECK(ByteRingSize(&ring) == 0);
+  CHECK(ByteRingPushBuffer(&ring, in, CAPACITY - 1) == TRUE);
+  CHECK(ByteRingPushByte(&ring, CAPACITY - 1) == TRUE);
+  CHECK(ByteRingSize(&ring) == CAPACITY);
+  CHECK(ByteRingRemaining(&ring) == 0);
+  CHECK(ByteRingPushByte(&ring, 0xAA) == FALSE);
+  CHECK(ByteRingPushBuffer(&ring, in, 1) == FALSE);
+  CHECK(ByteRingReserve(&ring, &data) == 0);
+  // Nothing was overwritten by the failed pushes.
+  ByteRingPullToBuffer(&ring, out, CAPACITY);
+  CHECK(memcmp(in, out, CAPACITY) == 0);
+  CHECK(ByteRingSize(&ring) == 0);
+  CHECK(ring.head == ring.tail);
+}
+
+// Bytes come out in order as the indices go around, whatever the mix of
+// single-byte and buffer operations.
+static void TestWraparound() {
+  BYTE in[7], out[7];
+  unsigned int next_in = 0, next_out = 0;
+  int round, i;
+  Reset(20);
+  for (round = 0; round < 50; ++round) {
+    for (i = 0; i < sizeof in; ++i) in[i] = next_in++;
+    CHECK(ByteRingPushBuffer(&ring, in, sizeof in));
+    CHECK(ByteRingPushByte(&ring, next_in++));
+    CHECK(ByteRingSize(&ring) == 8);
+    ByteRingPullToBuffer(&ring, out, sizeof out);
+    for (i = 0; i < sizeof out; ++i) CHECK(out[i] == (BYTE) next_out++);
+    CHECK(ByteRingPullByte(&ring) == (BYTE) next_out++);
+    CHECK(ByteRingSize(&ring) == 0);
+  }
+  CHECK(ring.head < 1000);  // went through UINT_MAX
+}
+
+// Reserve / commit, as the RX ISRs use it, hands out the free space in at most
+// two contiguous pieces.
+static void TestReserveAcrossWrap() {
+  BYTE* data;
+  BYTE out[12];
+  int n, i;
+  Reset(4);  // 4 bytes before the end of buf
+  n = ByteRingReserve(&ring, &data);
+  CHECK(n == 4);
+  CHECK(data == buf + CAPACITY - 4);
+  for (i = 0; i < n; ++i) data[i] = i;
+  ByteRingCommit(&ring, n);
+  n = ByteRingReserve(&ring, &data);
+  CHECK(n == CAPACITY - 4);
+  CHECK(data == buf);
+  for (i = 0; i < 8; ++i) data[i] = 4 + i;
+  ByteRingCommit(&ring, 8);
+  CHECK(ByteRingSize(&ring) == 12);
+  CHECK(ByteRingRemaining(&ring) == CAPACITY - 12);
+  ByteRingPullToBuffer(&ring, out, sizeof out);
+  for (i = 0; i < sizeof out; ++i) CHECK(out[i] == i);
+}
+
+// Peek gives the contiguous part, PeekMax both parts, up to max_size.
+static void TestPeekAcrossWrap() {
+  const BYTE *data1, *data2;
+  int size1, size2, i;
+  BYTE in[10];
+  for (i = 0; i < sizeof in; ++i) in[i] = 100 + i;
+  Reset(3);  // 3 bytes before the end of buf
+  CHECK(ByteRingPushBuffer(&ring, in, sizeof in));
+
+  CHECK(ByteRingPeek(&ring, &data1) == 3);
+  CHECK(data1 == buf + CAPACITY - 3 && data1[0] == 100);
+
+  ByteRingPeekMax(&ring, 100, &data1, &size1, &data2, &size2);
+  CHECK(size1 == 3 && size2 == 7);
+  CHECK(data1 == buf + CAPACITY - 3 && data2 == buf);
+  CHECK(data1[2] == 102 && data2[0] == 103 && data2[6] == 109);
+
+  ByteRingPeekMax(&ring, 5, &data1, &size1, &data2, &size2);
+  CHECK(size1 == 3 && size2 == 2);
+
+  ByteRingPeekMax(&ring, 2, &data1, &size1, &data2, &size2);
+  CHECK(size1 == 2 && size2 == 0);
+
+  // Pull the first part, and the rest is contiguous.
+  ByteRingPull(&ring, 3);
+  CHECK(ByteRingPeek(&ring, &data1) == 7);
+  CHECK(data1 == buf && data1[0] == 103);
+  ByteRingPeekMax(&ring, 100, &data1, &size1, &data2, &size2);
+  CHECK(size1 == 7 && size2 == 0);
+  ByteRingPull(&ring, 7);
+  CHECK(ByteRingSize(&ring) == 0);
+}
+
+static void TestOverflow() {
+  BYTE in[CAPACITY] = { 0 };
+  Reset(3);
+  CHECK(ring.overflows == 0);
+  CHECK(ByteRingPushBuffer(&ring, in, CAPACITY - 1));
+  CHECK(!ByteRingPushBuffer(&ring, in, 2));
+  CHECK(ring.overflows == 1);
+  CHECK(ByteRingSize(&ring) == CAPACITY - 1);
+  CHECK(ByteRingPushByte(&ring, 1));
+  CHECK(!ByteRingPushByte(&ring, 2));
+  CHECK(ring.overflows == 2);
+  // A failed push leaves the contents alone.
+  ByteRingPull(&ring, CAPACITY - 1);
+  CHECK(ByteRingPullByte(&ring) == 1);
+  CHECK(ring.overflows == 2);
+  ByteRingClear(&ring);
+  CHECK(ring.overflows == 0);
+}
+
+int main() {
+  TestEmpty();
+  TestFull();
+  TestWraparound();
+  TestReserveAcrossWrap();
+  TestPeekAcrossWrap();
+  TestOverflow();
+  if (failures) {
+    fprintf(stderr, "ringtest: %d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("ringtest: all passed\n");
+  return 0;
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+// Host stand-in for the PIC24 device header.
+// Special function registers are plain variables (defined in host_regs.c), so
+// firmware modules compile unchanged and whatever they write can be inspected.
+// Bit fields that the firmware accesses by their _NAME alias get a variable of
+// their own, not connected to the register they belong to.
+// Only the registers used by the modules built on the host are listed. Add
+// more to HOST_SFRS as needed.
+
+#ifndef __P24FXXXX_H__
+#define __P24FXXXX_H__
+
+#define HOST_SFRS(X)                                                          \
+  /* ADC / CTMU */                                                            \
+  X(AD1CON1) X(AD1CON2) X(AD1CON3) X(AD1CHS) X(AD1CSSL)                       \
+  X(CTMUCON) X(CTMUICON)                                                      \
+  X(_ADON) X(_ASAM) X(_SAMP) X(_SMPI) X(_SSRC) X(_CSCNA) X(_CH0SA)            \
+  X(_BUFM) X(_BUFS)                                                           \
+  X(_CTMUEN) X(_EDG1STAT) X(_IDISSEN)                                         \
+  X(_AD1IE) X(_AD1IF) X(_AD1IP)                                               \
+  X(_CRCIE) X(_CRCIF) X(_CRCIP)                                               \
+  /* Timers */                                                                \
+  X(T1CON) X(TMR1) X(PR1) X(T2CON) X(TMR2) X(PR2)                             \
+  X(T3CON) X(TMR3) X(PR3) X(T4CON) X(T5CON) X(TMR5) X(PR5)                    \
+  X(_T1IE) X(_T1IF) X(_T1IP)                                                  \
+  X(_T2IE) X(_T2IF) X(_T2IP)                                                  \
+  X(_T3IE) X(_T3IF) X(_T3IP)                                                  \
+  X(_T5IE) X(_T5IF) X(_T5IP)                                                  \
+  /* I/O ports */                                                             \
+  X(TRISB) X(TRISC) X(TRISD) X(TRISE) X(TRISF) X(TRISG)                       \
+  X(PORTB) X(PORTC) X(PORTD) X(PORTE) X(PORTF) X(PORTG)                       \
+  X(LATB) X(LATC) X(LATD) X(LATE) X(LATF) X(LATG)                             \
+  X(ODCB) X(ODCC) X(ODCD) X(ODCE) X(ODCF) X(ODCG)                             \
+  X(ANSB) X(ANSC) X(ANSD) X(ANSF) X(ANSG)                                     \
+  /* Change notification */                                                   \
+  X(CNEN1) X(CNEN2) X(CNEN3) X(CNEN4) X(CNEN5)                                \
+  X(CNPU1) X(CNPU2) X(CNPU3) X(CNPU4) X(CNPU5)                                \
+  X(CNPD1) X(CNPD2) X(CNPD3) X(CNPD4) X(CNPD5)                                \
+  X(_CNIE) X(_CNIF) X(_CNIP)                                                  \
+  /* Peripheral pin select inputs */                                          \
+  X(_U1RXR) X(_U2RXR) X(_U3RXR) X(_U4RXR)                                     \
+  X(_SDI1R) X(_SDI2R) X(_SDI3R)                                               \
+  X(_IC1R) X(_IC2R) X(_IC3R) X(_IC4R) X(_IC5R) X(_IC6R) X(_IC7R) X(_IC8R)     \
+  X(_IC9R)                                                                    \
+  /* Interrupt controls of the peripherals in host_io */                      \
+  X(_U1RXIE) X(_U1RXIF) X(_U1RXIP) X(_U1TXIE) X(_U1TXIF) X(_U1TXIP)           \
+  X(_U2RXIE) X(_U2RXIF) X(_U2RXIP) X(_U2TXIE) X(_U2TXIF) X(_U2TXIP)           \
+  X(_U3RXIE) X(_U3RXIF) X(_U3RXIP) X(_U3TXIE) X(_U3TXIF) X(_U3TXIP)           \
+  X(_U4RXIE) X(_U4RXIF) X(_U4RXIP) X(_U4TXIE) X(_U4TXIF) X(_U4TXIP)           \
+  X(_SPI1IE) X(_SPI1IF) X(_SPI1IP)                                            \
+  X(_SPI2IE) X(_SPI2IF) X(_SPI2IP)                                            \
+  X(_SPI3IE) X(_SPI3IF) X(_SPI3IP)                                            \
+  X(_MI2C1IE) X(_MI2C1IF) X(_MI2C1IP)                                         \
+  X(_MI2C2IE) X(_MI2C2IF) X(_MI2C2IP)                                         \
+  X(_MI2C3IE) X(_MI2C3IF) X(_MI2C3IP)                                         \
+  X(_IC1IE) X(_IC1IF) X(_IC1IP) X(_IC2IE) X(_IC2IF) X(_IC2IP)                 \
+  X(_IC3IE) X(_IC3IF) X(_IC3IP) X(_IC4IE) X(_IC4IF) X(_IC4IP)                 \
+  X(_IC5IE) X(_IC5IF) X(_IC5IP) X(_IC6IE) X(_IC6IF) X(_IC6IP)                 \
+  X(_IC7IE) X(_IC7IF) X(_IC7IP) X(_IC8IE) X(_IC8IF) X(_IC8IP)                 \
+  X(_IC9IE) X(_IC9IF) X(_IC9IP)                                               \
+  /* Interrupt controls of the output compare modules */                      \
+  X(_OC1IE) X(_OC1IF) X(_OC1IP) X(_OC2IE) X(_OC2IF) X(_OC2IP)                 \
+  X(_OC3IE) X(_OC3IF) X(_OC3IP) X(_OC4IE) X(_OC4IF) X(_OC4IP)                 \
+  X(_OC5IE) X(_OC5IF) X(_OC5IP) X(_OC6IE) X(_OC6IF) X(_OC6IP)                 \
+  X(_OC7IE) X(_OC7IF) X(_OC7IP) X(_OC8IE) X(_OC8IF) X(_OC8IP)                 \
+  X(_OC9IE) X(_OC9IF) X(_OC9IP)
+
+#define HOST_DECLARE_SFR(name) extern volatile unsigned int name;
+HOST_SFRS(HOST_DECLARE_SFR)
+
+extern volatile unsigned int ADC1BUF[16];
+#define ADC1BUF0 ADC1BUF[0]
+
+// Output compare modules: OCxCON1, OCxCON2, OCxRS, OCxR, OCxTMR.
+extern volatile unsigned int host_oc[9][5];
+#define OC1CON1 host_oc[0][0]
+
+// Peripheral pin select outputs, one byte per remappable pin.
+extern volatile unsigned int host_rpor[16];
+#define RPOR0 host_rpor[0]
+
+// Same layout as the device header.
+typedef struct tagUART {
+  unsigned int uxmode;
+  unsigned int uxsta;
+  unsigned int uxtxreg;
+  unsigned int uxrxreg;
+  unsigned int uxbrg;
+} UART, *PUART;
+
+// Registers whose accesses have side effects on the real device (FIFOs,
+// transfers started by a write). They share a page-aligned block of their own,
+// which the virtual IOIO protects in order to trap every access.
+typedef union {
+  struct {
+    UART uart[4];
+    unsigned int spi[3][5];  // SPIxSTAT, SPIxCON1, SPIxCON2, -, SPIxBUF
+    unsigned int i2c[3][7];  // I2CxRCV, TRN, BRG, CON, STAT, ADD, MSK
+    unsigned int ic[9][4];   // ICxCON1, ICxCON2, ICxBUF, ICxTMR
+  };
+  char page[4096];
+} HOST_IO_REGS;
+extern volatile HOST_IO_REGS host_io;
+
+#define U1MODE host_io.uart[0].uxmode
+#define U2MODE host_io.uart[1].uxmode
+#define U3MODE host_io.uart[2].uxmode
+#define U4MODE host_io.uart[3].uxmode
+#define SPI1STAT host_io.spi[0][0]
+#define SPI2STAT host_io.spi[1][0]
+#define SPI3STAT host_io.spi[2][0]
+#define I2C1RCV host_io.i2c[0][0]
+#define I2C2RCV host_io.i2c[1][0]
+#define I2C3RCV host_io.i2c[2][0]
+#define IC1CON1 host_io.ic[0][0]
+
+typedef struct {
+  unsigned int IPL : 3;
+} SRBITS;
+extern volatile SRBITS SRbits;
+
+// Interrupt handlers become ordinary functions, which the host code may call
+// to simulate an interrupt.
+#define __interrupt__ __used__
+#define auto_psv __used__
+
+#endif  // __P24FXXXX_H__
@@ -0,0 +1,241 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+// Virtual time, interrupt controller and the host_io access traps.
+//
+// An access to host_io raises SIGSEGV. The handler makes host_io accessible
+// and sets the trap flag, so that the faulting instruction is re-executed and
+// followed by SIGTRAP. That handler lets the peripheral model react to the
+// access and protects host_io again. This is x86-64 specific.
+
+#define _GNU_SOURCE
+#include "sim.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+
+#include "Compiler.h"
+
+#if !defined(__x86_64__) || !defined(__linux__)
+#error The virtual IOIO traps register accesses in an x86-64 Linux specific way.
+#endif
+
+#define TRAP_FLAG 0x100
+#define PF_WRITE 0x2
+
+SIM_TIME sim_now;
+SIM_STATS sim_stats;
+
+////////////////////////////////////////////////////////////////////////////////
+// Interrupt controller
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct {
+  volatile unsigned int* ie;
+  volatile unsigned int* ifs;
+  volatile unsigned int* ip;
+  void (*isr)();
+} IRQ;
+
+#define DECLARE_ISR(name) void _##name##Interrupt();
+#define IRQ_ENTRY(name, flag) { &_##flag##IE, &_##flag##IF, &_##flag##IP, &_##name##Interrupt },
+
+// In natural order (vector number), which breaks ties between equal
+// priorities.
+#define IRQS(X)                                                             \
+  X(IC1, IC1) X(OC1, OC1) X(T1, T1) X(IC2, IC2) X(OC2, OC2) X(T2, T2)      \
+  X(T3, T3) X(SPI1, SPI1) X(U1RX, U1RX) X(U1TX, U1TX) X(ADC1, AD1)           \
+  X(MI2C1, MI2C1) X(CN, CN) X(IC7, IC7) X(IC8, IC8) X(OC3, OC3) X(OC4, OC4)  \
+  X(IC3, IC3) X(IC4, IC4) X(T5, T5) X(U2RX, U2RX) X(U2TX, U2TX)              \
+  X(SPI2, SPI2) X(IC5, IC5) X(IC6, IC6) X(OC5, OC5) X(OC6, OC6) X(OC7, OC7)  \
+  X(OC8, OC8) X(MI2C2, MI2C2) X(CRC, CRC) X(U3RX, U3RX) X(U3TX, U3TX)        \
+  X(U4RX, U4RX) X(U4TX, U4TX) X(SPI3, SPI3) X(MI2C3, MI2C3) X(OC9, OC9)      \
+  X(IC9, IC9)
+
+#define DECLARE_IRQ_ISR(name, flag) DECLARE_ISR(name)
+IRQS(DECLARE_IRQ_ISR)
+
+static const IRQ irqs[] = {
+  IRQS(IRQ_ENTRY)
+};
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof(x[0]))
+
+// An interrupt that stays pending this many times in a row means its handler
+// fails to clear the condition.
+#define MAX_CONSECUTIVE_INTERRUPTS 100000
+
+static void ServiceInterrupts() {
+  int count = 0;
+  while (1) {
+    const IRQ* best = NULL;
+    int i;
+    for (i = 0; i < ARRAY_SIZE(irqs); ++i) {
+      const IRQ* irq = &irqs[i];
+      if (*irq->ie && *irq->ifs && (*irq->ip & 7) > SRbits.IPL
+          && (!best || (*irq->ip & 7) > (*best->ip & 7))) {
+        best = irq;
+      }
+    }
+    if (!best) return;
+    if (++count == MAX_CONSECUTIVE_INTERRUPTS) {
+      fprintf(stderr, "vioio: interrupt storm, ISR at %p never settles\n",
+              best->isr);
+      abort();
+    }
+    unsigned int prev = SRbits.IPL;
+    SRbits.IPL = *best->ip & 7;
+    best->isr();
+    SRbits.IPL = prev;
+    ++sim_stats.interrupts;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// host_io traps
+////////////////////////////////////////////////////////////////////////////////
+
+static volatile BYTE* trap_addr;
+static BOOL trap_write;
+
+void SimIoUnlock() {
+  mprotect((void*) &host_io, sizeof host_io, PROT_READ | PROT_WRITE);
+}
+
+void SimIoLock() {
+  mprotect((void*) &host_io, sizeof host_io, PROT_NONE);
+}
+
+static void AccessDone(volatile BYTE* addr, BOOL write) {
+  volatile BYTE* base = (volatile BYTE*) &host_io;
+  int offset = addr - base;
+  int reg = offset / sizeof(unsigned int);
+  int uart_regs = sizeof host_io.uart / (sizeof(unsigned int));
+  int spi_regs = (sizeof host_io.spi) / sizeof(unsigned int);
+  int i2c_regs = (sizeof host_io.i2c) / sizeof(unsigned int);
+  int ic_regs = (sizeof host_io.ic) / sizeof(unsigned int);
+  const int uart_size = sizeof(UART) / sizeof(unsigned int);
+
+  if (reg < uart_regs) {
+    SimUartAccess(reg / uart_size, reg % uart_size, write);
+    return;
+  }
+  reg -= uart_regs;
+  if (reg < spi_regs) {
+    SimSpiAccess(reg / 5, reg % 5, write);
+    return;
+  }
+  reg -= spi_regs;
+  if (reg < i2c_regs) {
+    SimI2CAccess(reg / 7, reg % 7, write);
+    return;
+  }
+  reg -= i2c_regs;
+  if (reg < ic_regs) {
+    SimInCapAccess(reg / 4, reg % 4, write);
+  }
+}
+
+static void SegvHandler(int sig, siginfo_t* info, void* context) {
+  ucontext_t* uc = (ucontext_t*) context;
+  volatile BYTE* addr = (volatile BYTE*) info->si_addr;
+  volatile BYTE* base = (volatile BYTE*) &host_io;
+  if (addr < base || addr >= base + sizeof host_io) {
+    // A genuine crash: let it happen.
+    signal(SIGSEGV, SIG_DFL);
+    return;
+  }
+  trap_addr = addr;
+  trap_write = (uc->uc_mcontext.gregs[REG_ERR] & PF_WRITE) != 0;
+  SimIoUnlock();
+  uc->uc_mcontext.gregs[REG_EFL] |= TRAP_FLAG;
+}
+
+static void TrapHandler(int sig, siginfo_t* info, void* context) {
+  ucontext_t* uc = (ucontext_t*) context;
+  uc->uc_mcontext.gregs[REG_EFL] &= ~TRAP_FLAG;
+  ++sim_stats.traps;
+  AccessDone(trap_addr, trap_write);
+  SimIoLock();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Public API
+////////////////////////////////////////////////////////////////////////////////
+
+void SimInit() {
+  struct sigaction sa;
+  memset(&sa, 0, sizeof sa);
+  sa.sa_flags = SA_SIGINFO | SA_NODEFER;
+  sa.sa_sigaction = &SegvHandler;
+  sigaction(SIGSEGV, &sa, NULL);
+  sa.sa_sigaction = &TrapHandler;
+  sigaction(SIGTRAP, &sa, NULL);
+  SimPinsInit();
+  SimReset();
+}
+
+#define RESET_SFR(name) name = 0;
+
+void SimReset() {
+  HOST_SFRS(RESET_SFR)
+  memset((void*) ADC1BUF, 0, sizeof ADC1BUF);
+  memset((void*) host_oc, 0, sizeof host_oc);
+  memset((void*) host_rpor, 0, sizeof host_rpor);
+  SRbits.IPL = 0;
+  SimIoUnlock();
+  memset((void*) &host_io, 0, sizeof host_io);
+  SimUartReset();
+  SimSpiReset();
+  SimI2CReset();
+  SimInCapReset();
+  SimAdcReset();
+  SimIoLock();
+}
+
+void SimAdvance(SIM_TIME dt) {
+  SIM_TIME from = sim_now;
+  SIM_TIME to = sim_now + dt;
+  SimIoUnlock();
+  SimTimersStep(from, to);
+  SimPwmStep(from, to);
+  SimPinsStep(from, to);
+  SimAdcStep(from, to);
+  SimUartStep(from, to);
+  SimSpiStep(from, to);
+  SimI2CStep(from, to);
+  SimInCapStep(from, to);
+  sim_now = to;
+  SimIoLock();
+  ServiceInterrupts();
+}
@@ -0,0 +1,201 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+// Register-level model of the IOIO's microcontroller peripherals, driving the
+// unmodified firmware modules on the host. See vioio.c for the big picture.
+//
+// Virtual time is counted in picoseconds, so that both the 62.5ns instruction
+// cycle and signal periods are exact integers.
+//
+// Most registers are plain variables (shim/p24Fxxxx.h), which the models read
+// and write whenever time advances. Registers whose accesses have side effects
+// on the real device live in host_io, which is kept inaccessible while firmware
+// code runs. Every firmware access to it faults, the model is notified once
+// the access completed (SimXxxAccess) and the protection is restored. Models
+// update the registers they own eagerly, so that what the firmware reads is
+// always current.
+//
+// Interrupts are only dispatched from SimAdvance(), i.e. between firmware main
+// loop iterations, never in the middle of firmware code.
+
+#ifndef __SIM_H__
+#define __SIM_H__
+
+#include "GenericTypeDefs.h"
+#include "platform.h"
+
+typedef unsigned long long SIM_TIME;
+
+#define SIM_NEVER (~0ULL)
+#define SIM_PS_PER_SEC 1000000000000ULL
+#define SIM_US(us) ((SIM_TIME) (us) * 1000000ULL)
+#define SIM_FCY 16000000ULL
+#define SIM_TCY (SIM_PS_PER_SEC / SIM_FCY)
+#define SIM_VDD 3.3
+
+typedef struct {
+  unsigned long long interrupts;
+  unsigned long long traps;
+} SIM_STATS;
+
+extern SIM_TIME sim_now;
+extern SIM_STATS sim_stats;
+
+// Number of whole ticks of a clock running at rate Hz at time t.
+static inline unsigned long long SimTicks(SIM_TIME t, unsigned long long rate) {
+  return (unsigned __int128) t * rate / SIM_PS_PER_SEC;
+}
+
+// The time at which SimTicks(., rate) reaches n.
+static inline SIM_TIME SimTickTime(unsigned long long n,
+                                   unsigned long long rate) {
+  return ((unsigned __int128) n * SIM_PS_PER_SEC + rate - 1) / rate;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Core (sim.c)
+////////////////////////////////////////////////////////////////////////////////
+
+// Installs the access traps. Call once, before any firmware code runs.
+void SimInit();
+// Power-on reset of all registers and peripheral models. Time keeps running.
+void SimReset();
+// Advances time by dt in a single step, then services pending interrupts.
+void SimAdvance(SIM_TIME dt);
+
+// Make host_io accessible to the models, or trap firmware accesses again.
+void SimIoUnlock();
+void SimIoLock();
+
+////////////////////////////////////////////////////////////////////////////////
+// Signal sources (sim_signal.c)
+////////////////////////////////////////////////////////////////////////////////
+
+typedef enum {
+  SIM_SIGNAL_DC,
+  SIM_SIGNAL_SQUARE,
+  SIM_SIGNAL_SINE,
+  SIM_SIGNAL_TRIANGLE
+} SIM_SIGNAL_TYPE;
+
+typedef struct {
+  SIM_SIGNAL_TYPE type;
+  double low;        // volts
+  double high;       // volts
+  SIM_TIME period;
+  SIM_TIME high_time;  // square only
+} SIM_SIGNAL;
+
+// Parses one of:
+//   dc:VOLTS
+//   square:HZ[:DUTY]           0V / VDD, duty cycle 0..1, default 0.5
+//   sine:HZ[:AMPL[:OFFSET]]    default ampl. VDD/2, default offset VDD/2
+//   triangle:HZ                0V to VDD and back
+// Returns FALSE on a malformed spec.
+BOOL SimSignalParse(const char* spec, SIM_SIGNAL* sig);
+double SimSignalVoltage(const SIM_SIGNAL* sig, SIM_TIME t);
+// The first logic level change in (after, until], or SIM_NEVER. Exact for
+// square signals, the others are only compared at both ends.
+SIM_TIME SimSignalNextEdge(const SIM_SIGNAL* sig, SIM_TIME after,
+                           SIM_TIME until);
+
+static inline int SimLogicLevel(double volts) { return volts > SIM_VDD / 2; }
+
+////////////////////////////////////////////////////////////////////////////////
+// Pins (sim_pins.c)
+////////////////////////////////////////////////////////////////////////////////
+
+// Attaches an external source to an (input) pin.
+void SimPinSetSignal(int pin, const SIM_SIGNAL* sig);
+// Connects pin to, which is an input, to pin from. Peripherals that model
+// transfers at the byte level (UART, SPI) follow wires too.
+void SimPinSetWire(int from, int to);
+int SimPinGetWire(int to);
+
+int SimPinLevel(int pin, SIM_TIME t);
+double SimPinVoltage(int pin, SIM_TIME t);
+SIM_TIME SimPinNextEdge(int pin, SIM_TIME after, SIM_TIME until);
+
+// Peripheral pin select: the peripheral output function of a pin and the pin
+// of a remappable input, or -1 if there is none.
+int SimPinOutputFunction(int pin);
+int SimPinFromOutputFunction(int func);
+int SimPinFromRpin(int rpin);
+// Whether a byte-level transfer from pin from reaches pin to.
+BOOL SimPinConnected(int from, int to);
+
+void SimPinsInit();
+void SimPinsStep(SIM_TIME from, SIM_TIME to);
+
+////////////////////////////////////////////////////////////////////////////////
+// Peripherals
+////////////////////////////////////////////////////////////////////////////////
+
+// Rate of the clock selected by OCTSEL / ICTSEL, 0 when stopped.
+unsigned long long SimTimerRate(int timer);
+void SimTimersStep(SIM_TIME from, SIM_TIME to);
+
+int SimPwmLevel(int oc, SIM_TIME t);
+SIM_TIME SimPwmNextEdge(int oc, SIM_TIME after, SIM_TIME until);
+void SimPwmStep(SIM_TIME from, SIM_TIME to);
+
+void SimAdcReset();
+void SimAdcStep(SIM_TIME from, SIM_TIME to);
+
+void SimUartReset();
+void SimUartStep(SIM_TIME from, SIM_TIME to);
+void SimUartAccess(int uart, int reg, BOOL write);
+
+void SimSpiReset();
+void SimSpiStep(SIM_TIME from, SIM_TIME to);
+void SimSpiAccess(int spi, int reg, BOOL write);
+
+// A device on an I2C bus. All callbacks return whether the device acks.
+typedef struct SIM_I2C_DEVICE {
+  int addr;  // 7-bit
+  BOOL (*start)(struct SIM_I2C_DEVICE* dev, BOOL read);
+  BOOL (*write)(struct SIM_I2C_DEVICE* dev, BYTE b);
+  BYTE (*read)(struct SIM_I2C_DEVICE* dev);
+  void (*stop)(struct SIM_I2C_DEVICE* dev);
+  struct SIM_I2C_DEVICE* next;
+} SIM_I2C_DEVICE;
+
+void SimI2CAttach(int i2c, SIM_I2C_DEVICE* dev);
+// A 256-byte register file: the first byte written after the address sets the
+// register pointer, reads and further writes auto-increment it.
+SIM_I2C_DEVICE* SimI2CNewRegisterFile(int addr);
+void SimI2CReset();
+void SimI2CStep(SIM_TIME from, SIM_TIME to);
+void SimI2CAccess(int i2c, int reg, BOOL write);
+
+void SimInCapReset();
+void SimInCapStep(SIM_TIME from, SIM_TIME to);
+void SimInCapAccess(int incap, int reg, BOOL write);
+
+#endif  // __SIM_H__
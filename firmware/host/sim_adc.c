@@ -0,0 +1,111 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+// ADC: a sequence starts when the module is on and sampling is enabled.
+// It takes the configured sample and conversion time per conversion, then fills
+// ADC1BUF and raises the ADC interrupt. With auto-sampling on, the next
+// sequence follows right away, into the other half of the buffer if it is
+// split. At most one sequence completes per step, so that the firmware gets to
+// turn the module off in between. Channel voltages are those of the pins.
+// Cap-sense conversions read the pin voltage too, so a source attached to a
+// cap-sense pin stands for the voltage the CTMU charge would produce.
+
+#include "sim.h"
+
+#include "Compiler.h"
+#include "pins.h"
+
+static BOOL busy;
+static SIM_TIME start;
+static SIM_TIME per_conversion;
+static int half;
+
+static unsigned int Convert(int channel, SIM_TIME t) {
+  int pin = PinFromAnalogChannel(channel);
+  double v = SimPinVoltage(pin, t);
+  if (v <= 0) return 0;
+  if (v >= SIM_VDD) return 1023;
+  return (unsigned int) (v / SIM_VDD * 1023 + 0.5);
+}
+
+static void StartSequence(SIM_TIME t) {
+  SIM_TIME tad = ((AD1CON3 & 0xFF) + 1) * SIM_TCY;
+  SIM_TIME samc = (AD1CON3 >> 8) & 0x1F;
+  // Manual (cap-sense) sampling converts right after the CTMU pulse.
+  per_conversion = (_SSRC == 7 ? samc : 0) * tad + 12 * tad;
+  start = t;
+  busy = TRUE;
+}
+
+void SimAdcReset() {
+  busy = FALSE;
+  half = 0;
+}
+
+void SimAdcStep(SIM_TIME from, SIM_TIME to) {
+  int conversions = _SMPI + 1;
+  SIM_TIME done;
+  if (!_ADON) {
+    busy = FALSE;
+    half = 0;
+    return;
+  }
+  if (!busy && (_ASAM || _SAMP)) {
+    StartSequence(from);
+  }
+  if (!busy) return;
+  if (!_CSCNA) conversions = 1;
+  done = start + conversions * per_conversion;
+  if (done <= to) {
+    volatile unsigned int* buf = ADC1BUF + (_BUFM && half ? 8 : 0);
+    if (_CSCNA) {
+      // Scan the selected channels in ascending order, over and over.
+      unsigned int mask = AD1CSSL & 0xFFFF;
+      int channel = -1, i;
+      for (i = 0; i < conversions && mask; ++i) {
+        do {
+          channel = (channel + 1) & 15;
+        } while (!(mask & (1 << channel)));
+        buf[i] = Convert(channel, start + (i + 1) * per_conversion);
+      }
+    } else {
+      buf[0] = Convert(_CH0SA, done);
+    }
+    if (_BUFM) {
+      half = !half;
+      _BUFS = half;
+    }
+    _SAMP = 0;
+    busy = FALSE;
+    _AD1IF = 1;
+    if (_ASAM) {
+      StartSequence(done);
+    }
+  }
+}
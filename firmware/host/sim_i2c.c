@@ -0,0 +1,243 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+// I2C masters. Every bus event the firmware requests (start, restart, stop,
+// byte write, byte read, ack) completes after a number of bit times and raises
+// the master interrupt. Devices on the bus are SIM_I2C_DEVICEs; an address
+// nobody answers to is nacked.
+
+#include "sim.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "Compiler.h"
+
+// con
+#define I2CEN 0x8000
+#define SEN 0x0001
+#define RSEN 0x0002
+#define PEN 0x0004
+#define RCEN 0x0008
+#define ACKEN 0x0010
+#define ACKDT 0x0020
+#define CON_EVENTS (SEN | RSEN | PEN | RCEN | ACKEN)
+// stat
+#define ACKSTAT 0x8000
+#define TRSTAT 0x4000
+#define RBF 0x0002
+#define TBF 0x0001
+
+enum { REG_RCV, REG_TRN, REG_BRG, REG_CON, REG_STAT };
+
+typedef enum {
+  EVENT_NONE,
+  EVENT_START,
+  EVENT_STOP,
+  EVENT_WRITE,
+  EVENT_READ,
+  EVENT_ACK
+} EVENT;
+
+typedef struct {
+  EVENT event;
+  SIM_TIME done;
+  BOOL expect_address;
+  SIM_I2C_DEVICE* addressed;
+  SIM_I2C_DEVICE* devices;
+} SIM_I2C;
+
+static SIM_I2C i2cs[NUM_I2C_MODULES];
+
+static volatile unsigned int* const mi2cif[] = {
+  &_MI2C1IF, &_MI2C2IF, &_MI2C3IF
+};
+
+static SIM_TIME BitTime(int n) {
+  // Fscl = Fcy / (BRG + 1 + Fcy / 10MHz)
+  return (host_io.i2c[n][REG_BRG] + 2ULL) * SIM_TCY;
+}
+
+static void Begin(int n, EVENT event, int bits) {
+  i2cs[n].event = event;
+  i2cs[n].done = sim_now + bits * BitTime(n);
+}
+
+static void Complete(int n) {
+  SIM_I2C* i2c = &i2cs[n];
+  volatile unsigned int* reg = host_io.i2c[n];
+  SIM_I2C_DEVICE* dev = i2c->addressed;
+  BYTE b;
+  switch (i2c->event) {
+    case EVENT_NONE:
+      return;
+
+    case EVENT_START:
+      reg[REG_CON] &= ~(SEN | RSEN);
+      i2c->expect_address = TRUE;
+      break;
+
+    case EVENT_STOP:
+      reg[REG_CON] &= ~PEN;
+      if (dev && dev->stop) dev->stop(dev);
+      i2c->addressed = NULL;
+      break;
+
+    case EVENT_WRITE:
+      b = reg[REG_TRN];
+      reg[REG_STAT] &= ~(TBF | TRSTAT | ACKSTAT);
+      if (i2c->expect_address) {
+        // 10-bit addresses are not modeled and are nacked.
+        i2c->expect_address = FALSE;
+        for (dev = i2c->devices; dev && dev->addr != b >> 1; dev = dev->next);
+        if (dev && dev->start(dev, b & 1)) {
+          i2c->addressed = dev;
+        } else {
+          i2c->addressed = NULL;
+          reg[REG_STAT] |= ACKSTAT;
+        }
+      } else if (!dev || !dev->write(dev, b)) {
+        reg[REG_STAT] |= ACKSTAT;
+      }
+      break;
+
+    case EVENT_READ:
+      reg[REG_CON] &= ~RCEN;
+      reg[REG_RCV] = dev ? dev->read(dev) : 0xFF;
+      reg[REG_STAT] |= RBF;
+      break;
+
+    case EVENT_ACK:
+      reg[REG_CON] &= ~ACKEN;
+      break;
+  }
+  i2c->event = EVENT_NONE;
+  *mi2cif[n] = 1;
+}
+
+void SimI2CAttach(int n, SIM_I2C_DEVICE* dev) {
+  dev->next = i2cs[n].devices;
+  i2cs[n].devices = dev;
+}
+
+void SimI2CReset() {
+  int i;
+  for (i = 0; i < NUM_I2C_MODULES; ++i) {
+    SIM_I2C_DEVICE* devices = i2cs[i].devices;
+    memset(&i2cs[i], 0, sizeof i2cs[i]);
+    i2cs[i].devices = devices;
+  }
+}
+
+void SimI2CAccess(int n, int reg, BOOL write) {
+  SIM_I2C* i2c = &i2cs[n];
+  volatile unsigned int* regs = host_io.i2c[n];
+  if (n >= NUM_I2C_MODULES) return;
+  switch (reg) {
+    case REG_CON:
+      if (!write) break;
+      if (!(regs[REG_CON] & I2CEN)) {
+        i2c->event = EVENT_NONE;
+        i2c->addressed = NULL;
+        regs[REG_CON] &= ~CON_EVENTS;
+        regs[REG_STAT] = 0;
+        break;
+      }
+      if (i2c->event != EVENT_NONE) break;
+      if (regs[REG_CON] & (SEN | RSEN)) {
+        Begin(n, EVENT_START, 1);
+      } else if (regs[REG_CON] & PEN) {
+        Begin(n, EVENT_STOP, 1);
+      } else if (regs[REG_CON] & RCEN) {
+        Begin(n, EVENT_READ, 8);
+      } else if (regs[REG_CON] & ACKEN) {
+        Begin(n, EVENT_ACK, 1);
+      }
+      break;
+
+    case REG_TRN:
+      if (write && (regs[REG_CON] & I2CEN) && i2c->event == EVENT_NONE) {
+        regs[REG_STAT] |= TBF | TRSTAT;
+        Begin(n, EVENT_WRITE, 9);
+      }
+      break;
+
+    case REG_RCV:
+      if (!write) regs[REG_STAT] &= ~RBF;
+      break;
+  }
+}
+
+void SimI2CStep(SIM_TIME from, SIM_TIME to) {
+  int n;
+  for (n = 0; n < NUM_I2C_MODULES; ++n) {
+    if (i2cs[n].event != EVENT_NONE && i2cs[n].done <= to) Complete(n);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Register file device
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct {
+  SIM_I2C_DEVICE dev;
+  BYTE regs[256];
+  BYTE ptr;
+  BOOL ptr_set;
+} REGISTER_FILE;
+
+static BOOL RegisterFileStart(SIM_I2C_DEVICE* dev, BOOL read) {
+  ((REGISTER_FILE*) dev)->ptr_set = read;
+  return TRUE;
+}
+
+static BOOL RegisterFileWrite(SIM_I2C_DEVICE* dev, BYTE b) {
+  REGISTER_FILE* rf = (REGISTER_FILE*) dev;
+  if (rf->ptr_set) {
+    rf->regs[rf->ptr++] = b;
+  } else {
+    rf->ptr = b;
+    rf->ptr_set = TRUE;
+  }
+  return TRUE;
+}
+
+static BYTE RegisterFileRead(SIM_I2C_DEVICE* dev) {
+  REGISTER_FILE* rf = (REGISTER_FILE*) dev;
+  return rf->regs[rf->ptr++];
+}
+
+SIM_I2C_DEVICE* SimI2CNewRegisterFile(int addr) {
+  REGISTER_FILE* rf = calloc(1, sizeof(REGISTER_FILE));
+  rf->dev.addr = addr;
+  rf->dev.start = &RegisterFileStart;
+  rf->dev.write = &RegisterFileWrite;
+  rf->dev.read = &RegisterFileRead;
+  return &rf->dev;
+}
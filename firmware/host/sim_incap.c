@@ -0,0 +1,181 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+// Input capture modules. Each enabled module watches the edges of its input
+// pin and pushes the value of its timer into a 4-deep FIFO, raising its
+// interrupt every ICI + 1 captures. In cascade (32-bit) mode the odd module
+// captures the low word and the next one the high word.
+
+#include "sim.h"
+
+#include <string.h>
+
+#include "Compiler.h"
+
+#define FIFO_SIZE 4
+
+// con1
+#define ICM_MASK 0x0007
+#define ICBNE 0x0008
+#define ICOV 0x0010
+#define CON1_READ_ONLY (ICBNE | ICOV)
+// con2
+#define IC32 0x0100
+
+enum { REG_CON1, REG_CON2, REG_BUF, REG_TMR };
+
+typedef struct {
+  WORD fifo[FIFO_SIZE];
+  int count;
+  BOOL on;
+  SIM_TIME start;     // time the module was turned on
+  unsigned rising;    // rising edges seen, for the prescaled modes
+  unsigned captures;  // captures since turned on, for ICI
+  int level;          // input level at the end of the last step
+} SIM_INCAP;
+
+static SIM_INCAP incaps[NUM_INCAP_MODULES];
+
+static volatile unsigned int* const icr[] = {
+  &_IC1R, &_IC2R, &_IC3R, &_IC4R, &_IC5R, &_IC6R, &_IC7R, &_IC8R, &_IC9R
+};
+static volatile unsigned int* const icif[] = {
+  &_IC1IF, &_IC2IF, &_IC3IF, &_IC4IF, &_IC5IF, &_IC6IF, &_IC7IF, &_IC8IF,
+  &_IC9IF
+};
+
+// ICTSEL -> timer, -1 for the system clock.
+static const int ic_clock[8] = { 3, 2, 4, 5, 1, -2, -2, -1 };
+
+static void UpdateStatus(int n) {
+  SIM_INCAP* ic = &incaps[n];
+  volatile unsigned int* reg = host_io.ic[n];
+  reg[REG_CON1] &= ~ICBNE;
+  if (ic->count) reg[REG_CON1] |= ICBNE;
+  reg[REG_BUF] = ic->count ? ic->fifo[0] : 0;
+}
+
+static void Push(int n, WORD value) {
+  SIM_INCAP* ic = &incaps[n];
+  if (ic->count == FIFO_SIZE) {
+    host_io.ic[n][REG_CON1] |= ICOV;
+    return;
+  }
+  ic->fifo[ic->count++] = value;
+  UpdateStatus(n);
+}
+
+// Whether n is the lower half of a cascaded pair. Pairs are IC1/IC2,
+// IC3/IC4, etc.
+static BOOL Cascaded(int n) {
+  return n % 2 == 0 && n + 1 < NUM_INCAP_MODULES
+         && (host_io.ic[n][REG_CON2] & IC32);
+}
+
+static void Edge(int n, SIM_TIME t, int level) {
+  SIM_INCAP* ic = &incaps[n];
+  volatile unsigned int* reg = host_io.ic[n];
+  int clock = ic_clock[(reg[REG_CON1] >> 10) & 7];
+  unsigned long long rate = clock == -2 ? 0 : SimTimerRate(clock);
+  unsigned long long value;
+  BOOL capture;
+  if (level) ++ic->rising;
+  switch (reg[REG_CON1] & ICM_MASK) {
+    case 1: capture = TRUE; break;
+    case 2: capture = !level; break;
+    case 3: capture = level; break;
+    case 4: capture = level && ic->rising % 4 == 0; break;
+    case 5: capture = level && ic->rising % 16 == 0; break;
+    default: capture = FALSE; break;
+  }
+  if (!capture) return;
+  value = SimTicks(t, rate) - SimTicks(ic->start, rate);
+  Push(n, value & 0xFFFF);
+  if (Cascaded(n)) Push(n + 1, (value >> 16) & 0xFFFF);
+  if (++ic->captures % (((reg[REG_CON1] >> 5) & 3) + 1) == 0) *icif[n] = 1;
+}
+
+void SimInCapReset() {
+  int i;
+  memset(incaps, 0, sizeof incaps);
+  for (i = 0; i < NUM_INCAP_MODULES; ++i) UpdateStatus(i);
+}
+
+void SimInCapAccess(int n, int reg, BOOL write) {
+  SIM_INCAP* ic = &incaps[n];
+  volatile unsigned int* regs = host_io.ic[n];
+  if (n >= NUM_INCAP_MODULES) return;
+  switch (reg) {
+    case REG_CON1:
+      if (!write) break;
+      if (!(regs[REG_CON1] & ICM_MASK)) {
+        // Turning the module off clears the FIFO.
+        ic->on = FALSE;
+        ic->count = 0;
+        regs[REG_CON1] &= ~ICOV;
+      } else if (!ic->on) {
+        int pin = SimPinFromRpin(*icr[n]);
+        ic->on = TRUE;
+        ic->start = sim_now;
+        ic->rising = 0;
+        ic->captures = 0;
+        ic->level = pin >= 0 ? SimPinLevel(pin, sim_now) : 0;
+      }
+      break;
+
+    case REG_BUF:
+      if (!write && ic->count) {
+        memmove(ic->fifo, ic->fifo + 1, --ic->count * sizeof ic->fifo[0]);
+      }
+      break;
+  }
+  UpdateStatus(n);
+}
+
+void SimInCapStep(SIM_TIME from, SIM_TIME to) {
+  int n;
+  for (n = 0; n < NUM_INCAP_MODULES; ++n) {
+    SIM_INCAP* ic = &incaps[n];
+    int pin = SimPinFromRpin(*icr[n]);
+    SIM_TIME t = from;
+    int level;
+    // The upper half of a cascaded pair captures along with the lower one.
+    if (!ic->on || pin < 0 || (n % 2 && Cascaded(n - 1))) continue;
+    // Level changes that the pin can't predict, e.g. writes to LAT, show up
+    // as an edge at the start of the step.
+    level = SimPinLevel(pin, from);
+    if (level != ic->level) Edge(n, from, level);
+    ic->level = level;
+    while ((t = SimPinNextEdge(pin, t, to)) != SIM_NEVER) {
+      level = SimPinLevel(pin, t);
+      if (level != ic->level) Edge(n, t, level);
+      ic->level = level;
+    }
+  }
+}
@@ -0,0 +1,234 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+// Pin levels: driven by the firmware (LAT or a remapped peripheral output),
+// by an attached signal, by a wire from another pin or by the pull resistors.
+// PORTx registers are refreshed on every step, and change notification is
+// raised when a pin enabled for it changes.
+
+#include "sim.h"
+
+#include <assert.h>
+
+#include "Compiler.h"
+#include "pins.h"
+
+// Defined in pins.c.
+extern volatile unsigned char* pin_to_rpor[NUM_PINS];
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof(x[0]))
+
+typedef struct {
+  volatile unsigned int* tris;
+  volatile unsigned int* port;
+  volatile unsigned int* lat;
+  volatile unsigned int* odc;
+  int (*pin_from_port)(int bit);
+} PORT;
+
+static const PORT ports[] = {
+  { &TRISB, &PORTB, &LATB, &ODCB, &PinFromPortB },
+  { &TRISC, &PORTC, &LATC, &ODCC, &PinFromPortC },
+  { &TRISD, &PORTD, &LATD, &ODCD, &PinFromPortD },
+  { &TRISE, &PORTE, &LATE, &ODCE, &PinFromPortE },
+  { &TRISF, &PORTF, &LATF, &ODCF, &PinFromPortF },
+  { &TRISG, &PORTG, &LATG, &ODCG, &PinFromPortG }
+};
+
+static volatile unsigned int* const cnpu[] = {
+  &CNPU1, &CNPU2, &CNPU3, &CNPU4, &CNPU5
+};
+
+typedef struct {
+  const PORT* port;
+  unsigned int mask;
+  int cn_reg;  // index into cnpu, -1 if none
+  unsigned int cn_mask;
+  BOOL has_signal;
+  SIM_SIGNAL signal;
+  int wire;  // pin driving this one, -1 if none
+} PIN;
+
+static PIN pins[NUM_PINS];
+
+// Wires may form loops.
+#define MAX_WIRE_DEPTH 8
+
+void SimPinsInit() {
+  int i, bit, reg;
+  for (i = 0; i < NUM_PINS; ++i) {
+    pins[i].cn_reg = -1;
+    pins[i].wire = -1;
+  }
+  for (i = 0; i < ARRAY_SIZE(ports); ++i) {
+    for (bit = 0; bit < 16; ++bit) {
+      int pin = ports[i].pin_from_port(bit);
+      if (pin >= 0) {
+        pins[pin].port = &ports[i];
+        pins[pin].mask = 1 << bit;
+      }
+    }
+  }
+  // The pull-up / pull-down bit of each pin is private to pins.c. Find it by
+  // watching which one PinSetCnpu() sets.
+  for (i = 0; i < NUM_PINS; ++i) {
+    unsigned int before[ARRAY_SIZE(cnpu)];
+    for (reg = 0; reg < ARRAY_SIZE(cnpu); ++reg) before[reg] = *cnpu[reg];
+    PinSetCnpu(i, 1);
+    for (reg = 0; reg < ARRAY_SIZE(cnpu); ++reg) {
+      if (*cnpu[reg] != before[reg]) {
+        pins[i].cn_reg = reg;
+        pins[i].cn_mask = *cnpu[reg] ^ before[reg];
+        *cnpu[reg] = before[reg];
+      }
+    }
+  }
+}
+
+void SimPinSetSignal(int pin, const SIM_SIGNAL* sig) {
+  pins[pin].has_signal = TRUE;
+  pins[pin].signal = *sig;
+}
+
+void SimPinSetWire(int from, int to) {
+  pins[to].wire = from;
+}
+
+int SimPinGetWire(int to) {
+  return pins[to].wire;
+}
+
+int SimPinOutputFunction(int pin) {
+  return pin_to_rpor[pin] ? *pin_to_rpor[pin] : 0;
+}
+
+int SimPinFromOutputFunction(int func) {
+  int i;
+  for (i = 0; i < NUM_PINS; ++i) {
+    if (SimPinOutputFunction(i) == func) return i;
+  }
+  return -1;
+}
+
+int SimPinFromRpin(int rpin) {
+  int i;
+  for (i = 0; i < NUM_PINS; ++i) {
+    if (PinToRpin(i) == rpin) return i;
+  }
+  return -1;
+}
+
+BOOL SimPinConnected(int from, int to) {
+  return from >= 0 && to >= 0 && (from == to || pins[to].wire == from);
+}
+
+// The output compare module driving a pin, -1 if none.
+static int PinOc(int pin) {
+  int func = SimPinOutputFunction(pin);
+  if (func >= 18 && func < 18 + 8) return func - 18;
+  if (func == 35) return 8;
+  return -1;
+}
+
+// Whether the firmware drives the pin and if so, to which level.
+static BOOL Driven(int pin, SIM_TIME t, int* level) {
+  const PIN* p = &pins[pin];
+  int oc;
+  if (!p->port || (*p->port->tris & p->mask)) return FALSE;
+  if ((oc = PinOc(pin)) >= 0) {
+    *level = SimPwmLevel(oc, t);
+  } else if (SimPinOutputFunction(pin)) {
+    *level = 1;  // serial outputs idle high
+  } else {
+    *level = (*p->port->lat & p->mask) != 0;
+  }
+  // Open-drain outputs only drive low.
+  return !*level || !(*p->port->odc & p->mask);
+}
+
+static BOOL PulledUp(int pin) {
+  const PIN* p = &pins[pin];
+  return p->cn_reg >= 0 && (*cnpu[p->cn_reg] & p->cn_mask);
+}
+
+static double Voltage(int pin, SIM_TIME t, int depth) {
+  const PIN* p = &pins[pin];
+  int level;
+  if (Driven(pin, t, &level)) return level ? SIM_VDD : 0;
+  if (p->wire >= 0 && depth < MAX_WIRE_DEPTH) {
+    return Voltage(p->wire, t, depth + 1);
+  }
+  if (p->has_signal) return SimSignalVoltage(&p->signal, t);
+  return PulledUp(pin) ? SIM_VDD : 0;
+}
+
+double SimPinVoltage(int pin, SIM_TIME t) {
+  return Voltage(pin, t, 0);
+}
+
+int SimPinLevel(int pin, SIM_TIME t) {
+  return SimLogicLevel(Voltage(pin, t, 0));
+}
+
+static SIM_TIME NextEdge(int pin, SIM_TIME after, SIM_TIME until, int depth) {
+  const PIN* p = &pins[pin];
+  int level, oc;
+  if (Driven(pin, after, &level)) {
+    oc = PinOc(pin);
+    return oc >= 0 ? SimPwmNextEdge(oc, after, until) : SIM_NEVER;
+  }
+  if (p->wire >= 0 && depth < MAX_WIRE_DEPTH) {
+    return NextEdge(p->wire, after, until, depth + 1);
+  }
+  if (p->has_signal) return SimSignalNextEdge(&p->signal, after, until);
+  return SIM_NEVER;
+}
+
+SIM_TIME SimPinNextEdge(int pin, SIM_TIME after, SIM_TIME until) {
+  return NextEdge(pin, after, until, 0);
+}
+
+void SimPinsStep(SIM_TIME from, SIM_TIME to) {
+  int i, bit;
+  for (i = 0; i < ARRAY_SIZE(ports); ++i) {
+    const PORT* port = &ports[i];
+    unsigned int value = 0, changed;
+    for (bit = 0; bit < 16; ++bit) {
+      int pin = port->pin_from_port(bit);
+      if (pin >= 0 && SimPinLevel(pin, to)) value |= 1 << bit;
+    }
+    // As on the chip, the hardware enables raise the interrupt, whether or not
+    // the pin is reported.
+    changed = value ^ *port->port;
+    for (bit = 0; changed; ++bit, changed >>= 1) {
+      if ((changed & 1) && PinGetCnen(port->pin_from_port(bit))) _CNIF = 1;
+    }
+    *port->port = value;
+  }
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+// Waveforms that can be attached to pins as external signal sources.
+
+#include "sim.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+static BOOL ParsePeriod(double hz, SIM_SIGNAL* sig) {
+  if (!(hz > 0) || hz > SIM_FCY) return FALSE;
+  sig->period = (SIM_TIME) (SIM_PS_PER_SEC / hz + 0.5);
+  return TRUE;
+}
+
+BOOL SimSignalParse(const char* spec, SIM_SIGNAL* sig) {
+  double a = 0, b = 0, c = 0;
+  int n;
+  memset(sig, 0, sizeof *sig);
+  if (sscanf(spec, "dc:%lf%n", &a, &n) == 1 && !spec[n]) {
+    sig->type = SIM_SIGNAL_DC;
+    sig->low = sig->high = a;
+    return TRUE;
+  }
+  if (!strncmp(spec, "square:", 7)) {
+    b = 0.5;
+    n = sscanf(spec + 7, "%lf:%lf", &a, &b);
+    if (n < 1 || !ParsePeriod(a, sig) || b < 0 || b > 1) return FALSE;
+    sig->type = SIM_SIGNAL_SQUARE;
+    sig->low = 0;
+    sig->high = SIM_VDD;
+    sig->high_time = (SIM_TIME) (sig->period * b + 0.5);
+    return TRUE;
+  }
+  if (!strncmp(spec, "sine:", 5)) {
+    b = c = SIM_VDD / 2;
+    n = sscanf(spec + 5, "%lf:%lf:%lf", &a, &b, &c);
+    if (n < 1 || !ParsePeriod(a, sig)) return FALSE;
+    sig->type = SIM_SIGNAL_SINE;
+    sig->low = c - b;
+    sig->high = c + b;
+    return TRUE;
+  }
+  if (!strncmp(spec, "triangle:", 9)) {
+    n = sscanf(spec + 9, "%lf", &a);
+    if (n < 1 || !ParsePeriod(a, sig)) return FALSE;
+    sig->type = SIM_SIGNAL_TRIANGLE;
+    sig->low = 0;
+    sig->high = SIM_VDD;
+    return TRUE;
+  }
+  return FALSE;
+}
+
+double SimSignalVoltage(const SIM_SIGNAL* sig, SIM_TIME t) {
+  SIM_TIME pos;
+  double phase;
+  switch (sig->type) {
+    case SIM_SIGNAL_DC:
+      return sig->low;
+
+    case SIM_SIGNAL_SQUARE:
+      return t % sig->period < sig->high_time ? sig->high : sig->low;
+
+    case SIM_SIGNAL_SINE:
+      phase = (double) (t % sig->period) / sig->period;
+      return (sig->low + sig->high) / 2
+             + (sig->high - sig->low) / 2 * sin(2 * M_PI * phase);
+
+    case SIM_SIGNAL_TRIANGLE:
+      pos = t % sig->period;
+      phase = 2.0 * pos / sig->period;
+      if (phase > 1) phase = 2 - phase;
+      return sig->low + (sig->high - sig->low) * phase;
+  }
+  return 0;
+}
+
+SIM_TIME SimSignalNextEdge(const SIM_SIGNAL* sig, SIM_TIME after,
+                           SIM_TIME until) {
+  SIM_TIME edge;
+  if (sig->type == SIM_SIGNAL_SQUARE) {
+    SIM_TIME start = after - after % sig->period;
+    if (sig->high_time == 0 || sig->high_time == sig->period) {
+      return SIM_NEVER;
+    }
+    edge = start + sig->high_time;
+    if (edge <= after) edge = start + sig->period;
+  } else if (SimLogicLevel(SimSignalVoltage(sig, after))
+             != SimLogicLevel(SimSignalVoltage(sig, until))) {
+    edge = until;
+  } else {
+    return SIM_NEVER;
+  }
+  return edge <= until ? edge : SIM_NEVER;
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+// SPI masters in enhanced buffer mode, at the byte level: 8-deep TX and RX
+// FIFOs, one byte shifted at a time at the configured clock. The byte received
+// is the one sent if the SDI pin is the SDO pin or wired to it, otherwise it
+// is the SDI level repeated.
+
+#include "sim.h"
+
+#include <string.h>
+
+#include "Compiler.h"
+
+#define FIFO_SIZE 8
+
+// spixstat
+#define SPIEN 0x8000
+#define SPIROV 0x0040
+#define SRXMPT 0x0020
+#define SPITBF 0x0002
+#define SPIRBF 0x0001
+#define STAT_READ_ONLY 0x07A3  // SPIBEC, SRMPT, SRXMPT, SPITBF, SPIRBF
+
+enum { REG_STAT, REG_CON1, REG_CON2, REG_RESERVED, REG_BUF };
+
+typedef struct {
+  BYTE tx_fifo[FIFO_SIZE];
+  int tx_count;
+  BOOL shifting;
+  BYTE shift_byte;
+  SIM_TIME shift_done;
+  BYTE rx_fifo[FIFO_SIZE];
+  int rx_count;
+} SIM_SPI;
+
+static SIM_SPI spis[NUM_SPI_MODULES];
+
+static volatile unsigned int* const sdir[] = { &_SDI1R, &_SDI2R, &_SDI3R };
+static volatile unsigned int* const spiif[] = {
+  &_SPI1IF, &_SPI2IF, &_SPI3IF
+};
+// Peripheral pin select output function numbers.
+static const int sdo_func[] = { 7, 10, 32 };
+
+static void UpdateStatus(int n) {
+  SIM_SPI* s = &spis[n];
+  volatile unsigned int* reg = host_io.spi[n];
+  unsigned int stat = reg[REG_STAT] & ~STAT_READ_ONLY;
+  if (!s->rx_count) stat |= SRXMPT;
+  if (s->rx_count == FIFO_SIZE) stat |= SPIRBF;
+  if (s->tx_count == FIFO_SIZE) stat |= SPITBF;
+  reg[REG_STAT] = stat;
+  reg[REG_BUF] = s->rx_count ? s->rx_fifo[0] : 0;
+}
+
+static SIM_TIME ByteTime(int n) {
+  static const int primary[] = { 64, 16, 4, 1 };
+  unsigned int con1 = host_io.spi[n][REG_CON1];
+  int secondary = 8 - ((con1 >> 2) & 7);
+  return 8ULL * primary[con1 & 3] * secondary * SIM_TCY;
+}
+
+static void LoadShifter(int n, SIM_TIME t) {
+  SIM_SPI* s = &spis[n];
+  if (!s->tx_count) {
+    s->shifting = FALSE;
+    return;
+  }
+  s->shift_byte = s->tx_fifo[0];
+  memmove(s->tx_fifo, s->tx_fifo + 1, --s->tx_count);
+  s->shifting = TRUE;
+  s->shift_done = t + ByteTime(n);
+}
+
+static void Complete(int n, SIM_TIME t) {
+  SIM_SPI* s = &spis[n];
+  int sdo_pin = SimPinFromOutputFunction(sdo_func[n]);
+  int sdi_pin = SimPinFromRpin(*sdir[n]);
+  BYTE b;
+  if (SimPinConnected(sdo_pin, sdi_pin)) {
+    b = s->shift_byte;
+  } else {
+    b = sdi_pin >= 0 && SimPinLevel(sdi_pin, t) ? 0xFF : 0x00;
+  }
+  if (s->rx_count == FIFO_SIZE) {
+    host_io.spi[n][REG_STAT] |= SPIROV;
+  } else {
+    s->rx_fifo[s->rx_count++] = b;
+  }
+  // SISEL = 001: interrupt when the RX FIFO is not empty.
+  *spiif[n] = 1;
+}
+
+static void ResetSpi(int n) {
+  memset(&spis[n], 0, sizeof spis[n]);
+}
+
+void SimSpiReset() {
+  int i;
+  for (i = 0; i < NUM_SPI_MODULES; ++i) {
+    ResetSpi(i);
+    UpdateStatus(i);
+  }
+}
+
+void SimSpiAccess(int n, int reg, BOOL write) {
+  SIM_SPI* s = &spis[n];
+  volatile unsigned int* regs = host_io.spi[n];
+  if (n >= NUM_SPI_MODULES) return;
+  switch (reg) {
+    case REG_STAT:
+      if (write && !(regs[REG_STAT] & SPIEN)) ResetSpi(n);
+      break;
+
+    case REG_BUF:
+      if (write) {
+        if ((regs[REG_STAT] & SPIEN) && s->tx_count < FIFO_SIZE) {
+          s->tx_fifo[s->tx_count++] = regs[REG_BUF];
+          if (!s->shifting) LoadShifter(n, sim_now);
+        }
+      } else if (s->rx_count) {
+        memmove(s->rx_fifo, s->rx_fifo + 1, --s->rx_count);
+      }
+      break;
+  }
+  UpdateStatus(n);
+}
+
+void SimSpiStep(SIM_TIME from, SIM_TIME to) {
+  int n;
+  for (n = 0; n < NUM_SPI_MODULES; ++n) {
+    SIM_SPI* s = &spis[n];
+    while (s->shifting && s->shift_done <= to) {
+      Complete(n, s->shift_done);
+      LoadShifter(n, s->shift_done);
+    }
+    UpdateStatus(n);
+  }
+}
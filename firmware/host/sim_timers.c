@@ -0,0 +1,170 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+// Timers 1-5 and the output compare (PWM) modules.
+// All but Timer 4 count and raise their interrupts. Timer 4 only serves as a
+// clock source. The output level of the output compare modules is a function
+// of time, computed on demand. They are stepped only in order to raise their
+// interrupts on period match.
+
+#include "sim.h"
+
+#include "Compiler.h"
+
+typedef struct {
+  volatile unsigned int* con;
+  volatile unsigned int* tmr;
+  volatile unsigned int* pr;
+  volatile unsigned int* ifs;
+} TIMER;
+
+static volatile unsigned int no_reg;
+
+// Indexed by timer number.
+static const TIMER timers[] = {
+  { 0 },
+  { &T1CON, &TMR1, &PR1, &_T1IF },
+  { &T2CON, &TMR2, &PR2, &_T2IF },
+  { &T3CON, &TMR3, &PR3, &_T3IF },
+  { &T4CON, &no_reg, &no_reg, &no_reg },
+  { &T5CON, &TMR5, &PR5, &_T5IF }
+};
+
+static unsigned long long Rate(int timer) {
+  static const unsigned int prescale[] = { 1, 8, 64, 256 };
+  unsigned int con;
+  if (timer < 1 || timer > 5) return 0;
+  con = *timers[timer].con;
+  if (!(con & 0x8000)) return 0;
+  return SIM_FCY / prescale[(con >> 4) & 3];
+}
+
+unsigned long long SimTimerRate(int timer) {
+  return timer < 0 ? SIM_FCY : Rate(timer);
+}
+
+void SimTimersStep(SIM_TIME from, SIM_TIME to) {
+  int i;
+  for (i = 1; i <= 5; ++i) {
+    const TIMER* t = &timers[i];
+    unsigned long long rate = Rate(i);
+    unsigned long long ticks, tmr, period;
+    if (!rate || t->tmr == &no_reg) continue;
+    ticks = SimTicks(to, rate) - SimTicks(from, rate);
+    tmr = *t->tmr + ticks;
+    period = *t->pr + 1ULL;
+    if (*t->tmr <= *t->pr && tmr >= period) {
+      // Reset on period match.
+      *t->ifs = 1;
+      tmr %= period;
+    }
+    *t->tmr = tmr & 0xFFFF;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Output compare
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct {
+  unsigned int con1;
+  unsigned int con2;
+  unsigned int rs;
+  unsigned int r;
+  unsigned int tmr;
+} OC_REGS;
+
+// OCTSEL -> timer, -1 for the system clock.
+static const int oc_clock[8] = { 2, 3, 4, 5, 1, -2, -2, -1 };
+
+// The period of an OC's timer, in ticks. It is rs + 1, of the OC itself or of
+// the OC it is synchronized to.
+static unsigned long long PwmPeriod(const volatile OC_REGS* regs) {
+  const unsigned int syncsel = regs->con2 & 0x1F;
+  if (syncsel >= 1 && syncsel <= 9) {
+    regs = (const volatile OC_REGS*) host_oc[syncsel - 1];
+  }
+  return regs->rs + 1ULL;
+}
+
+// Edge-aligned PWM from the OC's own timer, whose period is given by
+// PwmPeriod() and which we assume started at time 0, so that synchronized
+// OCs are in phase. Sets *period and *high in ticks, returns the tick rate or
+// 0 if the output is static at *high != 0.
+static unsigned long long PwmParams(int oc, unsigned long long* period,
+                                    unsigned long long* high) {
+  const volatile OC_REGS* regs = (const volatile OC_REGS*) host_oc[oc];
+  int clock = oc_clock[(regs->con1 >> 10) & 7];
+  unsigned long long rate = clock == -2 ? 0 : SimTimerRate(clock);
+  *period = PwmPeriod(regs);
+  *high = regs->r;
+  if ((regs->con1 & 7) != 6 || !rate) {
+    *high = 0;
+    return 0;
+  }
+  if (*high >= *period) return 0;
+  return *high ? rate : 0;
+}
+
+int SimPwmLevel(int oc, SIM_TIME t) {
+  unsigned long long period, high;
+  unsigned long long rate = PwmParams(oc, &period, &high);
+  if (!rate) return high != 0;
+  return SimTicks(t, rate) % period < high;
+}
+
+void SimPwmStep(SIM_TIME from, SIM_TIME to) {
+  static volatile unsigned int* const ifs[] = {
+    &_OC1IF, &_OC2IF, &_OC3IF, &_OC4IF, &_OC5IF, &_OC6IF, &_OC7IF, &_OC8IF,
+    &_OC9IF
+  };
+  int oc;
+  for (oc = 0; oc < 9; ++oc) {
+    const volatile OC_REGS* regs = (const volatile OC_REGS*) host_oc[oc];
+    int clock = oc_clock[(regs->con1 >> 10) & 7];
+    unsigned long long rate = clock == -2 ? 0 : SimTimerRate(clock);
+    unsigned long long period = PwmPeriod(regs);
+    if ((regs->con1 & 7) != 6 || !rate) continue;
+    if (SimTicks(to, rate) / period != SimTicks(from, rate) / period) {
+      *ifs[oc] = 1;
+    }
+  }
+}
+
+SIM_TIME SimPwmNextEdge(int oc, SIM_TIME after, SIM_TIME until) {
+  unsigned long long period, high, n, pos, edge_tick;
+  SIM_TIME edge;
+  unsigned long long rate = PwmParams(oc, &period, &high);
+  if (!rate) return SIM_NEVER;
+  n = SimTicks(after, rate);
+  pos = n % period;
+  edge_tick = n - pos + (pos < high ? high : period);
+  edge = SimTickTime(edge_tick, rate);
+  return edge <= until ? edge : SIM_NEVER;
+}
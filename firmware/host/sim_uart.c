@@ -0,0 +1,194 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+// UARTs, at the byte level: a 4-deep TX FIFO feeding the shift register at
+// the configured baud rate and a 4-deep RX FIFO. A transmitted byte is
+// received by every enabled UART whose RX pin is the TX pin or is wired to it.
+
+#include "sim.h"
+
+#include <string.h>
+
+#include "Compiler.h"
+
+#define FIFO_SIZE 4
+
+// uxmode
+#define UARTEN 0x8000
+#define BRGH 0x0008
+// uxsta
+#define UTXEN 0x0400
+#define UTXBF 0x0200
+#define TRMT 0x0100
+#define OERR 0x0002
+#define URXDA 0x0001
+#define STA_READ_ONLY 0x031D
+
+enum { REG_MODE, REG_STA, REG_TXREG, REG_RXREG, REG_BRG };
+
+typedef struct {
+  BYTE tx_fifo[FIFO_SIZE];
+  int tx_count;
+  BOOL shifting;
+  BYTE shift_byte;
+  SIM_TIME shift_done;
+  BYTE rx_fifo[FIFO_SIZE];
+  int rx_count;
+  BOOL txen;
+} SIM_UART;
+
+static SIM_UART uarts[NUM_UART_MODULES];
+
+static volatile unsigned int* const rxr[] = {
+  &_U1RXR, &_U2RXR, &_U3RXR, &_U4RXR
+};
+static volatile unsigned int* const txif[] = {
+  &_U1TXIF, &_U2TXIF, &_U3TXIF, &_U4TXIF
+};
+static volatile unsigned int* const rxif[] = {
+  &_U1RXIF, &_U2RXIF, &_U3RXIF, &_U4RXIF
+};
+// Peripheral pin select output function numbers.
+static const int tx_func[] = { 3, 5, 28, 30 };
+
+static void UpdateStatus(int n) {
+  SIM_UART* u = &uarts[n];
+  volatile UART* reg = &host_io.uart[n];
+  unsigned int sta = reg->uxsta & ~STA_READ_ONLY;
+  if (u->tx_count == FIFO_SIZE) sta |= UTXBF;
+  if (!u->tx_count && !u->shifting) sta |= TRMT;
+  if (u->rx_count) sta |= URXDA;
+  reg->uxsta = sta;
+  reg->uxrxreg = u->rx_count ? u->rx_fifo[0] : 0;
+}
+
+static SIM_TIME FrameTime(int n) {
+  volatile UART* reg = &host_io.uart[n];
+  int bits = 1 + 8 + 1;
+  if ((reg->uxmode & 6) == 6) ++bits;       // 9-bit
+  else if (reg->uxmode & 6) ++bits;         // parity
+  if (reg->uxmode & 1) ++bits;              // 2 stop bits
+  return (SIM_TIME) bits * (reg->uxmode & BRGH ? 4 : 16) * (reg->uxbrg + 1)
+         * SIM_TCY;
+}
+
+static void Receive(int n, BYTE b) {
+  SIM_UART* u = &uarts[n];
+  if (u->rx_count == FIFO_SIZE) {
+    host_io.uart[n].uxsta |= OERR;
+    return;
+  }
+  u->rx_fifo[u->rx_count++] = b;
+  *rxif[n] = 1;
+  UpdateStatus(n);
+}
+
+static void Deliver(int n, BYTE b) {
+  int tx_pin = SimPinFromOutputFunction(tx_func[n]);
+  int m;
+  for (m = 0; m < NUM_UART_MODULES; ++m) {
+    if ((host_io.uart[m].uxmode & UARTEN)
+        && SimPinConnected(tx_pin, SimPinFromRpin(*rxr[m]))) {
+      Receive(m, b);
+    }
+  }
+}
+
+// Moves the next byte from the FIFO to the shift register, starting at t.
+static void LoadShifter(int n, SIM_TIME t) {
+  SIM_UART* u = &uarts[n];
+  if (!u->tx_count) {
+    u->shifting = FALSE;
+    return;
+  }
+  u->shift_byte = u->tx_fifo[0];
+  memmove(u->tx_fifo, u->tx_fifo + 1, --u->tx_count);
+  u->shifting = TRUE;
+  u->shift_done = t + FrameTime(n);
+  // UTXISEL = 10: interrupt when the TX buffer becomes empty.
+  if (!u->tx_count) *txif[n] = 1;
+}
+
+static void ResetUart(int n) {
+  memset(&uarts[n], 0, sizeof uarts[n]);
+}
+
+void SimUartReset() {
+  int i;
+  for (i = 0; i < NUM_UART_MODULES; ++i) {
+    ResetUart(i);
+    UpdateStatus(i);
+  }
+}
+
+void SimUartAccess(int n, int reg, BOOL write) {
+  SIM_UART* u = &uarts[n];
+  volatile UART* regs = &host_io.uart[n];
+  if (n >= NUM_UART_MODULES) return;
+  switch (reg) {
+    case REG_MODE:
+      if (write && !(regs->uxmode & UARTEN)) ResetUart(n);
+      break;
+
+    case REG_STA:
+      if (write) {
+        BOOL txen = (regs->uxsta & UTXEN) && (regs->uxmode & UARTEN);
+        // Enabling the transmitter raises the TX interrupt: buffer is empty.
+        if (txen && !u->txen) *txif[n] = 1;
+        u->txen = txen;
+      }
+      break;
+
+    case REG_TXREG:
+      if (write && u->txen && u->tx_count < FIFO_SIZE) {
+        u->tx_fifo[u->tx_count++] = regs->uxtxreg;
+        if (!u->shifting) LoadShifter(n, sim_now);
+      }
+      break;
+
+    case REG_RXREG:
+      if (!write && u->rx_count) {
+        memmove(u->rx_fifo, u->rx_fifo + 1, --u->rx_count);
+      }
+      break;
+  }
+  UpdateStatus(n);
+}
+
+void SimUartStep(SIM_TIME from, SIM_TIME to) {
+  int n;
+  for (n = 0; n < NUM_UART_MODULES; ++n) {
+    SIM_UART* u = &uarts[n];
+    while (u->shifting && u->shift_done <= to) {
+      Deliver(n, u->shift_byte);
+      LoadShifter(n, u->shift_done);
+    }
+    UpdateStatus(n);
+  }
+}
@@ -0,0 +1,395 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+
+// Virtual IOIO: the application firmware running on Linux, against the
+// peripheral models of sim.h, speaking the IOIO protocol over TCP.
+//
+// Like a real IOIO reaching IOIOLib through ADB's "tcp:4545" forward, the
+// virtual IOIO connects to a listening IOIOLib (SocketIOIOConnection, port
+// 4545 by default), so a PC or emulator app connects to it unchanged. It takes
+// the place of main.c: when the connection closes it soft-resets and connects
+// again, a hard reset also resets all the registers.
+//
+// Virtual time either follows the wall clock (optionally scaled), or advances
+// by a fixed amount per main loop iteration, which makes runs reproducible
+// regardless of how fast the host is. Within an iteration, time advances in
+// steps of at most the quantum, with interrupts serviced after each step.
+//
+// When a connection ends, a JSON line with its statistics goes to stdout.
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sim.h"
+
+#include "Compiler.h"
+#include "connection.h"
+#include "features.h"
+#include "protocol.h"
+#include "timer.h"
+
+#define MAX_PACKET 4096
+
+const char bootloader_version[8] = "HOST0000";
+const char hardware_version[8] = "SPRK0020";
+
+typedef enum {
+  CLOCK_MODE_REALTIME,
+  CLOCK_MODE_STEP
+} CLOCK_MODE;
+
+static const char* host = "127.0.0.1";
+static const char* port = "4545";
+static CLOCK_MODE clock_mode = CLOCK_MODE_REALTIME;
+static double clock_speed = 1.0;
+static SIM_TIME clock_step = SIM_US(10);
+static SIM_TIME quantum = SIM_US(10);
+static int max_connections = 0;
+
+static int sock = -1;
+static BOOL link_broken;
+static jmp_buf reset_jmp;
+
+static struct {
+  unsigned long long loops;
+  unsigned long long bytes_in;
+  unsigned long long bytes_out;
+  unsigned long long packets_out;
+} stats;
+
+////////////////////////////////////////////////////////////////////////////////
+// Connection layer (libconn/connection.h)
+////////////////////////////////////////////////////////////////////////////////
+
+BOOL ConnectionCanSend(CHANNEL_HANDLE ch) {
+  return !link_broken;
+}
+
+int ConnectionGetMaxPacket(CHANNEL_HANDLE ch) {
+  return MAX_PACKET;
+}
+
+int ConnectionSendSplit(CHANNEL_HANDLE ch, const void* data1, int size1,
+                        const void* data2, int size2) {
+  struct iovec iov[2] = {
+    { (void*) data1, size1 },
+    { (void*) data2, size2 }
+  };
+  struct msghdr msg = { .msg_iov = iov, .msg_iovlen = 2 };
+  int total = size1 + size2;
+  int left = total;
+  while (left > 0 && !link_broken) {
+    ssize_t n = sendmsg(ch, &msg, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno != EINTR) link_broken = TRUE;
+      continue;
+    }
+    left -= n;
+    while (n > 0 && msg.msg_iovlen) {
+      if (n >= msg.msg_iov->iov_len) {
+        n -= msg.msg_iov->iov_len;
+        ++msg.msg_iov;
+        --msg.msg_iovlen;
+      } else {
+        msg.msg_iov->iov_base = (BYTE*) msg.msg_iov->iov_base + n;
+        msg.msg_iov->iov_len -= n;
+        n = 0;
+      }
+    }
+  }
+  stats.bytes_out += total;
+  ++stats.packets_out;
+  return total;
+}
+
+void ConnectionCloseChannel(CHANNEL_HANDLE ch) {
+  link_broken = TRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Hooks required by the host shims
+////////////////////////////////////////////////////////////////////////////////
+
+static void Advance(SIM_TIME dt) {
+  while (dt) {
+    SIM_TIME d = dt < quantum ? dt : quantum;
+    SimAdvance(d);
+    dt -= d;
+  }
+}
+
+void HostDelayUs(DWORD us) {
+  Advance(SIM_US(us));
+}
+
+void HostReset() {
+  longjmp(reset_jmp, 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Main loop
+////////////////////////////////////////////////////////////////////////////////
+
+static double WallTime() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int Connect() {
+  struct addrinfo hints, *res, *ai;
+  int fd = -1, one = 1, waiting = 0;
+  memset(&hints, 0, sizeof hints);
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(host, port, &hints, &res)) {
+    fprintf(stderr, "vioio: can't resolve %s:%s\n", host, port);
+    exit(1);
+  }
+  while (fd < 0) {
+    for (ai = res; ai; ai = ai->ai_next) {
+      fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+      if (fd < 0) continue;
+      if (!connect(fd, ai->ai_addr, ai->ai_addrlen)) break;
+      close(fd);
+      fd = -1;
+    }
+    if (fd < 0) {
+      if (!waiting++) {
+        fprintf(stderr, "vioio: waiting for IOIOLib on %s:%s\n", host, port);
+      }
+      sleep(1);
+    }
+  }
+  freeaddrinfo(res);
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+  return fd;
+}
+
+static void Tick(double wall_start, SIM_TIME virtual_start) {
+  if (clock_mode == CLOCK_MODE_STEP) {
+    Advance(clock_step);
+  } else {
+    double elapsed = (WallTime() - wall_start) * clock_speed;
+    SIM_TIME target = virtual_start + (SIM_TIME) (elapsed * SIM_PS_PER_SEC);
+    // Delays may have run ahead of the wall clock.
+    if (target > sim_now) Advance(target - sim_now);
+  }
+}
+
+// Serves one connection, until it closes.
+static void Serve(int connection) {
+  static BYTE buf[MAX_PACKET];
+  double wall_start = WallTime();
+  SIM_TIME virtual_start = sim_now;
+  SIM_STATS sim_start = sim_stats;
+
+  memset(&stats, 0, sizeof stats);
+  link_broken = FALSE;
+  fprintf(stderr, "vioio: connected\n");
+  AppProtocolInit(sock);
+  while (!link_broken) {
+    ssize_t n = recv(sock, buf, sizeof buf, MSG_DONTWAIT);
+    if (n == 0) break;
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+      break;
+    }
+    if (n > 0) {
+      stats.bytes_in += n;
+      if (!AppProtocolHandleIncoming(buf, n)) {
+        fprintf(stderr, "vioio: protocol error\n");
+        break;
+      }
+    }
+    AppProtocolTasks(sock);
+    Tick(wall_start, virtual_start);
+    ++stats.loops;
+  }
+  fprintf(stderr, "vioio: disconnected\n");
+  printf("{\"connection\": %d, \"virtual_s\": %.6f, \"wall_s\": %.6f, "
+         "\"loops\": %llu, \"bytes_in\": %llu, \"bytes_out\": %llu, "
+         "\"packets_out\": %llu, \"interrupts\": %llu, \"traps\": %llu}\n",
+         connection, (double) (sim_now - virtual_start) / SIM_PS_PER_SEC,
+         WallTime() - wall_start, stats.loops, stats.bytes_in,
+         stats.bytes_out, stats.packets_out,
+         sim_stats.interrupts - sim_start.interrupts,
+         sim_stats.traps - sim_start.traps);
+  fflush(stdout);
+}
+
+static void Usage(const char* argv0) {
+  fprintf(stderr,
+    "Usage: %s [options]\n"
+    "  -H, --host HOST         IOIOLib host (default 127.0.0.1)\n"
+    "  -p, --port PORT         IOIOLib port (default 4545)\n"
+    "  -c, --clock MODE        realtime[:SPEED] - virtual time follows the\n"
+    "                          wall clock, times SPEED (default realtime:1)\n"
+    "                          step:US - every main loop iteration advances\n"
+    "                          virtual time by US microseconds\n"
+    "  -q, --quantum US        longest step between interrupt services\n"
+    "                          (default 10)\n"
+    "  -s, --signal PIN=SPEC   attach a signal source to a pin, SPEC is\n"
+    "                          dc:VOLTS, square:HZ[:DUTY],\n"
+    "                          sine:HZ[:AMPL[:OFFSET]] or triangle:HZ\n"
+    "  -w, --wire FROM:TO      drive pin TO from pin FROM, e.g. for UART or\n"
+    "                          SPI loopback\n"
+    "  -i, --i2c NUM:ADDR      attach a 256-byte register file device with\n"
+    "                          7-bit address ADDR to I2C module NUM\n"
+    "  -n, --connections N     exit after N connections\n",
+    argv0);
+  exit(2);
+}
+
+static BOOL ValidPin(long pin) {
+  return pin >= 0 && pin < NUM_PINS;
+}
+
+static void ParseArgs(int argc, char* argv[]) {
+  static const struct option options[] = {
+    { "host", required_argument, NULL, 'H' },
+    { "port", required_argument, NULL, 'p' },
+    { "clock", required_argument, NULL, 'c' },
+    { "quantum", required_argument, NULL, 'q' },
+    { "signal", required_argument, NULL, 's' },
+    { "wire", required_argument, NULL, 'w' },
+    { "i2c", required_argument, NULL, 'i' },
+    { "connections", required_argument, NULL, 'n' },
+    { "help", no_argument, NULL, 'h' },
+    { NULL, 0, NULL, 0 }
+  };
+  int opt;
+  while ((opt = getopt_long(argc, argv, "H:p:c:q:s:w:i:n:h", options, NULL))
+         != -1) {
+    char* end;
+    long a, b;
+    double d;
+    SIM_SIGNAL sig;
+    switch (opt) {
+      case 'H':
+        host = optarg;
+        break;
+
+      case 'p':
+        port = optarg;
+        break;
+
+      case 'c':
+        if (!strncmp(optarg, "step:", 5)) {
+          d = strtod(optarg + 5, &end);
+          if (*end || !(d > 0)) Usage(argv[0]);
+          clock_mode = CLOCK_MODE_STEP;
+          clock_step = (SIM_TIME) (d * SIM_US(1));
+        } else if (!strcmp(optarg, "realtime")) {
+          clock_mode = CLOCK_MODE_REALTIME;
+        } else if (!strncmp(optarg, "realtime:", 9)) {
+          d = strtod(optarg + 9, &end);
+          if (*end || !(d > 0)) Usage(argv[0]);
+          clock_mode = CLOCK_MODE_REALTIME;
+          clock_speed = d;
+        } else {
+          Usage(argv[0]);
+        }
+        break;
+
+      case 'q':
+        d = strtod(optarg, &end);
+        if (*end || !(d > 0)) Usage(argv[0]);
+        quantum = (SIM_TIME) (d * SIM_US(1));
+        break;
+
+      case 's':
+        a = strtol(optarg, &end, 10);
+        if (*end != '=' || !ValidPin(a) || !SimSignalParse(end + 1, &sig)) {
+          Usage(argv[0]);
+        }
+        SimPinSetSignal(a, &sig);
+        break;
+
+      case 'w':
+        a = strtol(optarg, &end, 10);
+        if (*end != ':') Usage(argv[0]);
+        b = strtol(end + 1, &end, 10);
+        if (*end || !ValidPin(a) || !ValidPin(b) || a == b) Usage(argv[0]);
+        SimPinSetWire(a, b);
+        break;
+
+      case 'i':
+        a = strtol(optarg, &end, 10);
+        if (*end != ':') Usage(argv[0]);
+        b = strtol(end + 1, &end, 0);
+        if (*end || a < 0 || a >= NUM_I2C_MODULES || b < 0 || b > 0x7F) {
+          Usage(argv[0]);
+        }
+        SimI2CAttach(a, SimI2CNewRegisterFile(b));
+        break;
+
+      case 'n':
+        max_connections = atoi(optarg);
+        break;
+
+      default:
+        Usage(argv[0]);
+    }
+  }
+  if (optind != argc) Usage(argv[0]);
+}
+
+int main(int argc, char* argv[]) {
+  static int connection;
+  // Before ParseArgs(), which configures the models.
+  SimInit();
+  ParseArgs(argc, argv);
+  if (setjmp(reset_jmp)) {
+    fprintf(stderr, "vioio: hard reset\n");
+    if (sock >= 0) close(sock);
+    sock = -1;
+    SimReset();
+  }
+  SoftReset();
+  while (!max_connections || connection < max_connections) {
+    sock = Connect();
+    Serve(++connection);
+    close(sock);
+    sock = -1;
+    SoftReset();
+  }
+  return 0;
+}
@@ -0,0 +1,238 @@
+#!/usr/bin/python3
+
+#
+# Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+#
+#
+# Redistribution and use in source and binary forms, with or without modification, are
+# permitted provided that the following conditions are met:
+#
+#    1. Redistributions of source code must retain the above copyright notice, this list of
+#       conditions and the following disclaimer.
+#
+#    2. Redistributions in binary form must reproduce the above copyright notice, this list
+#       of conditions and the following disclaimer in the documentation and/or other materials
+#       provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+# WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+# FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+# SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+# ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+# NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+# ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+# The views and conclusions contained in the software and documentation are those of the
+# authors and should not be interpreted as representing official policies, either expressed
+# or implied.
+#
+
+# End-to-end checks of the virtual IOIO: each one starts build/vioio, plays
+# the IOIOLib side of the protocol over TCP and checks what comes back.
+#
+# Usage: vioio_check.py [path to vioio]
+
+import socket
+import struct
+import subprocess
+import sys
+import time
+
+ESTABLISH_CONNECTION = 0x00
+SET_PIN_DIGITAL_OUT = 0x03
+SET_DIGITAL_OUT_LEVEL = 0x04
+REPORT_DIGITAL_IN_STATUS = 0x04
+SET_PIN_DIGITAL_IN = 0x05
+SET_CHANGE_NOTIFY = 0x06
+SET_PIN_PWM = 0x08
+SET_PWM_PERIOD = 0x0A
+INCAP_CONFIGURE = 0x1B
+INCAP_STATUS = 0x1B
+SET_PIN_INCAP = 0x1C
+INCAP_REPORT = 0x1C
+SOFT_CLOSE = 0x1D
+CONTROL_CONFIG = 0x3A
+CONTROL_STATUS = 0x3A
+CONTROL_PARAMS = 0x3B
+ENCODER_CONFIG = 0x2E
+ENCODER_STATUS = 0x2E
+ENCODER_READ = 0x2F
+ENCODER_REPORT = 0x2F
+CONTROL_REPORT = 0x3B
+
+CONTROL_INCAP = 2
+
+
+class Device:
+    """A vioio process connected to us."""
+
+    # Argument sizes of the outgoing messages the checks expect.
+    ARG_SIZES = {
+        ESTABLISH_CONNECTION: 28,
+        REPORT_DIGITAL_IN_STATUS: 1,
+        SET_CHANGE_NOTIFY: 1,
+        ENCODER_STATUS: 1,
+        ENCODER_REPORT: 13,
+        INCAP_STATUS: 1,
+        CONTROL_STATUS: 1,
+        CONTROL_REPORT: 7,
+    }
+
+    def __init__(self, vioio, args):
+        server = socket.socket()
+        server.bind(('127.0.0.1', 0))
+        server.listen(1)
+        port = server.getsockname()[1]
+        self.process = subprocess.Popen(
+            [vioio, '-p', str(port), '-n', '1'] + args,
+            stdout=subprocess.DEVNULL)
+        server.settimeout(5)
+        self.sock, _ = server.accept()
+        self.sock.settimeout(5)
+        server.close()
+        self.buf = b''
+        msg_type, _ = self.read()
+        assert msg_type == ESTABLISH_CONNECTION
+
+    def send(self, *data):
+        self.sock.sendall(bytes(data))
+
+    def take(self, size):
+        while len(self.buf) < size:
+            data = self.sock.recv(4096)
+            if not data:
+                raise EOFError
+            self.buf += data
+        result, self.buf = self.buf[:size], self.buf[size:]
+        return result
+
+    def read(self):
+        msg_type = self.take(1)[0]
+        if msg_type == INCAP_REPORT:
+            header = self.take(1)
+            return msg_type, header + self.take([4, 1, 2, 3][header[0] >> 6])
+        if msg_type not in self.ARG_SIZES:
+            raise Exception('Unexpected message 0x%02X' % msg_type)
+        return msg_type, self.take(self.ARG_SIZES[msg_type])
+
+    def close(self):
+        self.send(SOFT_CLOSE)
+        self.sock.close()
+        try:
+            self.process.wait(timeout=5)
+        except subprocess.TimeoutExpired:
+            self.process.kill()
+            self.process.wait()
+
+
+def check_control_incap(vioio):
+    """A loop on an input capture module runs once per capture, with no analog
+    input open to run the ADC scan."""
+    dev = Device(vioio, ['-c', 'step:10', '-s', '10=square:100'])
+    try:
+        # PWM 2 on pin 3, 5000 clocks.
+        dev.send(SET_PIN_PWM, 3, 0x80 | 2)
+        dev.send(SET_PWM_PERIOD, 2 << 2, *struct.pack('<H', 5000))
+        # Input capture 0 on pin 10, measuring periods at 2MHz: 20000 ticks.
+        dev.send(SET_PIN_INCAP, 10, 0x80 | 0)
+        dev.send(INCAP_CONFIGURE, 0, (3 << 3) | 1)
+        # Integral only, setpoint 30000, ki 1/256, reporting every run.
+        dev.send(CONTROL_PARAMS, 1 | (8 << 4),
+                 *struct.pack('<ihhh', 30000, 0, 1, 0))
+        dev.send(CONTROL_CONFIG, 1 | (CONTROL_INCAP << 6), 0, 2,
+                 *struct.pack('<HHH', 0, 5000, 1))
+        captures = 0
+        runs = 0
+        acc = 0
+        while runs < 20:
+            msg_type, args = dev.read()
+            if msg_type == INCAP_REPORT:
+                captures += 1
+                assert captures <= runs + 1, (
+                    'No run for capture %d' % (captures - 1))
+            elif msg_type == CONTROL_STATUS:
+                assert args[0] & 0x80, 'Loop not enabled'
+            elif msg_type == CONTROL_REPORT:
+                runs += 1
+                loop_input, output = struct.unpack('<IH', args[1:])
+                # Each run integrates the error of one capture, no more.
+                acc = min(acc + 30000 - loop_input, 5000 << 8)
+                assert output == acc >> 8, (
+                    'Run %d: output %d, expected %d'
+                    % (runs, output, acc >> 8))
+                assert captures == runs, (
+                    '%d runs for %d captures' % (runs, captures))
+    finally:
+        dev.close()
+
+
+def check_encoder_change_notify(vioio):
+    """An encoder and change notification on the same pin turn on and off
+    without stopping each other."""
+    # Pins 3 and 4 drive the encoder lines on pins 10 and 11.
+    dev = Device(vioio, ['-w', '3:10', '-w', '4:11'])
+    try:
+        def expect(msg_type, args, mask=0xFF):
+            # Only the bits in mask of the first argument byte count.
+            got_type, got = dev.read()
+            got = bytes([got[0] & mask]) + got[1:]
+            assert (got_type, got) == (msg_type, bytes(args)), (
+                'Got %r, expected %r'
+                % ((got_type, got), (msg_type, bytes(args))))
+
+        def turn(steps):
+            # Gray code steps of A (pin 3) and B (pin 4), forward.
+            for a, b in [(1, 0), (1, 1), (0, 1), (0, 0)][:steps]:
+                dev.send(SET_DIGITAL_OUT_LEVEL, a | 3 << 2)
+                dev.send(SET_DIGITAL_OUT_LEVEL, b | 4 << 2)
+                time.sleep(0.05)
+
+        def position():
+            dev.send(ENCODER_READ, 0)
+            msg_type, args = dev.read()
+            assert msg_type == ENCODER_REPORT
+            return struct.unpack('<i', args[1:5])[0]
+
+        dev.send(SET_PIN_DIGITAL_OUT, 3 << 2, SET_PIN_DIGITAL_OUT, 4 << 2)
+        dev.send(SET_PIN_DIGITAL_IN, 10 << 2, SET_PIN_DIGITAL_IN, 11 << 2)
+        dev.send(ENCODER_CONFIG, 0x80, 10, 11, 0, 0)
+        expect(ENCODER_STATUS, [0x80], 0x83)
+        dev.send(SET_CHANGE_NOTIFY, 1 | 10 << 2)
+        expect(SET_CHANGE_NOTIFY, [1 | 10 << 2])
+        expect(REPORT_DIGITAL_IN_STATUS, [10 << 2])
+        dev.send(SET_CHANGE_NOTIFY, 10 << 2)
+        expect(SET_CHANGE_NOTIFY, [10 << 2])
+        turn(4)
+        assert position() == 4, 'Encoder stopped along with change notification'
+
+        dev.send(SET_CHANGE_NOTIFY, 1 | 10 << 2)
+        expect(SET_CHANGE_NOTIFY, [1 | 10 << 2])
+        expect(REPORT_DIGITAL_IN_STATUS, [10 << 2])
+        dev.send(ENCODER_CONFIG, 0, 10, 11, 0, 0)
+        expect(ENCODER_STATUS, [0], 0x83)
+        turn(1)
+        expect(REPORT_DIGITAL_IN_STATUS, [1 | 10 << 2])
+    finally:
+        dev.close()
+
+
+CHECKS = [check_control_incap, check_encoder_change_notify]
+
+
+def main():
+    vioio = sys.argv[1] if len(sys.argv) > 1 else 'build/vioio'
+    failures = 0
+    for check in CHECKS:
+        try:
+            check(vioio)
+            print('%s: passed' % check.__name__)
+        except Exception as e:
+            print('%s: FAILED: %s' % (check.__name__, e))
+            failures += 1
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == '__main__':
+    main()
@@ -53,16 +53,15 @@ static uint8_t buf[5];
 
 static void Flush() {
   if (ConnectionCanSend(handle)) {
-    const BYTE *data;
+    const BYTE *data1, *data2;
+    int size1, size2;
     if (out_size) {
       ByteQueuePull(&out_queue, out_size);
+      out_size = 0;
     }
-    ByteQueuePeek(&out_queue, &data, &out_size);
-    if (out_size > max_packet) {
-      out_size = max_packet;
-    }
-    if (out_size) {
-      ConnectionSend(handle, data, out_size);
+    ByteQueuePeekMax(&out_queue, max_packet, &data1, &size1, &data2, &size2);
+    if (size1) {
+      out_size = ConnectionSendSplit(handle, data1, size1, data2, size2);
     }
   }
 }
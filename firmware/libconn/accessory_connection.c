@@ -127,6 +127,15 @@ static void AccessorySend(int h, const void *data, int size) {
   USBHostAndroidWrite(data, size, ANDROID_INTERFACE_ACC);
 }
 
+static int AccessorySendSplit(int h, const void *data1, int size1,
+                              const void *data2, int size2) {
+  const void *data;
+  int size = ConnectionGather(connection_gather_buf, CONNECTION_GATHER_SIZE,
+                              &data, data1, size1, data2, size2);
+  AccessorySend(h, data, size);
+  return size;
+}
+
 static int AccessoryCanSend(int h) {
   BYTE err;
   assert(h == 0);
@@ -161,6 +170,7 @@ const CONNECTION_FACTORY accessory_connection_factory = {
   AccessoryOpenChannel,
   AccessoryCloseChannel,
   AccessorySend,
+  AccessorySendSplit,
   AccessoryCanSend,
   AccessoryMaxPacketSize
 };
@@ -67,6 +67,15 @@ static void ADBConSend(int h, const void *data, int size) {
   ADBWrite(h, data, size);
 }
 
+static int ADBConSendSplit(int h, const void *data1, int size1,
+                           const void *data2, int size2) {
+  const void *data;
+  int size = ConnectionGather(connection_gather_buf, CONNECTION_GATHER_SIZE,
+                              &data, data1, size1, data2, size2);
+  ADBWrite(h, data, size);
+  return size;
+}
+
 static int ADBConCanSend(int h) {
   return ADBChannelReady(h);
 }
@@ -83,6 +92,7 @@ const CONNECTION_FACTORY adb_connection_factory = {
   ADBConOpenChannel,
   ADBConCloseChannel,
   ADBConSend,
+  ADBConSendSplit,
   ADBConCanSend,
   ADBConMaxPacketSize
 };
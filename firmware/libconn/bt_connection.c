@@ -46,6 +46,8 @@
 #include "hci_transport.h"
 #include "btstack/sdp_util.h"
 
+#define BT_MAX_PACKET 242  // TODO: 244?
+
 typedef enum {
   STATE_DETACHED,
   STATE_ATTACHED
@@ -234,6 +236,15 @@ static void BTSend(int h, const void *data, int size) {
   rfcomm_send_internal(rfcomm_channel_id, (uint8_t *) data, size & 0xFFFF);
 }
 
+static int BTSendSplit(int h, const void *data1, int size1,
+                       const void *data2, int size2) {
+  const void *data;
+  int size = ConnectionGather(connection_gather_buf, CONNECTION_GATHER_SIZE,
+                              &data, data1, size1, data2, size2);
+  BTSend(h, data, size);
+  return size;
+}
+
 static int BTCanSend(int h) {
   assert(h == 0);
   return rfcomm_can_send(rfcomm_channel_id);
@@ -249,7 +260,7 @@ static int BTIsAvailable() {
 }
 
 static int BTMaxPacketSize(int h) {
-  return 242;  // TODO: 244?
+  return BT_MAX_PACKET;
 }
 
 const CONNECTION_FACTORY bt_connection_factory = {
@@ -260,6 +271,7 @@ const CONNECTION_FACTORY bt_connection_factory = {
   BTOpen,
   BTClose,
   BTSend,
+  BTSendSplit,
   BTCanSend,
   BTMaxPacketSize
 };
@@ -37,6 +37,8 @@
 #include "USB/usb.h"
 #include "USB/usb_function_cdc.h"
 
+#define CDC_MAX_PACKET 255
+
 typedef enum {
   CHANNEL_DETACHED,
   CHANNEL_WAIT_DTE,
@@ -123,6 +125,15 @@ static void CDCSend(int h, const void *data, int size) {
   putUSBUSART((char *) data, size);
 }
 
+static int CDCSendSplit(int h, const void *data1, int size1,
+                        const void *data2, int size2) {
+  const void *data;
+  int size = ConnectionGather(connection_gather_buf, CONNECTION_GATHER_SIZE,
+                              &data, data1, size1, data2, size2);
+  CDCSend(h, data, size);
+  return size;
+}
+
 static int CDCCanSend(int h) {
   assert(h == 0);
   if (channel_state != CHANNEL_OPEN) return 0;
@@ -140,7 +151,7 @@ int CDCIsReadyToOpen() {
 int CDCMaxPacketSize(int h) {
   assert(h == 0);
 //  return INT_MAX; // unlimited
-  return 255;
+  return CDC_MAX_PACKET;
 }
 
 const CONNECTION_FACTORY cdc_connection_factory = {
@@ -151,6 +162,7 @@ const CONNECTION_FACTORY cdc_connection_factory = {
   CDCOpenChannel,
   CDCCloseChannel,
   CDCSend,
+  CDCSendSplit,
   CDCCanSend,
   CDCMaxPacketSize
 };
@@ -45,6 +45,7 @@
 static uint8_t buf[BUF_SIZE];  // shared between Bluetooth and Accessory, as
                                // they are mutually exclusive. ADB currently
                                // conveniently ignores this.
+uint8_t connection_gather_buf[CONNECTION_GATHER_SIZE];
 
 static const CONNECTION_FACTORY *factories[CHANNEL_TYPE_MAX] = {
   &adb_connection_factory,
@@ -120,6 +121,13 @@ void ConnectionSend(CHANNEL_HANDLE ch, const void *data, int size) {
   factories[t]->connectionSend(h, data, size);
 }
 
+int ConnectionSendSplit(CHANNEL_HANDLE ch, const void *data1, int size1,
+                        const void *data2, int size2) {
+  int t = ch >> 12;
+  int h = ch & 0x0FFF;
+  return factories[t]->connectionSendSplit(h, data1, size1, data2, size2);
+}
+
 BOOL ConnectionCanSend(CHANNEL_HANDLE ch) {
   int t = ch >> 12;
   int h = ch & 0x0FFF;
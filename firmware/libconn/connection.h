@@ -79,6 +79,14 @@ CHANNEL_HANDLE ConnectionOpenChannelAccessory(ChannelCallback cb,
 CHANNEL_HANDLE ConnectionOpenChannelCdc(ChannelCallback cb,
                                         int_or_ptr_t cb_arg);
 void ConnectionSend(CHANNEL_HANDLE ch, const void *data, int size);
+
+// Send data given in two parts (e.g. both sides of a wrapped-around ring
+// buffer) in a single frame. The data must remain valid until the channel can
+// send again.
+// The total size should not exceed ConnectionGetMaxPacket().
+// Returns the number of bytes actually sent, which is never less than size1.
+int ConnectionSendSplit(CHANNEL_HANDLE ch, const void *data1, int size1,
+                        const void *data2, int size2);
 BOOL ConnectionCanSend(CHANNEL_HANDLE ch);
 void ConnectionCloseChannel(CHANNEL_HANDLE ch);
 int ConnectionGetMaxPacket(CHANNEL_HANDLE ch);
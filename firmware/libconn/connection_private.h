@@ -31,6 +31,7 @@
 #define __CONNECTIONPRIVATE_H__
 
 #include <stdint.h>
+#include <string.h>
 #include "connection.h"
 
 typedef struct {
@@ -42,10 +43,46 @@ typedef struct {
                         int_or_ptr_t cb_args);
   void (*connectionClose)(int h);
   void (*connectionSend)(int h, const void *data, int size);
+  int (*connectionSendSplit)(int h, const void *data1, int size1,
+                             const void *data2, int size2);
   int (*connectionCanSend)(int h);
   int (*connectionMaxPacketSize)(int h);
 } CONNECTION_FACTORY;
 
+// Frames that wrap around the client's buffer are assembled here, see
+// ConnectionGather(). All transports share it, since only the app's one
+// channel sends split data. It fits a whole max packet of BT and of CDC. ADB
+// and accessory writes have no size limit, so there it only bounds how much of
+// a wrapping frame goes out in one write. The fwbench tx_frames cases measure
+// what a larger buffer would gain.
+#define CONNECTION_GATHER_SIZE 256
+extern uint8_t connection_gather_buf[CONNECTION_GATHER_SIZE];
+
+// Helper for implementing connectionSendSplit() on top of a transport that can
+// only transmit from a single buffer, which must remain valid until the send
+// completes.
+// If the data is contiguous, or its first part alone fills gather_buf, the
+// first part is sent as-is. Otherwise, as much of both parts as fits is copied
+// into gather_buf.
+// Returns the number of bytes to send, starting at *data. This is never less
+// than size1.
+static inline int ConnectionGather(void *gather_buf, int gather_size,
+                                   const void **data,
+                                   const void *data1, int size1,
+                                   const void *data2, int size2) {
+  int size;
+  if (size2 == 0 || size1 >= gather_size) {
+    *data = data1;
+    return size1;
+  }
+  size = size1 + size2;
+  if (size > gather_size) size = gather_size;
+  memcpy(gather_buf, data1, size1);
+  memcpy(((uint8_t *) gather_buf) + size1, data2, size - size1);
+  *data = gather_buf;
+  return size;
+}
+
 
 #endif  // __CONNECTIONPRIVATE_H__
 
@@ -93,6 +93,115 @@ import ioio.lib.api.exception.ConnectionLostException;
  * @see IOIO#openAnalogInput(int)
  */
 public interface AnalogInput extends Closeable {
+	/**
+	 * A filter the IOIO applies to an input on every scan, before the sample
+	 * is reported or used by a {@link Reflex} or {@link ControlLoop}.
+	 * <p>
+	 * Filtering on the IOIO smooths out noise at the full scan rate, even when
+	 * only a fraction of the samples are reported, and so suits decimated or
+	 * deadbanded inputs in particular. The arithmetic is fixed-point, and the
+	 * result is within one count of the exact one.
+	 */
+	public static class Filter {
+		/** Kinds of filter. */
+		public enum Type {
+			/** Samples are passed as they are. */
+			NONE,
+			/** The average of the last few samples. */
+			MOVING_AVERAGE,
+			/** A single-pole low-pass. */
+			EXPONENTIAL,
+			/** A weighted sum of the last few samples. */
+			FIR
+		}
+
+		/** The maximum number of samples of a moving average or an FIR. */
+		public static final int MAX_LENGTH = 16;
+
+		/** No filter, which is the default. */
+		public static final Filter NONE = new Filter(Type.NONE, 0, null);
+
+		/** The kind of filter. */
+		public final Type type;
+
+		/**
+		 * The number of samples averaged, the shift of an exponential filter,
+		 * or the number of taps of an FIR, depending on the type.
+		 */
+		public final int param;
+
+		private final float[] taps_;
+
+		private Filter(Type type, int param, float[] taps) {
+			this.type = type;
+			this.param = param;
+			taps_ = taps;
+		}
+
+		/**
+		 * Gets the taps of an FIR.
+		 * 
+		 * @return A copy of the taps, or null if this is not an FIR.
+		 */
+		public float[] getTaps() {
+			return taps_ == null ? null : taps_.clone();
+		}
+
+		/**
+		 * Average the last few samples.
+		 * 
+		 * @param length
+		 *            The number of samples, between 1 and {@link #MAX_LENGTH}.
+		 * @return The filter.
+		 */
+		public static Filter movingAverage(int length) {
+			if (length < 1 || length > MAX_LENGTH) {
+				throw new IllegalArgumentException("Illegal length: " + length);
+			}
+			return new Filter(Type.MOVING_AVERAGE, length, null);
+		}
+
+		/**
+		 * Low-pass with a single pole: every sample moves the output by
+		 * 1/2^shift of the way to it. The time constant is about 2^shift
+		 * samples.
+		 * 
+		 * @param shift
+		 *            The shift, between 0 (no filtering) and 15.
+		 * @return The filter.
+		 */
+		public static Filter exponential(int shift) {
+			if (shift < 0 || shift > 15) {
+				throw new IllegalArgumentException("Illegal shift: " + shift);
+			}
+			return new Filter(Type.EXPONENTIAL, shift, null);
+		}
+
+		/**
+		 * A finite impulse response: the output is the sum of the last few
+		 * samples, each weighed by its tap. Outputs outside the range of the
+		 * input are clipped. Taps are rounded to multiples of 1/16384.
+		 * 
+		 * @param taps
+		 *            The taps, the first of which weighs the newest sample.
+		 *            Between 1 and {@link #MAX_LENGTH} of them, each in the
+		 *            range [-2,2). Taps summing to 1 have a gain of 1.
+		 * @return The filter.
+		 */
+		public static Filter fir(float... taps) {
+			if (taps.length < 1 || taps.length > MAX_LENGTH) {
+				throw new IllegalArgumentException("Illegal number of taps: "
+						+ taps.length);
+			}
+			for (float tap : taps) {
+				if (!(tap >= -2 && tap < 2)) {
+					throw new IllegalArgumentException("Illegal tap: " + tap);
+				}
+			}
+			return new Filter(Type.FIR, taps.length, taps.clone());
+		}
+	}
+
 	/**
 	 * Gets the analog input reading, as an absolute voltage in Volt units.
 	 * <p>
@@ -214,6 +323,37 @@ public interface AnalogInput extends Closeable {
 	public float getVoltageBuffered() throws InterruptedException,
 			ConnectionLostException;
 
+	/**
+	 * Only have the IOIO report this input when it has changed by more than a
+	 * given amount since it was last reported.
+	 * <p>
+	 * Quiescent inputs then cost next to nothing on the connection, while
+	 * changes still show up within one scan. The value read is the last one
+	 * reported, and the buffer only receives the reported samples, so the
+	 * samples it holds are no longer evenly spaced in time. The default is 0,
+	 * which reports every sample.
+	 * 
+	 * @param deadband
+	 *            The amount of change below which the input is not reported,
+	 *            as a fraction of full scale, in the range [0,1).
+	 * @throws ConnectionLostException
+	 *             The connection with the IOIO is lost.
+	 */
+	public void setDeadband(float deadband) throws ConnectionLostException;
+
+	/**
+	 * Have the IOIO filter this input on every scan.
+	 * <p>
+	 * The filter starts over from the next sample, and so does every time
+	 * sampling is resumed.
+	 * 
+	 * @param filter
+	 *            The filter, or {@link Filter#NONE}, which is the default.
+	 * @throws ConnectionLostException
+	 *             The connection with the IOIO is lost.
+	 */
+	public void setFilter(Filter filter) throws ConnectionLostException;
+
 	/**
 	 * Gets the sample rate used for obtaining buffered samples.
 	 * 
@@ -222,4 +362,18 @@ public interface AnalogInput extends Closeable {
 	 *             The connection with the IOIO is lost.
 	 */
 	public float getSampleRate() throws ConnectionLostException;
+
+	/**
+	 * Gets the time at which the IOIO sampled the value last read.
+	 * <p>
+	 * Only available after {@link IOIO#setSampleTimestamps(boolean)}. The time
+	 * is that of the scan, taken on the IOIO and translated to the time base
+	 * of {@link System#nanoTime()}, so it is not skewed by delays on the
+	 * connection.
+	 * 
+	 * @return The sample time in nanoseconds, or -1 if not available.
+	 * @throws ConnectionLostException
+	 *             The connection with the IOIO is lost.
+	 */
+	public long getTimestamp() throws ConnectionLostException;
 }
@@ -125,6 +125,19 @@ public interface CapSense extends Closeable {
 	 */
 	public void setFilterCoef(float t) throws ConnectionLostException;
 
+	/**
+	 * Have the IOIO filter the raw samples of this input, before they are
+	 * reported and go through the filter of {@link #setFilterCoef(float)}.
+	 * 
+	 * @param filter
+	 *            The filter, or {@link AnalogInput.Filter#NONE}, which is the
+	 *            default.
+	 * @throws ConnectionLostException
+	 *             The connection with the IOIO is lost.
+	 */
+	public void setFilter(AnalogInput.Filter filter)
+			throws ConnectionLostException;
+
 	/**
 	 * Block until sensed capacitance becomes greater than a given threshold.
 	 * 
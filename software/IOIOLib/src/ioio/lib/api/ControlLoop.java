@@ -0,0 +1,174 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *  
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * 
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ * 
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+package ioio.lib.api;
+
+import ioio.lib.api.exception.ConnectionLostException;
+
+/**
+ * A PID controller which the IOIO runs on its own: it measures an input and
+ * drives the duty cycle of a PWM output so as to keep the input at a
+ * setpoint.
+ * <p>
+ * Closing the loop on the client takes a report from the IOIO and a command
+ * back on every step, which over Bluetooth is both slow and jittery. A control
+ * loop runs on the IOIO on every new measurement of its input, and the client
+ * only tunes it and, optionally, watches it. For an analog input, that is on
+ * every analog scan, i.e. at the rate returned by
+ * {@link AnalogInput#getSampleRate()} with no decimation, 1KHz by default. For
+ * a pulse input, that is on every pulse measured, at most once per re-arm
+ * period (see {@link PulseInput#setRearmPeriod(int)}), 5ms by default. Control loop instances
+ * are obtained by calling
+ * {@link IOIO#openControlLoop(AnalogInput, PwmOutput, float, float, int)} or
+ * {@link IOIO#openControlLoop(PulseInput, PwmOutput, float, float, int)}.
+ * <p>
+ * On every run, the loop computes
+ * 
+ * <pre>
+ * output = kp * e + ki * sum(e * dt) - kd * dy / dt
+ * </pre>
+ * 
+ * where e is the setpoint minus the input, dy is the change in the input since
+ * the previous run, dt is the time between runs and output is a duty cycle,
+ * kept between the limits given on opening. The integral term is kept within
+ * these limits too, so that it doesn't wind up while the output is saturated,
+ * and taking the derivative on the input rather than on the error keeps a
+ * setpoint change from kicking the output. Gains and setpoint can be changed
+ * at any time, without a bump in the output.
+ * <p>
+ * The IOIO computes in fixed point: the gains are scaled together into 16-bit
+ * numbers, so gains that are far apart in magnitude lose precision on the
+ * smaller one, and the error is saturated to 32767 input counts, i.e. analog
+ * steps or clock ticks of the pulse input. The time between runs is taken at
+ * the time of {@link #setGains(float, float, float)}, which has to be called
+ * again if it changes: the analog scan period, or the re-arm period of a pulse
+ * input (1ms if 0). A pulse input is thus best measured with a re-arm period
+ * longer than the signal's period, so that runs are evenly spaced.
+ * <p>
+ * The input and the output remain open resources of their own, which the loop
+ * only refers to, and are to be closed after it. Setting the duty cycle of the
+ * output while the loop runs has no lasting effect.
+ * <p>
+ * The instance is alive since its creation. If the connection with the IOIO
+ * drops at any point, the instance transitions to a disconnected state, in
+ * which every attempt to use it (except {@link #close()}) will throw a
+ * {@link ConnectionLostException}. Whenever {@link #close()} is invoked the
+ * loop stops, leaving the output at its last duty cycle, and any resources
+ * associated with it are freed and can be reused.
+ * <p>
+ * Typical usage:
+ * 
+ * <pre>
+ * AnalogInput temperature = ioio.openAnalogInput(40);
+ * PwmOutput heater = ioio.openPwmOutput(11, 1000);
+ * // Report every 100 runs, i.e. every 100ms at the default scan rate.
+ * ControlLoop loop = ioio.openControlLoop(temperature, heater, 0, 1, 100);
+ * loop.setGains(2.0f, 0.5f, 0);
+ * loop.setSetpoint(0.6f);
+ * ...
+ * System.out.println(loop.getInput() + &quot; &quot; + loop.getDutyCycle());
+ * ...
+ * loop.close();
+ * </pre>
+ */
+public interface ControlLoop extends Closeable {
+	/**
+	 * Sets the value the loop keeps the input at. The loop starts out with a
+	 * setpoint of 0.
+	 * 
+	 * @param setpoint
+	 *            The setpoint, in the units of the input: a fraction of the
+	 *            reference voltage, as in {@link AnalogInput#read()}, or
+	 *            seconds, as in {@link PulseInput#getDuration()}.
+	 * @throws ConnectionLostException
+	 *             The connection with the IOIO has been lost.
+	 */
+	public void setSetpoint(float setpoint) throws ConnectionLostException;
+
+	/**
+	 * Sets the gains of the loop. The loop starts out with all gains 0, which
+	 * keeps the output at its lower limit.
+	 * 
+	 * @param kp
+	 *            The proportional gain, in duty cycle per input unit.
+	 * @param ki
+	 *            The integral gain, in duty cycle per input unit per second.
+	 * @param kd
+	 *            The derivative gain, in duty cycle per input unit per second
+	 *            of change.
+	 * @throws ConnectionLostException
+	 *             The connection with the IOIO has been lost.
+	 */
+	public void setGains(float kp, float ki, float kd)
+			throws ConnectionLostException;
+
+	/**
+	 * Gets the input of the latest reported run, waiting for the first report
+	 * if there hasn't been one yet.
+	 * 
+	 * @return The input, in the units of the setpoint.
+	 * @throws InterruptedException
+	 *             The calling thread has been interrupted.
+	 * @throws ConnectionLostException
+	 *             The connection with the IOIO has been lost.
+	 * @throws IllegalStateException
+	 *             The loop was opened without reports.
+	 */
+	public float getInput() throws InterruptedException,
+			ConnectionLostException;
+
+	/**
+	 * Gets the output of the latest reported run, as with {@link #getInput()}.
+	 * 
+	 * @return The duty cycle, as a number between 0 and 1.
+	 * @throws InterruptedException
+	 *             The calling thread has been interrupted.
+	 * @throws ConnectionLostException
+	 *             The connection with the IOIO has been lost.
+	 * @throws IllegalStateException
+	 *             The loop was opened without reports.
+	 */
+	public float getDutyCycle() throws InterruptedException,
+			ConnectionLostException;
+
+	/**
+	 * Gets whether the output of the latest reported run was at one of its
+	 * limits, as with {@link #getInput()}. A loop that stays saturated cannot
+	 * reach its setpoint.
+	 * 
+	 * @return Whether the output was saturated.
+	 * @throws InterruptedException
+	 *             The calling thread has been interrupted.
+	 * @throws ConnectionLostException
+	 *             The connection with the IOIO has been lost.
+	 * @throws IllegalStateException
+	 *             The loop was opened without reports.
+	 */
+	public boolean isSaturated() throws InterruptedException,
+			ConnectionLostException;
+}
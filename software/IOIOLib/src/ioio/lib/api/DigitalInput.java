@@ -137,4 +137,17 @@ public interface DigitalInput extends Closeable {
 	 */
 	public void waitForValue(boolean value) throws InterruptedException,
 			ConnectionLostException;
+
+	/**
+	 * Gets the time at which the IOIO sensed the change to the value last
+	 * read.
+	 * <p>
+	 * Only available after {@link IOIO#setSampleTimestamps(boolean)}. The time
+	 * is in the time base of {@link System#nanoTime()}.
+	 * 
+	 * @return The change time in nanoseconds, or -1 if not available.
+	 * @throws ConnectionLostException
+	 *             The connection with the IOIO has been lost.
+	 */
+	public long getTimestamp() throws ConnectionLostException;
 }
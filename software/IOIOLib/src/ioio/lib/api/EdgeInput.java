@@ -0,0 +1,105 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *  
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * 
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ * 
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+package ioio.lib.api;
+
+import ioio.lib.api.exception.ConnectionLostException;
+
+/**
+ * Timing of every edge of a digital signal.
+ * <p>
+ * Unlike {@link PulseInput}, which measures one pulse at a time and at most a
+ * few hundred times a second, an edge input has the IOIO timestamp every edge,
+ * rising and falling, and stream the timestamps to the client. This makes it
+ * possible to decode signals such as IR remote controls or single-wire
+ * protocols, where the duration of each pulse carries information.
+ * EdgeInput instances are obtained by calling
+ * {@link IOIO#openEdgeInput(DigitalInput.Spec, PulseInput.ClockRate, boolean)}
+ * . The clock rate and precision have the same meaning as with
+ * {@link PulseInput}, and determine the resolution and the longest interval
+ * that can be measured.
+ * <p>
+ * The intervals between consecutive edges are buffered on the client side.
+ * Every call to {@link #waitEdgeGetInterval()} returns the next one in order,
+ * blocking until one is available. The intervals alternate between the high
+ * and low times of the signal. Edges are lost when the buffer is full, or when
+ * they come faster than the IOIO can send them. The interval that spans a loss
+ * is not reported. {@link #getOverflowCount()} tells whether that happened.
+ * <p>
+ * The instance is alive since its creation. If the connection with the IOIO
+ * drops at any point, the instance transitions to a disconnected state, in
+ * which every attempt to use it (except {@link #close()}) will throw a
+ * {@link ConnectionLostException}. Whenever {@link #close()} is invoked the
+ * instance may no longer be used. Any resources associated with it are freed
+ * and can be reused.
+ * <p>
+ * Typical usage:
+ * 
+ * <pre>
+ * EdgeInput in = ioio.openEdgeInput(new DigitalInput.Spec(3),
+ *                                   ClockRate.RATE_2MHz, false);
+ * while (...) {
+ *   float intervalSec = in.waitEdgeGetInterval();
+ *   ...
+ * }
+ * in.close();  // pin 3 can now be used for something else.
+ * </pre>
+ */
+public interface EdgeInput extends Closeable {
+	/**
+	 * Reads the time between the next edge and the one before it. Blocks
+	 * until one is available.
+	 * 
+	 * @return The interval, in seconds.
+	 * @throws InterruptedException
+	 *             The calling thread has been interrupted.
+	 * @throws ConnectionLostException
+	 *             The connection with the IOIO has been lost.
+	 */
+	public float waitEdgeGetInterval() throws InterruptedException,
+			ConnectionLostException;
+
+	/**
+	 * Gets the number of intervals that can be read without blocking.
+	 * 
+	 * @return The number of buffered intervals.
+	 * @throws ConnectionLostException
+	 *             The connection with the IOIO has been lost.
+	 */
+	public int available() throws ConnectionLostException;
+
+	/**
+	 * Gets the number of times edges have been lost, either because the
+	 * buffer was full or because the IOIO could not send them fast enough.
+	 * 
+	 * @return The number of losses since opening.
+	 * @throws ConnectionLostException
+	 *             The connection with the IOIO has been lost.
+	 */
+	public int getOverflowCount() throws ConnectionLostException;
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *  
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * 
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ * 
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+package ioio.lib.api;
+
+import ioio.lib.api.exception.ConnectionLostException;
+
+/**
+ * Frequency measurement of a digital signal by counting its edges.
+ * <p>
+ * {@link PulseInput} in frequency mode measures single periods of a signal,
+ * which at high frequencies are few clock ticks long and therefore imprecise.
+ * A frequency counter instead has the IOIO count rising edges over a fixed
+ * gate time, and report once per gate how many there were and how long they
+ * took. Since the count spans whole periods of the signal, its precision is
+ * that of the clock over the whole gate time, e.g. 1 part in 1.6 million for a
+ * 16MHz clock and a 100ms gate, regardless of the signal's frequency. The
+ * number of messages is one per gate. FrequencyCounter instances are obtained
+ * by calling
+ * {@link IOIO#openFrequencyCounter(DigitalInput.Spec, PulseInput.ClockRate, int, int, boolean)}
+ * .
+ * <p>
+ * The clock rate and precision have the same meaning as with
+ * {@link PulseInput}, except that the longest interval they can measure needs
+ * to exceed the time between captured edges, not the gate time. The prescale
+ * sets which rising edges are captured: every one, every 4th or every 16th. A
+ * higher prescale lowers the load on the IOIO at high frequencies, but raises
+ * the lowest frequency that can be measured with a given clock rate. If the
+ * IOIO misses captured edges, the gate time in which they happened is left out
+ * of the count, and {@link #getOverflowCount()} tells that this happened.
+ * <p>
+ * The instance is alive since its creation. If the connection with the IOIO
+ * drops at any point, the instance transitions to a disconnected state, in
+ * which every attempt to use it (except {@link #close()}) will throw a
+ * {@link ConnectionLostException}. Whenever {@link #close()} is invoked the
+ * instance may no longer be used. Any resources associated with it are freed
+ * and can be reused.
+ * <p>
+ * Typical usage:
+ * 
+ * <pre>
+ * // Count a ~1MHz signal over 100ms gates.
+ * FrequencyCounter counter = ioio.openFrequencyCounter(3, 100);
+ * ...
+ * float freqHz = counter.getFrequency();
+ * ...
+ * counter.close();  // pin 3 can now be used for something else.
+ * </pre>
+ */
+public interface FrequencyCounter extends Closeable {
+	/**
+	 * Gets the frequency measured over the last gate time.
+	 * <p>
+	 * The first call to this method may block until the first gate time ends.
+	 * The client may interrupt the calling thread.
+	 * 
+	 * @return The frequency, in Hz, 0 if there were no edges.
+	 * @throws InterruptedException
+	 *             The calling thread has been interrupted.
+	 * @throws ConnectionLostException
+	 *             The connection with the IOIO has been lost.
+	 */
+	public float getFrequency() throws InterruptedException,
+			ConnectionLostException;
+
+	/**
+	 * Waits for the next gate time to end, and gets the frequency measured
+	 * over it.
+	 * 
+	 * @return The frequency, in Hz, 0 if there were no edges.
+	 * @throws InterruptedException
+	 *             The calling thread has been interrupted.
+	 * @throws ConnectionLostException
+	 *             The connection with the IOIO has been lost.
+	 */
+	public float waitGateGetFrequency() throws InterruptedException,
+			ConnectionLostException;
+
+	/**
+	 * Gets the number of gate times in which captured edges were missed.
+	 * 
+	 * @return The number of such gate times since opening.
+	 * @throws ConnectionLostException
+	 *             The connection with the IOIO has been lost.
+	 */
+	public int getOverflowCount() throws ConnectionLostException;
+}
@@ -53,6 +53,11 @@ import java.io.Closeable;
  * {@link #disconnect()}, or waiting for the physical connection to drop via
  * {@link #waitForDisconnect()}.
  * <p>
+ * Firmware that is compatible may still lack some of the newer features, such
+ * as encoders, schedules or control loops. Methods for those throw an
+ * {@link UnsupportedOperationException} when the connected firmware does not
+ * report supporting them, and never send it a message it does not know.
+ * <p>
  * As soon as a connection is established, the IOIO can be used, typically, by
  * calling the openXXX() functions to obtain additional interfaces for
  * controlling specific function of the board.
@@ -263,6 +268,36 @@ public interface IOIO {
 	public DigitalInput openDigitalInput(int pin, DigitalInput.Spec.Mode mode)
 			throws ConnectionLostException;
 
+	/**
+	 * Open a set of pins for periodic digital input.
+	 * <p>
+	 * All the pins are sampled together at a fixed rate, and every sample is
+	 * delivered, which makes it possible to capture signals too fast for
+	 * {@link DigitalInput}. The pins will operate in this mode until close()
+	 * is invoked on the returned interface. It is illegal to open a pin that
+	 * has already been opened and has not been closed, or to have more than
+	 * one periodic digital input open. A connection must have been
+	 * established prior to calling this method, by invoking
+	 * {@link #waitForConnect()}.
+	 *
+	 * @param specs
+	 *            Pin specifications. The order determines the order of the
+	 *            values in every sample.
+	 * @param rateHz
+	 *            Sample rate, between 400Hz and 50KHz. The rate actually used
+	 *            is the nearest one which is 100KHz divided by an integer.
+	 * @param bufferSize
+	 *            The number of samples to buffer on the client side.
+	 * @return Interface of the assigned pins.
+	 * @throws ConnectionLostException
+	 *             Connection was lost before or during the execution of this
+	 *             method.
+	 * @see PeriodicDigitalInput
+	 */
+	public PeriodicDigitalInput openPeriodicDigitalInput(
+			DigitalInput.Spec[] specs, float rateHz, int bufferSize)
+			throws ConnectionLostException;
+
 	/**
 	 * Open a pin for digital output.
 	 * <p>
@@ -317,6 +352,25 @@ public interface IOIO {
 	public DigitalOutput openDigitalOutput(int pin)
 			throws ConnectionLostException;
 
+	/**
+	 * Set several digital outputs at once.
+	 * <p>
+	 * This takes a single message, and all the outputs that share a port on
+	 * the IOIO change at the same instant, which suits parallel buses and LED
+	 * matrices. It is equivalent to calling {@link DigitalOutput#write(boolean)}
+	 * on each of the outputs otherwise.
+	 * 
+	 * @param outputs
+	 *            Open digital outputs of this IOIO.
+	 * @param values
+	 *            The values to write, one per output.
+	 * @throws ConnectionLostException
+	 *             Connection was lost before or during the execution of this
+	 *             method.
+	 */
+	public void writeDigitalOutputs(DigitalOutput[] outputs, boolean[] values)
+			throws ConnectionLostException;
+
 	/**
 	 * Open a pin for analog input.
 	 * <p>
@@ -339,6 +393,128 @@ public interface IOIO {
 	 */
 	public AnalogInput openAnalogInput(int pin) throws ConnectionLostException;
 
+	/**
+	 * Open a pin for analog input, reporting at a fraction of the scan rate.
+	 * <p>
+	 * Same as {@link #openAnalogInput(int)}, but the pin only reports once
+	 * every <code>decimation</code> scans, saving link bandwidth on slowly
+	 * varying signals. When <code>oversample</code> is set, the IOIO averages
+	 * all the samples taken in between into each reported value, which reduces
+	 * noise and increases resolution.
+	 * 
+	 * @param pin
+	 *            Pin number, as labeled on the board.
+	 * @param decimation
+	 *            Report every so many scans. Between 1 and 256, or up to 64
+	 *            when oversampling.
+	 * @param oversample
+	 *            Whether to report the average of the samples taken since the
+	 *            previous report, rather than the last one.
+	 * @return Interface of the assigned pin.
+	 * @throws ConnectionLostException
+	 *             Connection was lost before or during the execution of this
+	 *             method.
+	 * @throws UnsupportedOperationException
+	 *             Decimation or oversampling was requested and the IOIO
+	 *             firmware does not support it.
+	 * @see #setAnalogInputScanRate(float)
+	 */
+	public AnalogInput openAnalogInput(int pin, int decimation,
+			boolean oversample) throws ConnectionLostException;
+
+	/**
+	 * Set the rate at which the IOIO scans all analog inputs.
+	 * <p>
+	 * The default is 1000Hz. The rate is rounded to a multiple of 0.5us in
+	 * period. It applies to analog inputs that are already open as well as
+	 * to those opened later, and reverts to the default on
+	 * {@link #softReset()}.
+	 * 
+	 * @param rateHz
+	 *            Scan rate, between 31 and 10000 Hz.
+	 * @throws ConnectionLostException
+	 *             Connection was lost before or during the execution of this
+	 *             method.
+	 * @throws UnsupportedOperationException
+	 *             The IOIO firmware does not support setting the scan rate.
+	 * @see AnalogInput#getSampleRate()
+	 */
+	public void setAnalogInputScanRate(float rateHz)
+			throws ConnectionLostException;
+
+	/**
+	 * Have the IOIO send analog samples as differences from the previous
+	 * ones.
+	 * <p>
+	 * Slowly varying or quiet inputs then take about half the bandwidth, which
+	 * leaves more room for other traffic on slow connections. Values are
+	 * still resent whole periodically. Oversampled inputs are not affected.
+	 * This is transparent to the reading methods of {@link AnalogInput}, and
+	 * reverts to off on {@link #softReset()}.
+	 * 
+	 * @param enable
+	 *            Whether to use delta encoding.
+	 * @throws ConnectionLostException
+	 *             Connection was lost before or during the execution of this
+	 *             method.
+	 */
+	public void setAnalogInputDeltaEncoding(boolean enable)
+			throws ConnectionLostException;
+
+	/**
+	 * Have the IOIO report digital input changes that happen together in a
+	 * single message.
+	 * <p>
+	 * Changes then take one message per change notification rather than one
+	 * per pin, which matters when many inputs change
+	 * together, e.g. on a parallel bus. It is transparent to
+	 * {@link DigitalInput}. Reverts to off on {@link #softReset()}.
+	 * 
+	 * @param enable
+	 *            Whether to batch digital input changes.
+	 * @throws ConnectionLostException
+	 *             Connection was lost before or during the execution of this
+	 *             method.
+	 */
+	public void setDigitalInputBatching(boolean enable)
+			throws ConnectionLostException;
+
+	/**
+	 * Have the IOIO stamp analog and digital input reports with the time at
+	 * which they were sampled.
+	 * <p>
+	 * The times are available from {@link AnalogInput#getTimestamp()} and
+	 * {@link DigitalInput#getTimestamp()}. Enabling this also synchronizes the
+	 * clocks, as in {@link #syncClock()}. Reverts to off on
+	 * {@link #softReset()}.
+	 * 
+	 * @param enable
+	 *            Whether to timestamp inputs.
+	 * @throws ConnectionLostException
+	 *             Connection was lost before or during the execution of this
+	 *             method.
+	 * @throws InterruptedException
+	 *             The calling thread has been interrupted.
+	 */
+	public void setSampleTimestamps(boolean enable)
+			throws ConnectionLostException, InterruptedException;
+
+	/**
+	 * Measure the offset between the IOIO clock and this one.
+	 * <p>
+	 * Takes a few round trips. The two clocks drift apart by up to a few tens
+	 * of microseconds per second, so applications that need timestamps to be
+	 * accurate over long periods should call this every now and then.
+	 * 
+	 * @throws ConnectionLostException
+	 *             Connection was lost before or during the execution of this
+	 *             method.
+	 * @throws InterruptedException
+	 *             The calling thread has been interrupted.
+	 */
+	public void syncClock() throws ConnectionLostException,
+			InterruptedException;
+
 	/**
 	 * Open a pin for PWM (Pulse-Width Modulation) output.
 	 * <p>
@@ -384,6 +560,73 @@ public interface IOIO {
 	public PwmOutput openPwmOutput(int pin, int freqHz)
 			throws ConnectionLostException;
 
+	/**
+	 * Open a pin for PWM output, whose pulse width follows a sequence of
+	 * steps played by the IOIO.
+	 * <p>
+	 * The pin and PWM module are the same as with
+	 * {@link #openPwmOutput(DigitalOutput.Spec, int)}, and count towards the
+	 * same limit on concurrent usage.
+	 * 
+	 * @param spec
+	 *            Pin specification, see
+	 *            {@link #openPwmOutput(DigitalOutput.Spec, int)}.
+	 * @param freqHz
+	 *            PWM frequency, in Hertz.
+	 * @param periodsPerStep
+	 *            How many PWM periods every step lasts, 1 to 65535.
+	 * @param loop
+	 *            Whether to play the steps over and over again, see
+	 *            {@link PwmSequencer}.
+	 * @return Interface of the assigned pin.
+	 * @throws ConnectionLostException
+	 *             Connection was lost before or during the execution of this
+	 *             method.
+	 * @throws OutOfResourceException
+	 *             This is a runtime exception, so it is not necessary to catch
+	 *             it if the client guarantees that the total number of
+	 *             concurrent PWM resources is not exceeded.
+	 * @see PwmSequencer
+	 */
+	public PwmSequencer openPwmSequencer(DigitalOutput.Spec spec, int freqHz,
+			int periodsPerStep, boolean loop) throws ConnectionLostException;
+
+	/**
+	 * Shorthand for openPwmSequencer(new DigitalOutput.Spec(pin), freqHz,
+	 * periodsPerStep, false).
+	 * 
+	 * @see #openPwmSequencer(ioio.lib.api.DigitalOutput.Spec, int, int,
+	 *      boolean)
+	 */
+	public PwmSequencer openPwmSequencer(int pin, int freqHz,
+			int periodsPerStep) throws ConnectionLostException;
+
+	/**
+	 * Open a set of pins for PWM output, whose pulse widths are updated
+	 * together.
+	 * <p>
+	 * Every pin takes a PWM module, as with
+	 * {@link #openPwmOutput(DigitalOutput.Spec, int)}. The modules are
+	 * synchronized to that of the first pin, so they are in phase.
+	 * 
+	 * @param specs
+	 *            Pin specifications, see
+	 *            {@link #openPwmOutput(DigitalOutput.Spec, int)}.
+	 * @param freqHz
+	 *            PWM frequency, in Hertz, common to all the pins.
+	 * @return Interface of the assigned pins.
+	 * @throws ConnectionLostException
+	 *             Connection was lost before or during the execution of this
+	 *             method.
+	 * @throws OutOfResourceException
+	 *             This is a runtime exception, so it is not necessary to catch
+	 *             it if the client guarantees that the total number of
+	 *             concurrent PWM resources is not exceeded.
+	 * @see PwmGroup
+	 */
+	public PwmGroup openPwmGroup(DigitalOutput.Spec[] specs, int freqHz)
+			throws ConnectionLostException;
+
 	/**
 	 * Open a pin for pulse input.
 	 * <p>
@@ -447,6 +690,136 @@ public interface IOIO {
 	public PulseInput openPulseInput(int pin, PulseMode mode)
 			throws ConnectionLostException;
 
+	/**
+	 * Open a pin for timing every edge of a signal.
+	 * <p>
+	 * An edge input uses a pulse input module, so it counts against the same
+	 * limit on concurrent usage, and can only be opened on pins that support
+	 * pulse input.
+	 * <p>
+	 * The pin will operate in this mode until close() is invoked on the
+	 * returned interface. It is illegal to open a pin that has already been
+	 * opened and has not been closed. A connection must have been established
+	 * prior to calling this method, by invoking {@link #waitForConnect()}.
+	 * 
+	 * @param spec
+	 *            Pin specification, consisting of the pin number, as labeled on
+	 *            the board, and the mode, which determines whether the pin will
+	 *            be floating, pull-up or pull-down. See
+	 *            {@link DigitalInput.Spec.Mode} for more information.
+	 * @param rate
+	 *            The clock rate to use for timing the edges, see
+	 *            {@link PulseInput}.
+	 * @param doublePrecision
+	 *            Whether to use a double-precision module, see
+	 *            {@link PulseInput}.
+	 * @return An instance of the {@link EdgeInput}, which can be used to
+	 *         obtain the data.
+	 * @throws ConnectionLostException
+	 *             Connection was lost before or during the execution of this
+	 *             method.
+	 * @throws OutOfResourceException
+	 *             This is a runtime exception, so it is not necessary to catch
+	 *             it if the client guarantees that the total number of
+	 *             concurrent pulse input resources is not exceeded.
+	 * @see EdgeInput
+	 */
+	public EdgeInput openEdgeInput(DigitalInput.Spec spec,
+			PulseInput.ClockRate rate, boolean doublePrecision)
+			throws ConnectionLostException;
+
+	/**
+	 * Open a pin for measuring frequency by counting edges.
+	 * <p>
+	 * A frequency counter uses a pulse input module, so it counts against the
+	 * same limit on concurrent usage, and can only be opened on pins that
+	 * support pulse input.
+	 * <p>
+	 * The pin will operate in this mode until close() is invoked on the
+	 * returned interface. It is illegal to open a pin that has already been
+	 * opened and has not been closed. A connection must have been established
+	 * prior to calling this method, by invoking {@link #waitForConnect()}.
+	 * 
+	 * @param spec
+	 *            Pin specification, consisting of the pin number, as labeled on
+	 *            the board, and the mode, which determines whether the pin will
+	 *            be floating, pull-up or pull-down. See
+	 *            {@link DigitalInput.Spec.Mode} for more information.
+	 * @param rate
+	 *            The clock rate to use for timing the edges, see
+	 *            {@link FrequencyCounter}.
+	 * @param prescale
+	 *            Which rising edges to capture: 1 for every one, 4 for every
+	 *            4th or 16 for every 16th.
+	 * @param gateMs
+	 *            The gate time, in ms, between 1 and 65535.
+	 * @param doublePrecision
+	 *            Whether to use a double-precision module, see
+	 *            {@link PulseInput}.
+	 * @return An instance of the {@link FrequencyCounter}, which can be used
+	 *         to obtain the data.
+	 * @throws ConnectionLostException
+	 *             Connection was lost before or during the execution of this
+	 *             method.
+	 * @throws OutOfResourceException
+	 *             This is a runtime exception, so it is not necessary to catch
+	 *             it if the client guarantees that the total number of
+	 *             concurrent pulse input resources is not exceeded.
+	 * @see FrequencyCounter
+	 */
+	public FrequencyCounter openFrequencyCounter(DigitalInput.Spec spec,
+			PulseInput.ClockRate rate, int prescale, int gateMs,
+			boolean doublePrecision) throws ConnectionLostException;
+
+	/**
+	 * Shorthand for openFrequencyCounter(new DigitalInput.Spec(pin),
+	 * ClockRate.RATE_16MHz, 16, gateMs, true), i.e. opens a double-precision,
+	 * 16MHz frequency counter capturing every 16th edge on the given pin.
+	 * 
+	 * @see #openFrequencyCounter(ioio.lib.api.DigitalInput.Spec,
+	 *      ioio.lib.api.PulseInput.ClockRate, int, int, boolean)
+	 */
+	public FrequencyCounter openFrequencyCounter(int pin, int gateMs)
+			throws ConnectionLostException;
+
+	/**
+	 * Open a pair of pins for quadrature encoder decoding.
+	 * <p>
+	 * The pins will operate in this mode until close() is invoked on the
+	 * returned interface. It is illegal to open a pin that has already been
+	 * opened and has not been closed. A connection must have been established
+	 * prior to calling this method, by invoking {@link #waitForConnect()}.
+	 *
+	 * @param a
+	 *            Pin specification of the A line.
+	 * @param b
+	 *            Pin specification of the B line.
+	 * @param periodMs
+	 *            Time between position reports, in milliseconds, between 1
+	 *            and 65535, or 0 for reports only on
+	 *            {@link QuadratureEncoder#update()}.
+	 * @return An interface for the encoder.
+	 * @throws ConnectionLostException
+	 *             Connection was lost before or during the execution of this
+	 *             method.
+	 * @throws OutOfResourceException
+	 *             This is a runtime exception, so it is not necessary to catch
+	 *             it if the client guarantees that there are enough encoders
+	 *             available.
+	 * @see QuadratureEncoder
+	 */
+	public QuadratureEncoder openQuadratureEncoder(DigitalInput.Spec a,
+			DigitalInput.Spec b, int periodMs) throws ConnectionLostException;
+
+	/**
+	 * Shorthand for openQuadratureEncoder(new DigitalInput.Spec(a), new
+	 * DigitalInput.Spec(b), periodMs).
+	 *
+	 * @see #openQuadratureEncoder(DigitalInput.Spec, DigitalInput.Spec, int)
+	 */
+	public QuadratureEncoder openQuadratureEncoder(int a, int b, int periodMs)
+			throws ConnectionLostException;
+
 	/**
 	 * Open a UART module, enabling a bulk transfer of byte buffers.
 	 * <p>
@@ -708,6 +1081,10 @@ public interface IOIO {
 	 * be treated as a hint. Code running inside the block must be quick as it
 	 * blocks <b>all</b> transfers to the IOIO, including those performed from
 	 * other threads.
+	 * <p>
+	 * The operations of a batch are sent to the IOIO as a single unit, which
+	 * it decodes straight from its receive buffer. Use {@link #sync()} to find
+	 * out when they have all been executed.
 	 * 
 	 * @throws ConnectionLostException
 	 *             Connection was lost before or during the execution of this
@@ -723,4 +1100,171 @@ public interface IOIO {
 	 *             method.
 	 */
 	public void endBatch() throws ConnectionLostException;
+
+	/**
+	 * Block until the IOIO has executed all the operations requested so far.
+	 * <p>
+	 * This takes a single round trip, e.g. after setting up all the pins in a
+	 * batch. May not be called inside a batch.
+	 * 
+	 * @throws ConnectionLostException
+	 *             Connection was lost before or during the execution of this
+	 *             method.
+	 * @throws InterruptedException
+	 *             The calling thread has been interrupted.
+	 */
+	public void sync() throws ConnectionLostException, InterruptedException;
+
+	/**
+	 * Start recording a schedule: a sequence of operations, which the IOIO
+	 * will repeat periodically on its own. See {@link Schedule}.
+	 * <p>
+	 * Until {@link #endSchedule(int)}, the operations performed by the
+	 * calling thread are recorded rather than executed, while those of other
+	 * threads go on as usual. Only operations which neither wait for a reply
+	 * from the IOIO nor are flow controlled may be recorded, e.g. setting
+	 * digital outputs and PWM pulse widths. UART output, SPI and TWI
+	 * transactions, encoder reads, ICSP and syncing throw an
+	 * {@link IllegalStateException} while recording. Opening and closing
+	 * resources may not be recorded, and the resources used by a schedule
+	 * should stay open as long as it runs. May not be called inside a batch.
+	 * 
+	 * @throws ConnectionLostException
+	 *             Connection was lost before or during the execution of this
+	 *             method.
+	 */
+	public void beginSchedule() throws ConnectionLostException;
+
+	/**
+	 * End recording a schedule, and start running it. For explanation, see
+	 * {@link #beginSchedule()}.
+	 * 
+	 * @param periodUs
+	 *            The period, in microseconds, at which to run the schedule.
+	 * @return The running schedule, which is stopped by closing it.
+	 * @throws ConnectionLostException
+	 *             Connection was lost before or during the execution of this
+	 *             method.
+	 * @throws OutOfResourceException
+	 *             This is a runtime exception, so it is not necessary to catch
+	 *             it if the client guarantees that the total number of
+	 *             concurrent schedules is not exceeded.
+	 */
+	public Schedule endSchedule(int periodUs) throws ConnectionLostException;
+
+	/**
+	 * Open a reflex on a digital input: a rule which the IOIO applies on its
+	 * own whenever the input changes to a given level. See {@link Reflex}.
+	 * 
+	 * @param input
+	 *            The input, opened on this IOIO.
+	 * @param level
+	 *            The level on which to fire.
+	 * @param action
+	 *            What to do on firing.
+	 * @return Interface of the reflex.
+	 * @throws ConnectionLostException
+	 *             Connection was lost before or during the execution of this
+	 *             method.
+	 * @throws OutOfResourceException
+	 *             This is a runtime exception, so it is not necessary to catch
+	 *             it if the client guarantees that the total number of
+	 *             concurrent reflexes is not exceeded.
+	 */
+	public Reflex openReflex(DigitalInput input, boolean level,
+			Reflex.Action action) throws ConnectionLostException;
+
+	/**
+	 * Open a reflex on an analog input: a rule which the IOIO applies on its
+	 * own whenever the input crosses a threshold. See {@link Reflex}.
+	 * <p>
+	 * With two thresholds, the input has to get back to the other side of the
+	 * other one before the reflex may fire again, so that noise around the
+	 * threshold doesn't fire it over and over. The input is checked at the
+	 * analog scan rate.
+	 * 
+	 * @param input
+	 *            The input, opened on this IOIO.
+	 * @param low
+	 *            The lower threshold, as a fraction of the reference voltage,
+	 *            between 0 and 1.
+	 * @param high
+	 *            The upper threshold, between low and 1.
+	 * @param rising
+	 *            Whether to fire when the input rises from below low to high
+	 *            or above, or when it falls from above high to low or below.
+	 * @param action
+	 *            What to do on firing.
+	 * @return Interface of the reflex.
+	 * @throws ConnectionLostException
+	 *             Connection was lost before or during the execution of this
+	 *             method.
+	 * @throws OutOfResourceException
+	 *             This is a runtime exception, so it is not necessary to catch
+	 *             it if the client guarantees that the total number of
+	 *             concurrent reflexes is not exceeded.
+	 */
+	public Reflex openReflex(AnalogInput input, float low, float high,
+			boolean rising, Reflex.Action action)
+			throws ConnectionLostException;
+
+	/**
+	 * Open a control loop on an analog input: a PID controller which the IOIO
+	 * runs on its own, driving a PWM output so as to keep the input at a
+	 * setpoint. See {@link ControlLoop}.
+	 * 
+	 * @param input
+	 *            The input, opened on this IOIO.
+	 * @param output
+	 *            The output, opened on this IOIO.
+	 * @param minDutyCycle
+	 *            The lowest duty cycle the loop may set, between 0 and 1.
+	 * @param maxDutyCycle
+	 *            The highest duty cycle the loop may set, between minDutyCycle
+	 *            and 1.
+	 * @param reportInterval
+	 *            Report the state of the loop every this many runs, up to
+	 *            65535, or 0 for no reports.
+	 * @return Interface of the control loop.
+	 * @throws ConnectionLostException
+	 *             Connection was lost before or during the execution of this
+	 *             method.
+	 * @throws OutOfResourceException
+	 *             This is a runtime exception, so it is not necessary to catch
+	 *             it if the client guarantees that the total number of
+	 *             concurrent control loops is not exceeded.
+	 */
+	public ControlLoop openControlLoop(AnalogInput input, PwmOutput output,
+			float minDutyCycle, float maxDutyCycle, int reportInterval)
+			throws ConnectionLostException;
+
+	/**
+	 * Open a control loop on a pulse input, which keeps the width or period
+	 * it measures at a setpoint. Otherwise the same as
+	 * {@link #openControlLoop(AnalogInput, PwmOutput, float, float, int)}.
+	 * 
+	 * @param input
+	 *            The input, opened on this IOIO.
+	 * @param output
+	 *            The output, opened on this IOIO.
+	 * @param minDutyCycle
+	 *            The lowest duty cycle the loop may set, between 0 and 1.
+	 * @param maxDutyCycle
+	 *            The highest duty cycle the loop may set, between minDutyCycle
+	 *            and 1.
+	 * @param reportInterval
+	 *            Report the state of the loop every this many runs, up to
+	 *            65535, or 0 for no reports.
+	 * @return Interface of the control loop.
+	 * @throws ConnectionLostException
+	 *             Connection was lost before or during the execution of this
+	 *             method.
+	 * @throws OutOfResourceException
+	 *             This is a runtime exception, so it is not necessary to catch
+	 *             it if the client guarantees that the total number of
+	 *             concurrent control loops is not exceeded.
+	 */
+	public ControlLoop openControlLoop(PulseInput input, PwmOutput output,
+			float minDutyCycle, float maxDutyCycle, int reportInterval)
+			throws ConnectionLostException;
 }
@@ -0,0 +1,115 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *  
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * 
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ * 
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+package ioio.lib.api;
+
+import ioio.lib.api.exception.ConnectionLostException;
+
+/**
+ * A set of pins sampled together at a fixed rate.
+ * <p>
+ * Unlike {@link DigitalInput}, which reports level changes as they are
+ * sensed, a periodic digital input has the IOIO sample all of its pins on
+ * every tick of a timer, at up to 50KHz, and stream the samples to the client
+ * packed one bit per pin. This makes it possible to capture fast signals, such
+ * as slow serial buses or encoder outputs, without a message per edge.
+ * PeriodicDigitalInput instances are obtained by calling
+ * {@link IOIO#openPeriodicDigitalInput(DigitalInput.Spec[], float, int)}.
+ * <p>
+ * The samples are buffered on the client side. Every call to
+ * {@link #read(boolean[])} returns the next sample in order, blocking until
+ * one is available. Samples are lost when the buffer is full, or when the
+ * IOIO produces them faster than the connection can carry them.
+ * {@link #getOverflowCount()} tells whether that happened.
+ * <p>
+ * Only one periodic digital input may be open at a time. The instance is
+ * alive since its creation. If the connection with the IOIO drops at any
+ * point, the instance transitions to a disconnected state, in which every
+ * attempt to use it (except {@link #close()}) will throw a
+ * {@link ConnectionLostException}. Whenever {@link #close()} is invoked the
+ * instance may no longer be used. Any resources associated with it are freed
+ * and can be reused.
+ * <p>
+ * Typical usage:
+ * 
+ * <pre>
+ * PeriodicDigitalInput in = ioio.openPeriodicDigitalInput(
+ *     new DigitalInput.Spec[] { new DigitalInput.Spec(10),
+ *                               new DigitalInput.Spec(11) },
+ *     10000, 1024);
+ * boolean[] sample = new boolean[2];
+ * while (...) {
+ *   in.read(sample);  // sample[0] is pin 10, sample[1] is pin 11.
+ *   ...
+ * }
+ * in.close();  // pins 10 and 11 can now be used for something else.
+ * </pre>
+ */
+public interface PeriodicDigitalInput extends Closeable {
+	/**
+	 * Reads the next sample. Blocks until one is available.
+	 * 
+	 * @param values
+	 *            Receives the levels sensed on the pins, in the order they
+	 *            were given when opening. true for "HIGH", false for "LOW".
+	 *            Must be at least as long as the number of pins.
+	 * @throws InterruptedException
+	 *             The calling thread has been interrupted.
+	 * @throws ConnectionLostException
+	 *             The connection with the IOIO has been lost.
+	 */
+	public void read(boolean[] values) throws InterruptedException,
+			ConnectionLostException;
+
+	/**
+	 * Gets the number of samples that can be read without blocking.
+	 * 
+	 * @return The number of buffered samples.
+	 * @throws ConnectionLostException
+	 *             The connection with the IOIO has been lost.
+	 */
+	public int available() throws ConnectionLostException;
+
+	/**
+	 * Gets the number of times samples have been lost, either because the
+	 * buffer was full or because the IOIO could not send them fast enough.
+	 * 
+	 * @return The number of losses since opening.
+	 * @throws ConnectionLostException
+	 *             The connection with the IOIO has been lost.
+	 */
+	public int getOverflowCount() throws ConnectionLostException;
+
+	/**
+	 * Gets the actual sample rate, which is the requested one rounded to
+	 * what the IOIO supports.
+	 * 
+	 * @return The sample rate, in Hz.
+	 */
+	public float getSampleRate();
+}
@@ -192,7 +192,9 @@ import ioio.lib.api.exception.ConnectionLostException;
  * introduced on purpose, in order to prevent saturation the communication
  * channel when the input signal is very high frequency. Effectively, this means
  * that the maximum sample rate is 200Hz. This rate has been chosen as it
- * enables measure R/C servo signals without missing pulses.
+ * enables measure R/C servo signals without missing pulses. It can be changed
+ * with {@link #setRearmPeriod(int)}. To time every edge of a signal, use
+ * {@link EdgeInput} instead.
  * 
  * <p>
  * Typical usage (servo signal pulse width measurement):
@@ -319,4 +321,18 @@ public interface PulseInput extends Closeable {
 	 */
 	public float getFrequency() throws InterruptedException,
 			ConnectionLostException;
+
+	/**
+	 * Sets the minimum time between the starts of consecutive measurements.
+	 * Pulses that start sooner are skipped. The default is 5ms, i.e. at most
+	 * 200 measurements per second.
+	 * 
+	 * @param periodMs
+	 *            The period, in ms, between 0 and 255. 0 means measuring
+	 *            the next pulse as soon as the previous one has been reported,
+	 *            which can saturate the connection with fast signals.
+	 * @throws ConnectionLostException
+	 *             The connection with the IOIO has been lost.
+	 */
+	public void setRearmPeriod(int periodMs) throws ConnectionLostException;
 }
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *  
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * 
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ * 
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+package ioio.lib.api;
+
+import ioio.lib.api.exception.ConnectionLostException;
+
+/**
+ * A set of PWM outputs which are updated together.
+ * <p>
+ * Setting the pulse widths of several {@link PwmOutput}s one by one takes a
+ * message each, and the new pulse widths take effect in whatever PWM period
+ * each message happens to arrive in. The outputs of a PWM group instead share
+ * the same frequency and phase, and a new set of pulse widths for all of them
+ * is sent in a single message, which the IOIO applies to all of them on the
+ * same period boundary. This suits e.g. multi-axis motor control, where the
+ * axes are to move in lockstep. PwmGroup instances are obtained by calling
+ * {@link IOIO#openPwmGroup(DigitalOutput.Spec[], int)}.
+ * <p>
+ * The outputs are numbered by the order of their pins as given on opening,
+ * and each of them is available as a {@link PwmOutput} for setting its pulse
+ * width on its own.
+ * <p>
+ * The instance is alive since its creation. If the connection with the IOIO
+ * drops at any point, the instance transitions to a disconnected state, in
+ * which every attempt to use it (except {@link #close()}) will throw a
+ * {@link ConnectionLostException}. Whenever {@link #close()} is invoked the
+ * instance may no longer be used. Any resources associated with it, including
+ * the individual outputs, are freed and can be reused.
+ * <p>
+ * Typical usage:
+ * 
+ * <pre>
+ * PwmGroup motors = ioio.openPwmGroup(new DigitalOutput.Spec[] {
+ *         new DigitalOutput.Spec(10), new DigitalOutput.Spec(11) }, 20000);
+ * ...
+ * motors.setDutyCycles(new float[] { 0.25f, 0.75f });
+ * ...
+ * motors.close();  // pins 10 and 11 can now be used for something else.
+ * </pre>
+ */
+public interface PwmGroup extends Closeable {
+	/**
+	 * Sets the duty cycles of all the outputs at once.
+	 * 
+	 * @param dutyCycles
+	 *            The duty cycles, as real values from 0.0 to 1.0, one per
+	 *            output.
+	 * @throws ConnectionLostException
+	 *             The connection to the IOIO has been lost.
+	 * @see PwmOutput#setDutyCycle(float)
+	 */
+	public void setDutyCycles(float[] dutyCycles)
+			throws ConnectionLostException;
+
+	/**
+	 * Sets the pulse widths of all the outputs at once.
+	 * 
+	 * @param pulseWidthsUs
+	 *            The pulse widths, in microsecond units, one per output.
+	 * @throws ConnectionLostException
+	 *             The connection to the IOIO has been lost.
+	 * @see PwmOutput#setPulseWidth(float)
+	 */
+	public void setPulseWidths(float[] pulseWidthsUs)
+			throws ConnectionLostException;
+
+	/**
+	 * Gets one of the outputs.
+	 * 
+	 * @param index
+	 *            The index of the output, by the order of the pins given on
+	 *            opening.
+	 * @return The output. It is closed along with the group, and may not be
+	 *         closed on its own.
+	 */
+	public PwmOutput get(int index);
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *  
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * 
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ * 
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+package ioio.lib.api;
+
+import ioio.lib.api.exception.ConnectionLostException;
+
+/**
+ * A PWM output playing a sequence of pulse widths.
+ * <p>
+ * With a plain {@link PwmOutput}, every change of the pulse width is a
+ * separate message, so the timing of a waveform is at the mercy of the
+ * connection. A PWM sequencer instead queues pulse widths on the IOIO, which
+ * applies them one by one, a step every given number of PWM periods. Changes
+ * always take effect on a period boundary, and the timing is as precise as the
+ * PWM itself. PwmSequencer instances are obtained by calling
+ * {@link IOIO#openPwmSequencer(DigitalOutput.Spec, int, int, boolean)}.
+ * <p>
+ * The IOIO holds up to {@link #CAPACITY} steps. Writing to a full queue blocks
+ * until the IOIO has played enough steps to make room. When the queue runs
+ * empty, the output keeps the last pulse width it has played. In loop mode,
+ * the steps are played over and over again instead of being consumed, which
+ * suits repetitive waveforms: write all of them once (no more than
+ * {@link #CAPACITY}), and they will keep playing with no further traffic.
+ * Steps written later in loop mode join the loop.
+ * <p>
+ * The methods of {@link PwmOutput} still work, but their pulse width only
+ * lasts until the next step is played.
+ * <p>
+ * The instance is alive since its creation. If the connection with the IOIO
+ * drops at any point, the instance transitions to a disconnected state, in
+ * which every attempt to use it (except {@link #close()}) will throw a
+ * {@link ConnectionLostException}. Whenever {@link #close()} is invoked the
+ * instance may no longer be used. Any resources associated with it are freed
+ * and can be reused.
+ * <p>
+ * Typical usage (a 10Hz triangle wave of LED intensity):
+ * 
+ * <pre>
+ * // 1KHz PWM, a step every 5 periods.
+ * PwmSequencer seq = ioio.openPwmSequencer(new DigitalOutput.Spec(12), 1000,
+ *         5, true);
+ * float[] dc = new float[20];
+ * for (int i = 0; i &lt; 20; ++i) {
+ *     dc[i] = i &lt; 10 ? i / 10.f : (20 - i) / 10.f;
+ * }
+ * seq.writeDutyCycles(dc);
+ * ...
+ * seq.close();  // pin 12 can now be used for something else.
+ * </pre>
+ */
+public interface PwmSequencer extends PwmOutput {
+	/** The number of steps the IOIO can hold. */
+	public static final int CAPACITY = 64;
+
+	/**
+	 * Appends steps to the sequence, given as duty cycles.
+	 * <p>
+	 * This method blocks while the queue is full. The client may interrupt
+	 * the calling thread.
+	 * 
+	 * @param dutyCycles
+	 *            The duty cycles, as real values from 0.0 to 1.0.
+	 * @throws InterruptedException
+	 *             The calling thread has been interrupted.
+	 * @throws ConnectionLostException
+	 *             The connection to the IOIO has been lost.
+	 * @throws IllegalStateException
+	 *             In loop mode, the steps do not fit in what is left of the
+	 *             capacity.
+	 */
+	public void writeDutyCycles(float[] dutyCycles)
+			throws InterruptedException, ConnectionLostException;
+
+	/**
+	 * Appends steps to the sequence, given as pulse widths. Otherwise the
+	 * same as {@link #writeDutyCycles(float[])}.
+	 * 
+	 * @param pulseWidthsUs
+	 *            The pulse widths, in microsecond units.
+	 */
+	public void writePulseWidths(float[] pulseWidthsUs)
+			throws InterruptedException, ConnectionLostException;
+
+	/**
+	 * Gets the number of steps that can be written without blocking.
+	 * 
+	 * @return The number of free places in the queue.
+	 * @throws ConnectionLostException
+	 *             The connection to the IOIO has been lost.
+	 */
+	public int available() throws ConnectionLostException;
+}
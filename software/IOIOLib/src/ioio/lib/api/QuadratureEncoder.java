@@ -0,0 +1,102 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *  
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * 
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ * 
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+package ioio.lib.api;
+
+import ioio.lib.api.exception.ConnectionLostException;
+
+/**
+ * A quadrature encoder, decoded on the IOIO.
+ * <p>
+ * A quadrature encoder has two lines, A and B, whose levels follow each other
+ * a quarter of a cycle apart. The IOIO counts every edge on either line, up
+ * when A leads B and down when B leads A, into a 32-bit position which starts
+ * at 0 when the encoder is opened. Only the position is sent to the client,
+ * periodically and on request, so fast encoders do not load the connection.
+ * QuadratureEncoder instances are obtained by calling
+ * {@link IOIO#openQuadratureEncoder(DigitalInput.Spec, DigitalInput.Spec, int)}.
+ * <p>
+ * {@link #getPosition()} and {@link #getVelocity()} return the last reported
+ * values, blocking until the first report. {@link #update()} asks the IOIO for
+ * a fresh report and waits for it.
+ * <p>
+ * The instance is alive since its creation. If the connection with the IOIO
+ * drops at any point, the instance transitions to a disconnected state, in
+ * which every attempt to use it (except {@link #close()}) will throw a
+ * {@link ConnectionLostException}. Whenever {@link #close()} is invoked the
+ * instance may no longer be used. Any resources associated with it are freed
+ * and can be reused.
+ * <p>
+ * Typical usage:
+ * 
+ * <pre>
+ * // Report every 10ms.
+ * QuadratureEncoder encoder = ioio.openQuadratureEncoder(10, 11, 10);
+ * int position = encoder.getPosition();
+ * float speed = encoder.getVelocity();  // counts per second
+ * ...
+ * encoder.close();  // pins 10 and 11 can now be used for something else.
+ * </pre>
+ */
+public interface QuadratureEncoder extends Closeable {
+	/**
+	 * Gets the last reported position. May block until the first report.
+	 * 
+	 * @return The position, in counts.
+	 * @throws InterruptedException
+	 *             The calling thread has been interrupted.
+	 * @throws ConnectionLostException
+	 *             The connection with the IOIO has been lost.
+	 */
+	public int getPosition() throws InterruptedException,
+			ConnectionLostException;
+
+	/**
+	 * Gets the average velocity between the last two reports. May block until
+	 * the first report.
+	 * 
+	 * @return The velocity, in counts per second.
+	 * @throws InterruptedException
+	 *             The calling thread has been interrupted.
+	 * @throws ConnectionLostException
+	 *             The connection with the IOIO has been lost.
+	 */
+	public float getVelocity() throws InterruptedException,
+			ConnectionLostException;
+
+	/**
+	 * Asks the IOIO for the current position and blocks until it arrives.
+	 * Useful when the encoder was opened without periodic reports.
+	 * 
+	 * @throws InterruptedException
+	 *             The calling thread has been interrupted.
+	 * @throws ConnectionLostException
+	 *             The connection with the IOIO has been lost.
+	 */
+	public void update() throws InterruptedException, ConnectionLostException;
+}
@@ -0,0 +1,205 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *  
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * 
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ * 
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+package ioio.lib.api;
+
+import ioio.lib.api.exception.ConnectionLostException;
+
+/**
+ * A rule which the IOIO applies on its own: when an input enters a condition,
+ * an output is driven right away.
+ * <p>
+ * Reacting to an input on the client takes a report from the IOIO and a
+ * command back, i.e. two trips over the connection, which may add up to tens
+ * of milliseconds over Bluetooth. A reflex acts from the very interrupt in
+ * which the IOIO notices the input, within microseconds, which suits safety
+ * interlocks and limit switches. The client is notified after the fact.
+ * Reflex instances are obtained by calling
+ * {@link IOIO#openReflex(DigitalInput, boolean, Reflex.Action)} or
+ * {@link IOIO#openReflex(AnalogInput, float, float, boolean, Reflex.Action)}.
+ * <p>
+ * A reflex fires every time its input enters the condition, including right
+ * away if the condition already holds when it is opened. The input and the
+ * output of the action remain open resources of their own, which the reflex
+ * only refers to, and are to be closed after it. Since the action is taken
+ * behind the client's back, the output it drives does not know about it:
+ * <ul>
+ * <li>A {@link PwmSequencer} stops playing and taking steps.</li>
+ * <li>A {@link Uart} stops transmitting, and writes to its output stream
+ * block once the IOIO's buffer is full, until it is closed.</li>
+ * </ul>
+ * <p>
+ * The instance is alive since its creation. If the connection with the IOIO
+ * drops at any point, the instance transitions to a disconnected state, in
+ * which every attempt to use it (except {@link #close()}) will throw a
+ * {@link ConnectionLostException}. Whenever {@link #close()} is invoked the
+ * reflex stops, and any resources associated with it are freed and can be
+ * reused.
+ * <p>
+ * Typical usage:
+ * 
+ * <pre>
+ * DigitalInput limit = ioio.openDigitalInput(10, DigitalInput.Spec.Mode.PULL_UP);
+ * PwmOutput motor = ioio.openPwmOutput(11, 20000);
+ * // Stop the motor as soon as the limit switch closes.
+ * Reflex stop = ioio.openReflex(limit, false,
+ *         Reflex.Action.setDutyCycle(motor, 0));
+ * motor.setDutyCycle(0.5f);
+ * stop.waitForCount(1);
+ * ...
+ * stop.close();
+ * </pre>
+ */
+public interface Reflex extends Closeable {
+	/**
+	 * What a reflex does when it fires. The output has to be open, and remain
+	 * so as long as the reflex is.
+	 */
+	public static class Action {
+		/** Kinds of action. */
+		public enum Type {
+			/** Set the level of a {@link DigitalOutput}. */
+			DIGITAL_OUT,
+			/** Set the duty cycle of a {@link PwmOutput}. */
+			PWM_DUTY_CYCLE,
+			/** Set the pulse width of a {@link PwmOutput}. */
+			PWM_PULSE_WIDTH,
+			/** Stop transmitting on a {@link Uart}. */
+			UART_HALT
+		}
+
+		/** The kind of action. */
+		public final Type type;
+
+		/** The output the action drives. */
+		public final Closeable output;
+
+		/**
+		 * The level (0 or 1), duty cycle or pulse width in microseconds the
+		 * output is set to, depending on the type.
+		 */
+		public final float value;
+
+		private Action(Type type, Closeable output, float value) {
+			this.type = type;
+			this.output = output;
+			this.value = value;
+		}
+
+		/**
+		 * Set the level of a digital output.
+		 * 
+		 * @param output
+		 *            The output.
+		 * @param level
+		 *            The level to set it to.
+		 * @return The action.
+		 */
+		public static Action setLevel(DigitalOutput output, boolean level) {
+			return new Action(Type.DIGITAL_OUT, output, level ? 1 : 0);
+		}
+
+		/**
+		 * Set the duty cycle of a PWM output, stopping its sequencer if it is
+		 * a {@link PwmSequencer}, and overriding its part of a pending
+		 * {@link PwmGroup} update.
+		 * 
+		 * @param output
+		 *            The output.
+		 * @param dutyCycle
+		 *            The duty cycle, as a number between 0 and 1.
+		 * @return The action.
+		 */
+		public static Action setDutyCycle(PwmOutput output, float dutyCycle) {
+			return new Action(Type.PWM_DUTY_CYCLE, output, dutyCycle);
+		}
+
+		/**
+		 * Set the pulse width of a PWM output, as with
+		 * {@link #setDutyCycle(PwmOutput, float)}.
+		 * 
+		 * @param output
+		 *            The output.
+		 * @param pulseWidthUs
+		 *            The pulse width, in microseconds.
+		 * @return The action.
+		 */
+		public static Action setPulseWidth(PwmOutput output, float pulseWidthUs) {
+			return new Action(Type.PWM_PULSE_WIDTH, output, pulseWidthUs);
+		}
+
+		/**
+		 * Stop transmitting on a UART. Only the few bytes already in the
+		 * transmitter's hardware buffer still go out.
+		 * 
+		 * @param uart
+		 *            The UART.
+		 * @return The action.
+		 */
+		public static Action haltTransmit(Uart uart) {
+			return new Action(Type.UART_HALT, uart, 0);
+		}
+	}
+
+	/**
+	 * Gets the number of times the reflex has fired so far, as notified by
+	 * the IOIO.
+	 * 
+	 * @return The count.
+	 * @throws ConnectionLostException
+	 *             The connection with the IOIO has been lost.
+	 */
+	public int getCount() throws ConnectionLostException;
+
+	/**
+	 * Waits until the reflex has fired a given number of times since it was
+	 * opened.
+	 * 
+	 * @param count
+	 *            The count to wait for.
+	 * @throws InterruptedException
+	 *             The calling thread has been interrupted.
+	 * @throws ConnectionLostException
+	 *             The connection with the IOIO has been lost.
+	 */
+	public void waitForCount(int count) throws InterruptedException,
+			ConnectionLostException;
+
+	/**
+	 * Gets the time at which the IOIO took the action, the last time the
+	 * reflex fired.
+	 * <p>
+	 * The time is in the time base of {@link System#nanoTime()}, which takes
+	 * the clocks to have been synchronized, as in {@link IOIO#syncClock()}.
+	 * 
+	 * @return The time in nanoseconds, or -1 if not available.
+	 * @throws ConnectionLostException
+	 *             The connection with the IOIO has been lost.
+	 */
+	public long getTimestamp() throws ConnectionLostException;
+}
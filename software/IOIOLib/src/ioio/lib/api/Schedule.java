@@ -0,0 +1,65 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *  
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * 
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ * 
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+package ioio.lib.api;
+
+/**
+ * A sequence of IOIO operations, which the IOIO itself repeats periodically.
+ * <p>
+ * Each operation normally costs a transfer to the IOIO, so a loop of them
+ * runs at the pace of the connection, with its latency and jitter. A schedule
+ * is recorded once, and then runs on the IOIO with no further traffic, e.g.
+ * a motor control pattern at a kHz rate. Schedules are recorded between
+ * {@link IOIO#beginSchedule()} and {@link IOIO#endSchedule(int)}, which
+ * returns the running schedule.
+ * <p>
+ * The IOIO runs a schedule from its main loop, so a run may be late by as long
+ * as the IOIO takes to go around it, typically well under a millisecond. If a
+ * run is so late that the next one is due as well, the missed runs are
+ * dropped. Should the IOIO reject any of the operations when running them, the
+ * schedule stops.
+ * <p>
+ * The instance is alive since its creation. If the connection with the IOIO
+ * drops at any point, the instance transitions to a disconnected state.
+ * Whenever {@link #close()} is invoked the schedule stops, and its resources
+ * are freed and can be reused.
+ * <p>
+ * Typical usage:
+ * 
+ * <pre>
+ * DigitalOutput led = ioio.openDigitalOutput(0);
+ * ...
+ * ioio.beginSchedule();
+ * led.write(true);
+ * Schedule blink = ioio.endSchedule(1000);  // Turn on every ms.
+ * ...
+ * blink.close();
+ * </pre>
+ */
+public interface Schedule extends Closeable {
+}
@@ -91,6 +91,9 @@ public interface Uart extends Closeable {
 		TWO
 	}
 
+	/** The largest number of bytes the IOIO sends in one go. */
+	public static final int MAX_FRAME = 256;
+
 	/**
 	 * Gets the input stream.
 	 * 
@@ -104,4 +107,35 @@ public interface Uart extends Closeable {
 	 * @return An output stream.
 	 */
 	public OutputStream getOutputStream();
+
+	/**
+	 * Sets how the IOIO batches received bytes before sending them over.
+	 * <p>
+	 * By default every byte is sent as soon as possible, which keeps latency
+	 * low but, at moderate baud rates, spends much of the connection on small
+	 * messages. Instead, the IOIO can hold bytes back until a minimum batch
+	 * has come in, the line has been idle for a while, e.g. at the end of a
+	 * packet of the peer's protocol, or the first byte has waited for a given
+	 * time. Whatever is held back is then sent in frames of up to a given
+	 * size. The setting lasts until the UART is closed.
+	 * 
+	 * @param minBatch
+	 *            The number of bytes to send right away, between 1 and
+	 *            maxFrame. The IOIO buffers {@link #MAX_FRAME} received bytes,
+	 *            so large batches may lose bytes at high baud rates.
+	 * @param maxFrame
+	 *            The largest frame, between 1 and {@link #MAX_FRAME}. The
+	 *            default is 64.
+	 * @param idleTimeoutUs
+	 *            The idle time after which to send whatever came in, in
+	 *            microseconds, up to 6553500, or 0 for none. The IOIO counts
+	 *            it in units of 100us, so it is rounded up to the next one.
+	 * @param maxLatencyMs
+	 *            The longest a byte is held back, in milliseconds, up to
+	 *            65535, or 0 for no limit.
+	 * @throws ConnectionLostException
+	 *             The connection with the IOIO is lost.
+	 */
+	public void setRxAggregation(int minBatch, int maxFrame, int idleTimeoutUs,
+			int maxLatencyMs) throws ConnectionLostException;
 }
@@ -36,8 +36,14 @@ import java.io.IOException;
 
 class AnalogInputImpl extends AbstractPin implements AnalogInput,
 		InputPinListener {
+	// Values arrive scaled to 16 bits.
+	private static final float FULL_SCALE = 1023 << 6;
+
+	private final int decimation_;
 	private int value_;
+	private long timestamp_ = -1;
 	private boolean valid_ = false;
+	private boolean filtered_ = false;
 
 	short[] buffer_;
 	int bufferSize_;
@@ -46,8 +52,10 @@ class AnalogInputImpl extends AbstractPin implements AnalogInput,
 	int bufferWriteCursor_;
 	int bufferOverflowCount_ = 0;
 
-	AnalogInputImpl(IOIOImpl ioio, int pin) throws ConnectionLostException {
+	AnalogInputImpl(IOIOImpl ioio, int pin, int decimation)
+			throws ConnectionLostException {
 		super(ioio, pin);
+		decimation_ = decimation;
 	}
 
 	@Override
@@ -61,10 +69,21 @@ class AnalogInputImpl extends AbstractPin implements AnalogInput,
 		return 3.3f;
 	}
 
+	@Override
+	synchronized public void setTimestamp(long time) {
+		timestamp_ = time;
+	}
+
+	@Override
+	synchronized public long getTimestamp() throws ConnectionLostException {
+		checkState();
+		return timestamp_;
+	}
+
 	@Override
 	synchronized public void setValue(int value) {
 		// Log.v("AnalogInputImpl", "Pin " + pinNum_ + " value is " + value);
-		assert (value >= 0 && value < 1024);
+		assert (value >= 0 && value <= FULL_SCALE);
 		value_ = value;
 		if (!valid_) {
 			valid_ = true;
@@ -80,7 +99,7 @@ class AnalogInputImpl extends AbstractPin implements AnalogInput,
 			wait();
 		}
 		checkState();
-		return (float) value_ / 1023.0f;
+		return (float) value_ / FULL_SCALE;
 	}
 
 	@Override
@@ -93,6 +112,10 @@ class AnalogInputImpl extends AbstractPin implements AnalogInput,
 	public synchronized void close() {
 		try {
 			ioio_.protocol_.setAnalogInSampling(pinNum_, false);
+			// The IOIO keeps the filter until told otherwise.
+			if (filtered_) {
+				setFilter(ioio_.protocol_, pinNum_, Filter.NONE);
+			}
 		} catch (IOException e) {
 		}
 		super.close();
@@ -118,7 +141,7 @@ class AnalogInputImpl extends AbstractPin implements AnalogInput,
 	public float readBuffered() throws InterruptedException,
 			ConnectionLostException {
 		checkState();
-		return (float) bufferPull() / 1023.0f;
+		return (float) (bufferPull() & 0xFFFF) / FULL_SCALE;
 	}
 
 	@Override
@@ -166,9 +189,67 @@ class AnalogInputImpl extends AbstractPin implements AnalogInput,
 		return bufferOverflowCount_;
 	}
 
+	@Override
+	public synchronized void setDeadband(float deadband)
+			throws ConnectionLostException {
+		checkState();
+		ioio_.checkCapability(IOIOProtocol.CAPABILITY_ANALOG_DEADBAND,
+				"analog deadband");
+		if (deadband < 0 || deadband >= 1) {
+			throw new IllegalArgumentException("Illegal deadband: " + deadband);
+		}
+		try {
+			ioio_.protocol_.setAnalogInDeadband(pinNum_,
+					Math.round(deadband * 1023));
+		} catch (IOException e) {
+			throw new ConnectionLostException(e);
+		}
+	}
+
+	@Override
+	public synchronized void setFilter(Filter filter)
+			throws ConnectionLostException {
+		checkState();
+		ioio_.checkCapability(IOIOProtocol.CAPABILITY_ANALOG_FILTER,
+				"analog filters");
+		try {
+			setFilter(ioio_.protocol_, pinNum_, filter);
+		} catch (IOException e) {
+			throw new ConnectionLostException(e);
+		}
+		filtered_ = filter.type != Filter.Type.NONE;
+	}
+
+	// Also used for capacitive sensing, which goes through the same filters.
+	static void setFilter(IOIOProtocol protocol, int pin, Filter filter)
+			throws IOException {
+		int[] taps = null;
+		int param;
+		switch (filter.type) {
+		case MOVING_AVERAGE:
+			param = filter.param - 1;
+			break;
+		case EXPONENTIAL:
+			param = filter.param;
+			break;
+		case FIR:
+			param = filter.param - 1;
+			final float[] t = filter.getTaps();
+			taps = new int[t.length];
+			for (int i = 0; i < t.length; ++i) {
+				// Q14, where 2.0 would just overflow.
+				taps[i] = Math.min(Math.round(t[i] * 16384), Short.MAX_VALUE);
+			}
+			break;
+		default:
+			param = 0;
+		}
+		protocol.setAnalogInFilter(pin, filter.type.ordinal(), param, taps);
+	}
+
 	@Override
 	public float getSampleRate() throws ConnectionLostException {
-		return 1000.0f;
+		return ioio_.getAnalogScanRate() / decimation_;
 	}
 
 	@Override
@@ -28,6 +28,7 @@
  */
 package ioio.lib.impl;
 
+import ioio.lib.api.AnalogInput;
 import ioio.lib.api.CapSense;
 import ioio.lib.api.exception.ConnectionLostException;
 import ioio.lib.impl.IncomingState.InputPinListener;
@@ -40,6 +41,7 @@ class CapSenseImpl extends AbstractPin implements CapSense, InputPinListener {
 	private float value_;
 	private boolean valid_ = false;
 	private float coef_;
+	private boolean filtered_ = false;
 
 	CapSenseImpl(IOIOImpl ioio, int pin, float filterCoef)
 			throws ConnectionLostException {
@@ -47,6 +49,10 @@ class CapSenseImpl extends AbstractPin implements CapSense, InputPinListener {
 		setFilterCoef(filterCoef);
 	}
 
+	@Override
+	public void setTimestamp(long time) {
+	}
+
 	@Override
 	synchronized public void setValue(int value) {
 		assert (value >= 0 && value < 1024);
@@ -97,6 +103,11 @@ class CapSenseImpl extends AbstractPin implements CapSense, InputPinListener {
 	public synchronized void close() {
 		try {
 			ioio_.protocol_.setCapSenseSampling(pinNum_, false);
+			// The IOIO keeps the filter until told otherwise.
+			if (filtered_) {
+				AnalogInputImpl.setFilter(ioio_.protocol_, pinNum_,
+						AnalogInput.Filter.NONE);
+			}
 		} catch (IOException e) {
 		}
 		super.close();
@@ -109,4 +120,18 @@ class CapSenseImpl extends AbstractPin implements CapSense, InputPinListener {
 		// 0.1.
 		coef_ = (float) Math.pow(0.1, SAMPLE_PERIOD_MS / t);
 	}
+
+	@Override
+	public synchronized void setFilter(AnalogInput.Filter filter)
+			throws ConnectionLostException {
+		checkState();
+		ioio_.checkCapability(IOIOProtocol.CAPABILITY_ANALOG_FILTER,
+				"analog filters");
+		try {
+			AnalogInputImpl.setFilter(ioio_.protocol_, pinNum_, filter);
+		} catch (IOException e) {
+			throw new ConnectionLostException(e);
+		}
+		filtered_ = filter.type != AnalogInput.Filter.Type.NONE;
+	}
 }
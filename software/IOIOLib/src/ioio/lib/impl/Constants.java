@@ -31,4 +31,9 @@ package ioio.lib.impl;
 class Constants {
 	static final int BUFFER_SIZE = 1024;
 	static final int PACKET_BUFFER_SIZE = 256;
+	static final int NUM_ENCODERS = 4;
+	static final int NUM_SCHEDULES = 4;
+	static final int SCHEDULE_SIZE = 128;
+	static final int NUM_REFLEXES = 8;
+	static final int NUM_CONTROL_LOOPS = 4;
 }
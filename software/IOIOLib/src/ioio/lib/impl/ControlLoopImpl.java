@@ -0,0 +1,178 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *  
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * 
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ * 
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+package ioio.lib.impl;
+
+import ioio.lib.api.ControlLoop;
+import ioio.lib.api.exception.ConnectionLostException;
+import ioio.lib.impl.IncomingState.ControlLoopListener;
+
+import java.io.IOException;
+
+class ControlLoopImpl extends AbstractResource implements ControlLoop,
+		ControlLoopListener {
+	// Matches CONTROL_MAX_SHIFT in the firmware.
+	private static final int MAX_SHIFT = 14;
+
+	private final int loopNum_;
+	// Input counts per input unit and duty cycle clocks per unit of duty cycle.
+	private final float inputScale_;
+	// The measured pulse input, null for an analog one.
+	private final IncapImpl pulseInput_;
+	private final float outputScale_;
+	private final boolean reporting_;
+	private float setpoint_ = 0;
+	private float kp_ = 0;
+	private float ki_ = 0;
+	private float kd_ = 0;
+	private boolean valid_ = false;
+	private long input_;
+	private int output_;
+	private boolean saturated_;
+
+	ControlLoopImpl(IOIOImpl ioio, int loopNum, float inputScale,
+			IncapImpl pulseInput, float outputScale, boolean reporting)
+			throws ConnectionLostException {
+		super(ioio);
+		loopNum_ = loopNum;
+		inputScale_ = inputScale;
+		pulseInput_ = pulseInput;
+		outputScale_ = outputScale;
+		reporting_ = reporting;
+	}
+
+	@Override
+	synchronized public void setSetpoint(float setpoint)
+			throws ConnectionLostException {
+		if (!(setpoint >= 0 && setpoint * inputScale_ <= Integer.MAX_VALUE)) {
+			throw new IllegalArgumentException("Illegal setpoint: " + setpoint);
+		}
+		checkState();
+		setpoint_ = setpoint;
+		sendParams();
+	}
+
+	@Override
+	synchronized public void setGains(float kp, float ki, float kd)
+			throws ConnectionLostException {
+		checkState();
+		kp_ = kp;
+		ki_ = ki;
+		kd_ = kd;
+		sendParams();
+	}
+
+	// The loop works in input counts and duty cycle clocks, per run, with
+	// gains in fixed point: out of the shifts that leave every gain within 16
+	// bits, the largest one gives the most precision.
+	private void sendParams() throws ConnectionLostException {
+		final float dt = pulseInput_ != null ? pulseInput_.getRunPeriod()
+				: 1 / ioio_.getAnalogScanRate();
+		final float scale = outputScale_ / inputScale_;
+		final float kp = kp_ * scale;
+		final float ki = ki_ * scale * dt;
+		final float kd = kd_ * scale / dt;
+		final float max = Math.max(Math.abs(kp),
+				Math.max(Math.abs(ki), Math.abs(kd)));
+		int shift = MAX_SHIFT;
+		while (shift >= 0 && max * (1 << shift) > Short.MAX_VALUE) {
+			--shift;
+		}
+		if (shift < 0) {
+			throw new IllegalArgumentException("Gains too large: " + kp_
+					+ ", " + ki_ + ", " + kd_);
+		}
+		try {
+			ioio_.protocol_.controlParams(loopNum_,
+					Math.round(setpoint_ * inputScale_),
+					Math.round(kp * (1 << shift)),
+					Math.round(ki * (1 << shift)),
+					Math.round(kd * (1 << shift)), shift);
+		} catch (IOException e) {
+			throw new ConnectionLostException(e);
+		}
+	}
+
+	@Override
+	synchronized public void reportReceived(long input, int output,
+			boolean saturated) {
+		input_ = input;
+		output_ = output;
+		saturated_ = saturated;
+		valid_ = true;
+		notifyAll();
+	}
+
+	private void waitForReport() throws InterruptedException,
+			ConnectionLostException {
+		if (!reporting_) {
+			throw new IllegalStateException(
+					"Control loop was opened without reports.");
+		}
+		checkState();
+		while (!valid_) {
+			wait();
+			checkState();
+		}
+	}
+
+	@Override
+	synchronized public float getInput() throws InterruptedException,
+			ConnectionLostException {
+		waitForReport();
+		return input_ / inputScale_;
+	}
+
+	@Override
+	synchronized public float getDutyCycle() throws InterruptedException,
+			ConnectionLostException {
+		waitForReport();
+		// A duty cycle register value of n > 0 gives pulses of n + 1 clocks.
+		return output_ == 0 ? 0 : Math.min((output_ + 1) / outputScale_, 1);
+	}
+
+	@Override
+	synchronized public boolean isSaturated() throws InterruptedException,
+			ConnectionLostException {
+		waitForReport();
+		return saturated_;
+	}
+
+	@Override
+	public synchronized void disconnected() {
+		super.disconnected();
+		notifyAll();
+	}
+
+	@Override
+	public synchronized void close() {
+		ioio_.closeControlLoop(loopNum_);
+		super.close();
+		notifyAll();
+	}
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *  
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * 
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ * 
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+package ioio.lib.impl;
+
+/**
+ * Maps device timestamps onto {@link System#nanoTime()}.
+ * <p>
+ * The device counts microseconds in 32 bits. Every sync round sends a request
+ * and notes the host time around the reply; the device time in the reply is
+ * assumed to be halfway between. Of all the rounds since {@link #reset()}, the
+ * one with the shortest round trip is used, since it bounds the error best.
+ * Device times are taken relative to it, so they may be up to 35 minutes away
+ * from it in either direction.
+ */
+class DeviceClock {
+	private int pendingSeq_ = -1;
+	private long requestTime_;
+	private boolean replied_;
+
+	private boolean synced_ = false;
+	private long bestRoundTrip_;
+	private long hostRef_;
+	private long deviceRef_;
+
+	synchronized void reset() {
+		synced_ = false;
+		pendingSeq_ = -1;
+	}
+
+	synchronized void requestSent(int seq) {
+		pendingSeq_ = seq;
+		replied_ = false;
+		requestTime_ = System.nanoTime();
+	}
+
+	synchronized void replyReceived(int seq, long deviceTime) {
+		final long now = System.nanoTime();
+		if (seq != pendingSeq_) {
+			return;
+		}
+		final long roundTrip = now - requestTime_;
+		if (!synced_ || roundTrip < bestRoundTrip_) {
+			synced_ = true;
+			bestRoundTrip_ = roundTrip;
+			hostRef_ = requestTime_ + roundTrip / 2;
+			deviceRef_ = deviceTime;
+		}
+		pendingSeq_ = -1;
+		replied_ = true;
+		notifyAll();
+	}
+
+	/**
+	 * @return Whether the reply to the last request arrived in time.
+	 */
+	synchronized boolean awaitReply(long timeoutMs)
+			throws InterruptedException {
+		final long deadline = System.currentTimeMillis() + timeoutMs;
+		long left = timeoutMs;
+		while (!replied_ && left > 0) {
+			wait(left);
+			left = deadline - System.currentTimeMillis();
+		}
+		return replied_;
+	}
+
+	/**
+	 * @return The host time, in nanoseconds, or -1 if never synced.
+	 */
+	synchronized long toHostNanos(long deviceTime) {
+		if (!synced_) {
+			return -1;
+		}
+		final int elapsedUs = (int) (deviceTime - deviceRef_);
+		return hostRef_ + elapsedUs * 1000L;
+	}
+}
@@ -37,12 +37,24 @@ import java.io.IOException;
 class DigitalInputImpl extends AbstractPin implements DigitalInput,
 		InputPinListener {
 	private boolean value_;
+	private long timestamp_ = -1;
 	private boolean valid_ = false;
 
 	DigitalInputImpl(IOIOImpl ioio, int pin) throws ConnectionLostException {
 		super(ioio, pin);
 	}
 
+	@Override
+	synchronized public void setTimestamp(long time) {
+		timestamp_ = time;
+	}
+
+	@Override
+	synchronized public long getTimestamp() throws ConnectionLostException {
+		checkState();
+		return timestamp_;
+	}
+
 	@Override
 	synchronized public void setValue(int value) {
 		// Log.v("DigitalInputImpl", "Pin " + pinNum_ + " value is " + value);
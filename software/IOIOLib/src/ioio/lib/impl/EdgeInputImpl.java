@@ -0,0 +1,117 @@
+package ioio.lib.impl;
+
+import ioio.lib.api.EdgeInput;
+import ioio.lib.api.exception.ConnectionLostException;
+import ioio.lib.impl.IncomingState.DataModuleListener;
+
+class EdgeInputImpl extends AbstractPin implements DataModuleListener,
+		EdgeInput {
+	private static final int BUFFER_SIZE = 1024;
+	private final int incapNum_;
+	private final float timeBase_;
+	private final boolean doublePrecision_;
+	private final long mask_;
+
+	// The capture value of the previous edge, if there was one since opening
+	// or since the last loss.
+	private boolean havePrevious_ = false;
+	private long previous_;
+
+	private final long[] buffer_ = new long[BUFFER_SIZE];
+	private int bufferSize_ = 0;
+	private int bufferReadCursor_ = 0;
+	private int bufferWriteCursor_ = 0;
+	private int overflowCount_ = 0;
+
+	EdgeInputImpl(IOIOImpl ioio, int incapNum, int pin, int clockRate,
+			boolean doublePrecision) throws ConnectionLostException {
+		super(ioio, pin);
+		incapNum_ = incapNum;
+		timeBase_ = 1.0f / clockRate;
+		doublePrecision_ = doublePrecision;
+		mask_ = doublePrecision ? 0xFFFFFFFFL : 0xFFFFL;
+	}
+
+	@Override
+	synchronized public void dataReceived(byte[] data, int size) {
+		if (size == 0) {
+			// Edges were lost and the capture timer starts over.
+			++overflowCount_;
+			havePrevious_ = false;
+			return;
+		}
+		final int captureSize = doublePrecision_ ? 4 : 2;
+		for (int i = 0; i + captureSize <= size; i += captureSize) {
+			long capture = 0;
+			for (int j = captureSize - 1; j >= 0; --j) {
+				capture = (capture << 8) | (data[i + j] & 0xFF);
+			}
+			if (havePrevious_) {
+				long interval = (capture - previous_) & mask_;
+				if (interval == 0) {
+					interval = mask_ + 1;
+				}
+				bufferPush(interval);
+			}
+			previous_ = capture;
+			havePrevious_ = true;
+		}
+		notifyAll();
+	}
+
+	private void bufferPush(long interval) {
+		if (bufferSize_ == buffer_.length) {
+			++overflowCount_;
+			return;
+		}
+		buffer_[bufferWriteCursor_++] = interval;
+		if (bufferWriteCursor_ == buffer_.length) {
+			bufferWriteCursor_ = 0;
+		}
+		++bufferSize_;
+	}
+
+	@Override
+	synchronized public float waitEdgeGetInterval()
+			throws InterruptedException, ConnectionLostException {
+		checkState();
+		while (bufferSize_ == 0 && state_ == State.OPEN) {
+			wait();
+		}
+		checkState();
+		final long interval = buffer_[bufferReadCursor_++];
+		if (bufferReadCursor_ == buffer_.length) {
+			bufferReadCursor_ = 0;
+		}
+		--bufferSize_;
+		return timeBase_ * interval;
+	}
+
+	@Override
+	synchronized public int available() throws ConnectionLostException {
+		checkState();
+		return bufferSize_;
+	}
+
+	@Override
+	synchronized public int getOverflowCount() throws ConnectionLostException {
+		checkState();
+		return overflowCount_;
+	}
+
+	@Override
+	public synchronized void reportAdditionalBuffer(int bytesToAdd) {
+	}
+
+	@Override
+	public synchronized void close() {
+		ioio_.closeIncap(incapNum_, doublePrecision_);
+		super.close();
+	}
+
+	@Override
+	public synchronized void disconnected() {
+		notifyAll();
+		super.disconnected();
+	}
+}
@@ -0,0 +1,84 @@
+package ioio.lib.impl;
+
+import ioio.lib.api.FrequencyCounter;
+import ioio.lib.api.exception.ConnectionLostException;
+import ioio.lib.impl.IncomingState.IncapCountListener;
+
+class FrequencyCounterImpl extends AbstractPin implements IncapCountListener,
+		FrequencyCounter {
+	private final int incapNum_;
+	private final int clockRate_;
+	private final boolean doublePrecision_;
+	private float frequency_;
+	private int numGates_ = 0;
+	private int overflowCount_ = 0;
+
+	FrequencyCounterImpl(IOIOImpl ioio, int incapNum, int pin, int clockRate,
+			boolean doublePrecision) throws ConnectionLostException {
+		super(ioio, pin);
+		incapNum_ = incapNum;
+		clockRate_ = clockRate;
+		doublePrecision_ = doublePrecision;
+	}
+
+	@Override
+	synchronized public void countReceived(boolean overflow, long edges,
+			long ticks) {
+		frequency_ = ticks == 0 ? 0
+				: (float) ((double) edges * clockRate_ / ticks);
+		if (overflow) {
+			++overflowCount_;
+		}
+		++numGates_;
+		notifyAll();
+	}
+
+	@Override
+	synchronized public float getFrequency() throws InterruptedException,
+			ConnectionLostException {
+		checkState();
+		while (numGates_ == 0 && state_ == State.OPEN) {
+			wait();
+		}
+		checkState();
+		return frequency_;
+	}
+
+	@Override
+	synchronized public float waitGateGetFrequency()
+			throws InterruptedException, ConnectionLostException {
+		checkState();
+		final int gates = numGates_;
+		while (numGates_ == gates && state_ == State.OPEN) {
+			wait();
+		}
+		checkState();
+		return frequency_;
+	}
+
+	@Override
+	synchronized public int getOverflowCount() throws ConnectionLostException {
+		checkState();
+		return overflowCount_;
+	}
+
+	@Override
+	public synchronized void dataReceived(byte[] data, int size) {
+	}
+
+	@Override
+	public synchronized void reportAdditionalBuffer(int bytesToAdd) {
+	}
+
+	@Override
+	public synchronized void close() {
+		ioio_.closeIncap(incapNum_, doublePrecision_);
+		super.close();
+	}
+
+	@Override
+	public synchronized void disconnected() {
+		notifyAll();
+		super.disconnected();
+	}
+}
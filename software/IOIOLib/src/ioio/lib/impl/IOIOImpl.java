@@ -30,17 +30,26 @@ package ioio.lib.impl;
 
 import ioio.lib.api.AnalogInput;
 import ioio.lib.api.CapSense;
+import ioio.lib.api.ControlLoop;
 import ioio.lib.api.DigitalInput;
 import ioio.lib.api.DigitalInput.Spec;
 import ioio.lib.api.DigitalInput.Spec.Mode;
 import ioio.lib.api.DigitalOutput;
+import ioio.lib.api.EdgeInput;
+import ioio.lib.api.FrequencyCounter;
 import ioio.lib.api.IOIO;
 import ioio.lib.api.IOIOConnection;
 import ioio.lib.api.IcspMaster;
+import ioio.lib.api.PeriodicDigitalInput;
 import ioio.lib.api.PulseInput;
 import ioio.lib.api.PulseInput.ClockRate;
 import ioio.lib.api.PulseInput.PulseMode;
+import ioio.lib.api.PwmGroup;
 import ioio.lib.api.PwmOutput;
+import ioio.lib.api.PwmSequencer;
+import ioio.lib.api.QuadratureEncoder;
+import ioio.lib.api.Reflex;
+import ioio.lib.api.Schedule;
 import ioio.lib.api.SpiMaster;
 import ioio.lib.api.TwiMaster;
 import ioio.lib.api.TwiMaster.Rate;
@@ -59,20 +68,41 @@ public class IOIOImpl implements IOIO, DisconnectListener {
 
 	private static final byte[] REQUIRED_INTERFACE_ID = new byte[] { 'I', 'O',
 			'I', 'O', '0', '0', '0', '4' };
+	// Firmware supporting this interface ID reports which extensions to
+	// IOIO0004 it has. Older firmware is still accepted, without any.
+	private static final byte[] CAPABILITIES_INTERFACE_ID = new byte[] {
+			'I', 'O', 'I', 'O', '0', '0', '0', '5' };
+
+	// Analog scan period, in 0.5us units, minus one. Matches the firmware's
+	// default after reset.
+	private static final int DEFAULT_ANALOG_SCAN_PERIOD = 1999;
+	private static final int MIN_ANALOG_SCAN_PERIOD = 199;
+	// Delta encoded analog frames are resent whole every so many frames.
+	private static final int ANALOG_KEYFRAME_INTERVAL = 250;
+	// Clock sync keeps the fastest of this many round trips.
+	private static final int CLOCK_SYNC_ROUNDS = 8;
+	private static final long CLOCK_SYNC_TIMEOUT_MS = 1000;
 
 	private IOIOConnection connection_;
 	private IncomingState incomingState_ = new IncomingState();
 	private boolean openPins_[];
 	private boolean openTwi_[];
 	private boolean openIcsp_;
+	private boolean openPeriodicDigitalInput_;
 	private ModuleAllocator pwmAllocator_;
 	private ModuleAllocator uartAllocator_;
 	private ModuleAllocator spiAllocator_;
 	private ModuleAllocator incapAllocatorDouble_;
 	private ModuleAllocator incapAllocatorSingle_;
+	private ModuleAllocator encoderAllocator_;
+	private ModuleAllocator scheduleAllocator_;
+	private ModuleAllocator reflexAllocator_;
+	private ModuleAllocator controlLoopAllocator_;
 	IOIOProtocol protocol_;
 	private State state_ = State.INIT;
 	private Board.Hardware hardware_;
+	private int capabilities_;
+	private int analogScanPeriod_ = DEFAULT_ANALOG_SCAN_PERIOD;
 
 	public IOIOImpl(IOIOConnection con) {
 		connection_ = con;
@@ -112,6 +142,7 @@ public class IOIOImpl implements IOIO, DisconnectListener {
 			Log.v(TAG, "Querying for required interface ID");
 			checkInterfaceVersion();
 			Log.v(TAG, "Required interface ID is supported");
+			queryCapabilities();
 			state_ = State.CONNECTED;
 			Log.i(TAG, "IOIO connection established");
 		} catch (ConnectionLostException e) {
@@ -173,6 +204,7 @@ public class IOIOImpl implements IOIO, DisconnectListener {
 		openPins_ = new boolean[hardware_.numPins()];
 		openTwi_ = new boolean[hardware_.numTwiModules()];
 		openIcsp_ = false;
+		openPeriodicDigitalInput_ = false;
 		pwmAllocator_ = new ModuleAllocator(hardware_.numPwmModules(), "PWM");
 		uartAllocator_ = new ModuleAllocator(hardware_.numUartModules(), "UART");
 		spiAllocator_ = new ModuleAllocator(hardware_.numSpiModules(), "SPI");
@@ -180,6 +212,14 @@ public class IOIOImpl implements IOIO, DisconnectListener {
 				hardware_.incapDoubleModules(), "INCAP_DOUBLE");
 		incapAllocatorSingle_ = new ModuleAllocator(
 				hardware_.incapSingleModules(), "INCAP_SINGLE");
+		encoderAllocator_ = new ModuleAllocator(Constants.NUM_ENCODERS,
+				"ENCODER");
+		scheduleAllocator_ = new ModuleAllocator(Constants.NUM_SCHEDULES,
+				"SCHEDULE");
+		reflexAllocator_ = new ModuleAllocator(Constants.NUM_REFLEXES,
+				"REFLEX");
+		controlLoopAllocator_ = new ModuleAllocator(
+				Constants.NUM_CONTROL_LOOPS, "CONTROL_LOOP");
 	}
 
 	private void checkInterfaceVersion() throws IncompatibilityException,
@@ -198,6 +238,35 @@ public class IOIOImpl implements IOIO, DisconnectListener {
 		}
 	}
 
+	private void queryCapabilities() throws ConnectionLostException,
+			InterruptedException {
+		try {
+			protocol_.checkInterface(CAPABILITIES_INTERFACE_ID);
+			if (!incomingState_.waitForOptionalInterfaceSupport()) {
+				Log.v(TAG, "Firmware has no extensions");
+				capabilities_ = 0;
+				return;
+			}
+			protocol_.getCapabilities();
+		} catch (IOException e) {
+			throw new ConnectionLostException(e);
+		}
+		capabilities_ = incomingState_.waitForCapabilities();
+		Log.v(TAG, "Firmware capabilities: 0x"
+				+ Integer.toHexString(capabilities_));
+	}
+
+	boolean hasCapability(int capability) {
+		return (capabilities_ & capability) != 0;
+	}
+
+	void checkCapability(int capability, String feature) {
+		if (!hasCapability(capability)) {
+			throw new UnsupportedOperationException(
+					"IOIO firmware does not support " + feature);
+		}
+	}
+
 	synchronized void removeDisconnectListener(DisconnectListener listener) {
 		incomingState_.removeDisconnectListener(listener);
 	}
@@ -230,6 +299,15 @@ public class IOIOImpl implements IOIO, DisconnectListener {
 		}
 	}
 
+	synchronized void closePwmSequencer(int pwmNum) {
+		try {
+			checkState();
+			protocol_.pwmSeqConfigure(pwmNum, false, false, 0);
+		} catch (IOException e) {
+		} catch (ConnectionLostException e) {
+		}
+	}
+
 	synchronized void closeUart(int uartNum) {
 		try {
 			checkState();
@@ -256,6 +334,25 @@ public class IOIOImpl implements IOIO, DisconnectListener {
 		}
 	}
 
+	synchronized void closePeriodicDigitalInput(int[] pins) {
+		try {
+			checkState();
+			if (!openPeriodicDigitalInput_) {
+				throw new IllegalStateException(
+						"Periodic digital input not open");
+			}
+			openPeriodicDigitalInput_ = false;
+			for (int pin : pins) {
+				protocol_.registerPeriodicDigitalSampling(pin, 0);
+			}
+		} catch (IOException e) {
+		} catch (ConnectionLostException e) {
+		}
+		for (int pin : pins) {
+			closePin(pin);
+		}
+	}
+
 	synchronized void closeIcsp() {
 		try {
 			checkState();
@@ -296,6 +393,49 @@ public class IOIOImpl implements IOIO, DisconnectListener {
 		}
 	}
 
+	synchronized void closeSchedule(int scheduleNum) {
+		try {
+			checkState();
+			scheduleAllocator_.releaseModule(scheduleNum);
+			protocol_.scheduleConfigure(scheduleNum, false, 0);
+		} catch (IOException e) {
+		} catch (ConnectionLostException e) {
+		}
+	}
+
+	synchronized void closeQuadratureEncoder(int encoderNum, int pinA,
+			int pinB) {
+		try {
+			checkState();
+			encoderAllocator_.releaseModule(encoderNum);
+			protocol_.encoderClose(encoderNum);
+		} catch (IOException e) {
+		} catch (ConnectionLostException e) {
+		}
+		closePin(pinA);
+		closePin(pinB);
+	}
+
+	synchronized void closeReflex(int reflexNum) {
+		try {
+			checkState();
+			reflexAllocator_.releaseModule(reflexNum);
+			protocol_.clearReflex(reflexNum);
+		} catch (IOException e) {
+		} catch (ConnectionLostException e) {
+		}
+	}
+
+	synchronized void closeControlLoop(int loopNum) {
+		try {
+			checkState();
+			controlLoopAllocator_.releaseModule(loopNum);
+			protocol_.controlClose(loopNum);
+		} catch (IOException e) {
+		} catch (ConnectionLostException e) {
+		}
+	}
+
 	@Override
 	synchronized public void softReset() throws ConnectionLostException {
 		checkState();
@@ -304,6 +444,7 @@ public class IOIOImpl implements IOIO, DisconnectListener {
 		} catch (IOException e) {
 			throw new ConnectionLostException(e);
 		}
+		analogScanPeriod_ = DEFAULT_ANALOG_SCAN_PERIOD;
 	}
 
 	@Override
@@ -367,6 +508,58 @@ public class IOIOImpl implements IOIO, DisconnectListener {
 		return result;
 	}
 
+	@Override
+	synchronized public PeriodicDigitalInput openPeriodicDigitalInput(
+			DigitalInput.Spec[] specs, float rateHz, int bufferSize)
+			throws ConnectionLostException {
+		checkState();
+		checkCapability(IOIOProtocol.CAPABILITY_PERIODIC_DIGITAL_IN,
+				"periodic digital input");
+		checkPeriodicDigitalInputFree();
+		// The IOIO samples every (freqScale + 1) * 10us.
+		final int freqScale = Math.round(100000 / rateHz) - 1;
+		if (freqScale < 1 || freqScale > 255) {
+			throw new IllegalArgumentException("Illegal sample rate: "
+					+ rateHz);
+		}
+		if (specs.length == 0 || bufferSize <= 0) {
+			throw new IllegalArgumentException(
+					"Need at least one pin and a non-empty buffer");
+		}
+		int[] pins = new int[specs.length];
+		for (int i = 0; i < specs.length; ++i) {
+			hardware_.checkValidPin(specs[i].pin);
+			checkPinFree(specs[i].pin);
+			for (int j = 0; j < i; ++j) {
+				if (pins[j] == specs[i].pin) {
+					throw new IllegalArgumentException("Pin given twice: "
+							+ specs[i].pin);
+				}
+			}
+			pins[i] = specs[i].pin;
+		}
+		PeriodicDigitalInputImpl result = new PeriodicDigitalInputImpl(this,
+				pins, 100000.f / (freqScale + 1), bufferSize);
+		addDisconnectListener(result);
+		for (int pin : pins) {
+			openPins_[pin] = true;
+		}
+		openPeriodicDigitalInput_ = true;
+		incomingState_.addPeriodicDigitalListener(result);
+		try {
+			for (DigitalInput.Spec spec : specs) {
+				protocol_.setPinDigitalIn(spec.pin, spec.mode);
+			}
+			for (int pin : pins) {
+				protocol_.registerPeriodicDigitalSampling(pin, freqScale);
+			}
+		} catch (IOException e) {
+			result.close();
+			throw new ConnectionLostException(e);
+		}
+		return result;
+	}
+
 	@Override
 	public DigitalOutput openDigitalOutput(int pin,
 			ioio.lib.api.DigitalOutput.Spec.Mode mode, boolean startValue)
@@ -406,17 +599,78 @@ public class IOIOImpl implements IOIO, DisconnectListener {
 	}
 
 	@Override
-	synchronized public AnalogInput openAnalogInput(int pin)
+	synchronized public void writeDigitalOutputs(DigitalOutput[] outputs,
+			boolean[] values) throws ConnectionLostException {
+		checkState();
+		checkCapability(IOIOProtocol.CAPABILITY_DIGITAL_OUT_LEVELS,
+				"writing digital outputs together");
+		if (outputs.length != values.length) {
+			throw new IllegalArgumentException(
+					"Number of outputs and values differ");
+		}
+		if (outputs.length == 0) {
+			return;
+		}
+		int firstPin = Integer.MAX_VALUE;
+		int lastPin = -1;
+		for (DigitalOutput output : outputs) {
+			final DigitalOutputImpl impl = (DigitalOutputImpl) output;
+			impl.checkState();
+			firstPin = Math.min(firstPin, impl.pinNum_);
+			lastPin = Math.max(lastPin, impl.pinNum_);
+		}
+		final int numBytes = (lastPin - firstPin) / 8 + 1;
+		final byte[] mask = new byte[numBytes];
+		final byte[] levels = new byte[numBytes];
+		for (int i = 0; i < outputs.length; ++i) {
+			final int bit = ((DigitalOutputImpl) outputs[i]).pinNum_ - firstPin;
+			mask[bit / 8] |= 1 << (bit % 8);
+			if (values[i]) {
+				levels[bit / 8] |= 1 << (bit % 8);
+			}
+		}
+		try {
+			protocol_.setDigitalOutLevels(firstPin, numBytes, mask, levels);
+		} catch (IOException e) {
+			throw new ConnectionLostException(e);
+		}
+		for (int i = 0; i < outputs.length; ++i) {
+			final DigitalOutputImpl impl = (DigitalOutputImpl) outputs[i];
+			synchronized (impl) {
+				impl.value_ = values[i];
+			}
+		}
+	}
+
+	@Override
+	public AnalogInput openAnalogInput(int pin)
 			throws ConnectionLostException {
+		return openAnalogInput(pin, 1, false);
+	}
+
+	@Override
+	synchronized public AnalogInput openAnalogInput(int pin, int decimation,
+			boolean oversample) throws ConnectionLostException {
 		checkState();
 		hardware_.checkSupportsAnalogInput(pin);
 		checkPinFree(pin);
-		AnalogInputImpl result = new AnalogInputImpl(this, pin);
+		if (decimation < 1 || decimation > (oversample ? 64 : 256)) {
+			throw new IllegalArgumentException("Illegal decimation: "
+					+ decimation);
+		}
+		if (decimation != 1 || oversample) {
+			checkCapability(IOIOProtocol.CAPABILITY_ANALOG_SCAN,
+					"analog input decimation");
+		}
+		AnalogInputImpl result = new AnalogInputImpl(this, pin, decimation);
 		addDisconnectListener(result);
 		openPins_[pin] = true;
 		incomingState_.addInputPinListener(pin, result);
 		try {
 			protocol_.setPinAnalogIn(pin);
+			if (decimation != 1 || oversample) {
+				protocol_.setAnalogInDecimation(pin, decimation - 1, oversample);
+			}
 			protocol_.setAnalogInSampling(pin, true);
 		} catch (IOException e) {
 			result.close();
@@ -425,6 +679,91 @@ public class IOIOImpl implements IOIO, DisconnectListener {
 		return result;
 	}
 
+	@Override
+	synchronized public void setAnalogInputScanRate(float rateHz)
+			throws ConnectionLostException {
+		checkState();
+		checkCapability(IOIOProtocol.CAPABILITY_ANALOG_SCAN,
+				"analog scan rate");
+		int period = Math.round(2000000.f / rateHz) - 1;
+		if (period < MIN_ANALOG_SCAN_PERIOD || period > 0xFFFF) {
+			throw new IllegalArgumentException("Scan rate out of range: "
+					+ rateHz);
+		}
+		try {
+			protocol_.setAnalogInPeriod(period);
+		} catch (IOException e) {
+			throw new ConnectionLostException(e);
+		}
+		analogScanPeriod_ = period;
+	}
+
+	@Override
+	synchronized public void setAnalogInputDeltaEncoding(boolean enable)
+			throws ConnectionLostException {
+		checkState();
+		checkCapability(IOIOProtocol.CAPABILITY_ANALOG_DELTA, "delta encoding");
+		try {
+			protocol_.setAnalogInEncoding(enable, ANALOG_KEYFRAME_INTERVAL);
+		} catch (IOException e) {
+			throw new ConnectionLostException(e);
+		}
+	}
+
+	@Override
+	synchronized public void setDigitalInputBatching(boolean enable)
+			throws ConnectionLostException {
+		checkState();
+		checkCapability(IOIOProtocol.CAPABILITY_DIGITAL_IN_CHANGES,
+				"digital input batching");
+		try {
+			protocol_.setDigitalInBatching(enable);
+		} catch (IOException e) {
+			throw new ConnectionLostException(e);
+		}
+	}
+
+	@Override
+	synchronized public void setSampleTimestamps(boolean enable)
+			throws ConnectionLostException, InterruptedException {
+		checkState();
+		checkCapability(IOIOProtocol.CAPABILITY_TIMESTAMPS, "timestamps");
+		if (enable) {
+			syncClock();
+		}
+		try {
+			protocol_.setTimestamps(enable ? IOIOProtocol.TIMESTAMP_ANALOG
+					| IOIOProtocol.TIMESTAMP_DIGITAL : 0);
+		} catch (IOException e) {
+			throw new ConnectionLostException(e);
+		}
+	}
+
+	@Override
+	synchronized public void syncClock() throws ConnectionLostException,
+			InterruptedException {
+		checkState();
+		checkCapability(IOIOProtocol.CAPABILITY_TIMESTAMPS, "clock sync");
+		protocol_.checkNotRecording("clock sync");
+		final DeviceClock clock = incomingState_.clock_;
+		clock.reset();
+		try {
+			for (int i = 0; i < CLOCK_SYNC_ROUNDS; ++i) {
+				clock.requestSent(i);
+				protocol_.syncTime(i);
+				if (!clock.awaitReply(CLOCK_SYNC_TIMEOUT_MS)) {
+					checkState();
+				}
+			}
+		} catch (IOException e) {
+			throw new ConnectionLostException(e);
+		}
+	}
+
+	float getAnalogScanRate() {
+		return 2000000.f / (analogScanPeriod_ + 1);
+	}
+
 	@Override
 	public CapSense openCapSense(int pin) throws ConnectionLostException {
 		return openCapSense(pin, CapSense.DEFAULT_COEF);
@@ -459,6 +798,68 @@ public class IOIOImpl implements IOIO, DisconnectListener {
 	@Override
 	synchronized public PwmOutput openPwmOutput(DigitalOutput.Spec spec,
 			int freqHz) throws ConnectionLostException {
+		return openPwm(spec, freqHz, 0, false);
+	}
+
+	@Override
+	public PwmSequencer openPwmSequencer(int pin, int freqHz,
+			int periodsPerStep) throws ConnectionLostException {
+		return openPwmSequencer(new DigitalOutput.Spec(pin), freqHz,
+				periodsPerStep, false);
+	}
+
+	@Override
+	synchronized public PwmSequencer openPwmSequencer(DigitalOutput.Spec spec,
+			int freqHz, int periodsPerStep, boolean loop)
+			throws ConnectionLostException {
+		checkState();
+		checkCapability(IOIOProtocol.CAPABILITY_PWM_SEQUENCER,
+				"PWM sequencers");
+		if (periodsPerStep < 1 || periodsPerStep > 65535) {
+			throw new IllegalArgumentException(
+					"Periods per step must be between 1 and 65535. Got: "
+							+ periodsPerStep);
+		}
+		return (PwmSequencer) openPwm(spec, freqHz, periodsPerStep, loop);
+	}
+
+	@Override
+	synchronized public PwmGroup openPwmGroup(DigitalOutput.Spec[] specs,
+			int freqHz) throws ConnectionLostException {
+		checkState();
+		checkCapability(IOIOProtocol.CAPABILITY_PWM_GROUP, "PWM groups");
+		if (specs.length == 0) {
+			throw new IllegalArgumentException("A PWM group needs pins");
+		}
+		PwmImpl[] outputs = new PwmImpl[specs.length];
+		int opened = 0;
+		try {
+			for (; opened < specs.length; ++opened) {
+				outputs[opened] = openPwm(specs[opened], freqHz, 0, false);
+			}
+		} finally {
+			if (opened < specs.length) {
+				while (opened > 0) {
+					outputs[--opened].close();
+				}
+			}
+		}
+		PwmGroupImpl group = new PwmGroupImpl(this, outputs);
+		addDisconnectListener(group);
+		try {
+			for (int i = 1; i < outputs.length; ++i) {
+				protocol_.setPwmSync(outputs[i].pwmNum_, outputs[0].pwmNum_);
+			}
+		} catch (IOException e) {
+			group.close();
+			throw new ConnectionLostException(e);
+		}
+		return group;
+	}
+
+	// A plain PWM output when periodsPerStep is 0, a sequencer otherwise.
+	private PwmImpl openPwm(DigitalOutput.Spec spec, int freqHz,
+			int periodsPerStep, boolean loop) throws ConnectionLostException {
 		checkState();
 		hardware_.checkSupportsPeripheralOutput(spec.pin);
 		checkPinFree(spec.pin);
@@ -480,7 +881,15 @@ public class IOIOImpl implements IOIO, DisconnectListener {
 			}
 		}
 
-		PwmImpl pwm = new PwmImpl(this, spec.pin, pwmNum, period, baseUs);
+		PwmImpl pwm;
+		if (periodsPerStep == 0) {
+			pwm = new PwmImpl(this, spec.pin, pwmNum, period, baseUs);
+		} else {
+			PwmSequencerImpl seq = new PwmSequencerImpl(this, spec.pin, pwmNum,
+					period, baseUs, loop);
+			incomingState_.addPwmSeqListener(pwmNum, seq);
+			pwm = seq;
+		}
 		addDisconnectListener(pwm);
 		openPins_[spec.pin] = true;
 		try {
@@ -488,6 +897,9 @@ public class IOIOImpl implements IOIO, DisconnectListener {
 			protocol_.setPinPwm(spec.pin, pwmNum, true);
 			protocol_.setPwmPeriod(pwmNum, period - 1,
 					IOIOProtocol.PwmScale.values()[scale]);
+			if (periodsPerStep != 0) {
+				protocol_.pwmSeqConfigure(pwmNum, true, loop, periodsPerStep);
+			}
 		} catch (IOException e) {
 			pwm.close();
 			throw new ConnectionLostException(e);
@@ -696,6 +1108,274 @@ public class IOIOImpl implements IOIO, DisconnectListener {
 				mode, true);
 	}
 
+	@Override
+	public EdgeInput openEdgeInput(Spec spec, ClockRate rate,
+			boolean doublePrecision) throws ConnectionLostException {
+		checkState();
+		checkCapability(IOIOProtocol.CAPABILITY_INCAP_EXTENDED, "edge input");
+		checkPinFree(spec.pin);
+		hardware_.checkSupportsPeripheralInput(spec.pin);
+		int incapNum = doublePrecision ? incapAllocatorDouble_.allocateModule()
+				: incapAllocatorSingle_.allocateModule();
+		EdgeInputImpl edges = new EdgeInputImpl(this, incapNum, spec.pin,
+				rate.hertz, doublePrecision);
+		addDisconnectListener(edges);
+		incomingState_.addIncapListener(incapNum, edges);
+		openPins_[spec.pin] = true;
+		try {
+			protocol_.setPinDigitalIn(spec.pin, spec.mode);
+			protocol_.setPinIncap(spec.pin, incapNum, true);
+			protocol_.incapConfigure(incapNum, doublePrecision,
+					IOIOProtocol.INCAP_MODE_EDGES, rate.ordinal());
+		} catch (IOException e) {
+			edges.close();
+			throw new ConnectionLostException(e);
+		}
+		return edges;
+	}
+
+	@Override
+	public FrequencyCounter openFrequencyCounter(Spec spec, ClockRate rate,
+			int prescale, int gateMs, boolean doublePrecision)
+			throws ConnectionLostException {
+		final int prescaleCode;
+		switch (prescale) {
+		case 1:
+			prescaleCode = 0;
+			break;
+		case 4:
+			prescaleCode = 1;
+			break;
+		case 16:
+			prescaleCode = 2;
+			break;
+		default:
+			throw new IllegalArgumentException(
+					"Prescale must be 1, 4 or 16.");
+		}
+		if (gateMs < 1 || gateMs > 65535) {
+			throw new IllegalArgumentException(
+					"Gate time must be between 1 and 65535ms.");
+		}
+		checkState();
+		checkCapability(IOIOProtocol.CAPABILITY_FREQUENCY_COUNTER,
+				"frequency counters");
+		checkPinFree(spec.pin);
+		hardware_.checkSupportsPeripheralInput(spec.pin);
+		int incapNum = doublePrecision ? incapAllocatorDouble_.allocateModule()
+				: incapAllocatorSingle_.allocateModule();
+		FrequencyCounterImpl counter = new FrequencyCounterImpl(this,
+				incapNum, spec.pin, rate.hertz, doublePrecision);
+		addDisconnectListener(counter);
+		incomingState_.addIncapListener(incapNum, counter);
+		openPins_[spec.pin] = true;
+		try {
+			protocol_.setPinDigitalIn(spec.pin, spec.mode);
+			protocol_.setPinIncap(spec.pin, incapNum, true);
+			protocol_.incapSetGate(incapNum, prescaleCode, gateMs);
+			protocol_.incapConfigure(incapNum, doublePrecision,
+					IOIOProtocol.INCAP_MODE_COUNT, rate.ordinal());
+		} catch (IOException e) {
+			counter.close();
+			throw new ConnectionLostException(e);
+		}
+		return counter;
+	}
+
+	@Override
+	public FrequencyCounter openFrequencyCounter(int pin, int gateMs)
+			throws ConnectionLostException {
+		return openFrequencyCounter(new DigitalInput.Spec(pin),
+				ClockRate.RATE_16MHz, 16, gateMs, true);
+	}
+
+	@Override
+	synchronized public QuadratureEncoder openQuadratureEncoder(
+			DigitalInput.Spec a, DigitalInput.Spec b, int periodMs)
+			throws ConnectionLostException {
+		checkState();
+		checkCapability(IOIOProtocol.CAPABILITY_ENCODER, "quadrature encoders");
+		hardware_.checkValidPin(a.pin);
+		hardware_.checkValidPin(b.pin);
+		checkPinFree(a.pin);
+		checkPinFree(b.pin);
+		if (a.pin == b.pin) {
+			throw new IllegalArgumentException("Pin given twice: " + a.pin);
+		}
+		if (periodMs < 0 || periodMs > 0xFFFF) {
+			throw new IllegalArgumentException("Illegal period: " + periodMs);
+		}
+		int encoderNum = encoderAllocator_.allocateModule();
+		QuadratureEncoderImpl encoder = new QuadratureEncoderImpl(this,
+				encoderNum, a.pin, b.pin);
+		addDisconnectListener(encoder);
+		incomingState_.addEncoderListener(encoderNum, encoder);
+		openPins_[a.pin] = true;
+		openPins_[b.pin] = true;
+		try {
+			protocol_.setPinDigitalIn(a.pin, a.mode);
+			protocol_.setPinDigitalIn(b.pin, b.mode);
+			protocol_.encoderConfigure(encoderNum, a.pin, b.pin, periodMs);
+		} catch (IOException e) {
+			encoder.close();
+			throw new ConnectionLostException(e);
+		}
+		return encoder;
+	}
+
+	@Override
+	public QuadratureEncoder openQuadratureEncoder(int a, int b, int periodMs)
+			throws ConnectionLostException {
+		return openQuadratureEncoder(new DigitalInput.Spec(a),
+				new DigitalInput.Spec(b), periodMs);
+	}
+
+	@Override
+	synchronized public Reflex openReflex(DigitalInput input, boolean level,
+			Reflex.Action action) throws ConnectionLostException {
+		checkState();
+		checkCapability(IOIOProtocol.CAPABILITY_REFLEX, "reflexes");
+		final DigitalInputImpl in = ownResource(input, DigitalInputImpl.class);
+		return openReflex(IOIOProtocol.REFLEX_DIGITAL, in.pinNum_, level, 0, 0,
+				action);
+	}
+
+	@Override
+	synchronized public Reflex openReflex(AnalogInput input, float low,
+			float high, boolean rising, Reflex.Action action)
+			throws ConnectionLostException {
+		checkState();
+		checkCapability(IOIOProtocol.CAPABILITY_REFLEX, "reflexes");
+		final AnalogInputImpl in = ownResource(input, AnalogInputImpl.class);
+		if (!(low >= 0 && low <= high && high <= 1)) {
+			throw new IllegalArgumentException("Illegal thresholds: " + low
+					+ ", " + high);
+		}
+		return openReflex(IOIOProtocol.REFLEX_ANALOG, in.pinNum_, rising,
+				Math.round(low * 1023), Math.round(high * 1023), action);
+	}
+
+	private Reflex openReflex(int condition, int pin, boolean level, int low,
+			int high, Reflex.Action action) throws ConnectionLostException {
+		final int type;
+		final int target;
+		int value = 0;
+		int fraction = 0;
+		switch (action.type) {
+		case DIGITAL_OUT:
+			type = IOIOProtocol.REFLEX_ACTION_DIGITAL_OUT;
+			target = ownResource(action.output, DigitalOutputImpl.class).pinNum_;
+			value = action.value != 0 ? 1 : 0;
+			break;
+
+		case PWM_DUTY_CYCLE:
+		case PWM_PULSE_WIDTH:
+			final PwmImpl pwm = ownResource(action.output, PwmImpl.class);
+			if (!(action.value >= 0)) {
+				throw new IllegalArgumentException("Illegal value: "
+						+ action.value);
+			}
+			final int duty = pwm.clocksToDuty(action.type
+					== Reflex.Action.Type.PWM_DUTY_CYCLE
+					? pwm.dutyCycleToClocks(Math.min(action.value, 1))
+					: pwm.pulseWidthToClocks(action.value));
+			type = IOIOProtocol.REFLEX_ACTION_PWM;
+			target = pwm.pwmNum_;
+			value = duty >> 2;
+			fraction = duty & 0x03;
+			break;
+
+		case UART_HALT:
+			type = IOIOProtocol.REFLEX_ACTION_UART_HALT;
+			target = ownResource(action.output, UartImpl.class).uartNum_;
+			break;
+
+		default:
+			throw new IllegalArgumentException("Unknown action: "
+					+ action.type);
+		}
+		int reflexNum = reflexAllocator_.allocateModule();
+		ReflexImpl reflex = new ReflexImpl(this, reflexNum);
+		addDisconnectListener(reflex);
+		incomingState_.addReflexListener(reflexNum, reflex);
+		try {
+			protocol_.setReflex(reflexNum, condition, pin, level, low, high,
+					type, target, value, fraction);
+		} catch (IOException e) {
+			reflex.close();
+			throw new ConnectionLostException(e);
+		}
+		return reflex;
+	}
+
+	@Override
+	synchronized public ControlLoop openControlLoop(AnalogInput input,
+			PwmOutput output, float minDutyCycle, float maxDutyCycle,
+			int reportInterval) throws ConnectionLostException {
+		checkState();
+		checkCapability(IOIOProtocol.CAPABILITY_CONTROL, "control loops");
+		final AnalogInputImpl in = ownResource(input, AnalogInputImpl.class);
+		return openControlLoop(IOIOProtocol.CONTROL_ANALOG, in.pinNum_, 1023,
+				null, output, minDutyCycle, maxDutyCycle, reportInterval);
+	}
+
+	@Override
+	synchronized public ControlLoop openControlLoop(PulseInput input,
+			PwmOutput output, float minDutyCycle, float maxDutyCycle,
+			int reportInterval) throws ConnectionLostException {
+		checkState();
+		checkCapability(IOIOProtocol.CAPABILITY_CONTROL, "control loops");
+		final IncapImpl in = ownResource(input, IncapImpl.class);
+		return openControlLoop(IOIOProtocol.CONTROL_INCAP, in.incapNum_,
+				1 / in.timeBase_, in, output, minDutyCycle, maxDutyCycle,
+				reportInterval);
+	}
+
+	private ControlLoop openControlLoop(int source, int input,
+			float inputScale, IncapImpl pulseInput, PwmOutput output,
+			float minDutyCycle,
+			float maxDutyCycle, int reportInterval)
+			throws ConnectionLostException {
+		final PwmImpl pwm = ownResource(output, PwmImpl.class);
+		if (!(minDutyCycle >= 0 && minDutyCycle <= maxDutyCycle
+				&& maxDutyCycle <= 1)) {
+			throw new IllegalArgumentException("Illegal duty cycle limits: "
+					+ minDutyCycle + ", " + maxDutyCycle);
+		}
+		if (reportInterval < 0 || reportInterval > 0xFFFF) {
+			throw new IllegalArgumentException("Illegal report interval: "
+					+ reportInterval);
+		}
+		final int outMin = pwm.clocksToDuty(pwm.dutyCycleToClocks(minDutyCycle)) >> 2;
+		final int outMax = pwm.clocksToDuty(pwm.dutyCycleToClocks(maxDutyCycle)) >> 2;
+		int loopNum = controlLoopAllocator_.allocateModule();
+		ControlLoopImpl loop = new ControlLoopImpl(this, loopNum, inputScale,
+				pulseInput, pwm.dutyCycleToClocks(1), reportInterval != 0);
+		addDisconnectListener(loop);
+		incomingState_.addControlLoopListener(loopNum, loop);
+		try {
+			// The setpoint and gains outlive the previous use of the loop.
+			protocol_.controlParams(loopNum, 0, 0, 0, 0, 0);
+			protocol_.controlConfigure(loopNum, source, input, pwm.pwmNum_,
+					outMin, outMax, reportInterval);
+		} catch (IOException e) {
+			loop.close();
+			throw new ConnectionLostException(e);
+		}
+		return loop;
+	}
+
+	// The resources a reflex or control loop refers to have to be of this
+	// IOIO.
+	private <T extends AbstractResource> T ownResource(Object resource,
+			Class<T> type) {
+		if (!type.isInstance(resource) || type.cast(resource).ioio_ != this) {
+			throw new IllegalArgumentException(
+					"Not a suitable resource of this IOIO: " + resource);
+		}
+		return type.cast(resource);
+	}
+
 	private void checkPinFree(int pin) {
 		if (openPins_[pin]) {
 			throw new IllegalArgumentException("Pin already open: " + pin);
@@ -708,6 +1388,13 @@ public class IOIOImpl implements IOIO, DisconnectListener {
 		}
 	}
 
+	private void checkPeriodicDigitalInputFree() {
+		if (openPeriodicDigitalInput_) {
+			throw new IllegalArgumentException(
+					"Periodic digital input already open");
+		}
+	}
+
 	private void checkIcspFree() {
 		if (openIcsp_) {
 			throw new IllegalArgumentException("ICSP already open");
@@ -731,16 +1418,83 @@ public class IOIOImpl implements IOIO, DisconnectListener {
 	@Override
 	public synchronized void beginBatch() throws ConnectionLostException {
 		checkState();
-		protocol_.beginBatch();
+		try {
+			if (hasCapability(IOIOProtocol.CAPABILITY_BATCH)) {
+				protocol_.beginClientBatch();
+			} else {
+				protocol_.beginBatch();
+			}
+		} catch (IOException e) {
+			throw new ConnectionLostException(e);
+		}
 	}
 
 	@Override
 	public synchronized void endBatch() throws ConnectionLostException {
 		checkState();
 		try {
+			if (hasCapability(IOIOProtocol.CAPABILITY_BATCH)) {
+				protocol_.endClientBatch();
+			} else {
+				protocol_.endBatch();
+			}
+		} catch (IOException e) {
+			throw new ConnectionLostException(e);
+		}
+	}
+
+	@Override
+	public void sync() throws ConnectionLostException, InterruptedException {
+		final int seq;
+		synchronized (this) {
+			checkState();
+			checkCapability(IOIOProtocol.CAPABILITY_BATCH, "sync");
+			try {
+				seq = protocol_.batchSync();
+			} catch (IOException e) {
+				throw new ConnectionLostException(e);
+			}
+		}
+		incomingState_.waitBatchDone(seq);
+	}
+
+	@Override
+	synchronized public void beginSchedule() throws ConnectionLostException {
+		checkState();
+		checkCapability(IOIOProtocol.CAPABILITY_SCHEDULER, "schedules");
+		protocol_.beginRecording();
+	}
+
+	@Override
+	synchronized public Schedule endSchedule(int periodUs)
+			throws ConnectionLostException {
+		final byte[] commands = protocol_.endRecording();
+		checkState();
+		if (periodUs <= 0) {
+			throw new IllegalArgumentException("Illegal period: " + periodUs);
+		}
+		if (commands.length == 0
+				|| commands.length > Constants.SCHEDULE_SIZE) {
+			throw new IllegalArgumentException("A schedule has 1 to "
+					+ Constants.SCHEDULE_SIZE + " bytes of commands. Got: "
+					+ commands.length);
+		}
+		int scheduleNum = scheduleAllocator_.allocateModule();
+		ScheduleImpl schedule = new ScheduleImpl(this, scheduleNum);
+		addDisconnectListener(schedule);
+		incomingState_.addScheduleListener(scheduleNum, schedule);
+		try {
+			protocol_.beginBatch();
+			for (int pos = 0; pos < commands.length; pos += 64) {
+				protocol_.scheduleData(scheduleNum, commands, pos,
+						Math.min(64, commands.length - pos));
+			}
+			protocol_.scheduleConfigure(scheduleNum, true, periodUs);
 			protocol_.endBatch();
 		} catch (IOException e) {
+			schedule.close();
 			throw new ConnectionLostException(e);
 		}
+		return schedule;
 	}
 }
@@ -35,6 +35,7 @@ import ioio.lib.api.TwiMaster.Rate;
 import ioio.lib.api.Uart;
 import ioio.lib.spi.Log;
 
+import java.io.ByteArrayOutputStream;
 import java.io.IOException;
 import java.io.InputStream;
 import java.io.OutputStream;
@@ -95,6 +96,91 @@ class IOIOProtocol {
 	static final int SET_PIN_CAPSENSE                    = 0x1E;
 	static final int CAPSENSE_REPORT                     = 0x1E;
 	static final int SET_CAPSENSE_SAMPLING               = 0x1F;
+	static final int SET_ANALOG_IN_PERIOD                = 0x20;
+	static final int SET_ANALOG_IN_DECIMATION            = 0x21;
+	static final int SET_ANALOG_IN_DEADBAND              = 0x27;
+	static final int SET_ANALOG_IN_ENCODING              = 0x28;
+	static final int SET_TIMESTAMPS                      = 0x29;
+	static final int TIMESTAMP                           = 0x29;
+	static final int SYNC_TIME                           = 0x2A;
+	static final int SYNC_TIME_REPLY                     = 0x2A;
+	static final int BATCH                               = 0x2B;
+	static final int BATCH_DONE                          = 0x2B;
+	static final int SET_DIGITAL_OUT_LEVELS              = 0x2C;
+	static final int SET_DIGITAL_IN_BATCHING             = 0x2D;
+	static final int REPORT_DIGITAL_IN_CHANGES           = 0x2D;
+	static final int ENCODER_CONFIG                      = 0x2E;
+	static final int ENCODER_STATUS                      = 0x2E;
+	static final int ENCODER_READ                        = 0x2F;
+	static final int ENCODER_REPORT                      = 0x2F;
+	static final int SET_INCAP_REARM_PERIOD              = 0x30;
+	static final int INCAP_EDGES                         = 0x30;
+	static final int SET_INCAP_GATE                      = 0x31;
+	static final int INCAP_COUNT                         = 0x31;
+	static final int PWM_SEQ_CONFIG                      = 0x32;
+	static final int PWM_SEQ_STATUS                      = 0x32;
+	static final int PWM_SEQ_DATA                        = 0x33;
+	static final int PWM_SEQ_REPORT_TX_STATUS            = 0x33;
+	static final int SET_PWM_SYNC                        = 0x34;
+	static final int PWM_GROUP_UPDATE                    = 0x35;
+	static final int SCHEDULE_CONFIG                     = 0x36;
+	static final int SCHEDULE_STATUS                     = 0x36;
+	static final int SCHEDULE_DATA                       = 0x37;
+	static final int SET_REFLEX                          = 0x38;
+	static final int REFLEX_STATUS                       = 0x38;
+	static final int REFLEX_FIRED                        = 0x39;
+	static final int CONTROL_CONFIG                      = 0x3A;
+	static final int CONTROL_STATUS                      = 0x3A;
+	static final int CONTROL_PARAMS                      = 0x3B;
+	static final int CONTROL_REPORT                      = 0x3B;
+	static final int SET_ANALOG_IN_FILTER                = 0x3C;
+	static final int SET_UART_RX_AGGREGATION             = 0x3D;
+	static final int UART_DATA_EXTENDED                  = 0x3D;
+	static final int GET_CAPABILITIES                    = 0x3E;
+	static final int CAPABILITIES                        = 0x3E;
+
+	// Input capture modes timing every edge and counting frequency, after the
+	// PulseMode ones.
+	static final int INCAP_MODE_EDGES                    = 6;
+	static final int INCAP_MODE_COUNT                    = 7;
+
+	static final int REFLEX_DIGITAL                      = 1;
+	static final int REFLEX_ANALOG                       = 2;
+
+	static final int REFLEX_ACTION_DIGITAL_OUT           = 0;
+	static final int REFLEX_ACTION_PWM                   = 1;
+	static final int REFLEX_ACTION_UART_HALT             = 2;
+
+	static final int CONTROL_ANALOG                      = 1;
+	static final int CONTROL_INCAP                       = 2;
+
+	// Capability bits reported by firmware supporting IOIO0005, one per group
+	// of messages added on top of IOIO0004.
+	static final int CAPABILITY_ANALOG_SCAN              = 0x00000001;
+	static final int CAPABILITY_ADC_CAPTURE              = 0x00000002;
+	static final int CAPABILITY_ANALOG_TRIGGER           = 0x00000004;
+	static final int CAPABILITY_ANALOG_DEADBAND          = 0x00000008;
+	static final int CAPABILITY_ANALOG_DELTA             = 0x00000010;
+	static final int CAPABILITY_TIMESTAMPS               = 0x00000020;
+	static final int CAPABILITY_BATCH                    = 0x00000040;
+	static final int CAPABILITY_DIGITAL_OUT_LEVELS       = 0x00000080;
+	static final int CAPABILITY_DIGITAL_IN_CHANGES       = 0x00000100;
+	static final int CAPABILITY_PERIODIC_DIGITAL_IN      = 0x00000200;
+	static final int CAPABILITY_ENCODER                  = 0x00000400;
+	static final int CAPABILITY_INCAP_EXTENDED           = 0x00000800;
+	static final int CAPABILITY_FREQUENCY_COUNTER        = 0x00001000;
+	static final int CAPABILITY_PWM_SEQUENCER            = 0x00002000;
+	static final int CAPABILITY_PWM_GROUP                = 0x00004000;
+	static final int CAPABILITY_SCHEDULER                = 0x00008000;
+	static final int CAPABILITY_REFLEX                   = 0x00010000;
+	static final int CAPABILITY_CONTROL                  = 0x00020000;
+	static final int CAPABILITY_ANALOG_FILTER            = 0x00040000;
+	static final int CAPABILITY_UART_RX_AGGREGATION      = 0x00080000;
+
+	static final int TIMESTAMP_ANALOG                    = 0x01;
+	static final int TIMESTAMP_DIGITAL                   = 0x02;
+	static final int TIMESTAMP_INCAP                     = 0x04;
+	static final int TIMESTAMP_UART                      = 0x08;
 
 	static final int[] SCALE_DIV = new int[] {
 		0x1F,  // 31.25
@@ -138,12 +224,31 @@ class IOIOProtocol {
 		}
 	}
 
+	// Longest message that can be sent.
+	private static final int MAX_MESSAGE_SIZE = 72;
+
 	private byte[] outbuf_ = new byte[256];
 	private int pos_ = 0;
 	private int batchCounter_ = 0;
+	// Client batches go out as BATCH containers, which the IOIO executes in
+	// one go. The size of a container is only known when it ends, so it has
+	// to fit in outbuf_. containerStart_ is where the header of the open
+	// container is in outbuf_, or -1 if none is open.
+	private int clientBatchCounter_ = 0;
+	private int containerStart_ = -1;
+	private int batchSeq_ = 0;
+	// While a thread is recording a schedule, the messages it writes go to
+	// recording_ instead of the IOIO. Those of other threads go out as usual.
+	private Thread recordingThread_ = null;
+	private ByteArrayOutputStream recording_;
 
 	private void writeByte(int b) throws IOException {
 		assert (b >= 0 && b < 256);
+		if (recordingThread_ != null
+				&& recordingThread_ == Thread.currentThread()) {
+			recording_.write(b);
+			return;
+		}
 		if (pos_ == outbuf_.length) {
 			// buffer is full
 			flush();
@@ -152,7 +257,14 @@ class IOIOProtocol {
 		outbuf_[pos_++] = (byte) b;
 	}
 	
-	public synchronized void beginBatch() {
+	public synchronized void beginBatch() throws IOException {
+		if (containerStart_ != -1
+				&& pos_ > outbuf_.length - MAX_MESSAGE_SIZE) {
+			// Make room for the next message.
+			closeContainer();
+			flush();
+			openContainer();
+		}
 		++batchCounter_;
 	}
 	
@@ -162,6 +274,95 @@ class IOIOProtocol {
 		}
 	}
 
+	synchronized public void beginClientBatch() throws IOException {
+		if (recordingThread_ == Thread.currentThread()) {
+			throw new IllegalStateException(
+					"Cannot batch while recording a schedule");
+		}
+		beginBatch();
+		if (clientBatchCounter_++ == 0) {
+			openContainer();
+		}
+	}
+
+	synchronized public void endClientBatch() throws IOException {
+		if (--clientBatchCounter_ == 0) {
+			closeContainer();
+		}
+		endBatch();
+	}
+
+	/**
+	 * Sends an empty BATCH that the IOIO acknowledges once it has executed
+	 * everything before it.
+	 * 
+	 * @return The sequence number of the acknowledgement.
+	 */
+	synchronized public int batchSync() throws IOException {
+		if (clientBatchCounter_ != 0) {
+			throw new IllegalStateException("Cannot sync inside a batch");
+		}
+		checkNotRecording("sync");
+		final int seq = batchSeq_++ & 0xFF;
+		beginBatch();
+		writeByte(BATCH);
+		writeByte(seq);
+		writeTwoBytes(0x8000);
+		endBatch();
+		return seq;
+	}
+
+	synchronized public void beginRecording() {
+		if (recordingThread_ != null) {
+			throw new IllegalStateException("Already recording a schedule");
+		}
+		if (clientBatchCounter_ != 0) {
+			throw new IllegalStateException(
+					"Cannot record a schedule inside a batch");
+		}
+		recordingThread_ = Thread.currentThread();
+		recording_ = new ByteArrayOutputStream();
+	}
+
+	/**
+	 * Refuses an operation which the calling thread may be recording, for
+	 * those which are flow controlled or wait for a reply. A schedule cannot
+	 * replay them: their TX credits and replies would reach the client as if
+	 * it had sent them itself.
+	 */
+	synchronized public void checkNotRecording(String what) {
+		if (recordingThread_ == Thread.currentThread()) {
+			throw new IllegalStateException("Cannot record " + what
+					+ " in a schedule");
+		}
+	}
+
+	synchronized public byte[] endRecording() {
+		if (recordingThread_ != Thread.currentThread()) {
+			throw new IllegalStateException("Not recording a schedule");
+		}
+		recordingThread_ = null;
+		return recording_.toByteArray();
+	}
+
+	private void openContainer() throws IOException {
+		containerStart_ = pos_;
+		writeByte(BATCH);
+		writeByte(batchSeq_++ & 0xFF);
+		writeTwoBytes(0);
+	}
+
+	private void closeContainer() {
+		final int size = pos_ - containerStart_ - 4;
+		if (size == 0) {
+			pos_ = containerStart_;
+		} else {
+			outbuf_[containerStart_ + 2] = (byte) size;
+			outbuf_[containerStart_ + 3] = (byte) (size >> 8);
+		}
+		containerStart_ = -1;
+	}
+
 	private void flush() throws IOException {
 		try {
 			out_.write(outbuf_, 0, pos_);
@@ -217,6 +418,12 @@ class IOIOProtocol {
 		endBatch();
 	}
 
+	synchronized public void getCapabilities() throws IOException {
+		beginBatch();
+		writeByte(GET_CAPABILITIES);
+		endBatch();
+	}
+
 	synchronized public void setDigitalOutLevel(int pin, boolean level)
 			throws IOException {
 		beginBatch();
@@ -225,6 +432,29 @@ class IOIOProtocol {
 		endBatch();
 	}
 
+	synchronized public void setDigitalOutLevels(int firstPin, int numBytes,
+			byte[] mask, byte[] levels) throws IOException {
+		beginBatch();
+		writeByte(SET_DIGITAL_OUT_LEVELS);
+		writeByte(firstPin);
+		writeByte(numBytes);
+		for (int i = 0; i < numBytes; ++i) {
+			writeByte(mask[i] & 0xFF);
+		}
+		for (int i = 0; i < numBytes; ++i) {
+			writeByte(levels[i] & 0xFF);
+		}
+		endBatch();
+	}
+
+	synchronized public void setDigitalInBatching(boolean enable)
+			throws IOException {
+		beginBatch();
+		writeByte(SET_DIGITAL_IN_BATCHING);
+		writeByte(enable ? 0x01 : 0x00);
+		endBatch();
+	}
+
 	synchronized public void setPinPwm(int pin, int pwmNum, boolean enable)
 			throws IOException {
 		beginBatch();
@@ -253,6 +483,92 @@ class IOIOProtocol {
 		endBatch();
 	}
 
+	synchronized public void pwmSeqConfigure(int pwmNum, boolean enable,
+			boolean loop, int periods) throws IOException {
+		beginBatch();
+		writeByte(PWM_SEQ_CONFIG);
+		writeByte((enable ? 0x80 : 0x00) | (loop ? 0x40 : 0x00) | pwmNum);
+		writeTwoBytes(periods);
+		endBatch();
+	}
+
+	synchronized public void pwmSeqData(int pwmNum, int[] duties, int offset,
+			int numSteps) throws IOException {
+		if (numSteps > 16) {
+			throw new IllegalArgumentException(
+					"A maximum of 16 steps can be sent in one pwmSeqData message. Got: "
+							+ numSteps);
+		}
+		beginBatch();
+		writeByte(PWM_SEQ_DATA);
+		writeByte((numSteps - 1) << 4 | pwmNum);
+		for (int i = offset; i < offset + numSteps; ++i) {
+			writeByte(duties[i] & 0x03);
+			writeTwoBytes(duties[i] >> 2);
+		}
+		endBatch();
+	}
+
+	synchronized public void setPwmSync(int pwmNum, int syncNum)
+			throws IOException {
+		beginBatch();
+		writeByte(SET_PWM_SYNC);
+		writeByte(syncNum << 4 | pwmNum);
+		endBatch();
+	}
+
+	/**
+	 * Updates the duty cycles of several PWM modules at once. duties[i] is
+	 * for module pwmNums[i], packed as (value << 2) | fraction. The periods
+	 * are left as they are.
+	 */
+	synchronized public void pwmGroupUpdate(int[] pwmNums, int[] duties)
+			throws IOException {
+		int[] byNum = new int[16];
+		int mask = 0;
+		for (int i = 0; i < pwmNums.length; ++i) {
+			mask |= 1 << pwmNums[i];
+			byNum[pwmNums[i]] = duties[i];
+		}
+		beginBatch();
+		writeByte(PWM_GROUP_UPDATE);
+		writeTwoBytes(mask);
+		for (int i = 0; i < byNum.length; ++i) {
+			if ((mask & (1 << i)) != 0) {
+				writeByte(byNum[i] & 0x03);
+				writeTwoBytes(byNum[i] >> 2);
+				writeTwoBytes(0);
+			}
+		}
+		endBatch();
+	}
+
+	synchronized public void scheduleConfigure(int scheduleNum,
+			boolean enable, int periodUs) throws IOException {
+		beginBatch();
+		writeByte(SCHEDULE_CONFIG);
+		writeByte((enable ? 0x80 : 0x00) | scheduleNum);
+		writeTwoBytes(periodUs & 0xFFFF);
+		writeTwoBytes(periodUs >>> 16);
+		endBatch();
+	}
+
+	synchronized public void scheduleData(int scheduleNum, byte[] data,
+			int offset, int size) throws IOException {
+		if (size > 64) {
+			throw new IllegalArgumentException(
+					"A maximum of 64 bytes can be sent in one scheduleData message. Got: "
+							+ size);
+		}
+		beginBatch();
+		writeByte(SCHEDULE_DATA);
+		writeByte((size - 1) << 2 | scheduleNum);
+		for (int i = offset; i < offset + size; ++i) {
+			writeByte(((int) data[i]) & 0xFF);
+		}
+		endBatch();
+	}
+
 	synchronized public void setPinIncap(int pin, int incapNum, boolean enable)
 			throws IOException {
 		beginBatch();
@@ -280,6 +596,111 @@ class IOIOProtocol {
 		endBatch();
 	}
 
+	synchronized public void incapSetRearmPeriod(int incapNum, int periodMs)
+			throws IOException {
+		beginBatch();
+		writeByte(SET_INCAP_REARM_PERIOD);
+		writeByte(incapNum);
+		writeByte(periodMs);
+		endBatch();
+	}
+
+	synchronized public void incapSetGate(int incapNum, int prescale,
+			int gateMs) throws IOException {
+		beginBatch();
+		writeByte(SET_INCAP_GATE);
+		writeByte((prescale << 6) | incapNum);
+		writeTwoBytes(gateMs);
+		endBatch();
+	}
+
+	synchronized public void setReflex(int reflexNum, int condition, int pin,
+			boolean level, int low, int high, int action, int target,
+			int value, int fraction) throws IOException {
+		beginBatch();
+		writeByte(SET_REFLEX);
+		writeByte((level ? 0x80 : 0x00) | (condition << 5) | reflexNum);
+		writeByte(pin);
+		writeTwoBytes(low);
+		writeTwoBytes(high);
+		writeByte((fraction << 2) | action);
+		writeByte(target);
+		writeTwoBytes(value);
+		endBatch();
+	}
+
+	synchronized public void clearReflex(int reflexNum) throws IOException {
+		beginBatch();
+		writeByte(SET_REFLEX);
+		writeByte(reflexNum);
+		writeByte(0);
+		writeTwoBytes(0);
+		writeTwoBytes(0);
+		writeByte(0);
+		writeByte(0);
+		writeTwoBytes(0);
+		endBatch();
+	}
+
+	synchronized public void controlConfigure(int loopNum, int source,
+			int input, int pwmNum, int outMin, int outMax, int reportInterval)
+			throws IOException {
+		beginBatch();
+		writeByte(CONTROL_CONFIG);
+		writeByte((source << 6) | loopNum);
+		writeByte(input);
+		writeByte(pwmNum);
+		writeTwoBytes(outMin);
+		writeTwoBytes(outMax);
+		writeTwoBytes(reportInterval);
+		endBatch();
+	}
+
+	synchronized public void controlClose(int loopNum) throws IOException {
+		controlConfigure(loopNum, 0, 0, 0, 0, 0, 0);
+	}
+
+	synchronized public void controlParams(int loopNum, int setpoint, int kp,
+			int ki, int kd, int shift) throws IOException {
+		beginBatch();
+		writeByte(CONTROL_PARAMS);
+		writeByte((shift << 4) | loopNum);
+		writeTwoBytes(setpoint & 0xFFFF);
+		writeTwoBytes(setpoint >>> 16);
+		writeTwoBytes(kp & 0xFFFF);
+		writeTwoBytes(ki & 0xFFFF);
+		writeTwoBytes(kd & 0xFFFF);
+		endBatch();
+	}
+
+	synchronized public void encoderConfigure(int encoderNum, int pinA,
+			int pinB, int periodMs) throws IOException {
+		beginBatch();
+		writeByte(ENCODER_CONFIG);
+		writeByte(0x80 | encoderNum);
+		writeByte(pinA);
+		writeByte(pinB);
+		writeTwoBytes(periodMs);
+		endBatch();
+	}
+
+	synchronized public void encoderClose(int encoderNum) throws IOException {
+		beginBatch();
+		writeByte(ENCODER_CONFIG);
+		writeByte(encoderNum);
+		writeByte(0);
+		writeByte(0);
+		writeTwoBytes(0);
+		endBatch();
+	}
+
+	synchronized public void encoderRead(int encoderNum) throws IOException {
+		beginBatch();
+		writeByte(ENCODER_READ);
+		writeByte(encoderNum);
+		endBatch();
+	}
+
 	synchronized public void i2cWriteRead(int i2cNum, boolean tenBitAddr,
 			int address, int writeSize, int readSize, byte[] writeData)
 			throws IOException {
@@ -329,7 +750,11 @@ class IOIOProtocol {
 
 	synchronized public void registerPeriodicDigitalSampling(int pin,
 			int freqScale) throws IOException {
-		// TODO: implement
+		beginBatch();
+		writeByte(REGISTER_PERIODIC_DIGITAL_SAMPLING);
+		writeByte(pin);
+		writeByte(freqScale);
+		endBatch();
 	}
 
 	synchronized public void setPinAnalogIn(int pin) throws IOException {
@@ -347,6 +772,68 @@ class IOIOProtocol {
 		endBatch();
 	}
 
+	synchronized public void setAnalogInPeriod(int period) throws IOException {
+		beginBatch();
+		writeByte(SET_ANALOG_IN_PERIOD);
+		writeTwoBytes(period);
+		endBatch();
+	}
+
+	synchronized public void setAnalogInDecimation(int pin, int decimation,
+			boolean oversample) throws IOException {
+		beginBatch();
+		writeByte(SET_ANALOG_IN_DECIMATION);
+		writeByte((oversample ? 0x80 : 0x00) | (pin & 0x3F));
+		writeByte(decimation);
+		endBatch();
+	}
+
+	synchronized public void setAnalogInDeadband(int pin, int deadband)
+			throws IOException {
+		beginBatch();
+		writeByte(SET_ANALOG_IN_DEADBAND);
+		writeByte(pin & 0x3F);
+		writeTwoBytes(deadband);
+		endBatch();
+	}
+
+	synchronized public void setAnalogInFilter(int pin, int type, int param,
+			int[] taps) throws IOException {
+		beginBatch();
+		writeByte(SET_ANALOG_IN_FILTER);
+		writeByte((type << 6) | (pin & 0x3F));
+		writeByte(param);
+		if (taps != null) {
+			for (int tap : taps) {
+				writeTwoBytes(tap & 0xFFFF);
+			}
+		}
+		endBatch();
+	}
+
+	synchronized public void setAnalogInEncoding(boolean delta,
+			int keyframeInterval) throws IOException {
+		beginBatch();
+		writeByte(SET_ANALOG_IN_ENCODING);
+		writeByte(delta ? 0x01 : 0x00);
+		writeByte(keyframeInterval);
+		endBatch();
+	}
+
+	synchronized public void setTimestamps(int sources) throws IOException {
+		beginBatch();
+		writeByte(SET_TIMESTAMPS);
+		writeByte(sources & 0x0F);
+		endBatch();
+	}
+
+	synchronized public void syncTime(int seq) throws IOException {
+		beginBatch();
+		writeByte(SYNC_TIME);
+		writeByte(seq & 0xFF);
+		endBatch();
+	}
+
 	synchronized public void uartData(int uartNum, int numBytes, byte data[])
 			throws IOException {
 		if (numBytes > 64) {
@@ -376,6 +863,19 @@ class IOIOProtocol {
 		endBatch();
 	}
 
+	synchronized public void uartRxAggregation(int uartNum, int minBatch,
+			int maxFrame, int idleTimeoutUs, int maxLatencyMs)
+			throws IOException {
+		beginBatch();
+		writeByte(SET_UART_RX_AGGREGATION);
+		writeByte(uartNum);
+		writeByte(minBatch - 1);
+		writeByte(maxFrame - 1);
+		writeTwoBytes((idleTimeoutUs + 99) / 100);
+		writeTwoBytes(maxLatencyMs);
+		endBatch();
+	}
+
 	synchronized public void uartClose(int uartNum) throws IOException {
 		beginBatch();
 		writeByte(UART_CONFIG);
@@ -528,11 +1028,17 @@ class IOIOProtocol {
 
 		public void handleRegisterPeriodicDigitalSampling(int pin, int freqScale);
 
-		public void handleReportPeriodicDigitalInStatus(int frameNum,
-				boolean values[]);
+		/**
+		 * Data of 0 size means that samples have been lost.
+		 */
+		public void handleReportPeriodicDigitalInStatus(byte[] data, int size);
 
 		public void handleAnalogPinStatus(int pin, boolean open);
 
+		/**
+		 * Values are scaled to 16 bits, regardless of the actual resolution:
+		 * full scale is 1023 << 6.
+		 */
 		public void handleReportAnalogInStatus(List<Integer> pins,
 				List<Integer> values);
 
@@ -574,10 +1080,71 @@ class IOIOProtocol {
 		public void handleIncapClose(int incapNum);
 
 		public void handleIncapOpen(int incapNum);
+
+		/**
+		 * Raw capture values of consecutive edges, or no data if edges have
+		 * been lost, after which the capture timer restarts from 0.
+		 */
+		public void handleIncapEdges(int incapNum, int size, byte[] data);
+
+		/**
+		 * The number of edges in a gate time, and how many clock ticks they
+		 * spanned. Overflow means that some of the gate time is left out.
+		 */
+		public void handleIncapCount(int incapNum, boolean overflow,
+				long edges, long ticks);
+
+		public void handlePwmSeqOpen(int pwmNum);
+
+		public void handlePwmSeqClose(int pwmNum);
+
+		public void handlePwmSeqReportTxStatus(int pwmNum, int stepsToAdd);
+
+		public void handleScheduleOpen(int scheduleNum);
+
+		public void handleScheduleClose(int scheduleNum);
 		
 		public void handleCapSenseReport(int pinNum, int value);
 		
 		public void handleSetCapSenseSampling(int pinNum, boolean enable);
+
+		/**
+		 * The device time, in microseconds, at which the data carried by the
+		 * next message was captured, or -1 once that message has been handled.
+		 */
+		public void handleTimestamp(long time);
+
+		public void handleSyncTimeReply(int seq, long time);
+
+		public void handleBatchDone(int seq);
+
+		public void handleCapabilities(int capabilities);
+
+		public void handleEncoderStatus(int encoderNum, boolean enabled);
+
+		/**
+		 * The position of an encoder, and how much it has changed in how many
+		 * microseconds since the previous report.
+		 */
+		public void handleEncoderReport(int encoderNum, int position,
+				int delta, long interval);
+
+		public void handleReflexStatus(int reflexNum, boolean enabled);
+
+		/**
+		 * A reflex has fired, and took its action at the given device time, in
+		 * microseconds.
+		 */
+		public void handleReflexFired(int reflexNum, long time);
+
+		public void handleControlStatus(int loopNum, boolean enabled);
+
+		/**
+		 * The input and output of a run of a control loop, and whether the
+		 * output was at one of its limits.
+		 */
+		public void handleControlReport(int loopNum, long input, int output,
+				boolean saturated);
 	}
 
 	class IncomingThread extends Thread {
@@ -587,6 +1154,17 @@ class IOIOProtocol {
 
 		private List<Integer> analogPinValues_ = new ArrayList<Integer>();
 		private List<Integer> analogFramePins_ = new ArrayList<Integer>();
+		// For extended frames: which pins are oversampled, and which appear in
+		// the current frame.
+		private boolean analogFrameExtended_ = false;
+		private List<Boolean> analogFrameWide_ = new ArrayList<Boolean>();
+		private List<Integer> analogDuePins_ = new ArrayList<Integer>();
+		// For delta encoded frames: the last value of every pin in the format,
+		// and the bits read but not consumed yet.
+		private boolean analogFrameDelta_ = false;
+		private int[] analogLastValues_ = new int[16];
+		private int bits_;
+		private int numBits_;
 		private List<Integer> newFramePins_ = new ArrayList<Integer>();
 		private Set<Integer> removedPins_ = new HashSet<Integer>();
 		private Set<Integer> addedPins_ = new HashSet<Integer>();
@@ -610,6 +1188,89 @@ class IOIOProtocol {
 			newFramePins_ = temp;
 		}
 
+		private int readBits(int count) throws IOException {
+			while (numBits_ < count) {
+				bits_ |= readByte() << numBits_;
+				numBits_ += 8;
+			}
+			final int result = bits_ & ((1 << count) - 1);
+			bits_ >>= count;
+			numBits_ -= count;
+			return result;
+		}
+
+		private int signExtend(int value, int bits) {
+			return (value << (32 - bits)) >> (32 - bits);
+		}
+
+		// In delta encoded frames, 10-bit values are a stream of codes, LSb
+		// first: 0 followed by a 4-bit difference from the previous value of
+		// the pin, 10 followed by a 7-bit difference, or 11 followed by the
+		// value itself. The stream is padded to a whole byte.
+		private int readDelta(int i) throws IOException {
+			int value;
+			if (readBits(1) == 0) {
+				value = analogLastValues_[i] + signExtend(readBits(4), 4);
+			} else if (readBits(1) == 0) {
+				value = analogLastValues_[i] + signExtend(readBits(7), 7);
+			} else {
+				value = readBits(10);
+			}
+			analogLastValues_[i] = value;
+			return value;
+		}
+
+		private void readAnalogInStatusDelta() throws IOException {
+			final int numPins = analogFramePins_.size();
+			bits_ = 0;
+			numBits_ = 0;
+			analogPinValues_.clear();
+			for (int i = 0; i < numPins; ++i) {
+				analogPinValues_.add(readDelta(i) << 6);
+			}
+		}
+
+		// An extended frame starts with a bitmap of the pins it carries. The
+		// 10-bit ones come first, packed as in regular frames, followed by the
+		// oversampled ones at 16 bits each.
+		private void readAnalogInStatusDue() throws IOException {
+			final int numPins = analogFramePins_.size();
+			final int due = readByte() | (readByte() << 8);
+			int header = 0;
+			int numNarrow = 0;
+			bits_ = 0;
+			numBits_ = 0;
+			analogDuePins_.clear();
+			analogPinValues_.clear();
+			for (int i = 0; i < numPins; ++i) {
+				if ((due & (1 << i)) == 0 || analogFrameWide_.get(i)) {
+					continue;
+				}
+				analogDuePins_.add(analogFramePins_.get(i));
+				if (analogFrameDelta_) {
+					analogPinValues_.add(readDelta(i) << 6);
+					continue;
+				}
+				if (numNarrow++ % 4 == 0) {
+					header = readByte();
+				}
+				analogPinValues_.add(((readByte() << 2) | (header & 0x03)) << 6);
+				header >>= 2;
+			}
+			for (int i = 0; i < numPins; ++i) {
+				if ((due & (1 << i)) == 0 || !analogFrameWide_.get(i)) {
+					continue;
+				}
+				analogDuePins_.add(analogFramePins_.get(i));
+				analogPinValues_.add(readByte() | (readByte() << 8));
+			}
+		}
+
+		private long readDword() throws IOException {
+			return readByte() | (readByte() << 8) | (readByte() << 16)
+					| ((long) readByte() << 24);
+		}
+
 		private void fillBuf() throws IOException {
 			try {
 				validBytes_ = in_.read(inbuf_, 0, inbuf_.length);
@@ -649,6 +1310,7 @@ class IOIOProtocol {
 			int numPins;
 			int size;
 			byte[] data = new byte[256];
+			boolean stamped = false;
 			try {
 				while (true) {
 					switch (arg1 = readByte()) {
@@ -671,6 +1333,9 @@ class IOIOProtocol {
 
 					case SOFT_RESET:
 						analogFramePins_.clear();
+						analogFrameWide_.clear();
+						analogFrameExtended_ = false;
+						analogFrameDelta_ = false;
 						handler_.handleSoftReset();
 						break;
 
@@ -680,6 +1345,18 @@ class IOIOProtocol {
 								(arg1 & 0x01) == 1);
 						break;
 
+					case REPORT_DIGITAL_IN_CHANGES:
+						arg1 = readByte() & 0x3F;
+						size = readByte() & 0x0F;
+						readBytes(2 * size, data);
+						for (int i = 0; i < size * 8; ++i) {
+							if ((data[i / 8] & (1 << (i % 8))) != 0) {
+								handler_.handleReportDigitalInStatus(arg1 + i,
+										(data[size + i / 8] & (1 << (i % 8))) != 0);
+							}
+						}
+						break;
+
 					case SET_CHANGE_NOTIFY:
 						arg1 = readByte();
 						handler_.handleSetChangeNotify(arg1 >> 2,
@@ -687,18 +1364,29 @@ class IOIOProtocol {
 						break;
 
 					case REGISTER_PERIODIC_DIGITAL_SAMPLING:
-						// TODO: implement
+						arg1 = readByte();
+						arg2 = readByte();
+						handler_.handleRegisterPeriodicDigitalSampling(
+								arg1 & 0x3F, arg2);
 						break;
 
 					case REPORT_PERIODIC_DIGITAL_IN_STATUS:
-						// TODO: implement
+						size = readByte();
+						readBytes(size, data);
+						handler_.handleReportPeriodicDigitalInStatus(data, size);
 						break;
 
 					case REPORT_ANALOG_IN_FORMAT:
-						numPins = readByte();
+						arg1 = readByte();
+						numPins = arg1 & 0x3F;
+						analogFrameDelta_ = (arg1 & 0x40) != 0;
+						analogFrameExtended_ = (arg1 & 0x80) != 0;
 						newFramePins_.clear();
+						analogFrameWide_.clear();
 						for (int i = 0; i < numPins; ++i) {
-							newFramePins_.add(readByte());
+							arg2 = readByte();
+							newFramePins_.add(arg2 & 0x3F);
+							analogFrameWide_.add((arg2 & 0x80) != 0);
 						}
 						calculateAnalogFrameDelta();
 						for (Integer i : removedPins_) {
@@ -710,6 +1398,18 @@ class IOIOProtocol {
 						break;
 
 					case REPORT_ANALOG_IN_STATUS:
+						if (analogFrameExtended_) {
+							readAnalogInStatusDue();
+							handler_.handleReportAnalogInStatus(analogDuePins_,
+									analogPinValues_);
+							break;
+						}
+						if (analogFrameDelta_) {
+							readAnalogInStatusDelta();
+							handler_.handleReportAnalogInStatus(analogFramePins_,
+									analogPinValues_);
+							break;
+						}
 						numPins = analogFramePins_.size();
 						int header = 0;
 						analogPinValues_.clear();
@@ -717,7 +1417,7 @@ class IOIOProtocol {
 							if (i % 4 == 0) {
 								header = readByte();
 							}
-							analogPinValues_.add((readByte() << 2) | (header & 0x03));
+							analogPinValues_.add(((readByte() << 2) | (header & 0x03)) << 6);
 							header >>= 2;
 						}
 						handler_.handleReportAnalogInStatus(analogFramePins_,
@@ -740,6 +1440,15 @@ class IOIOProtocol {
 								data);
 						break;
 
+					case UART_DATA_EXTENDED:
+						arg1 = readByte();
+						size = readByte() + 1;
+						for (int i = 0; i < size; ++i) {
+							data[i] = (byte) readByte();
+						}
+						handler_.handleUartData(arg1 & 0x03, size, data);
+						break;
+
 					case UART_STATUS:
 						arg1 = readByte();
 						if ((arg1 & 0x80) != 0) {
@@ -847,6 +1556,43 @@ class IOIOProtocol {
 						handler_.handleIncapReport(arg1 & 0x0F, size, data);
 						break;
 
+					case INCAP_EDGES:
+						arg1 = readByte();
+						size = readByte();
+						readBytes(size, data);
+						handler_.handleIncapEdges(arg1 & 0x0F, size, data);
+						break;
+
+					case INCAP_COUNT:
+						arg1 = readByte();
+						handler_.handleIncapCount(arg1 & 0x0F, (arg1 & 0x80) != 0,
+								readDword(), readDword());
+						break;
+
+					case PWM_SEQ_STATUS:
+						arg1 = readByte();
+						if ((arg1 & 0x80) != 0) {
+							handler_.handlePwmSeqOpen(arg1 & 0x0F);
+						} else {
+							handler_.handlePwmSeqClose(arg1 & 0x0F);
+						}
+						break;
+
+					case PWM_SEQ_REPORT_TX_STATUS:
+						arg1 = readByte();
+						arg2 = readByte();
+						handler_.handlePwmSeqReportTxStatus(arg1 & 0x0F, arg2);
+						break;
+
+					case SCHEDULE_STATUS:
+						arg1 = readByte();
+						if ((arg1 & 0x80) != 0) {
+							handler_.handleScheduleOpen(arg1 & 0x03);
+						} else {
+							handler_.handleScheduleClose(arg1 & 0x03);
+						}
+						break;
+
 					case SOFT_CLOSE:
 						Log.d(TAG, "Received soft close.");
 						throw new IOException("Soft close");
@@ -863,6 +1609,62 @@ class IOIOProtocol {
 						handler_.handleSetCapSenseSampling(arg1 & 0x3F, (arg1 & 0x80) != 0);
 						break;
 
+					case TIMESTAMP:
+						handler_.handleTimestamp(readDword());
+						stamped = true;
+						// Keep it for the message that follows.
+						continue;
+
+					case SYNC_TIME_REPLY:
+						arg1 = readByte();
+						handler_.handleSyncTimeReply(arg1, readDword());
+						break;
+
+					case BATCH_DONE:
+						handler_.handleBatchDone(readByte());
+						break;
+
+					case CAPABILITIES:
+						handler_.handleCapabilities((int) readDword());
+						break;
+
+					case ENCODER_STATUS:
+						arg1 = readByte();
+						handler_.handleEncoderStatus(arg1 & 0x03,
+								(arg1 & 0x80) != 0);
+						break;
+
+					case ENCODER_REPORT:
+						arg1 = readByte();
+						handler_.handleEncoderReport(arg1 & 0x03,
+								(int) readDword(), (int) readDword(),
+								readDword());
+						break;
+
+					case REFLEX_STATUS:
+						arg1 = readByte();
+						handler_.handleReflexStatus(arg1 & 0x07,
+								(arg1 & 0x80) != 0);
+						break;
+
+					case REFLEX_FIRED:
+						arg1 = readByte();
+						handler_.handleReflexFired(arg1 & 0x07, readDword());
+						break;
+
+					case CONTROL_STATUS:
+						arg1 = readByte();
+						handler_.handleControlStatus(arg1 & 0x03,
+								(arg1 & 0x80) != 0);
+						break;
+
+					case CONTROL_REPORT:
+						arg1 = readByte();
+						handler_.handleControlReport(arg1 & 0x03, readDword(),
+								readByte() | (readByte() << 8),
+								(arg1 & 0x80) != 0);
+						break;
+
 					default:
 						in_.close();
 						IOException e = new IOException(
@@ -871,6 +1673,10 @@ class IOIOProtocol {
 						Log.e("IOIOProtocol", "Protocol error", e);
 						throw e;
 					}
+					if (stamped) {
+						handler_.handleTimestamp(-1);
+						stamped = false;
+					}
 				}
 			} catch (IOException e) {
 				handler_.handleConnectionLost();
@@ -83,6 +83,7 @@ class IcspMasterImpl extends AbstractResource implements IcspMaster,
 	synchronized public void executeInstruction(int instruction)
 			throws ConnectionLostException {
 		checkState();
+		ioio_.protocol_.checkNotRecording("ICSP instructions");
 		try {
 			ioio_.protocol_.icspSix(instruction);
 		} catch (IOException e) {
@@ -94,6 +95,7 @@ class IcspMasterImpl extends AbstractResource implements IcspMaster,
 	synchronized public void readVisi() throws ConnectionLostException,
 			InterruptedException {
 		checkState();
+		ioio_.protocol_.checkNotRecording("ICSP reads");
 		while (rxRemaining_ < 2 && state_ == State.OPEN) {
 			wait();
 		}
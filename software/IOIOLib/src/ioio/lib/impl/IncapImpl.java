@@ -4,18 +4,22 @@ import ioio.lib.api.PulseInput;
 import ioio.lib.api.exception.ConnectionLostException;
 import ioio.lib.impl.IncomingState.DataModuleListener;
 
+import java.io.IOException;
 import java.util.LinkedList;
 import java.util.Queue;
 
 class IncapImpl extends AbstractPin implements DataModuleListener,
 		PulseInput {
 	private static final int MAX_QUEUE_LEN = 32;
+	// Matches the firmware's default after configuring a module.
+	private static final int DEFAULT_REARM_PERIOD_MS = 5;
 	private final PulseMode mode_;
-	private final int incapNum_;
+	final int incapNum_;
 	private long lastDuration_;
-	private final float timeBase_;
+	final float timeBase_;
 	private final boolean doublePrecision_;
 	private boolean valid_ = false;
+	private int rearmPeriodMs_ = DEFAULT_REARM_PERIOD_MS;
 	// TODO: a fixed-size array would have been much better than a linked list.
 	private Queue<Long> pulseQueue_ = new LinkedList<Long>();
 
@@ -66,6 +70,30 @@ class IncapImpl extends AbstractPin implements DataModuleListener,
 		return timeBase_ * pulseQueue_.remove();
 	}
 
+	@Override
+	public synchronized void setRearmPeriod(int periodMs)
+			throws ConnectionLostException {
+		if (periodMs < 0 || periodMs > 255) {
+			throw new IllegalArgumentException(
+					"Re-arm period must be between 0 and 255ms.");
+		}
+		checkState();
+		ioio_.checkCapability(IOIOProtocol.CAPABILITY_INCAP_EXTENDED,
+				"re-arm period");
+		try {
+			ioio_.protocol_.incapSetRearmPeriod(incapNum_, periodMs);
+		} catch (IOException e) {
+			throw new ConnectionLostException(e);
+		}
+		rearmPeriodMs_ = periodMs;
+	}
+
+	// The time between measurements of a signal faster than the re-arm
+	// period, in seconds. The re-arm timer ticks every 1ms.
+	synchronized float getRunPeriod() {
+		return Math.max(rearmPeriodMs_, 1) / 1000.f;
+	}
+
 	@Override
 	public synchronized void dataReceived(byte[] data, int size) {
 		lastDuration_ = ByteArrayToLong(data, size);
@@ -48,6 +48,12 @@ class IncomingState implements IncomingHandler {
 
 	interface InputPinListener {
 		void setValue(int value);
+
+		/**
+		 * Called before every setValue(), with the host time at which the
+		 * value was sampled, or -1 if unknown.
+		 */
+		void setTimestamp(long time);
 	}
 
 	interface DisconnectListener {
@@ -60,6 +66,40 @@ class IncomingState implements IncomingHandler {
 		void reportAdditionalBuffer(int bytesToAdd);
 	}
 
+	interface IncapCountListener extends DataModuleListener {
+		void countReceived(boolean overflow, long edges, long ticks);
+	}
+
+	interface EncoderListener {
+		void reportReceived(int position, int delta, long interval);
+	}
+
+	interface ReflexListener {
+		/**
+		 * Called whenever the reflex fires, with the time of its action in
+		 * host nanoseconds, or -1 if not available.
+		 */
+		void fired(long time);
+	}
+
+	interface ControlLoopListener {
+		void reportReceived(long input, int output, boolean saturated);
+	}
+
+	interface PeriodicDigitalListener {
+		/**
+		 * Called whenever the set of sampled pins changes, with the new number
+		 * of pins. The sample stream starts over.
+		 */
+		void restart(int numPins);
+
+		/**
+		 * Called with the next part of the sample stream. A size of 0 means
+		 * that samples have been lost and the stream starts over.
+		 */
+		void dataReceived(byte[] data, int size);
+	}
+
 	class InputPinState {
 		private Queue<InputPinListener> listeners_ = new ConcurrentLinkedQueue<InputPinListener>();
 		private boolean currentOpen_ = false;
@@ -82,9 +122,137 @@ class IncomingState implements IncomingHandler {
 			}
 		}
 
-		void setValue(int v) {
+		void setValue(int v, long time) {
+			assert (currentOpen_);
+			final InputPinListener listener = listeners_.peek();
+			listener.setTimestamp(time);
+			listener.setValue(v);
+		}
+	}
+
+	class PeriodicDigitalState {
+		private Queue<PeriodicDigitalListener> listeners_ = new ConcurrentLinkedQueue<PeriodicDigitalListener>();
+		private boolean[] sampled_;
+		private int numSampled_ = 0;
+
+		PeriodicDigitalState(int numPins) {
+			sampled_ = new boolean[numPins];
+		}
+
+		void pushListener(PeriodicDigitalListener listener) {
+			listeners_.add(listener);
+		}
+
+		void reset() {
+			if (numSampled_ > 0) {
+				listeners_.remove();
+			}
+			numSampled_ = 0;
+			sampled_ = new boolean[sampled_.length];
+		}
+
+		void setPinSampled(int pin, boolean sampled) {
+			if (sampled_[pin] == sampled) {
+				return;
+			}
+			sampled_[pin] = sampled;
+			if (sampled) {
+				assert (!listeners_.isEmpty());
+				++numSampled_;
+			} else if (--numSampled_ == 0) {
+				listeners_.remove().restart(0);
+				return;
+			}
+			listeners_.peek().restart(numSampled_);
+		}
+
+		void dataReceived(byte[] data, int size) {
+			assert (numSampled_ > 0);
+			listeners_.peek().dataReceived(data, size);
+		}
+	}
+
+	class EncoderState {
+		private Queue<EncoderListener> listeners_ = new ConcurrentLinkedQueue<EncoderListener>();
+		private boolean currentOpen_ = false;
+
+		void pushListener(EncoderListener listener) {
+			listeners_.add(listener);
+		}
+
+		void closeCurrentListener() {
+			if (currentOpen_) {
+				currentOpen_ = false;
+				listeners_.remove();
+			}
+		}
+
+		void openNextListener() {
+			assert (!listeners_.isEmpty());
+			if (!currentOpen_) {
+				currentOpen_ = true;
+			}
+		}
+
+		void reportReceived(int position, int delta, long interval) {
+			assert (currentOpen_);
+			listeners_.peek().reportReceived(position, delta, interval);
+		}
+	}
+
+	class ReflexState {
+		private Queue<ReflexListener> listeners_ = new ConcurrentLinkedQueue<ReflexListener>();
+		private boolean currentOpen_ = false;
+
+		void pushListener(ReflexListener listener) {
+			listeners_.add(listener);
+		}
+
+		void closeCurrentListener() {
+			if (currentOpen_) {
+				currentOpen_ = false;
+				listeners_.remove();
+			}
+		}
+
+		void openNextListener() {
+			assert (!listeners_.isEmpty());
+			if (!currentOpen_) {
+				currentOpen_ = true;
+			}
+		}
+
+		void fired(long time) {
 			assert (currentOpen_);
-			listeners_.peek().setValue(v);
+			listeners_.peek().fired(time);
+		}
+	}
+
+	class ControlLoopState {
+		private Queue<ControlLoopListener> listeners_ = new ConcurrentLinkedQueue<ControlLoopListener>();
+		private boolean currentOpen_ = false;
+
+		void pushListener(ControlLoopListener listener) {
+			listeners_.add(listener);
+		}
+
+		void closeCurrentListener() {
+			if (currentOpen_) {
+				currentOpen_ = false;
+				listeners_.remove();
+			}
+		}
+
+		void openNextListener() {
+			assert (!listeners_.isEmpty());
+			if (!currentOpen_) {
+				currentOpen_ = true;
+			}
+		}
+
+		void reportReceived(long input, int output, boolean saturated) {
+			assert (currentOpen_);
+			listeners_.peek().reportReceived(input, output, saturated);
 		}
 	}
 
@@ -115,6 +283,12 @@ class IncomingState implements IncomingHandler {
 			listeners_.peek().dataReceived(data, size);
 		}
 
+		void countReceived(boolean overflow, long edges, long ticks) {
+			assert (currentOpen_);
+			((IncapCountListener) listeners_.peek()).countReceived(overflow,
+					edges, ticks);
+		}
+
 		public void reportAdditionalBuffer(int bytesRemaining) {
 			assert (currentOpen_);
 			listeners_.peek().reportAdditionalBuffer(bytesRemaining);
@@ -126,13 +300,28 @@ class IncomingState implements IncomingHandler {
 	private DataModuleState[] twiStates_;
 	private DataModuleState[] spiStates_;
 	private DataModuleState[] incapStates_;
+	private DataModuleState[] pwmSeqStates_;
+	private DataModuleState[] scheduleStates_;
 	private DataModuleState icspState_;
+	private PeriodicDigitalState periodicDigitalState_;
+	private EncoderState[] encoderStates_;
+	private ReflexState[] reflexStates_;
+	private ControlLoopState[] controlLoopStates_;
 	private final Set<DisconnectListener> disconnectListeners_ = new HashSet<IncomingState.DisconnectListener>();
 	private ConnectionState connection_ = ConnectionState.INIT;
 	public String hardwareId_;
 	public String bootloaderId_;
 	public String firmwareId_;
 	public Board board_;
+	final DeviceClock clock_ = new DeviceClock();
+	// Device time of the message being handled, -1 if not stamped.
+	private long timestamp_ = -1;
+	private int lastBatchDone_ = -1;
+	// Answer to an interface check made after connecting, null until it
+	// arrives.
+	private Boolean optionalInterfaceSupported_ = null;
+	// Capability bits reported by the firmware, null until they arrive.
+	private Integer capabilities_ = null;
 
 	synchronized public void waitConnectionEstablished()
 			throws InterruptedException, ConnectionLostException {
@@ -159,6 +348,37 @@ class IncomingState implements IncomingHandler {
 		return connection_ == ConnectionState.CONNECTED;
 	}
 
+	synchronized public boolean waitForOptionalInterfaceSupport()
+			throws InterruptedException, ConnectionLostException {
+		while (optionalInterfaceSupported_ == null
+				&& connection_ != ConnectionState.DISCONNECTED) {
+			wait();
+		}
+		checkNotDisconnected();
+		boolean supported = optionalInterfaceSupported_;
+		optionalInterfaceSupported_ = null;
+		return supported;
+	}
+
+	synchronized public int waitForCapabilities() throws InterruptedException,
+			ConnectionLostException {
+		while (capabilities_ == null
+				&& connection_ != ConnectionState.DISCONNECTED) {
+			wait();
+		}
+		checkNotDisconnected();
+		return capabilities_;
+	}
+
+	synchronized public void waitBatchDone(int seq)
+			throws InterruptedException, ConnectionLostException {
+		while (lastBatchDone_ != seq
+				&& connection_ != ConnectionState.DISCONNECTED) {
+			wait();
+		}
+		checkNotDisconnected();
+	}
+
 	synchronized public void waitDisconnect() throws InterruptedException {
 		while (connection_ != ConnectionState.DISCONNECTED) {
 			wait();
@@ -181,10 +401,36 @@ class IncomingState implements IncomingHandler {
 		incapStates_[incapNum].pushListener(listener);
 	}
 
+	public void addPwmSeqListener(int pwmNum, DataModuleListener listener) {
+		pwmSeqStates_[pwmNum].pushListener(listener);
+	}
+
+	public void addScheduleListener(int scheduleNum,
+			DataModuleListener listener) {
+		scheduleStates_[scheduleNum].pushListener(listener);
+	}
+
 	public void addIcspListener(DataModuleListener listener) {
 		icspState_.pushListener(listener);
 	}
 
+	public void addEncoderListener(int encoderNum, EncoderListener listener) {
+		encoderStates_[encoderNum].pushListener(listener);
+	}
+
+	public void addReflexListener(int reflexNum, ReflexListener listener) {
+		reflexStates_[reflexNum].pushListener(listener);
+	}
+
+	public void addControlLoopListener(int loopNum,
+			ControlLoopListener listener) {
+		controlLoopStates_[loopNum].pushListener(listener);
+	}
+
+	public void addPeriodicDigitalListener(PeriodicDigitalListener listener) {
+		periodicDigitalState_.pushListener(listener);
+	}
+
 	public void addSpiListener(int spiNum, DataModuleListener listener) {
 		spiStates_[spiNum].pushListener(listener);
 	}
@@ -235,14 +481,34 @@ class IncomingState implements IncomingHandler {
 		for (DataModuleState incapState : incapStates_) {
 			incapState.closeCurrentListener();
 		}
+		for (DataModuleState pwmSeqState : pwmSeqStates_) {
+			pwmSeqState.closeCurrentListener();
+		}
+		for (DataModuleState scheduleState : scheduleStates_) {
+			scheduleState.closeCurrentListener();
+		}
 		icspState_.closeCurrentListener();
+		periodicDigitalState_.reset();
+		for (EncoderState encoderState : encoderStates_) {
+			encoderState.closeCurrentListener();
+		}
+		for (ReflexState reflexState : reflexStates_) {
+			reflexState.closeCurrentListener();
+		}
+		for (ControlLoopState controlLoopState : controlLoopStates_) {
+			controlLoopState.closeCurrentListener();
+		}
 	}
 
 	@Override
 	synchronized public void handleCheckInterfaceResponse(boolean supported) {
 		// logMethod("handleCheckInterfaceResponse", supported);
-		connection_ = supported ? ConnectionState.CONNECTED
-				: ConnectionState.UNSUPPORTED_IID;
+		if (connection_ == ConnectionState.ESTABLISHED) {
+			connection_ = supported ? ConnectionState.CONNECTED
+					: ConnectionState.UNSUPPORTED_IID;
+		} else {
+			optionalInterfaceSupported_ = supported;
+		}
 		notifyAll();
 	}
 
@@ -259,7 +525,7 @@ class IncomingState implements IncomingHandler {
 	@Override
 	public void handleRegisterPeriodicDigitalSampling(int pin, int freqScale) {
 		// logMethod("handleRegisterPeriodicDigitalSampling", pin, freqScale);
-		assert (false);
+		periodicDigitalState_.setPinSampled(pin, freqScale != 0);
 	}
 
 	@Override
@@ -365,7 +631,28 @@ class IncomingState implements IncomingHandler {
 			for (int i = 0; i < incapStates_.length; ++i) {
 				incapStates_[i] = new DataModuleState();
 			}
+			pwmSeqStates_ = new DataModuleState[hw.numPwmModules()];
+			for (int i = 0; i < pwmSeqStates_.length; ++i) {
+				pwmSeqStates_[i] = new DataModuleState();
+			}
+			scheduleStates_ = new DataModuleState[Constants.NUM_SCHEDULES];
+			for (int i = 0; i < scheduleStates_.length; ++i) {
+				scheduleStates_[i] = new DataModuleState();
+			}
 			icspState_ = new DataModuleState();
+			periodicDigitalState_ = new PeriodicDigitalState(hw.numPins());
+			encoderStates_ = new EncoderState[Constants.NUM_ENCODERS];
+			for (int i = 0; i < encoderStates_.length; ++i) {
+				encoderStates_[i] = new EncoderState();
+			}
+			reflexStates_ = new ReflexState[Constants.NUM_REFLEXES];
+			for (int i = 0; i < reflexStates_.length; ++i) {
+				reflexStates_[i] = new ReflexState();
+			}
+			controlLoopStates_ = new ControlLoopState[Constants.NUM_CONTROL_LOOPS];
+			for (int i = 0; i < controlLoopStates_.length; ++i) {
+				controlLoopStates_[i] = new ControlLoopState();
+			}
 		}
 		synchronized (this) {
 			connection_ = ConnectionState.ESTABLISHED;
@@ -400,21 +687,22 @@ class IncomingState implements IncomingHandler {
 	@Override
 	public void handleReportDigitalInStatus(int pin, boolean level) {
 		// logMethod("handleReportDigitalInStatus", pin, level);
-		intputPinStates_[pin].setValue(level ? 1 : 0);
+		intputPinStates_[pin].setValue(level ? 1 : 0, hostTimestamp());
 	}
 
 	@Override
-	public void handleReportPeriodicDigitalInStatus(int frameNum,
-			boolean[] values) {
-		// logMethod("handleReportPeriodicDigitalInStatus", frameNum, values);
+	public void handleReportPeriodicDigitalInStatus(byte[] data, int size) {
+		// logMethod("handleReportPeriodicDigitalInStatus", data, size);
+		periodicDigitalState_.dataReceived(data, size);
 	}
 
 	@Override
 	public void handleReportAnalogInStatus(List<Integer> pins,
 			List<Integer> values) {
 		// logMethod("handleReportAnalogInStatus", pins, values);
+		final long time = hostTimestamp();
 		for (int i = 0; i < pins.size(); ++i) {
-			intputPinStates_[pins.get(i)].setValue(values.get(i));
+			intputPinStates_[pins.get(i)].setValue(values.get(i), time);
 		}
 	}
 
@@ -436,6 +724,49 @@ class IncomingState implements IncomingHandler {
 		incapStates_[incapNum].dataReceived(data, size);
 	}
 
+	@Override
+	public void handleIncapEdges(int incapNum, int size, byte[] data) {
+		// logMethod("handleIncapEdges", incapNum, size, data);
+		incapStates_[incapNum].dataReceived(data, size);
+	}
+
+	@Override
+	public void handleIncapCount(int incapNum, boolean overflow, long edges,
+			long ticks) {
+		// logMethod("handleIncapCount", incapNum, overflow, edges, ticks);
+		incapStates_[incapNum].countReceived(overflow, edges, ticks);
+	}
+
+	@Override
+	public void handlePwmSeqOpen(int pwmNum) {
+		// logMethod("handlePwmSeqOpen", pwmNum);
+		pwmSeqStates_[pwmNum].openNextListener();
+	}
+
+	@Override
+	public void handlePwmSeqClose(int pwmNum) {
+		// logMethod("handlePwmSeqClose", pwmNum);
+		pwmSeqStates_[pwmNum].closeCurrentListener();
+	}
+
+	@Override
+	public void handlePwmSeqReportTxStatus(int pwmNum, int stepsToAdd) {
+		// logMethod("handlePwmSeqReportTxStatus", pwmNum, stepsToAdd);
+		pwmSeqStates_[pwmNum].reportAdditionalBuffer(stepsToAdd);
+	}
+
+	@Override
+	public void handleScheduleOpen(int scheduleNum) {
+		// logMethod("handleScheduleOpen", scheduleNum);
+		scheduleStates_[scheduleNum].openNextListener();
+	}
+
+	@Override
+	public void handleScheduleClose(int scheduleNum) {
+		// logMethod("handleScheduleClose", scheduleNum);
+		scheduleStates_[scheduleNum].closeCurrentListener();
+	}
+
 	@Override
 	public void handleIncapClose(int incapNum) {
 		// logMethod("handleIncapClose", incapNum);
@@ -457,7 +788,7 @@ class IncomingState implements IncomingHandler {
 	@Override
 	public void handleCapSenseReport(int pinNum, int value) {
 		// logMethod("handleCapSenseReport", pinNum, value);
-		intputPinStates_[pinNum].setValue(value);
+		intputPinStates_[pinNum].setValue(value, -1);
 	}
 	
 	@Override
@@ -470,6 +801,86 @@ class IncomingState implements IncomingHandler {
 		}
 	}
 	
+	@Override
+	public void handleTimestamp(long time) {
+		timestamp_ = time;
+	}
+
+	@Override
+	public void handleSyncTimeReply(int seq, long time) {
+		// logMethod("handleSyncTimeReply", seq, time);
+		clock_.replyReceived(seq, time);
+	}
+
+	@Override
+	synchronized public void handleBatchDone(int seq) {
+		// logMethod("handleBatchDone", seq);
+		lastBatchDone_ = seq;
+		notifyAll();
+	}
+
+	@Override
+	synchronized public void handleCapabilities(int capabilities) {
+		// logMethod("handleCapabilities", capabilities);
+		capabilities_ = capabilities;
+		notifyAll();
+	}
+
+	@Override
+	public void handleEncoderStatus(int encoderNum, boolean enabled) {
+		// logMethod("handleEncoderStatus", encoderNum, enabled);
+		if (enabled) {
+			encoderStates_[encoderNum].openNextListener();
+		} else {
+			encoderStates_[encoderNum].closeCurrentListener();
+		}
+	}
+
+	@Override
+	public void handleEncoderReport(int encoderNum, int position, int delta,
+			long interval) {
+		// logMethod("handleEncoderReport", encoderNum, position, delta,
+		// interval);
+		encoderStates_[encoderNum].reportReceived(position, delta, interval);
+	}
+
+	@Override
+	public void handleReflexStatus(int reflexNum, boolean enabled) {
+		// logMethod("handleReflexStatus", reflexNum, enabled);
+		if (enabled) {
+			reflexStates_[reflexNum].openNextListener();
+		} else {
+			reflexStates_[reflexNum].closeCurrentListener();
+		}
+	}
+
+	@Override
+	public void handleReflexFired(int reflexNum, long time) {
+		// logMethod("handleReflexFired", reflexNum, time);
+		reflexStates_[reflexNum].fired(clock_.toHostNanos(time));
+	}
+
+	@Override
+	public void handleControlStatus(int loopNum, boolean enabled) {
+		// logMethod("handleControlStatus", loopNum, enabled);
+		if (enabled) {
+			controlLoopStates_[loopNum].openNextListener();
+		} else {
+			controlLoopStates_[loopNum].closeCurrentListener();
+		}
+	}
+
+	@Override
+	public void handleControlReport(int loopNum, long input, int output,
+			boolean saturated) {
+		// logMethod("handleControlReport", loopNum, input, output, saturated);
+		controlLoopStates_[loopNum].reportReceived(input, output, saturated);
+	}
+
+	private long hostTimestamp() {
+		return timestamp_ == -1 ? -1 : clock_.toHostNanos(timestamp_);
+	}
+
 	private void checkNotDisconnected() throws ConnectionLostException {
 		if (connection_ == ConnectionState.DISCONNECTED) {
 			throw new ConnectionLostException();
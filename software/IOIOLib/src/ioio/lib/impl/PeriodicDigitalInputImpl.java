@@ -0,0 +1,168 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *  
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * 
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ * 
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+package ioio.lib.impl;
+
+import ioio.lib.api.PeriodicDigitalInput;
+import ioio.lib.api.exception.ConnectionLostException;
+import ioio.lib.impl.IncomingState.PeriodicDigitalListener;
+
+import java.util.Arrays;
+
+class PeriodicDigitalInputImpl extends AbstractResource implements
+		PeriodicDigitalInput, PeriodicDigitalListener {
+	// In the order given by the client.
+	private final int[] pins_;
+	// The samples come in ascending pin order. For every bit of a sample, the
+	// index of its pin in pins_.
+	private final int[] order_;
+	private final float sampleRate_;
+
+	// The sample being decoded, and how many of its bits are in.
+	private boolean streaming_ = false;
+	private long sample_;
+	private int sampleBits_;
+
+	private final long[] buffer_;
+	private int bufferSize_ = 0;
+	private int bufferReadCursor_ = 0;
+	private int bufferWriteCursor_ = 0;
+	private int overflowCount_ = 0;
+
+	PeriodicDigitalInputImpl(IOIOImpl ioio, int[] pins, float sampleRate,
+			int bufferSize) throws ConnectionLostException {
+		super(ioio);
+		pins_ = pins.clone();
+		sampleRate_ = sampleRate;
+		buffer_ = new long[bufferSize];
+		int[] sorted = pins.clone();
+		Arrays.sort(sorted);
+		order_ = new int[pins.length];
+		for (int i = 0; i < pins.length; ++i) {
+			for (int j = 0; j < pins.length; ++j) {
+				if (pins[j] == sorted[i]) {
+					order_[i] = j;
+				}
+			}
+		}
+	}
+
+	@Override
+	synchronized public void restart(int numPins) {
+		// Until all of our pins are in, the stream is not ours to decode.
+		streaming_ = numPins == pins_.length;
+		sample_ = 0;
+		sampleBits_ = 0;
+	}
+
+	@Override
+	synchronized public void dataReceived(byte[] data, int size) {
+		if (!streaming_) {
+			return;
+		}
+		if (size == 0) {
+			++overflowCount_;
+			sample_ = 0;
+			sampleBits_ = 0;
+			return;
+		}
+		for (int i = 0; i < size; ++i) {
+			for (int bit = 0; bit < 8; ++bit) {
+				if ((data[i] & (1 << bit)) != 0) {
+					sample_ |= 1L << sampleBits_;
+				}
+				if (++sampleBits_ == pins_.length) {
+					bufferPush(sample_);
+					sample_ = 0;
+					sampleBits_ = 0;
+				}
+			}
+		}
+		notifyAll();
+	}
+
+	private void bufferPush(long sample) {
+		if (bufferSize_ == buffer_.length) {
+			++overflowCount_;
+			return;
+		}
+		buffer_[bufferWriteCursor_++] = sample;
+		if (bufferWriteCursor_ == buffer_.length) {
+			bufferWriteCursor_ = 0;
+		}
+		++bufferSize_;
+	}
+
+	@Override
+	synchronized public void read(boolean[] values)
+			throws InterruptedException, ConnectionLostException {
+		checkState();
+		while (bufferSize_ == 0 && state_ == State.OPEN) {
+			wait();
+		}
+		checkState();
+		final long sample = buffer_[bufferReadCursor_++];
+		if (bufferReadCursor_ == buffer_.length) {
+			bufferReadCursor_ = 0;
+		}
+		--bufferSize_;
+		for (int i = 0; i < order_.length; ++i) {
+			values[order_[i]] = (sample & (1L << i)) != 0;
+		}
+	}
+
+	@Override
+	synchronized public int available() throws ConnectionLostException {
+		checkState();
+		return bufferSize_;
+	}
+
+	@Override
+	synchronized public int getOverflowCount() throws ConnectionLostException {
+		checkState();
+		return overflowCount_;
+	}
+
+	@Override
+	public float getSampleRate() {
+		return sampleRate_;
+	}
+
+	@Override
+	public synchronized void disconnected() {
+		super.disconnected();
+		notifyAll();
+	}
+
+	@Override
+	public synchronized void close() {
+		ioio_.closePeriodicDigitalInput(pins_);
+		super.close();
+		notifyAll();
+	}
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *  
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * 
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ * 
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+package ioio.lib.impl;
+
+import ioio.lib.api.PwmGroup;
+import ioio.lib.api.PwmOutput;
+import ioio.lib.api.exception.ConnectionLostException;
+
+import java.io.IOException;
+
+class PwmGroupImpl extends AbstractResource implements PwmGroup {
+	private final PwmImpl[] outputs_;
+	private final int[] pwmNums_;
+
+	public PwmGroupImpl(IOIOImpl ioio, PwmImpl[] outputs)
+			throws ConnectionLostException {
+		super(ioio);
+		outputs_ = outputs;
+		pwmNums_ = new int[outputs.length];
+		for (int i = 0; i < outputs.length; ++i) {
+			pwmNums_[i] = outputs[i].pwmNum_;
+		}
+	}
+
+	@Override
+	public void setDutyCycles(float[] dutyCycles)
+			throws ConnectionLostException {
+		checkLength(dutyCycles);
+		int[] duties = new int[outputs_.length];
+		for (int i = 0; i < duties.length; ++i) {
+			assert (dutyCycles[i] <= 1 && dutyCycles[i] >= 0);
+			duties[i] = outputs_[i].clocksToDuty(outputs_[i]
+					.dutyCycleToClocks(dutyCycles[i]));
+		}
+		update(duties);
+	}
+
+	@Override
+	public void setPulseWidths(float[] pulseWidthsUs)
+			throws ConnectionLostException {
+		checkLength(pulseWidthsUs);
+		int[] duties = new int[outputs_.length];
+		for (int i = 0; i < duties.length; ++i) {
+			assert (pulseWidthsUs[i] >= 0);
+			duties[i] = outputs_[i].clocksToDuty(outputs_[i]
+					.pulseWidthToClocks(pulseWidthsUs[i]));
+		}
+		update(duties);
+	}
+
+	@Override
+	public PwmOutput get(int index) {
+		return outputs_[index];
+	}
+
+	private void checkLength(float[] values) {
+		if (values.length != outputs_.length) {
+			throw new IllegalArgumentException("Expected "
+					+ outputs_.length + " values, got " + values.length);
+		}
+	}
+
+	synchronized private void update(int[] duties)
+			throws ConnectionLostException {
+		checkState();
+		try {
+			ioio_.protocol_.pwmGroupUpdate(pwmNums_, duties);
+		} catch (IOException e) {
+			throw new ConnectionLostException(e);
+		}
+	}
+
+	@Override
+	public synchronized void close() {
+		super.close();
+		// The first is the one the others are synchronized to, so it goes last.
+		for (int i = outputs_.length - 1; i >= 0; --i) {
+			outputs_[i].close();
+		}
+	}
+}
@@ -34,7 +34,7 @@ import ioio.lib.api.exception.ConnectionLostException;
 import java.io.IOException;
 
 class PwmImpl extends AbstractResource implements PwmOutput {
-	private final int pwmNum_;
+	final int pwmNum_;
 	private final int pinNum_;
 	private final float baseUs_;
 	private final int period_;
@@ -58,7 +58,7 @@ class PwmImpl extends AbstractResource implements PwmOutput {
 	@Override
 	public void setDutyCycle(float dutyCycle) throws ConnectionLostException {
 		assert (dutyCycle <= 1 && dutyCycle >= 0);
-		setPulseWidthInClocks(period_ * dutyCycle);
+		setPulseWidthInClocks(dutyCycleToClocks(dutyCycle));
 	}
 
 	@Override
@@ -70,13 +70,33 @@ class PwmImpl extends AbstractResource implements PwmOutput {
 	public void setPulseWidth(float pulseWidthUs)
 			throws ConnectionLostException {
 		assert (pulseWidthUs >= 0);
-		float p = pulseWidthUs / baseUs_;
-		setPulseWidthInClocks(p);
+		setPulseWidthInClocks(pulseWidthToClocks(pulseWidthUs));
 	}
 
 	synchronized private void setPulseWidthInClocks(float p)
 			throws ConnectionLostException {
 		checkState();
+		final int duty = clocksToDuty(p);
+		try {
+			ioio_.protocol_.setPwmDutyCycle(pwmNum_, duty >> 2, duty & 0x03);
+		} catch (IOException e) {
+			throw new ConnectionLostException(e);
+		}
+	}
+
+	float dutyCycleToClocks(float dutyCycle) {
+		return period_ * dutyCycle;
+	}
+
+	float pulseWidthToClocks(float pulseWidthUs) {
+		return pulseWidthUs / baseUs_;
+	}
+
+	/**
+	 * The duty cycle register value and fraction for a pulse width, packed as
+	 * (value << 2) | fraction.
+	 */
+	int clocksToDuty(float p) {
 		if (p > period_) {
 			p = period_;
 		}
@@ -92,10 +112,6 @@ class PwmImpl extends AbstractResource implements PwmOutput {
 			pw = (int) p;
 			fraction = ((int) p * 4) & 0x03;
 		}
-		try {
-			ioio_.protocol_.setPwmDutyCycle(pwmNum_, pw, fraction);
-		} catch (IOException e) {
-			throw new ConnectionLostException(e);
-		}
+		return pw << 2 | fraction;
 	}
 }
@@ -0,0 +1,129 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *  
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * 
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ * 
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+package ioio.lib.impl;
+
+import ioio.lib.api.PwmSequencer;
+import ioio.lib.api.exception.ConnectionLostException;
+import ioio.lib.impl.IncomingState.DataModuleListener;
+
+import java.io.IOException;
+
+class PwmSequencerImpl extends PwmImpl implements PwmSequencer,
+		DataModuleListener {
+	private static final int MAX_STEPS_PER_MESSAGE = 16;
+
+	private final boolean loop_;
+	private int available_ = 0;
+	private int written_ = 0;
+
+	public PwmSequencerImpl(IOIOImpl ioio, int pinNum, int pwmNum, int period,
+			float baseUs, boolean loop) throws ConnectionLostException {
+		super(ioio, pinNum, pwmNum, period, baseUs);
+		loop_ = loop;
+	}
+
+	@Override
+	public void writeDutyCycles(float[] dutyCycles)
+			throws InterruptedException, ConnectionLostException {
+		int[] duties = new int[dutyCycles.length];
+		for (int i = 0; i < duties.length; ++i) {
+			assert (dutyCycles[i] <= 1 && dutyCycles[i] >= 0);
+			duties[i] = clocksToDuty(dutyCycleToClocks(dutyCycles[i]));
+		}
+		write(duties);
+	}
+
+	@Override
+	public void writePulseWidths(float[] pulseWidthsUs)
+			throws InterruptedException, ConnectionLostException {
+		int[] duties = new int[pulseWidthsUs.length];
+		for (int i = 0; i < duties.length; ++i) {
+			assert (pulseWidthsUs[i] >= 0);
+			duties[i] = clocksToDuty(pulseWidthToClocks(pulseWidthsUs[i]));
+		}
+		write(duties);
+	}
+
+	synchronized private void write(int[] duties)
+			throws InterruptedException, ConnectionLostException {
+		checkState();
+		if (loop_ && written_ + duties.length > CAPACITY) {
+			throw new IllegalStateException("A loop can have at most "
+					+ CAPACITY + " steps");
+		}
+		int pos = 0;
+		while (pos < duties.length) {
+			while (available_ == 0 && state_ == State.OPEN) {
+				wait();
+			}
+			checkState();
+			final int n = Math.min(Math.min(available_, MAX_STEPS_PER_MESSAGE),
+					duties.length - pos);
+			try {
+				ioio_.protocol_.pwmSeqData(pwmNum_, duties, pos, n);
+			} catch (IOException e) {
+				throw new ConnectionLostException(e);
+			}
+			available_ -= n;
+			written_ += n;
+			pos += n;
+		}
+	}
+
+	@Override
+	synchronized public int available() throws ConnectionLostException {
+		checkState();
+		return available_;
+	}
+
+	@Override
+	public synchronized void dataReceived(byte[] data, int size) {
+	}
+
+	@Override
+	public synchronized void reportAdditionalBuffer(int stepsToAdd) {
+		available_ += stepsToAdd;
+		notifyAll();
+	}
+
+	@Override
+	public synchronized void close() {
+		// Stop while the module is still ours.
+		if (state_ == State.OPEN) {
+			ioio_.closePwmSequencer(pwmNum_);
+		}
+		super.close();
+	}
+
+	@Override
+	public synchronized void disconnected() {
+		notifyAll();
+		super.disconnected();
+	}
+}
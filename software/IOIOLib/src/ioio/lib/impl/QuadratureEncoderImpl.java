@@ -0,0 +1,121 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *  
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * 
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ * 
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+package ioio.lib.impl;
+
+import ioio.lib.api.QuadratureEncoder;
+import ioio.lib.api.exception.ConnectionLostException;
+import ioio.lib.impl.IncomingState.EncoderListener;
+
+import java.io.IOException;
+
+class QuadratureEncoderImpl extends AbstractResource implements
+		QuadratureEncoder, EncoderListener {
+	private final int encoderNum_;
+	private final int pinA_;
+	private final int pinB_;
+	private int position_;
+	private float velocity_ = 0;
+	// Counts every report received, so that update() can tell when a new one
+	// has come in.
+	private int numReports_ = 0;
+
+	QuadratureEncoderImpl(IOIOImpl ioio, int encoderNum, int pinA, int pinB)
+			throws ConnectionLostException {
+		super(ioio);
+		encoderNum_ = encoderNum;
+		pinA_ = pinA;
+		pinB_ = pinB;
+	}
+
+	@Override
+	synchronized public void reportReceived(int position, int delta,
+			long interval) {
+		position_ = position;
+		if (interval > 0) {
+			velocity_ = delta * 1e6f / interval;
+		}
+		++numReports_;
+		notifyAll();
+	}
+
+	@Override
+	synchronized public int getPosition() throws InterruptedException,
+			ConnectionLostException {
+		waitFirstReport();
+		return position_;
+	}
+
+	@Override
+	synchronized public float getVelocity() throws InterruptedException,
+			ConnectionLostException {
+		waitFirstReport();
+		return velocity_;
+	}
+
+	@Override
+	synchronized public void update() throws InterruptedException,
+			ConnectionLostException {
+		checkState();
+		ioio_.protocol_.checkNotRecording("encoder reads");
+		final int reports = numReports_;
+		try {
+			ioio_.protocol_.encoderRead(encoderNum_);
+		} catch (IOException e) {
+			throw new ConnectionLostException(e);
+		}
+		// Reports come in order, so any report after the request is at least
+		// as recent as the one requested.
+		while (numReports_ == reports && state_ == State.OPEN) {
+			wait();
+		}
+		checkState();
+	}
+
+	private void waitFirstReport() throws InterruptedException,
+			ConnectionLostException {
+		checkState();
+		while (numReports_ == 0 && state_ == State.OPEN) {
+			wait();
+		}
+		checkState();
+	}
+
+	@Override
+	public synchronized void disconnected() {
+		super.disconnected();
+		notifyAll();
+	}
+
+	@Override
+	public synchronized void close() {
+		ioio_.closeQuadratureEncoder(encoderNum_, pinA_, pinB_);
+		super.close();
+		notifyAll();
+	}
+}
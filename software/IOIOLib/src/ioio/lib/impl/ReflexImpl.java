@@ -0,0 +1,85 @@
+/*
+ * Copyright 2011 Ytai Ben-Tsvi. All rights reserved.
+ *  
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, are
+ * permitted provided that the following conditions are met:
+ * 
+ *    1. Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ * 
+ *    2. Redistributions in binary form must reproduce the above copyright notice, this list
+ *       of conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ARSHAN POURSOHI OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * The views and conclusions contained in the software and documentation are those of the
+ * authors and should not be interpreted as representing official policies, either expressed
+ * or implied.
+ */
+package ioio.lib.impl;
+
+import ioio.lib.api.Reflex;
+import ioio.lib.api.exception.ConnectionLostException;
+import ioio.lib.impl.IncomingState.ReflexListener;
+
+class ReflexImpl extends AbstractResource implements Reflex, ReflexListener {
+	private final int reflexNum_;
+	private int count_ = 0;
+	private long timestamp_ = -1;
+
+	ReflexImpl(IOIOImpl ioio, int reflexNum) throws ConnectionLostException {
+		super(ioio);
+		reflexNum_ = reflexNum;
+	}
+
+	@Override
+	synchronized public void fired(long time) {
+		++count_;
+		timestamp_ = time;
+		notifyAll();
+	}
+
+	@Override
+	synchronized public int getCount() throws ConnectionLostException {
+		checkState();
+		return count_;
+	}
+
+	@Override
+	synchronized public void waitForCount(int count)
+			throws InterruptedException, ConnectionLostException {
+		while (count_ < count && state_ == State.OPEN) {
+			wait();
+		}
+		checkState();
+	}
+
+	@Override
+	synchronized public long getTimestamp() throws ConnectionLostException {
+		checkState();
+		return timestamp_;
+	}
+
+	@Override
+	public synchronized void disconnected() {
+		super.disconnected();
+		notifyAll();
+	}
+
+	@Override
+	public synchronized void close() {
+		ioio_.closeReflex(reflexNum_);
+		super.close();
+		notifyAll();
+	}
+}
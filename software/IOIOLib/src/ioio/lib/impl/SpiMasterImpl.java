@@ -124,6 +124,7 @@ class SpiMasterImpl extends AbstractResource implements SpiMaster,
 			int writeSize, int totalSize, byte[] readData, int readSize)
 			throws ConnectionLostException {
 		checkState();
+		ioio_.protocol_.checkNotRecording("SPI transactions");
 		SpiResult result = new SpiResult(readData);
 
 		OutgoingPacket p = new OutgoingPacket();
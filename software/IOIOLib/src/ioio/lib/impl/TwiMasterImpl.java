@@ -110,6 +110,7 @@ class TwiMasterImpl extends AbstractResource implements TwiMaster,
 			byte[] writeData, int writeSize, byte[] readData, int readSize)
 			throws ConnectionLostException {
 		checkState();
+		ioio_.protocol_.checkNotRecording("TWI transactions");
 		TwiResult result = new TwiResult(readData);
 
 		OutgoingPacket p = new OutgoingPacket();
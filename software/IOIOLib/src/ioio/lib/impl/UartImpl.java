@@ -42,10 +42,17 @@ import java.io.OutputStream;
 class UartImpl extends AbstractResource implements DataModuleListener, Sender, Uart {
 	private static final int MAX_PACKET = 64;
 	
-	private final int uartNum_;
+	final int uartNum_;
 	private final int rxPinNum_;
 	private final int txPinNum_;
-	private final FlowControlledOutputStream outgoing_ = new FlowControlledOutputStream(this, MAX_PACKET);
+	private final FlowControlledOutputStream outgoing_ = new FlowControlledOutputStream(this, MAX_PACKET) {
+		@Override
+		public void write(int oneByte) throws IOException {
+			// The flush thread would send it right away.
+			ioio_.protocol_.checkNotRecording("UART output");
+			super.write(oneByte);
+		}
+	};
 	private final QueueInputStream incoming_ = new QueueInputStream();
 	
 	public UartImpl(IOIOImpl ioio, int txPin, int rxPin, int uartNum) throws ConnectionLostException {
@@ -100,6 +107,35 @@ class UartImpl extends AbstractResource implements DataModuleListener, Sender, U
 		return outgoing_;
 	}
 
+	@Override
+	synchronized public void setRxAggregation(int minBatch, int maxFrame,
+			int idleTimeoutUs, int maxLatencyMs)
+			throws ConnectionLostException {
+		checkState();
+		ioio_.checkCapability(IOIOProtocol.CAPABILITY_UART_RX_AGGREGATION,
+				"RX aggregation");
+		if (maxFrame < 1 || maxFrame > MAX_FRAME) {
+			throw new IllegalArgumentException("Illegal maxFrame: " + maxFrame);
+		}
+		if (minBatch < 1 || minBatch > maxFrame) {
+			throw new IllegalArgumentException("Illegal minBatch: " + minBatch);
+		}
+		if (idleTimeoutUs < 0 || idleTimeoutUs > 0xFFFF * 100) {
+			throw new IllegalArgumentException("Illegal idleTimeoutUs: "
+					+ idleTimeoutUs);
+		}
+		if (maxLatencyMs < 0 || maxLatencyMs > 0xFFFF) {
+			throw new IllegalArgumentException("Illegal maxLatencyMs: "
+					+ maxLatencyMs);
+		}
+		try {
+			ioio_.protocol_.uartRxAggregation(uartNum_, minBatch, maxFrame,
+					idleTimeoutUs, maxLatencyMs);
+		} catch (IOException e) {
+			throw new ConnectionLostException(e);
+		}
+	}
+
 	@Override
 	public void reportAdditionalBuffer(int bytesRemaining) {
 		outgoing_.readyToSend(bytesRemaining);